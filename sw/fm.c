@@ -11,125 +11,43 @@
 #include <signal.h>
 #include <time.h>
 
-// Конфигурация
-#define BASE_ADDR 0x43c30000
-#define PAGE_SIZE 4096
-#define CONFIG_FILE "/etc/fm_transmitter.conf"
-#define REFRESH_RATE 25    // Обновлений в секунду
-#define FRAME_DELAY (1000000 / REFRESH_RATE)  // мкс на кадр
-#define PEAK_HOLD_TIME 500  // Удержание пика в миллисекундах
-
-// Адреса регистров
-#define REG_VERSION   0x00
-#define REG_CTRL      0x04
-#define REG_FREQ      0x08
-#define REG_MPXLVL    0x0C
-#define REG_LEFT      0x10
-#define REG_RIGHT     0x14
-#define REG_STATUS    0x18
-#define REG_BALANCE   0x1C
-
-// Бит mute в контрольном регистре
-#define CTRL_MUTE_BIT (1 << 5)
-
-// Биты преэмфаза в контрольном регистре (3-4 биты)
-#define PREEMPHASIS_MASK 0x18  // биты 3-4 (00011000)
-#define PREEMPHASIS_BYPASS 0x00    // 00 (байпас)
-#define PREEMPHASIS_50US   0x08    // 01 (50 µs)
-#define PREEMPHASIS_75US   0x10    // 10 (75 µs)
-
-// Константы
-#define DDS_STEP 0.0286086784756944  // Шаг частоты в Гц
-#define MPX_MAX 0xFFFFFF  // Максимальное значение MPX (24 бита)
-#define AUDIO_MAX 32767   // Максимальное значение аудио (16 бит)
-
-// Уровни в дБ относительно полной шкалы
-#define DBFS_FULL_SCALE 0.0      // 0 dBFS = 32767
-#define DBFS_MINUS_12 (-12.0)    // -12 dBFS
-#define DBFS_MINUS_9 (-9.0)      // -9 dBFS (75 кГц девиации)
-#define DBFS_TO_LIN(db) (pow(10.0, (db) / 20.0) * AUDIO_MAX)
-
-// Пороговые значения для цветов аудио
-#define AUDIO_GREEN_MAX DBFS_TO_LIN(DBFS_MINUS_12)   // -12 dBFS = 8202
-#define AUDIO_YELLOW_MAX DBFS_TO_LIN(DBFS_MINUS_9)   // -9 dBFS = 11601
-
-// Пороговые значения для MPX (кГц) - ИЗМЕНЕНО
-#define MPX_GREEN_MAX 60.0    // до 60 кГц - зеленый
-#define MPX_YELLOW_MAX 75.0   // 60-75 кГц - желтый
-                           // выше 75 кГц - красный (новый порог)
-
-// Цвета ANSI
-#define COLOR_RESET   "\033[0m"
-#define COLOR_RED     "\033[31m"
-#define COLOR_GREEN   "\033[32m"
-#define COLOR_YELLOW  "\033[33m"
-#define COLOR_BLUE    "\033[34m"
-#define COLOR_CYAN    "\033[36m"
-#define BOLD          "\033[1m"
-#define COLOR_MAGENTA "\033[35m"
-#define BG_RED        "\033[41m"
-#define BG_GREEN      "\033[42m"
-#define BG_YELLOW     "\033[43m"
-
-// Структура для управления
-typedef struct {
-    uint32_t base_addr;
-    volatile uint32_t *regs;
-    void *map_base;
-    int fd;
-    int tx_en;
-    int stereo_en;
-    int rds_en;
-    int mute_en;
-    int preemphasis_mode;  // 0=bypass, 1=50us, 2=75us
-    double freq_mhz;
-    int auto_refresh;      // Автообновление уровней
-    volatile int running;  // Флаг работы программы
-    int screen_height;     // Высота экрана в строках
-    int menu_height;       // Высота меню в строках
-} fm_transmitter_t;
+#include "fm.h"
+#include "fm_sched.h"
+#include "fm_rt.h"
+#include "fm_audio.h"
+#include "fm_latency.h"
+#include "fm_pcm.h"
+#include "fm_loudness.h"
+#include "fm_phase.h"
+#include "fm_bench.h"
+#include "fm_boot.h"
+#include "fm_gen.h"
+#include "fm_rec.h"
+#include "fm_delay.h"
+#include "fm_ptp.h"
+#include "fm_xadc.h"
+#include "fm_proc.h"
+#include "fm_mcast.h"
+#include "fm_fleet.h"
+#include "fm_mix.h"
+#include "fm_health.h"
+#include "fm_rds.h"
+#include "fm_stream.h"
+#include "fm_playlist.h"
+#include "fm_config.h"
+#include "fm_tui.h"
+#include "fm_cal.h"
 
 // Глобальные переменные для обработки сигналов
 fm_transmitter_t *global_tx = NULL;
 
-// Структура для удержания пиковых значений
-typedef struct {
-    double mpx_khz;
-    int left;
-    int right;
-    long timestamp;  // Время последнего обновления в мс
-} peak_holder_t;
-
 peak_holder_t peak_values = {0, 0, 0, 0};
 
-// Прототипы функций
-void signal_handler(int sig);
-double lin_to_dbfs(int value);
-double mpx_to_khz(uint32_t mpx_raw);
-void update_peak_values(uint32_t mpx_raw, int16_t left, int16_t right);
-const char* get_audio_color(int value);
-const char* get_mpx_color(double khz);
-void print_audio_bar(int value, int max_value, int width);
-void print_mpx_bar(double khz, int width);
-double str_to_double(const char *str);
-int fm_init(fm_transmitter_t *tx, uint32_t base_addr);
-void fm_close(fm_transmitter_t *tx);
-uint32_t fm_read(fm_transmitter_t *tx, uint32_t offset);
-void fm_write(fm_transmitter_t *tx, uint32_t offset, uint32_t value);
-void fm_update_state(fm_transmitter_t *tx);
-void fm_set_frequency(fm_transmitter_t *tx, double freq_mhz);
-void fm_update_control(fm_transmitter_t *tx);
-void fm_toggle_preemphasis(fm_transmitter_t *tx);
-const char* get_preemphasis_str(int mode);
-void save_settings(const fm_transmitter_t *tx);
-int load_settings(fm_transmitter_t *tx);
-void auto_apply_settings(fm_transmitter_t *tx);
-void clear_screen();
-int kbhit();
-int getch_nonblock();
-void print_menu(fm_transmitter_t *tx, int clear_before);
-void frequency_dialog(fm_transmitter_t *tx);
-void print_help();
+// Измеритель громкости для интерфейса (NULL - нет источника PCM)
+loudness_t *tui_loudness = NULL;
+
+// Слежение за конфигом для строки состояния интерфейса (NULL - нет --watch)
+config_watch_t *tui_watch = NULL;
 
 // Обработчик сигналов для корректного завершения
 void signal_handler(int sig) {
@@ -248,24 +166,24 @@ void print_audio_bar(int value, int max_value, int width) {
     for (int i = 0; i < width; i++) {
         if (i < bars) {
             if (i < green_limit) {
-                printf("%s█", COLOR_GREEN);
+                tui_printf("%s█", COLOR_GREEN);
             } else if (i < available_width) {
-                printf("%s█", COLOR_YELLOW);
+                tui_printf("%s█", COLOR_YELLOW);
             } else {
-                printf("%s█", COLOR_RED);  // Красная зона (последний символ)
+                tui_printf("%s█", COLOR_RED);  // Красная зона (последний символ)
             }
         } else {
             // Фон ползунка
             if (i < green_limit) {
-                printf("%s░", COLOR_GREEN);
+                tui_printf("%s░", COLOR_GREEN);
             } else if (i < available_width) {
-                printf("%s░", COLOR_YELLOW);
+                tui_printf("%s░", COLOR_YELLOW);
             } else {
-                printf("%s░", COLOR_RED);  // Красная зона (последний символ)
+                tui_printf("%s░", COLOR_RED);  // Красная зона (последний символ)
             }
         }
     }
-    printf("%s", COLOR_RESET);
+    tui_printf("%s", COLOR_RESET);
 }
 
 // Отображение шкалы MPX с цветовой индикацией - ИСПРАВЛЕНА
@@ -283,24 +201,59 @@ void print_mpx_bar(double khz, int width) {
     for (int i = 0; i < width; i++) {
         if (i < bars) {
             if (i < green_limit) {
-                printf("%s█", COLOR_GREEN);
+                tui_printf("%s█", COLOR_GREEN);
             } else if (i < yellow_limit) {
-                printf("%s█", COLOR_YELLOW);
+                tui_printf("%s█", COLOR_YELLOW);
             } else {
-                printf("%s█", COLOR_RED);
+                tui_printf("%s█", COLOR_RED);
             }
         } else {
             // Фон ползунка
             if (i < green_limit) {
-                printf("%s░", COLOR_GREEN);
+                tui_printf("%s░", COLOR_GREEN);
             } else if (i < yellow_limit) {
-                printf("%s░", COLOR_YELLOW);
+                tui_printf("%s░", COLOR_YELLOW);
             } else {
-                printf("%s░", COLOR_RED);
+                tui_printf("%s░", COLOR_RED);
             }
         }
     }
-    printf("%s", COLOR_RESET);
+    tui_printf("%s", COLOR_RESET);
+}
+
+// Корреляция L/R: полоса от нуля, влево красная (противофаза), и векторскоп
+void print_phase_meter(int width) {
+    static const char dots[PHASE_SCOPE_LEVELS] = { ' ', '.', ':', 'o', '#' };
+    phase_snapshot_t ph;
+    phase_get(phase_meter, &ph);
+
+    int center = width / 2;
+    int pos = (int)lrint((ph.corr + 1.0) / 2.0 * (width - 1));
+    tui_printf("  COR: ");
+    for (int i = 0; i < width; i++) {
+        int lit = !ph.silent && (pos >= center ? i >= center && i <= pos : i >= pos && i < center);
+        tui_printf("%s%s", i < center ? COLOR_RED : COLOR_GREEN, lit ? "█" : "░");
+    }
+    if (ph.silent) {
+        tui_printf("%s   --   (silence)\n", COLOR_RESET);
+    } else {
+        tui_printf(" %s%+6.2f%s  min %s%+5.2f%s  bal %+5.1f dB  S/M %+5.1f dB\n",
+               ph.corr < 0 ? COLOR_RED : COLOR_GREEN, ph.corr, COLOR_RESET,
+               ph.corr_min < 0 ? COLOR_RED : COLOR_RESET, ph.corr_min, COLOR_RESET,
+               ph.balance_db, ph.side_db);
+    }
+
+    // M вверх, S вбок: моно - вертикаль, L слева, R справа, противофаза - горизонталь
+    for (int r = 0; r < PHASE_SCOPE_H; r++) {
+        char line[PHASE_SCOPE_W + 1];
+        for (int c = 0; c < PHASE_SCOPE_W; c++) {
+            int v = ph.scope[r][c];
+            line[c] = v ? dots[v] : c == PHASE_SCOPE_W / 2 ? '|' : r == PHASE_SCOPE_H / 2 ? '-' : ' ';
+        }
+        line[PHASE_SCOPE_W] = '\0';
+        tui_printf("     %s %s%s%s %s\n", r == 0 ? "L" : " ", ph.corr < 0 ? COLOR_RED : COLOR_CYAN,
+               line, COLOR_RESET, r == 0 ? "R" : " ");
+    }
 }
 
 // Функции преобразования
@@ -348,6 +301,42 @@ int fm_init(fm_transmitter_t *tx, uint32_t base_addr) {
     return 0;
 }
 
+// Инициализация симулятора: регистры лежат в обычном файле,
+// поэтому несколько процессов видят одно и то же "железо"
+int fm_init_sim(fm_transmitter_t *tx, const char *path) {
+    tx->base_addr = 0;
+    tx->fd = open(path, O_RDWR | O_CREAT, 0644);
+    
+    if (tx->fd == -1) {
+        printf("%sОшибка: Не могу открыть %s%s\n", COLOR_RED, path, COLOR_RESET);
+        return -1;
+    }
+    
+    if (ftruncate(tx->fd, PAGE_SIZE) != 0) {
+        perror("Ошибка ftruncate");
+        close(tx->fd);
+        return -1;
+    }
+    
+    tx->map_base = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, tx->fd, 0);
+    
+    if (tx->map_base == MAP_FAILED) {
+        perror("Ошибка маппирования");
+        close(tx->fd);
+        return -1;
+    }
+    
+    tx->regs = (volatile uint32_t*)tx->map_base;
+    if (tx->regs[REG_VERSION / 4] == 0) tx->regs[REG_VERSION / 4] = SIM_VERSION;
+    tx->auto_refresh = 0;
+    tx->running = 1;
+    tx->screen_height = 0;
+    tx->menu_height = 27;
+    tx->simulated = 1;
+    return 0;
+}
+
 // Закрытие
 void fm_close(fm_transmitter_t *tx) {
     if (tx->map_base != MAP_FAILED) munmap(tx->map_base, PAGE_SIZE);
@@ -363,6 +352,7 @@ uint32_t fm_read(fm_transmitter_t *tx, uint32_t offset) {
 // Запись регистра
 void fm_write(fm_transmitter_t *tx, uint32_t offset, uint32_t value) {
     if (!tx || !tx->regs) return;
+    health_note_write(offset, value);
     tx->regs[offset / 4] = value;
     usleep(1000);
 }
@@ -384,20 +374,25 @@ void fm_update_state(fm_transmitter_t *tx) {
     
     uint32_t ftw = fm_read(tx, REG_FREQ);
     tx->freq_mhz = (double)ftw * DDS_STEP / 1000000.0;
+    tx->balance = fm_read(tx, REG_BALANCE);
+}
+
+// Пересчет частоты в слово настройки DDS
+uint32_t fm_freq_to_ftw(double freq_mhz) {
+    double freq_hz = freq_mhz * 1000000.0;
+    return (uint32_t)(freq_hz / DDS_STEP + 0.5);
 }
 
 // Установка частоты
 void fm_set_frequency(fm_transmitter_t *tx, double freq_mhz) {
     if (freq_mhz < 0) return;
     
-    double freq_hz = freq_mhz * 1000000.0;
-    uint32_t ftw = (uint32_t)(freq_hz / DDS_STEP + 0.5);
-    fm_write(tx, REG_FREQ, ftw);
+    fm_write(tx, REG_FREQ, fm_freq_to_ftw(freq_mhz));
     tx->freq_mhz = freq_mhz;
 }
 
-// Обновление управления
-void fm_update_control(fm_transmitter_t *tx) {
+// Сборка контрольного регистра из состояния
+uint32_t fm_ctrl_word(const fm_transmitter_t *tx) {
     uint32_t ctrl = 0;
     ctrl |= tx->tx_en ? 0x1 : 0x0;
     ctrl |= tx->stereo_en ? 0x2 : 0x0;
@@ -410,7 +405,57 @@ void fm_update_control(fm_transmitter_t *tx) {
         default: ctrl |= PREEMPHASIS_BYPASS; break;
     }
     
-    fm_write(tx, REG_CTRL, ctrl);
+    return ctrl;
+}
+
+// Обновление управления
+void fm_update_control(fm_transmitter_t *tx) {
+    fm_write(tx, REG_CTRL, fm_ctrl_word(tx));
+}
+
+// Начало транзакции
+void fm_txn_begin(fm_txn_t *txn) {
+    txn->count = 0;
+}
+
+// Добавление записи в транзакцию (повторная запись в тот же регистр заменяет значение)
+void fm_txn_add(fm_txn_t *txn, uint32_t offset, uint32_t value) {
+    for (int i = 0; i < txn->count; i++) {
+        if (txn->offset[i] == offset) {
+            txn->value[i] = value;
+            return;
+        }
+    }
+    if (txn->count >= FM_TXN_MAX) return;
+    txn->offset[txn->count] = offset;
+    txn->value[txn->count] = value;
+    txn->count++;
+}
+
+// Частота, баланс и CTRL из состояния одной транзакцией (CTRL последним)
+void fm_txn_add_state(fm_txn_t *txn, const fm_transmitter_t *tx) {
+    if (tx->freq_mhz > 0 && tx->freq_mhz < 200) {
+        fm_txn_add(txn, REG_FREQ, fm_freq_to_ftw(tx->freq_mhz));
+    }
+    fm_txn_add(txn, REG_BALANCE, tx->balance);
+    fm_txn_add(txn, REG_CTRL, fm_ctrl_word(tx));
+}
+
+// Записи транзакции подряд, без паузы (ранний запуск: некому ждать)
+void fm_txn_write(fm_transmitter_t *tx, const fm_txn_t *txn) {
+    if (!tx || !tx->regs || txn->count == 0) return;
+    for (int i = 0; i < txn->count; i++) {
+        health_note_write(txn->offset[i], txn->value[i]);
+        tx->regs[txn->offset[i] / 4] = txn->value[i];
+    }
+    __sync_synchronize();
+}
+
+// Применение транзакции: записи идут подряд, одна пауза в конце
+void fm_txn_commit(fm_transmitter_t *tx, const fm_txn_t *txn) {
+    if (!tx || !tx->regs || txn->count == 0) return;
+    fm_txn_write(tx, txn);
+    usleep(1000);
 }
 
 // Переключение преэмфаза
@@ -429,10 +474,21 @@ const char* get_preemphasis_str(int mode) {
     }
 }
 
-// Сохранение настроек
-void save_settings(const fm_transmitter_t *tx) {
-    FILE *f = fopen(CONFIG_FILE, "w");
-    if (!f) return;
+// Сохранение настроек: временный файл, fsync и rename - после сбоя питания
+// на месте остается либо старый файл, либо новый целиком
+int save_settings(const fm_transmitter_t *tx) {
+    static const char *own[] = { "TX=", "STEREO=", "RDS=", "MUTE=", "PREEMPHASIS=", "FREQUENCY=", "BALANCE=" };
+    char tmp[256], dir[256], line[256];
+    
+    snprintf(tmp, sizeof(tmp), "%s.tmp", CONFIG_FILE);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    FILE *f = fdopen(fd, "w");
+    if (!f) {
+        close(fd);
+        unlink(tmp);
+        return -1;
+    }
     
     fprintf(f, "TX=%d\n", tx->tx_en);
     fprintf(f, "STEREO=%d\n", tx->stereo_en);
@@ -440,8 +496,43 @@ void save_settings(const fm_transmitter_t *tx) {
     fprintf(f, "MUTE=%d\n", tx->mute_en);
     fprintf(f, "PREEMPHASIS=%d\n", tx->preemphasis_mode);
     fprintf(f, "FREQUENCY=%.6f\n", tx->freq_mhz);
+    if (tx->balance) fprintf(f, "BALANCE=0x%08X\n", tx->balance);
+    
+    // Остальные строки (RT_*, HEALTH_*, комментарии) переносятся из старого файла
+    FILE *old = fopen(CONFIG_FILE, "r");
+    if (old) {
+        while (fgets(line, sizeof(line), old)) {
+            int mine = 0;
+            for (size_t i = 0; i < sizeof(own) / sizeof(own[0]); i++) {
+                if (strncmp(line, own[i], strlen(own[i])) == 0) mine = 1;
+            }
+            if (!mine) fputs(line, f);
+        }
+        fclose(old);
+    }
     
-    fclose(f);
+    if (fflush(f) != 0 || fsync(fd) != 0) {
+        fclose(f);
+        unlink(tmp);
+        return -1;
+    }
+    if (fclose(f) != 0 || rename(tmp, CONFIG_FILE) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    
+    // Запись каталога, чтобы сам rename тоже пережил сбой питания
+    snprintf(dir, sizeof(dir), "%s", CONFIG_FILE);
+    char *slash = strrchr(dir, '/');
+    if (slash) {
+        *(slash == dir ? slash + 1 : slash) = 0;
+        int dfd = open(dir, O_RDONLY | O_DIRECTORY);
+        if (dfd >= 0) {
+            fsync(dfd);
+            close(dfd);
+        }
+    }
+    return 0;
 }
 
 // Загрузка настроек
@@ -457,27 +548,50 @@ int load_settings(fm_transmitter_t *tx) {
         if (!value) continue;
         *value++ = 0;
         
-        if (strcmp(line, "TX") == 0) tx->tx_en = atoi(value);
-        else if (strcmp(line, "STEREO") == 0) tx->stereo_en = atoi(value);
-        else if (strcmp(line, "RDS") == 0) tx->rds_en = atoi(value);
-        else if (strcmp(line, "MUTE") == 0) tx->mute_en = atoi(value);
-        else if (strcmp(line, "PREEMPHASIS") == 0) {
-            tx->preemphasis_mode = atoi(value);
-            if (tx->preemphasis_mode < 0 || tx->preemphasis_mode > 2) tx->preemphasis_mode = 0;
-        }
-        else if (strcmp(line, "FREQUENCY") == 0) tx->freq_mhz = str_to_double(value);
+        apply_setting(tx, line, value);
     }
     
     fclose(f);
     return 1;
 }
 
-// Автоматическое применение настроек
-void auto_apply_settings(fm_transmitter_t *tx) {
+// Разбор одного параметра KEY=VALUE (общий для конфига и расписания)
+int apply_setting(fm_transmitter_t *tx, const char *key, const char *value) {
+    if (strcmp(key, "TX") == 0) tx->tx_en = atoi(value);
+    else if (strcmp(key, "STEREO") == 0) tx->stereo_en = atoi(value);
+    else if (strcmp(key, "RDS") == 0) tx->rds_en = atoi(value);
+    else if (strcmp(key, "MUTE") == 0) tx->mute_en = atoi(value);
+    else if (strcmp(key, "PREEMPHASIS") == 0) {
+        tx->preemphasis_mode = atoi(value);
+        if (tx->preemphasis_mode < 0 || tx->preemphasis_mode > 2) tx->preemphasis_mode = 0;
+    }
+    else if (strcmp(key, "FREQUENCY") == 0) tx->freq_mhz = str_to_double(value);
+    else if (strcmp(key, "BALANCE") == 0) tx->balance = strtoul(value, NULL, 0);
+    else return 0;
+    return 1;
+}
+
+// Транзакция из регистров, значение которых отличается от настроек.
+// CTRL последним: несущая включается уже на нужной частоте и с балансом
+void settings_txn(fm_transmitter_t *tx, fm_txn_t *txn) {
+    fm_txn_begin(txn);
     if (tx->freq_mhz > 0 && tx->freq_mhz < 200) {
-        fm_set_frequency(tx, tx->freq_mhz);
+        uint32_t ftw = fm_freq_to_ftw(tx->freq_mhz);
+        if (fm_read(tx, REG_FREQ) != ftw) fm_txn_add(txn, REG_FREQ, ftw);
     }
-    fm_update_control(tx);
+    if (fm_read(tx, REG_BALANCE) != tx->balance) fm_txn_add(txn, REG_BALANCE, tx->balance);
+    uint32_t ctrl = fm_ctrl_word(tx);
+    if (fm_read(tx, REG_CTRL) != ctrl) fm_txn_add(txn, REG_CTRL, ctrl);
+}
+
+// Применение настроек: пишутся только регистры, значение которых отличается,
+// все одной транзакцией. Возвращает число записанных регистров
+int auto_apply_settings(fm_transmitter_t *tx) {
+    fm_txn_t txn;
+    
+    settings_txn(tx, &txn);
+    fm_txn_commit(tx, &txn);
+    return txn.count;
 }
 
 // Очистка экрана
@@ -536,78 +650,64 @@ void get_terminal_size(int *width, int *height) {
 
 // Отображение меню
 void print_menu(fm_transmitter_t *tx, int clear_before) {
-    static struct timespec last_update = {0, 0};
-    struct timespec now;
-    long elapsed_ms;
-    
-    // Если автообновление включено, проверяем время
-    if (tx->auto_refresh && !clear_before) {
-        clock_gettime(CLOCK_MONOTONIC, &now);
-        if (last_update.tv_sec != 0) {
-            elapsed_ms = (now.tv_sec - last_update.tv_sec) * 1000 +
-                        (now.tv_nsec - last_update.tv_nsec) / 1000000;
-            if (elapsed_ms < (1000 / REFRESH_RATE)) {
-                return;  // Слишком рано для обновления
-            }
-        }
-        last_update = now;
-    }
+    // Кадр не рисуется, пока терминал не принял прошлый (кроме полной перерисовки)
+    if (!tui_frame_due(clear_before || !tx->auto_refresh)) return;
     
     if (clear_before || !tx->auto_refresh) {
-        clear_screen();
+        tui_printf("\033[2J\033[H");
     } else {
         // В режиме автообновления перемещаем курсор в начало
-        printf("\033[H");
+        tui_printf("\033[H");
     }
     
     // Заголовок
-    printf("%s┌────────────────────────────────────────────────────────────────┐%s\n", COLOR_BLUE, COLOR_RESET);
-    printf("%s│   %sAntminer S9 FM TRANSMITTER by Denis Koryakin @denisfk1985%s    %s│%s\n", COLOR_BLUE, BOLD, COLOR_RESET, COLOR_BLUE, COLOR_RESET);
-    printf("%s└────────────────────────────────────────────────────────────────┘%s\n\n", COLOR_BLUE, COLOR_RESET);
+    tui_printf("%s┌────────────────────────────────────────────────────────────────┐%s\n", COLOR_BLUE, COLOR_RESET);
+    tui_printf("%s│   %sAntminer S9 FM TRANSMITTER by Denis Koryakin @denisfk1985%s    %s│%s\n", COLOR_BLUE, BOLD, COLOR_RESET, COLOR_BLUE, COLOR_RESET);
+    tui_printf("%s└────────────────────────────────────────────────────────────────┘%s\n\n", COLOR_BLUE, COLOR_RESET);
     
     // Частота
-    printf("%s  ═══ %s%.1f MHz%s%s ═══%s\n\n", 
+    tui_printf("%s  ═══ %s%.1f MHz%s%s ═══%s\n\n", 
            COLOR_CYAN, BOLD, tx->freq_mhz, COLOR_RESET, COLOR_CYAN, COLOR_RESET);
     
     // Статусы
-    printf("%s[%s1]%s TX:     %s%s%s\n", 
+    tui_printf("%s[%s1]%s TX:     %s%s%s\n", 
            COLOR_YELLOW, COLOR_RESET, COLOR_CYAN,
            tx->tx_en ? COLOR_GREEN : COLOR_RED,
            tx->tx_en ? " ● ON Air!    " : " ○ No carrier",
            COLOR_RESET);
     
-    printf("%s[%s2]%s STEREO: %s%s%s\n", 
+    tui_printf("%s[%s2]%s STEREO: %s%s%s\n", 
            COLOR_YELLOW, COLOR_RESET, COLOR_CYAN,
            tx->stereo_en ? COLOR_GREEN : COLOR_RED,
            tx->stereo_en ? " ● ON " : " ○ OFF",
            COLOR_RESET);
     
-    printf("%s[%s3]%s RDS:    %s%s%s\n", 
+    tui_printf("%s[%s3]%s RDS:    %s%s%s\n", 
            COLOR_YELLOW, COLOR_RESET, COLOR_CYAN,
            tx->rds_en ? COLOR_GREEN : COLOR_RED,
            tx->rds_en ? " ● ON " : " ○ OFF",
            COLOR_RESET);
     
-    printf("%s[%s4]%s MUTE:   %s%s%s\n", 
+    tui_printf("%s[%s4]%s MUTE:   %s%s%s\n", 
            COLOR_YELLOW, COLOR_RESET, COLOR_CYAN,
            tx->mute_en ? COLOR_MAGENTA : COLOR_YELLOW,
            tx->mute_en ? " ● MUTED " : " ○ OFF  ",
            COLOR_RESET);
     
-    printf("%s[%s5]%s PRE:    %s%s%s\n\n", 
+    tui_printf("%s[%s5]%s PRE:    %s%s%s\n\n", 
            COLOR_YELLOW, COLOR_RESET, COLOR_CYAN,
            tx->preemphasis_mode == 0 ? COLOR_YELLOW : COLOR_GREEN,
            get_preemphasis_str(tx->preemphasis_mode),
            COLOR_RESET);
     
     // Заголовок для уровней
-    printf("%sAUDIO LEVELS ", COLOR_BLUE);
+    tui_printf("%sAUDIO LEVELS ", COLOR_BLUE);
     if (tx->auto_refresh) {
-        printf("%s[AUTO REFRESH]  ", COLOR_GREEN);
+        tui_printf("%s[AUTO REFRESH] %4.1f fps, %ld dropped  ", COLOR_GREEN, tui_out.fps, tui_out.dropped);
     } else {
-        printf("%s[MANUAL]        ", COLOR_YELLOW);
+        tui_printf("%s[MANUAL]        ", COLOR_YELLOW);
     }
-    printf("%s\n%s", COLOR_BLUE, COLOR_RESET);
+    tui_printf("%s\n%s", COLOR_BLUE, COLOR_RESET);
     
     uint32_t left_raw = fm_read(tx, REG_LEFT) & 0xFFFF;
     uint32_t right_raw = fm_read(tx, REG_RIGHT) & 0xFFFF;
@@ -622,70 +722,126 @@ void print_menu(fm_transmitter_t *tx, int clear_before) {
     // Обновляем пиковые значения (текущие MPX всегда обновляются)
     update_peak_values(mpxlvl_raw, left, right);
     
+    loudness_snapshot_t loud;
+    if (tui_loudness) loudness_get(tui_loudness, &loud);
+    
     // Левый канал
-    printf("    L: ");
+    tui_printf("    L: ");
     print_audio_bar(left, AUDIO_MAX, 16);
-    printf(" %s%6.1f dBFS%s", get_audio_color(left), lin_to_dbfs(left), COLOR_RESET);
+    tui_printf(" %s%6.1f dBFS%s", get_audio_color(left), lin_to_dbfs(left), COLOR_RESET);
     
     // Пиковый индикатор
     if (abs(left) == peak_values.left && peak_values.left > AUDIO_GREEN_MAX) {
-        printf(" %s▲", get_audio_color(peak_values.left));
+        tui_printf(" %s▲%s", get_audio_color(peak_values.left), COLOR_RESET);
+    } else if (tui_loudness) {
+        tui_printf("  ");
+    }
+    
+    // Громкость BS.1770: мгновенная и кратковременная
+    if (tui_loudness) {
+        tui_printf("  %sM%s %5.1f  %sS%s %5.1f LUFS",
+               COLOR_CYAN, COLOR_RESET, loud.momentary, COLOR_CYAN, COLOR_RESET, loud.shortterm);
     }
-    printf("\n");
+    tui_printf("\n");
     
     // Правый канал
-    printf("    R: ");
+    tui_printf("    R: ");
     print_audio_bar(right, AUDIO_MAX, 16);
-    printf(" %s%6.1f dBFS%s", get_audio_color(right), lin_to_dbfs(right), COLOR_RESET);
+    tui_printf(" %s%6.1f dBFS%s", get_audio_color(right), lin_to_dbfs(right), COLOR_RESET);
     
     // Пиковый индикатор
     if (abs(right) == peak_values.right && peak_values.right > AUDIO_GREEN_MAX) {
-        printf(" %s▲", get_audio_color(peak_values.right));
+        tui_printf(" %s▲%s", get_audio_color(peak_values.right), COLOR_RESET);
+    } else if (tui_loudness) {
+        tui_printf("  ");
+    }
+    
+    // Интегральная громкость и истинный пик
+    if (tui_loudness) {
+        tui_printf("  %sI%s %5.1f LUFS  %sTP%s %s%5.1f%s dBTP",
+               COLOR_CYAN, COLOR_RESET, loud.integrated, COLOR_CYAN, COLOR_RESET,
+               loud.true_peak > -1.0 ? COLOR_RED : COLOR_GREEN, loud.true_peak, COLOR_RESET);
     }
-    printf("\n");
+    tui_printf("\n");
     
     // Шкала аудио с подписями
-    printf("%s", COLOR_GREEN);
-    for (int i = 0; i < 7; i++) printf(" ");
-    printf("-12dB%s", COLOR_RESET);
+    tui_printf("%s", COLOR_GREEN);
+    for (int i = 0; i < 7; i++) tui_printf(" ");
+    tui_printf("-12dB%s", COLOR_RESET);
     
-    printf("%s", COLOR_YELLOW);
-    for (int i = 0; i < 5; i++) printf(" ");
-    printf("-9dB%s", COLOR_RESET);
+    tui_printf("%s", COLOR_YELLOW);
+    for (int i = 0; i < 5; i++) tui_printf(" ");
+    tui_printf("-9dB%s", COLOR_RESET);
     
-    printf("%s", COLOR_RED);
-    printf(" O%s\n", COLOR_RESET);
+    tui_printf("%s", COLOR_RED);
+    tui_printf(" O%s\n", COLOR_RESET);
     
-    printf("\n");
+    if (phase_meter) print_phase_meter(16);
+    tui_printf("\n");
     
     // MPX в кГц с ползунком
-    printf("  MPX: ");
+    tui_printf("  MPX: ");
     print_mpx_bar(mpx_khz, 16);
-    printf(" %s%6.1f kHz%s", 
+    tui_printf(" %s%6.1f kHz%s", 
            get_mpx_color(mpx_khz),
            mpx_khz,
            COLOR_RESET);
     
     // Индикатор пика для MPX
     if (fabs(mpx_khz - peak_values.mpx_khz) < 0.1 && mpx_khz > MPX_GREEN_MAX) {
-        printf(" %s▲", get_mpx_color(mpx_khz));
+        tui_printf(" %s▲", get_mpx_color(mpx_khz));
     }
-    printf("\n");
+    tui_printf("\n");
     
     // Шкала MPX - ИЗМЕНЕНО
-    printf("%s", COLOR_GREEN);
-    printf("       60%s", COLOR_RESET);
-    
-    printf("%s", COLOR_YELLOW);
-    printf("        75%s", COLOR_RESET);
+    tui_printf("%s", COLOR_GREEN);
+    tui_printf("       60%s", COLOR_RESET);
+    
+    tui_printf("%s", COLOR_YELLOW);
+    tui_printf("        75%s", COLOR_RESET);
+    
+    tui_printf("%s", COLOR_RED);
+    tui_printf(" 100%s\n", COLOR_RESET);
+    
+    // Последнее применение конфига вместо пустой строки
+    if (tui_watch && tui_watch->applied) {
+        char stamp[16];
+        struct tm tm;
+        time_t at = tui_watch->last_at;
+        localtime_r(&at, &tm);
+        strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+        tui_printf("%sConfig reloaded %s: %d register%s written in %.2f ms%s    \n",
+               COLOR_CYAN, stamp, tui_watch->last_writes, tui_watch->last_writes == 1 ? "" : "s",
+               tui_watch->last_ms, COLOR_RESET);
+    } else {
+        tui_printf("\n");
+    }
     
-    printf("%s", COLOR_RED);
-    printf(" 100%s\n", COLOR_RESET);
+    // Защитная задержка, если запущен --delay: файл состояния читается раз в секунду
+    static delay_status_t delay_st;
+    static time_t delay_at;
+    static int delay_ok = -1;
+    if (time(NULL) != delay_at) {
+        delay_at = time(NULL);
+        delay_ok = delay_read_status(&delay_st);
+    }
+    if (delay_ok == 0) {
+        tui_printf("%sDELAY %6.2f s of %.2f s, %s, %ld dump%s  %s[D]%s Dump%s    \n",
+               COLOR_CYAN, delay_st.delay_sec, delay_st.target_sec,
+               delay_st.mode > 0 ? "building" : delay_st.mode < 0 ? "shrinking" : "holding",
+               delay_st.dumps, delay_st.dumps == 1 ? "" : "s", COLOR_YELLOW, COLOR_CYAN, COLOR_RESET);
+    }
     
-    printf("\n");
+    // Телеметрия XADC, если запущена с --xadc
+    if (xadc_active) {
+        char line[160];
+        int action = xadc_tui_line(xadc_active, line, sizeof(line));
+        tui_printf("%s%s%s    \n", action >= XADC_ACT_MUTE ? COLOR_RED : action == XADC_ACT_WARN ? COLOR_YELLOW :
+                   action < 0 ? COLOR_MAGENTA : COLOR_CYAN, line, COLOR_RESET);
+    }
     
     // Управление
-    printf("%s[1-5]%s Toggles  %s[F]%s Freq  %s[A]%s Auto(%s) %s[L]%s Load %s[S]%s Save  %s[Q]%s Quit %s\n",
+    tui_printf("%s[1-5]%s Toggles  %s[F]%s Freq  %s[A]%s Auto(%s) %s[L]%s Load %s[S]%s Save  %s[Q]%s Quit %s\n",
            COLOR_YELLOW, COLOR_RESET,
            COLOR_YELLOW, COLOR_RESET,
            COLOR_YELLOW, COLOR_RESET,
@@ -697,9 +853,9 @@ void print_menu(fm_transmitter_t *tx, int clear_before) {
            tx->mute_en ? COLOR_MAGENTA : COLOR_RESET);
     
     if (!tx->auto_refresh) {
-        printf("\n%s>%s ", COLOR_GREEN, COLOR_RESET);
+        tui_printf("\n%s>%s ", COLOR_GREEN, COLOR_RESET);
     }
-    fflush(stdout);
+    tui_frame_end(!tx->auto_refresh);
 }
 
 // Диалог установки частоты
@@ -756,6 +912,63 @@ void print_help() {
     printf("%sUsage:%s\n", BOLD, COLOR_RESET);
     printf("  fm_ctrl [--auto | -a]    Apply saved settings and exit\n");
     printf("  fm_ctrl [--help | -h]    Show this help\n");
+    printf("  fm_ctrl --schedule FILE  Run timed actions from FILE until stopped\n");
+    printf("  fm_ctrl --sim [FILE]     Use file-backed registers (default %s)\n", SIM_REGS_FILE);
+    printf("  fm_ctrl --latency [N]    Measure playback-to-capture latency N times\n");
+    printf("  fm_ctrl --play DEV       Playback device: ALSA name, file:PATH or - (default %s)\n", AUDIO_DEVICE);
+    printf("  fm_ctrl --capture DEV    Capture device: ALSA name, file:PATH or -\n");
+    printf("  fm_ctrl --buffer-us N    ALSA buffer size in microseconds\n");
+    printf("  fm_ctrl --convert FMT    Convert stdin (s16/s24/s32/f32) to S16 on the playback device\n");
+    printf("  fm_ctrl --dither MODE    none, tpdf (default) or shaped\n");
+    printf("  fm_ctrl --conv-bench     Benchmark conversion kernels\n");
+    printf("  fm_ctrl --meter DEV      Show BS.1770 loudness, true peak, L/R correlation and vectorscope of PCM from DEV\n");
+    printf("  fm_ctrl --phase-bench    Check the correlation meter on test signals and measure its CPU cost\n");
+    printf("  fm_ctrl --bench [FILE [CASE]] Time register, render, meter and DSP hot paths, JSON to FILE or stdout\n");
+    printf("  fm_ctrl --bench-compare OLD NEW [PCT] Flag cases slower by PCT%% (default %.0f), new allocations or output\n", BENCH_THRESHOLD);
+    printf("  fm_ctrl --loudness DEV   Measure loudness of a whole file or stream and exit\n");
+    printf("  fm_ctrl --process [N]    AGC, N-band compressor (1-%d, default 5) and limiter: capture -> playback\n", PROC_MAX_BANDS);
+    printf("  fm_ctrl --proc-bench [N] Per-stage CPU load of the N-band processor\n");
+    printf("  fm_ctrl --broadcast [ADDR] Send meter packets to ADDR (default %s) until stopped\n", MCAST_ADDR);
+    printf("  fm_ctrl --bcast-rate HZ  Meter packets per second, a divisor of %d (default %d)\n", MCAST_SAMPLE_HZ, MCAST_RATE);
+    printf("  fm_ctrl --id HEX         Board id in meter packets (default from MAC address)\n");
+    printf("  fm_ctrl --monitor [ADDR] Overview of all boards broadcasting to ADDR\n");
+    printf("  fm_ctrl --mcast-test N [LOSS%%] Simulate N boards (to --broadcast ADDR)\n");
+    printf("  fm_ctrl --serve [[ADDR:]PORT] Accept fleet commands (default port %d)\n", FLEET_PORT);
+    printf("  fm_ctrl --fleet FILE [CMD] Apply KEY=VALUE.../plan/preset NAME/status to all boards in FILE\n");
+    printf("  fm_ctrl --timeout MS     Per-board fleet timeout (default %d)\n", FLEET_TIMEOUT_MS);
+    printf("  fm_ctrl --no-rollback    Keep successful boards changed when others fail\n");
+    printf("  fm_ctrl --input NAME=DEV[,gain=DB][,prio=N][,duck=DB] Mixer input (DEV or tone:HZ)\n");
+    printf("  fm_ctrl --mix            Mix the inputs to the playback device, commands on %s\n", MIX_CTL_FIFO);
+    printf("  fm_ctrl --mix-bench [N]  Mixer CPU per input with N generated inputs\n");
+    printf("  fm_ctrl --rds-decode DEV Decode RDS from mono S16 MPX (file:PATH, - or capture device)\n");
+    printf("  fm_ctrl --rds-gen DEV [SEC] Write model MPX with RDS (--pi HEX, --ps TEXT, --rds-rt TEXT)\n");
+    printf("  fm_ctrl --rds-bench [SEC] Decode model MPX with noise, check the text and speed\n");
+    printf("  fm_ctrl --mpx-rate HZ    MPX sample rate for the RDS modes (default %d)\n", RDS_RATE);
+    printf("  fm_ctrl --stream URL     Play an HTTP/ICY stream (MP3, AAC, WAV, L16) to the playback device\n");
+    printf("  fm_ctrl --prebuffer MS   Stream buffer before playback and after an underrun (default %d)\n", STREAM_PREBUFFER_MS);
+    printf("  fm_ctrl --playlist PATH  Play a directory or M3U list of WAV/FLAC files gaplessly\n");
+    printf("  fm_ctrl --crossfade MS   Crossfade between playlist tracks instead of a gapless join\n");
+    printf("  fm_ctrl --loop           Repeat the playlist\n");
+    printf("  fm_ctrl --playlist-bench PATH Decode the list from a cold cache without and with read-ahead\n");
+    printf("  fm_ctrl --gen SIGNAL [SEC] Test signal to the playback device: tone, sweep, pink or multi\n");
+    printf("                           [,hz=F][,db=DB][,ch=both|l|r|anti][,from=F,to=F,sec=S]\n");
+    printf("  fm_ctrl --record DIR     Log the capture device to DIR as FLAC segments with a seek index\n");
+    printf("  fm_ctrl --rec-segment SEC Segment length (default %d, boundaries aligned to the clock)\n", REC_SEGMENT_SEC);
+    printf("  fm_ctrl --rec-seek DIR TIME [SEC] Find TIME in the log; play SEC seconds from it to --play\n");
+    printf("  fm_ctrl --delay SEC      Safety delay capture -> playback (0-%d s); dump/delay commands on %s or D key\n",
+           DELAY_MAX_SEC, DELAY_CTL_FIFO);
+    printf("  fm_ctrl --ptp IFACE      PTPv2 follower: media clock for AES67; alone prints state, with --stream steers it\n");
+    printf("  fm_ctrl --ptp-domain N   PTP domain (default %d)\n", PTP_DOMAIN);
+    printf("  fm_ctrl --xadc [DIR]     XADC temperature and rails over the IIO buffer: 1 s min/max/mean, XADC_LIMIT mute/off\n");
+    printf("  fm_ctrl --xadc-gen DIR [SEC] Write a file-backed IIO stand-in for --xadc DIR (heat-up and a VCCINT dip)\n");
+    printf("  fm_ctrl --early [LOG]    Boot: apply saved FREQ/CTRL at once, no terminal or pauses, log timing (append to LOG)\n");
+    printf("  fm_ctrl --watch          Apply changes of %s to the running instance, writing only changed registers\n", CONFIG_FILE);
+    printf("  fm_ctrl --calibrate      Tone sweep: fit deviation (-9 dBFS = 75 kHz) and L/R balance, write REG_BALANCE\n");
+    printf("  fm_ctrl --cal-model G,B  With --sim: model deviation and L/R errors in dB (default -1.2,0.6)\n");
+    printf("  fm_ctrl --health         Supervise registers, levels and player; re-apply settings on faults\n");
+    printf("  fm_ctrl --inject FAULT [MS] With --sim: ctrl, freq, reload, version, wedge or levels\n");
+    printf("  fm_ctrl --rt             SCHED_FIFO, CPU affinity and mlockall (RT_* keys in config)\n");
+    printf("  fm_ctrl --rt-test [SEC]  Measure thread wakeup latency (default 10 s)\n");
     printf("  fm_ctrl                  Interactive mode\n\n");
     printf("%sInteractive controls:%s\n", BOLD, COLOR_RESET);
     printf("  1-5    Toggle TX/Stereo/RDS/Mute/Preemphasis\n");
@@ -782,23 +995,338 @@ int main(int argc, char *argv[]) {
     signal(SIGTERM, signal_handler);
     global_tx = &tx;
     
+    const char *sim_path = NULL;
+    const char *sched_file = NULL;
+    int rt_mode = 0;
+    int rt_test_seconds = 0;
+    const char *play_dev = AUDIO_DEVICE;
+    const char *capture_dev = AUDIO_DEVICE;
+    int latency_runs = 0;
+    int conv_mode = 0;
+    int proc_bands = 0;
+    const char *bcast_addr = NULL;
+    int bcast = 0;
+    int bcast_rate = MCAST_RATE;
+    uint32_t bcast_id = 0;
+    int mcast_senders = 0;
+    int serve = 0;
+    const char *serve_addr = NULL;
+    const char *fleet_file = NULL;
+    const char *fleet_cmd = NULL;
+    int fleet_timeout = FLEET_TIMEOUT_MS;
+    int fleet_rollback = 1;
+    static mix_t mixer;
+    int mix_mode = 0;
+    int health = 0;
+    int watch = 0;
+    int calibrate = 0;
+    int early = 0;
+    const char *early_log = NULL;
+    const char *cal_model = NULL;
+    const char *stream_url = NULL;
+    int prebuffer_ms = STREAM_PREBUFFER_MS;
+    const char *playlist = NULL;
+    int crossfade_ms = 0;
+    int loop = 0;
+    const char *rds_dev = NULL;
+    const char *rec_dir = NULL;
+    int rec_segment = REC_SEGMENT_SEC;
+    const char *rec_seek_dir = NULL;
+    const char *rec_seek_time = NULL;
+    int rec_seek_seconds = 0;
+    const char *gen_spec = NULL;
+    double delay_sec = -1;
+    const char *ptp_iface = NULL;
+    int ptp_domain = PTP_DOMAIN;
+    int xadc = 0;
+    const char *xadc_dir = NULL;
+    const char *xadc_gen_dir = NULL;
+    int xadc_gen_sec = 0;
+    int gen_seconds = 0;
+    const char *rds_gen_dev = NULL;
+    int rds_gen_seconds = 0;
+    int mpx_rate = RDS_RATE;
+    uint16_t rds_pi = 0x7A51;
+    const char *rds_ps = "ANTMINER";
+    const char *rds_rt = "Antminer S9 FM transmitter";
+    const char *inject = NULL;
+    int inject_ms = 0;
+    double mcast_loss = 0.0;
+    const char *meter_dev = NULL;
+    pcm_format_t conv_fmt = PCM_FMT_F32;
+    pcm_dither_t dither = DITHER_TPDF;
+    
     // Обработка аргументов
-    if (argc > 1) {
-        if (strcmp(argv[1], "--auto") == 0 || strcmp(argv[1], "-a") == 0) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--auto") == 0 || strcmp(argv[i], "-a") == 0) {
             auto_mode = 1;
-        } else if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
+        } else if (strcmp(argv[i], "--sim") == 0) {
+            sim_path = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : SIM_REGS_FILE;
+        } else if (strcmp(argv[i], "--schedule") == 0 && i + 1 < argc) {
+            sched_file = argv[++i];
+        } else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            play_dev = argv[++i];
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_dev = argv[++i];
+        } else if (strcmp(argv[i], "--buffer-us") == 0 && i + 1 < argc) {
+            audio_buffer_us = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            latency_runs = (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? atoi(argv[++i]) : 10;
+        } else if (strcmp(argv[i], "--convert") == 0 && i + 1 < argc) {
+            if (pcm_parse_format(argv[++i], &conv_fmt) != 0) {
+                printf("%sUnknown format: %s%s\n", COLOR_RED, argv[i], COLOR_RESET);
+                return 1;
+            }
+            conv_mode = 1;
+        } else if (strcmp(argv[i], "--dither") == 0 && i + 1 < argc) {
+            if (pcm_parse_dither(argv[++i], &dither) != 0) {
+                printf("%sUnknown dither: %s%s\n", COLOR_RED, argv[i], COLOR_RESET);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--conv-bench") == 0) {
+            return pcm_bench();
+        } else if (strcmp(argv[i], "--meter") == 0 && i + 1 < argc) {
+            meter_dev = argv[++i];
+        } else if (strcmp(argv[i], "--phase-bench") == 0) {
+            return phase_bench();
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            const char *json = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : NULL;
+            const char *filter = (json && i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : NULL;
+            return bench_main(json, filter);
+        } else if (strcmp(argv[i], "--bench-compare") == 0 && i + 2 < argc) {
+            const char *old_path = argv[++i], *new_path = argv[++i];
+            double pct = (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? atof(argv[++i]) : BENCH_THRESHOLD;
+            return bench_compare(old_path, new_path, pct);
+        } else if (strcmp(argv[i], "--loudness") == 0 && i + 1 < argc) {
+            return loudness_analyze(argv[++i]);
+        } else if (strcmp(argv[i], "--process") == 0) {
+            proc_bands = (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? atoi(argv[++i]) : PROC_MAX_BANDS;
+        } else if (strcmp(argv[i], "--proc-bench") == 0) {
+            tx.running = 1;
+            return proc_bench((i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? atoi(argv[++i]) : PROC_MAX_BANDS, 60);
+        } else if (strcmp(argv[i], "--broadcast") == 0) {
+            bcast = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-') bcast_addr = argv[++i];
+        } else if (strcmp(argv[i], "--bcast-rate") == 0 && i + 1 < argc) {
+            bcast_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--id") == 0 && i + 1 < argc) {
+            bcast_id = (uint32_t)strtoul(argv[++i], NULL, 16);
+        } else if (strcmp(argv[i], "--monitor") == 0) {
+            tx.running = 1;
+            return mcast_monitor((i + 1 < argc && argv[i + 1][0] != '-') ? argv[i + 1] : NULL);
+        } else if (strcmp(argv[i], "--mcast-test") == 0 && i + 1 < argc) {
+            mcast_senders = atoi(argv[++i]);
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) mcast_loss = atof(argv[++i]) / 100.0;
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            serve = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-') serve_addr = argv[++i];
+        } else if (strcmp(argv[i], "--fleet") == 0 && i + 1 < argc) {
+            fleet_file = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') fleet_cmd = argv[++i];
+        } else if (strcmp(argv[i], "--timeout") == 0 && i + 1 < argc) {
+            fleet_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-rollback") == 0) {
+            fleet_rollback = 0;
+        } else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) {
+            if (mix_add_input(&mixer, argv[++i]) != 0) return 1;
+        } else if (strcmp(argv[i], "--mix") == 0) {
+            mix_mode = 1;
+        } else if (strcmp(argv[i], "--mix-bench") == 0) {
+            tx.running = 1;
+            return mix_bench((i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? atoi(argv[++i]) : 4, 30);
+        } else if (strcmp(argv[i], "--rds-decode") == 0 && i + 1 < argc) {
+            rds_dev = argv[++i];
+        } else if (strcmp(argv[i], "--rds-gen") == 0 && i + 1 < argc) {
+            rds_gen_dev = argv[++i];
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) rds_gen_seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rds-bench") == 0) {
+            tx.running = 1;
+            return rds_bench((i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? atoi(argv[++i]) : 120);
+        } else if (strcmp(argv[i], "--mpx-rate") == 0 && i + 1 < argc) {
+            mpx_rate = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--pi") == 0 && i + 1 < argc) {
+            rds_pi = (uint16_t)strtoul(argv[++i], NULL, 16);
+        } else if (strcmp(argv[i], "--ps") == 0 && i + 1 < argc) {
+            rds_ps = argv[++i];
+        } else if (strcmp(argv[i], "--rds-rt") == 0 && i + 1 < argc) {
+            rds_rt = argv[++i];
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            stream_url = argv[++i];
+        } else if (strcmp(argv[i], "--prebuffer") == 0 && i + 1 < argc) {
+            prebuffer_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--playlist") == 0 && i + 1 < argc) {
+            playlist = argv[++i];
+        } else if (strcmp(argv[i], "--crossfade") == 0 && i + 1 < argc) {
+            crossfade_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--loop") == 0) {
+            loop = 1;
+        } else if (strcmp(argv[i], "--playlist-bench") == 0 && i + 1 < argc) {
+            tx.running = 1;
+            return pl_bench(argv[++i], crossfade_ms);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            rec_dir = argv[++i];
+        } else if (strcmp(argv[i], "--rec-segment") == 0 && i + 1 < argc) {
+            rec_segment = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rec-seek") == 0 && i + 2 < argc) {
+            rec_seek_dir = argv[++i];
+            rec_seek_time = argv[++i];
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) rec_seek_seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--gen") == 0 && i + 1 < argc) {
+            gen_spec = argv[++i];
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) gen_seconds = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--delay") == 0 && i + 1 < argc) {
+            delay_sec = str_to_double(argv[++i]);
+        } else if (strcmp(argv[i], "--ptp") == 0 && i + 1 < argc) {
+            ptp_iface = argv[++i];
+        } else if (strcmp(argv[i], "--ptp-domain") == 0 && i + 1 < argc) {
+            ptp_domain = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--xadc") == 0) {
+            xadc = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-') xadc_dir = argv[++i];
+        } else if (strcmp(argv[i], "--xadc-gen") == 0 && i + 1 < argc) {
+            xadc_gen_dir = argv[++i];
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) xadc_gen_sec = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--calibrate") == 0) {
+            calibrate = 1;
+        } else if (strcmp(argv[i], "--cal-model") == 0 && i + 1 < argc) {
+            cal_model = argv[++i];
+        } else if (strcmp(argv[i], "--early") == 0) {
+            early = 1;
+            if (i + 1 < argc && argv[i + 1][0] != '-') early_log = argv[++i];
+        } else if (strcmp(argv[i], "--watch") == 0) {
+            watch = 1;
+        } else if (strcmp(argv[i], "--health") == 0) {
+            health = 1;
+        } else if (strcmp(argv[i], "--inject") == 0 && i + 1 < argc) {
+            inject = argv[++i];
+            if (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) inject_ms = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rt") == 0) {
+            rt_mode = 1;
+        } else if (strcmp(argv[i], "--rt-test") == 0) {
+            rt_test_seconds = (i + 1 < argc && isdigit((unsigned char)argv[i + 1][0])) ? atoi(argv[++i]) : 10;
+        } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             print_help();
             return 0;
         } else {
-            printf("%sUnknown argument: %s%s\n", COLOR_RED, argv[1], COLOR_RESET);
+            printf("%sUnknown argument: %s%s\n", COLOR_RED, argv[i], COLOR_RESET);
             print_help();
             return 1;
         }
     }
     
+    // Ранний запуск при загрузке: только конфиг и регистры, сразу выход
+    if (early) return boot_apply(sim_path, early_log);
+    
+    // Профиль реального времени для этого процесса
+    if (rt_mode) {
+        rt_load_profile(CONFIG_FILE);
+        if (rt_process_setup() == 0 && rt_set_current(RT_ROLE_CONTROL) != 0) {
+            printf("%sWarning: RT priority not granted%s\n", COLOR_YELLOW, COLOR_RESET);
+        }
+    }
+    
+    // Самотест задержек не трогает регистры
+    if (rt_test_seconds > 0) {
+        tx.running = 1;
+        return rt_selftest(rt_test_seconds);
+    }
+    
+    // Измерение задержки звукового тракта
+    if (latency_runs > 0) {
+        tx.running = 1;
+        return latency_probe(play_dev, capture_dev, latency_runs);
+    }
+    
+    // Преобразование формата из stdin в I2S
+    if (conv_mode) {
+        tx.running = 1;
+        return pcm_pipe(conv_fmt, dither, play_dev);
+    }
+    
+    // Проверка RDS по отсчетам MPX
+    if (rds_dev) {
+        tx.running = 1;
+        return rds_decode(rds_dev, mpx_rate);
+    }
+    if (rds_gen_dev) {
+        tx.running = 1;
+        return rds_generate(rds_gen_dev, mpx_rate, rds_gen_seconds, rds_pi, rds_ps, rds_rt);
+    }
+    
+    // Тестовые сигналы для настройки тракта
+    if (gen_spec) {
+        tx.running = 1;
+        return gen_main(gen_spec, play_dev, gen_seconds, dither);
+    }
+    
+    // Запись эфира и поиск в ней
+    if (rec_dir) {
+        tx.running = 1;
+        return rec_main(rec_dir, capture_dev, rec_segment);
+    }
+    if (rec_seek_dir) {
+        tx.running = 1;
+        return rec_seek(rec_seek_dir, rec_seek_time, rec_seek_seconds, play_dev);
+    }
+    
+    // Защитная задержка эфира
+    if (delay_sec >= 0) {
+        tx.running = 1;
+        return delay_main(delay_sec, capture_dev, play_dev);
+    }
+    
+    // Ведомый PTP сам по себе: проверка захвата против гроссмейстера
+    if (ptp_iface && !stream_url && !serve) {
+        tx.running = 1;
+        return ptp_main(ptp_iface, ptp_domain);
+    }
+    
+    // Подмена XADC для проверки телеметрии без платы
+    if (xadc_gen_dir) return xadc_gen(xadc_gen_dir, xadc_gen_sec);
+    
+    // Имитация множества передатчиков для проверки --monitor
+    if (mcast_senders > 0) {
+        tx.running = 1;
+        return mcast_test(bcast_addr, mcast_senders, mcast_loss, bcast_rate);
+    }
+    
+    // Управление группой плат
+    if (fleet_file) {
+        tx.running = 1;
+        return fleet_main(fleet_file, fleet_cmd, fleet_timeout, fleet_rollback);
+    }
+    
+    // Микшер источников
+    if (mix_mode) {
+        tx.running = 1;
+        return mix_main(&mixer, dither, play_dev);
+    }
+    
+    // Интернет-радио прямо в I2S
+    if (stream_url) {
+        static ptp_t ptp;
+        tx.running = 1;
+        if (ptp_iface && ptp_start(&ptp, ptp_iface, ptp_domain) != 0) return 1;
+        int ret = stream_main(stream_url, play_dev, prebuffer_ms, dither);
+        if (ptp_iface) ptp_stop(&ptp);
+        return ret;
+    }
+    
+    // Локальный плейлист
+    if (playlist) {
+        tx.running = 1;
+        return pl_main(playlist, play_dev, crossfade_ms, loop, dither);
+    }
+    
+    // Обработка звука перед I2S передатчиком
+    if (proc_bands > 0) {
+        tx.running = 1;
+        return proc_run(proc_bands, dither, capture_dev, play_dev);
+    }
+    
     printf("%sInitializing...%s\n", COLOR_BLUE, COLOR_RESET);
     
-    if (fm_init(&tx, BASE_ADDR) != 0) {
+    if ((sim_path ? fm_init_sim(&tx, sim_path) : fm_init(&tx, BASE_ADDR)) != 0) {
         return 1;
     }
     
@@ -810,11 +1338,115 @@ int main(int argc, char *argv[]) {
     
     fm_update_state(&tx);
     
+    // Калибровка девиации и баланса
+    if (calibrate) {
+        int ret = cal_main(&tx, play_dev, cal_model);
+        fm_close(&tx);
+        return ret;
+    }
+    
+    // Внесение сбоя в регистры симулятора
+    if (inject) {
+        int ret = health_inject(&tx, inject, inject_ms);
+        fm_close(&tx);
+        return ret;
+    }
+    
+    // Рассылка показаний работает и вместе с расписанием
+    static mcast_sender_t sender;
+    if (bcast && mcast_sender_start(&sender, &tx, bcast_addr, bcast_rate,
+                                    bcast_id ? bcast_id : mcast_default_id()) != 0) {
+        fm_close(&tx);
+        return 1;
+    }
+    
+    // Надзор тоже работает вместе с расписанием и --serve
+    static health_t supervisor;
+    if (health) {
+        health_load_profile(&supervisor, CONFIG_FILE);
+        if (health_start(&supervisor, &tx) != 0) {
+            if (bcast) mcast_sender_stop(&sender);
+            fm_close(&tx);
+            return 1;
+        }
+    }
+    
+    // Телеметрия XADC: окна в интерфейсе и --serve, пороги глушат или снимают несущую
+    static xadc_t telemetry;
+    int headless = sched_file || serve || bcast || health || auto_mode || !isatty(STDIN_FILENO);
+    if ((watch || xadc) && auto_mode && load_settings(&tx)) auto_apply_settings(&tx);
+    if (xadc && xadc_start(&telemetry, &tx, xadc_dir) != 0) {
+        if (health) health_stop(&supervisor);
+        if (bcast) mcast_sender_stop(&sender);
+        fm_close(&tx);
+        return 1;
+    }
+    
+    // Изменения сохраненного конфига применяются на лету; с интерфейсом - без журнала
+    static config_watch_t watcher;
+    if (watch && config_watch_start(&watcher, &tx, !headless) != 0) {
+        if (xadc) xadc_stop(&telemetry);
+        if (health) health_stop(&supervisor);
+        if (bcast) mcast_sender_stop(&sender);
+        fm_close(&tx);
+        return 1;
+    }
+    if (watch && !headless) tui_watch = &watcher;
+    
+    // Работа по расписанию
+    if (sched_file) {
+        int ret = sched_main(&tx, sched_file);
+        if (watch) config_watch_stop(&watcher);
+        if (xadc) xadc_stop(&telemetry);
+        if (health) health_stop(&supervisor);
+        if (bcast) mcast_sender_stop(&sender);
+        fm_close(&tx);
+        return ret;
+    }
+    
+    // Измерение громкости и корреляции по PCM тракта: для интерфейса и команды PHASE
+    static loudness_t loudness;
+    static phase_meter_t phase;
+    if (meter_dev && (serve || !headless)) {
+        phase_init(&phase, AUDIO_RATE);
+        loudness.phase = &phase;
+        if (loudness_start(&loudness, meter_dev) == 0) {
+            tui_loudness = &loudness;
+            phase_meter = &phase;
+        }
+    }
+    
+    // Точка управления для --fleet
+    if (serve) {
+        static ptp_t ptp;
+        if (ptp_iface && ptp_start(&ptp, ptp_iface, ptp_domain) != 0) ptp_iface = NULL;
+        int ret = fleet_serve(&tx, serve_addr);
+        if (ptp_iface) ptp_stop(&ptp);
+        if (tui_loudness) loudness_stop(tui_loudness);
+        if (watch) config_watch_stop(&watcher);
+        if (xadc) xadc_stop(&telemetry);
+        if (health) health_stop(&supervisor);
+        if (bcast) mcast_sender_stop(&sender);
+        fm_close(&tx);
+        return ret;
+    }
+    
+    // Только рассылка, надзор, телеметрия и/или слежение за конфигом, без интерфейса
+    if (bcast || health || ((watch || xadc) && headless)) {
+        while (tx.running) pause();
+        if (watch) config_watch_stop(&watcher);
+        if (xadc) xadc_stop(&telemetry);
+        if (health) health_stop(&supervisor);
+        if (bcast) mcast_sender_stop(&sender);
+        fm_close(&tx);
+        return 0;
+    }
+    
     // Автоматический режим
     if (auto_mode) {
         if (load_settings(&tx)) {
-            auto_apply_settings(&tx);
-            printf("%sSettings applied%s\n", COLOR_GREEN, COLOR_RESET);
+            int n = auto_apply_settings(&tx);
+            printf("%sSettings applied (%d register%s written)%s\n", COLOR_GREEN, n, n == 1 ? "" : "s", COLOR_RESET);
         }
         fm_close(&tx);
         return 0;
@@ -824,14 +1456,18 @@ int main(int argc, char *argv[]) {
     peak_values.timestamp = clock() * 1000 / CLOCKS_PER_SEC;
     
     // Первоначальное отображение
+    tui_init();
     print_menu(&tx, 1);
     
     // Интерактивный режим
     while(tx.running) {
         if (tx.auto_refresh) {
             // В режиме автообновления проверяем ввод без блокировки
-            ch = getch_nonblock();
+            ch = tui_getch();
             if (ch != -1) {
+                // Сообщения ниже печатаются через stdio, а ввод читается getchar() -
+                // сначала кадры должны дойти и ответы терминала вернуться
+                tui_sync();
                 // Обработка ввода
                 switch(ch) {
                     case '1': tx.tx_en = !tx.tx_en; fm_update_control(&tx); break;
@@ -844,8 +1480,11 @@ int main(int argc, char *argv[]) {
                         print_menu(&tx, 1);
                         break;
                     case 's': case 'S': 
-                        save_settings(&tx);
-                        printf("\n%sSettings saved%s\n", COLOR_GREEN, COLOR_RESET);
+                        if (save_settings(&tx) == 0) {
+                            printf("\n%sSettings saved%s\n", COLOR_GREEN, COLOR_RESET);
+                        } else {
+                            printf("\n%sОшибка: Не могу сохранить %s%s\n", COLOR_RED, CONFIG_FILE, COLOR_RESET);
+                        }
                         usleep(500000);
                         print_menu(&tx, 1);
                         break;
@@ -863,15 +1502,38 @@ int main(int argc, char *argv[]) {
                     case 'f': case 'F':
                         frequency_dialog(&tx);
                         break;
+                    case 'd': case 'D':
+                        if (delay_send("dump") == 0) {
+                            printf("\n%sDump sent%s\n", COLOR_GREEN, COLOR_RESET);
+                        } else {
+                            printf("\n%sОшибка: задержка не запущена (--delay SEC)%s\n", COLOR_RED, COLOR_RESET);
+                        }
+                        usleep(500000);
+                        print_menu(&tx, 1);
+                        break;
                 }
                 // Обновляем состояние после действий
                 fm_update_state(&tx);
             }
             
+            // Конфиг применен из другого потока - показываем новое состояние
+            static long seen_applied;
+            if (tui_watch && tui_watch->applied != seen_applied) {
+                seen_applied = tui_watch->applied;
+                fm_update_state(&tx);
+            }
+            
+            // Порог телеметрии переключил MUTE или несущую
+            static long seen_changes;
+            if (xadc_active && xadc_active->changes != seen_changes) {
+                seen_changes = xadc_active->changes;
+                fm_update_state(&tx);
+            }
+            
             // Автообновление экрана
             if (tx.auto_refresh) {
                 print_menu(&tx, 0);
-                usleep(FRAME_DELAY);
+                tui_wait();
             }
         } else {
             // В режиме ручного обновления ждем ввода
@@ -889,8 +1551,11 @@ int main(int argc, char *argv[]) {
                     frequency_dialog(&tx);
                     break;
                 case 's': case 'S': 
-                    save_settings(&tx);
-                    printf("%sSettings saved%s\n", COLOR_GREEN, COLOR_RESET);
+                    if (save_settings(&tx) == 0) {
+                        printf("%sSettings saved%s\n", COLOR_GREEN, COLOR_RESET);
+                    } else {
+                        printf("%sОшибка: Не могу сохранить %s%s\n", COLOR_RED, CONFIG_FILE, COLOR_RESET);
+                    }
                     usleep(300000);
                     break;
                 case 'l': case 'L':
@@ -903,6 +1568,14 @@ int main(int argc, char *argv[]) {
                     usleep(300000);
                     break;
                 case 'q': case 'Q': tx.running = 0; break;
+                case 'd': case 'D':
+                    if (delay_send("dump") == 0) {
+                        printf("%sDump sent%s\n", COLOR_GREEN, COLOR_RESET);
+                    } else {
+                        printf("%sОшибка: задержка не запущена (--delay SEC)%s\n", COLOR_RED, COLOR_RESET);
+                    }
+                    usleep(300000);
+                    break;
             }
             
             fm_update_state(&tx);
@@ -910,7 +1583,12 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (tui_loudness) loudness_stop(tui_loudness);
+    if (tui_watch) config_watch_stop(tui_watch);
+    if (xadc) xadc_stop(&telemetry);
+    
     // Восстановление терминала
+    tui_sync();
     tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
     clear_screen();
     fm_close(&tx);
@@ -0,0 +1,155 @@
+#ifndef FM_H
+#define FM_H
+
+#include <stdint.h>
+
+// Конфигурация
+#define BASE_ADDR 0x43c30000
+#define PAGE_SIZE 4096
+#define CONFIG_FILE "/etc/fm_transmitter.conf"
+#define SIM_REGS_FILE "/tmp/fm_sim_regs"  // Файл регистров для --sim
+#define SIM_VERSION 0x00010000           // REG_VERSION нового файла симулятора
+#define REFRESH_RATE 25    // Обновлений в секунду
+#define FRAME_DELAY (1000000 / REFRESH_RATE)  // мкс на кадр
+#define PEAK_HOLD_TIME 500  // Удержание пика в миллисекундах
+
+// Адреса регистров
+#define REG_VERSION   0x00
+#define REG_CTRL      0x04
+#define REG_FREQ      0x08
+#define REG_MPXLVL    0x0C
+#define REG_LEFT      0x10
+#define REG_RIGHT     0x14
+#define REG_STATUS    0x18
+#define REG_BALANCE   0x1C
+
+// Усиление каналов перед модулятором: Q2.14, [15:0] - L, [31:16] - R; 0 - без коррекции
+#define BALANCE_UNITY 0x4000
+#define BALANCE_GAIN(reg, shift) ((reg) ? (((reg) >> (shift)) & 0xFFFF) / (double)BALANCE_UNITY : 1.0)
+
+// Бит mute в контрольном регистре
+#define CTRL_MUTE_BIT (1 << 5)
+
+// Биты преэмфаза в контрольном регистре (3-4 биты)
+#define PREEMPHASIS_MASK 0x18  // биты 3-4 (00011000)
+#define PREEMPHASIS_BYPASS 0x00    // 00 (байпас)
+#define PREEMPHASIS_50US   0x08    // 01 (50 µs)
+#define PREEMPHASIS_75US   0x10    // 10 (75 µs)
+
+// Константы
+#define DDS_STEP 0.0286086784756944  // Шаг частоты в Гц
+#define MPX_MAX 0xFFFFFF  // Максимальное значение MPX (24 бита)
+#define AUDIO_MAX 32767   // Максимальное значение аудио (16 бит)
+
+// Уровни в дБ относительно полной шкалы
+#define DBFS_FULL_SCALE 0.0      // 0 dBFS = 32767
+#define DBFS_MINUS_12 (-12.0)    // -12 dBFS
+#define DBFS_MINUS_9 (-9.0)      // -9 dBFS (75 кГц девиации)
+#define DBFS_TO_LIN(db) (pow(10.0, (db) / 20.0) * AUDIO_MAX)
+
+// Пороговые значения для цветов аудио
+#define AUDIO_GREEN_MAX DBFS_TO_LIN(DBFS_MINUS_12)   // -12 dBFS = 8202
+#define AUDIO_YELLOW_MAX DBFS_TO_LIN(DBFS_MINUS_9)   // -9 dBFS = 11601
+
+// Пороговые значения для MPX (кГц) - ИЗМЕНЕНО
+#define MPX_GREEN_MAX 60.0    // до 60 кГц - зеленый
+#define MPX_YELLOW_MAX 75.0   // 60-75 кГц - желтый
+                           // выше 75 кГц - красный (новый порог)
+
+// Цвета ANSI
+#define COLOR_RESET   "\033[0m"
+#define COLOR_RED     "\033[31m"
+#define COLOR_GREEN   "\033[32m"
+#define COLOR_YELLOW  "\033[33m"
+#define COLOR_BLUE    "\033[34m"
+#define COLOR_CYAN    "\033[36m"
+#define BOLD          "\033[1m"
+#define COLOR_MAGENTA "\033[35m"
+#define BG_RED        "\033[41m"
+#define BG_GREEN      "\033[42m"
+#define BG_YELLOW     "\033[43m"
+
+// Структура для управления
+typedef struct {
+    uint32_t base_addr;
+    volatile uint32_t *regs;
+    void *map_base;
+    int fd;
+    int tx_en;
+    int stereo_en;
+    int rds_en;
+    int mute_en;
+    int preemphasis_mode;  // 0=bypass, 1=50us, 2=75us
+    double freq_mhz;
+    uint32_t balance;      // REG_BALANCE, пишется калибровкой
+    int auto_refresh;      // Автообновление уровней
+    volatile int running;  // Флаг работы программы
+    int screen_height;     // Высота экрана в строках
+    int menu_height;       // Высота меню в строках
+    int simulated;         // Регистры в файле вместо /dev/mem
+} fm_transmitter_t;
+
+// Транзакция записи регистров: все записи подряд, без пауз между ними
+#define FM_TXN_MAX 8
+
+typedef struct {
+    int count;
+    uint32_t offset[FM_TXN_MAX];
+    uint32_t value[FM_TXN_MAX];
+} fm_txn_t;
+
+// Глобальные переменные для обработки сигналов
+extern fm_transmitter_t *global_tx;
+
+// Структура для удержания пиковых значений
+typedef struct {
+    double mpx_khz;
+    int left;
+    int right;
+    long timestamp;  // Время последнего обновления в мс
+} peak_holder_t;
+
+extern peak_holder_t peak_values;
+
+// Прототипы функций
+void signal_handler(int sig);
+double lin_to_dbfs(int value);
+double mpx_to_khz(uint32_t mpx_raw);
+void update_peak_values(uint32_t mpx_raw, int16_t left, int16_t right);
+const char* get_audio_color(int value);
+const char* get_mpx_color(double khz);
+void print_audio_bar(int value, int max_value, int width);
+void print_mpx_bar(double khz, int width);
+void print_phase_meter(int width);
+double str_to_double(const char *str);
+int fm_init(fm_transmitter_t *tx, uint32_t base_addr);
+int fm_init_sim(fm_transmitter_t *tx, const char *path);
+void fm_close(fm_transmitter_t *tx);
+uint32_t fm_read(fm_transmitter_t *tx, uint32_t offset);
+void fm_write(fm_transmitter_t *tx, uint32_t offset, uint32_t value);
+void fm_update_state(fm_transmitter_t *tx);
+void fm_set_frequency(fm_transmitter_t *tx, double freq_mhz);
+void fm_update_control(fm_transmitter_t *tx);
+uint32_t fm_freq_to_ftw(double freq_mhz);
+uint32_t fm_ctrl_word(const fm_transmitter_t *tx);
+void fm_txn_begin(fm_txn_t *txn);
+void fm_txn_add(fm_txn_t *txn, uint32_t offset, uint32_t value);
+void fm_txn_add_state(fm_txn_t *txn, const fm_transmitter_t *tx);
+void fm_txn_write(fm_transmitter_t *tx, const fm_txn_t *txn);
+void fm_txn_commit(fm_transmitter_t *tx, const fm_txn_t *txn);
+void fm_toggle_preemphasis(fm_transmitter_t *tx);
+const char* get_preemphasis_str(int mode);
+int save_settings(const fm_transmitter_t *tx);
+int load_settings(fm_transmitter_t *tx);
+int apply_setting(fm_transmitter_t *tx, const char *key, const char *value);
+void settings_txn(fm_transmitter_t *tx, fm_txn_t *txn);
+int auto_apply_settings(fm_transmitter_t *tx);
+void clear_screen();
+int kbhit();
+int getch_nonblock();
+void get_terminal_size(int *width, int *height);
+void print_menu(fm_transmitter_t *tx, int clear_before);
+void frequency_dialog(fm_transmitter_t *tx);
+void print_help();
+
+#endif // FM_H
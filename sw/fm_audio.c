@@ -0,0 +1,182 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "fm.h"
+#include "fm_audio.h"
+
+int audio_buffer_us = 100000;
+
+// Открытие устройства
+int audio_open(audio_dev_t *dev, const char *name, int flags, int rate, int channels) {
+    memset(dev, 0, sizeof(*dev));
+    dev->fd = -1;
+    dev->flags = flags;
+    dev->rate = rate;
+    dev->channels = channels;
+
+    if (strcmp(name, "-") == 0) {
+        dev->fd = (flags & AUDIO_CAPTURE) ? STDIN_FILENO : STDOUT_FILENO;
+        return 0;
+    }
+
+    if (strncmp(name, "file:", 5) == 0) {
+        const char *path = name + 5;
+        if (flags & AUDIO_CAPTURE) dev->fd = open(path, O_RDONLY);
+        else dev->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (dev->fd < 0) {
+            printf("%sОшибка: Не могу открыть %s%s\n", COLOR_RED, path, COLOR_RESET);
+            return -1;
+        }
+        return 0;
+    }
+
+#ifdef HAVE_ALSA
+    snd_pcm_t *pcm;
+    int err = snd_pcm_open(&pcm, name,
+                           (flags & AUDIO_CAPTURE) ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK, 0);
+    if (err < 0) {
+        printf("%sALSA %s: %s%s\n", COLOR_RED, name, snd_strerror(err), COLOR_RESET);
+        return -1;
+    }
+    err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                             channels, rate, 0, audio_buffer_us);
+    if (err < 0) {
+        printf("%sALSA %s: %s%s\n", COLOR_RED, name, snd_strerror(err), COLOR_RESET);
+        snd_pcm_close(pcm);
+        return -1;
+    }
+    dev->pcm = pcm;
+    return 0;
+#else
+    printf("%sALSA support not built in (compile with -DHAVE_ALSA -lasound), use file:PATH%s\n",
+           COLOR_RED, COLOR_RESET);
+    return -1;
+#endif
+}
+
+// Ожидание момента, когда кадр frames "прозвучал" бы в реальном времени
+static void audio_pace(audio_dev_t *dev) {
+    if (dev->frames == 0) return;
+    struct timespec t = dev->start;
+    long long ns = (long long)dev->frames * 1000000000LL / dev->rate;
+    t.tv_sec += ns / 1000000000LL;
+    t.tv_nsec += ns % 1000000000LL;
+    if (t.tv_nsec >= 1000000000L) {
+        t.tv_nsec -= 1000000000L;
+        t.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL);
+}
+
+// Запись кадров (блокирующая)
+int audio_write(audio_dev_t *dev, const int16_t *buf, int frames) {
+    if (dev->frames == 0) clock_gettime(CLOCK_MONOTONIC, &dev->start);
+
+#ifdef HAVE_ALSA
+    if (dev->pcm) {
+        int done = 0;
+        while (done < frames) {
+            snd_pcm_sframes_t n = snd_pcm_writei(dev->pcm, buf + done * dev->channels, frames - done);
+            if (n < 0) {
+                n = snd_pcm_recover(dev->pcm, n, 1);
+                if (n < 0) return -1;
+                continue;
+            }
+            done += n;
+        }
+        dev->frames += frames;
+        return frames;
+    }
+#endif
+
+    size_t bytes = (size_t)frames * dev->channels * sizeof(int16_t);
+    const char *p = (const char *)buf;
+    while (bytes > 0) {
+        ssize_t n = write(dev->fd, p, bytes);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        bytes -= n;
+    }
+    dev->frames += frames;
+    if (dev->flags & AUDIO_PACED) audio_pace(dev);
+    return frames;
+}
+
+// Чтение кадров; после конца файла отдается тишина, чтобы время шло дальше
+int audio_read(audio_dev_t *dev, int16_t *buf, int frames) {
+    if (dev->frames == 0) clock_gettime(CLOCK_MONOTONIC, &dev->start);
+
+#ifdef HAVE_ALSA
+    if (dev->pcm) {
+        int done = 0;
+        while (done < frames) {
+            snd_pcm_sframes_t n = snd_pcm_readi(dev->pcm, buf + done * dev->channels, frames - done);
+            if (n < 0) {
+                n = snd_pcm_recover(dev->pcm, n, 1);
+                if (n < 0) return -1;
+                continue;
+            }
+            done += n;
+        }
+        dev->frames += frames;
+        return frames;
+    }
+#endif
+
+    size_t bytes = (size_t)frames * dev->channels * sizeof(int16_t);
+    char *p = (char *)buf;
+    while (bytes > 0) {
+        ssize_t n = read(dev->fd, p, bytes);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (!(dev->flags & AUDIO_PACED)) {
+                int got = (int)((p - (char *)buf) / (dev->channels * sizeof(int16_t)));
+                dev->frames += got;
+                return got;
+            }
+            memset(p, 0, bytes);
+            break;
+        }
+        p += n;
+        bytes -= n;
+    }
+    dev->frames += frames;
+    if (dev->flags & AUDIO_PACED) audio_pace(dev);
+    return frames;
+}
+
+// Кадров в очереди устройства (задержка буфера ALSA)
+long audio_delay(audio_dev_t *dev) {
+#ifdef HAVE_ALSA
+    if (dev->pcm) {
+        snd_pcm_sframes_t d;
+        if (snd_pcm_delay(dev->pcm, &d) == 0) return d;
+    }
+#endif
+    (void)dev;
+    return 0;
+}
+
+void audio_close(audio_dev_t *dev) {
+#ifdef HAVE_ALSA
+    if (dev->pcm) {
+        if (!(dev->flags & AUDIO_CAPTURE)) snd_pcm_drain(dev->pcm);
+        snd_pcm_close(dev->pcm);
+        dev->pcm = NULL;
+    }
+#endif
+    if (dev->fd > STDERR_FILENO) close(dev->fd);
+    dev->fd = -1;
+}
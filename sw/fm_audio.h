@@ -0,0 +1,37 @@
+#ifndef FM_AUDIO_H
+#define FM_AUDIO_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Формат I2S тракта: 16 бит (xlnx,dwidth = 0x10), стерео,
+// aud_mclk 18.432 МГц = 384 * 48 кГц
+#define AUDIO_RATE      48000
+#define AUDIO_CHANNELS  2
+#define AUDIO_PERIOD    256      // Кадров в одном блоке
+#define AUDIO_DEVICE    "hw:0,0" // ALSA устройство audio_formatter_0
+
+// Флаги открытия
+#define AUDIO_CAPTURE   0x1      // Запись вместо воспроизведения
+#define AUDIO_PACED     0x2      // Файл читается/пишется в темпе реального времени
+
+typedef struct {
+    int fd;                      // Файловый бэкенд
+    void *pcm;                   // snd_pcm_t * для ALSA
+    int flags;
+    int rate;
+    int channels;
+    long frames;                 // Передано кадров с момента открытия
+    struct timespec start;       // Момент первого кадра (для AUDIO_PACED)
+} audio_dev_t;
+
+extern int audio_buffer_us;      // Размер буфера ALSA
+
+// name: "file:PATH" - сырой S16_LE, "-" - stdin/stdout, иначе имя ALSA устройства
+int audio_open(audio_dev_t *dev, const char *name, int flags, int rate, int channels);
+int audio_write(audio_dev_t *dev, const int16_t *buf, int frames);
+int audio_read(audio_dev_t *dev, int16_t *buf, int frames);
+long audio_delay(audio_dev_t *dev);
+void audio_close(audio_dev_t *dev);
+
+#endif // FM_AUDIO_H
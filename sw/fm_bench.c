@@ -0,0 +1,506 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include "fm.h"
+#include "fm_simd.h"
+#include "fm_audio.h"
+#include "fm_tui.h"
+#include "fm_loudness.h"
+#include "fm_phase.h"
+#include "fm_pcm.h"
+#include "fm_proc.h"
+#include "fm_delay.h"
+#include "fm_bench.h"
+
+// Счетчик выделений: malloc программы подменяет библиотечный и зовет его же.
+// Считает только во время замера, остальное время - одна проверка флага.
+// Слабые символы: при статической сборке побеждает malloc из libc.a, и
+// подсчет отключается (это видно по пробному выделению в bench_main)
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+
+static volatile int bench_counting;
+static long bench_allocs;
+
+__attribute__((weak)) void *malloc(size_t size) {
+    if (bench_counting) bench_allocs++;
+    return __libc_malloc(size);
+}
+
+__attribute__((weak)) void *calloc(size_t n, size_t size) {
+    if (bench_counting) bench_allocs++;
+    return __libc_calloc(n, size);
+}
+
+__attribute__((weak)) void *realloc(void *p, size_t size) {
+    if (bench_counting) bench_allocs++;
+    return __libc_realloc(p, size);
+}
+#else
+static volatile int bench_counting;
+static long bench_allocs;
+#endif
+static int bench_allocs_counted;
+
+typedef struct {
+    fm_transmitter_t *tx;
+    int16_t *pcm;                    // Стерео, BENCH_PERIODS периодов
+    int16_t *out;
+    float *f32;
+    loudness_t *loud;
+    phase_meter_t *phase;
+    proc_t *proc;
+    delay_t *delay;                  // Набирает 40 с: каждый шаг с поиском совмещения
+    pcm_conv_t conv;
+    double sink;                     // Результаты, чтобы вызовы не выбросил оптимизатор
+} bench_ctx_t;
+
+#define BENCH_PERIODS 64
+
+// Возвращает байт, выведенных в терминал
+typedef long (*bench_fn_t)(bench_ctx_t *c, long iters);
+
+typedef struct {
+    const char *name;
+    const char *group;
+    bench_fn_t fn;
+} bench_case_t;
+
+static double bench_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Собранный, но не отправленный кадр: байты и сброс буфера
+static long bench_tui_take(void) {
+    long n = tui_out.len;
+    tui_out.len = 0;
+    return n;
+}
+
+// ---------- Регистры ----------
+
+static long bench_fm_read(bench_ctx_t *c, long iters) {
+    uint32_t acc = 0;
+    for (long i = 0; i < iters; i++) acc += fm_read(c->tx, REG_LEFT + (i & 3) * 4);
+    c->sink += acc;
+    return 0;
+}
+
+static long bench_update_state(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) fm_update_state(c->tx);
+    c->sink += c->tx->freq_mhz;
+    return 0;
+}
+
+// С паузой 1 мс после записи, как на плате
+static long bench_txn_commit(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) {
+        fm_txn_t txn;
+        fm_txn_begin(&txn);
+        fm_txn_add(&txn, REG_FREQ, fm_read(c->tx, REG_FREQ));
+        fm_txn_commit(c->tx, &txn);
+    }
+    return 0;
+}
+
+// ---------- Индикаторы и отрисовка ----------
+
+static long bench_mpx_to_khz(bench_ctx_t *c, long iters) {
+    double acc = 0;
+    for (long i = 0; i < iters; i++) acc += mpx_to_khz((uint32_t)(i * 2654435761u) & MPX_MAX);
+    c->sink += acc;
+    return 0;
+}
+
+static long bench_lin_to_dbfs(bench_ctx_t *c, long iters) {
+    double acc = 0;
+    for (long i = 0; i < iters; i++) acc += lin_to_dbfs((int)(i & 0x7FFF));
+    c->sink += acc;
+    return 0;
+}
+
+static long bench_update_peaks(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) {
+        update_peak_values((uint32_t)(i * 40503u) & MPX_MAX, (int16_t)(i * 7), (int16_t)(i * 13));
+    }
+    c->sink += peak_values.mpx_khz;
+    return 0;
+}
+
+static long bench_audio_bar(bench_ctx_t *c, long iters) {
+    long bytes = 0;
+    (void)c;
+    for (long i = 0; i < iters; i++) {
+        print_audio_bar((int)(i & 0x7FFF), AUDIO_MAX, 16);
+        bytes += bench_tui_take();
+    }
+    return bytes;
+}
+
+static long bench_mpx_bar(bench_ctx_t *c, long iters) {
+    long bytes = 0;
+    (void)c;
+    for (long i = 0; i < iters; i++) {
+        print_mpx_bar((i % 1100) / 10.0, 16);
+        bytes += bench_tui_take();
+    }
+    return bytes;
+}
+
+static long bench_phase_meter(bench_ctx_t *c, long iters) {
+    long bytes = 0;
+    phase_meter = c->phase;
+    for (long i = 0; i < iters; i++) {
+        print_phase_meter(16);
+        bytes += bench_tui_take();
+    }
+    phase_meter = NULL;
+    return bytes;
+}
+
+// Кадр автообновления целиком в пустой терминал, как в цикле интерфейса
+static long bench_menu(bench_ctx_t *c, long iters, int meters) {
+    long bytes = 0;
+    c->tx->auto_refresh = 1;
+    if (meters) {
+        tui_loudness = c->loud;
+        phase_meter = c->phase;
+    }
+    for (long i = 0; i < iters; i++) {
+        tui_out.last_at = 0;
+        c->tx->regs[REG_LEFT / 4] = (uint16_t)(i * 97);
+        c->tx->regs[REG_MPXLVL / 4] = (uint32_t)(i * 40503u) & MPX_MAX;
+        print_menu(c->tx, 0);
+        bytes += tui_out.pend_len;
+    }
+    tui_loudness = NULL;
+    phase_meter = NULL;
+    return bytes;
+}
+
+static long bench_print_menu(bench_ctx_t *c, long iters) {
+    return bench_menu(c, iters, 0);
+}
+
+static long bench_print_menu_meters(bench_ctx_t *c, long iters) {
+    return bench_menu(c, iters, 1);
+}
+
+// ---------- Измерители и DSP, операция - период ALSA ----------
+
+static long bench_loudness(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) {
+        loudness_process(c->loud, c->pcm + (i % BENCH_PERIODS) * AUDIO_PERIOD * 2, AUDIO_PERIOD);
+    }
+    c->sink += c->loud->snap.momentary;
+    return 0;
+}
+
+static long bench_phase(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) {
+        phase_process(c->phase, c->pcm + (i % BENCH_PERIODS) * AUDIO_PERIOD * 2, AUDIO_PERIOD);
+    }
+    c->sink += c->phase->snap.corr;
+    return 0;
+}
+
+static long bench_f32_to_s16(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) {
+        pcm_f32_to_s16(&c->conv, c->f32 + (i % BENCH_PERIODS) * AUDIO_PERIOD * 2, c->out, AUDIO_PERIOD * 2, 2);
+    }
+    c->sink += c->out[0];
+    return 0;
+}
+
+static long bench_proc(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) {
+        proc_process(c->proc, c->pcm + (i % BENCH_PERIODS) * AUDIO_PERIOD * 2, c->out, AUDIO_PERIOD);
+    }
+    c->sink += c->out[0];
+    return 0;
+}
+
+static long bench_delay(bench_ctx_t *c, long iters) {
+    for (long i = 0; i < iters; i++) {
+        delay_process(c->delay, c->pcm + (i % BENCH_PERIODS) * AUDIO_PERIOD * 2, c->out, AUDIO_PERIOD);
+    }
+    c->sink += c->out[0];
+    return 0;
+}
+
+// Новые горячие пути добавляются сюда; имя - ключ для сравнения прогонов
+static const bench_case_t bench_cases[] = {
+    { "fm_read", "reg", bench_fm_read },
+    { "fm_update_state", "reg", bench_update_state },
+    { "fm_txn_commit (1 reg)", "reg", bench_txn_commit },
+    { "mpx_to_khz", "meter", bench_mpx_to_khz },
+    { "lin_to_dbfs", "meter", bench_lin_to_dbfs },
+    { "update_peak_values", "meter", bench_update_peaks },
+    { "print_audio_bar", "render", bench_audio_bar },
+    { "print_mpx_bar", "render", bench_mpx_bar },
+    { "print_phase_meter", "render", bench_phase_meter },
+    { "print_menu", "render", bench_print_menu },
+    { "print_menu (meters)", "render", bench_print_menu_meters },
+    { "loudness_process/period", "dsp", bench_loudness },
+    { "phase_process/period", "dsp", bench_phase },
+    { "pcm_f32_to_s16/period", "dsp", bench_f32_to_s16 },
+    { "proc_process/period", "dsp", bench_proc },
+    { "delay_process/period", "dsp", bench_delay },
+};
+
+static int bench_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Подбор числа итераций под BENCH_RUN_MS, затем BENCH_RUNS прогонов
+static void bench_run(const bench_case_t *bc, bench_ctx_t *c, bench_result_t *r) {
+    long iters = 1;
+    double t;
+
+    bc->fn(c, 1);
+    for (;;) {
+        double t0 = bench_now();
+        bc->fn(c, iters);
+        t = bench_now() - t0;
+        if (t >= BENCH_RUN_MS / 1000.0 / 4 || iters >= (1L << 40)) break;
+        iters *= t > 0 ? fmin(8.0, fmax(2.0, BENCH_RUN_MS / 1000.0 / 4 / t)) : 8;
+    }
+    iters = (long)fmax(1.0, iters * (BENCH_RUN_MS / 1000.0) / t);
+
+    double ns[BENCH_RUNS];
+    long bytes = 0, allocs;
+    bench_allocs = 0;
+    for (int k = 0; k < BENCH_RUNS; k++) {
+        bench_counting = 1;
+        double t0 = bench_now();
+        bytes += bc->fn(c, iters);
+        ns[k] = (bench_now() - t0) * 1e9 / iters;
+        bench_counting = 0;
+    }
+    allocs = bench_allocs;
+    qsort(ns, BENCH_RUNS, sizeof(double), bench_cmp_double);
+
+    snprintf(r->name, sizeof(r->name), "%s", bc->name);
+    snprintf(r->group, sizeof(r->group), "%s", bc->group);
+    r->iters = iters * BENCH_RUNS;
+    r->ns = ns[0];
+    r->ns_median = ns[BENCH_RUNS / 2];
+    r->allocs = (double)allocs / r->iters;
+    r->bytes = (double)bytes / r->iters;
+}
+
+static void bench_write_json(FILE *f, const bench_result_t *res, int n) {
+    struct utsname u;
+    if (uname(&u) != 0) snprintf(u.machine, sizeof(u.machine), "unknown");
+    fprintf(f, "{\n  \"version\": 1,\n  \"simd\": \"%s\",\n  \"machine\": \"%s\",\n  \"compiler\": \"%s\",\n"
+               "  \"allocs_counted\": %s,\n  \"results\": [\n",
+            FM_SIMD_NAME, u.machine, __VERSION__, bench_allocs_counted ? "true" : "false");
+    // По результату на строку: сравнение читает файл построчно
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "    {\"name\": \"%s\", \"group\": \"%s\", \"iters\": %ld, \"ns_per_op\": %.3f, "
+                   "\"ns_median\": %.3f, \"allocs_per_op\": %.4f, \"bytes_per_op\": %.1f}%s\n",
+                res[i].name, res[i].group, res[i].iters, res[i].ns, res[i].ns_median,
+                res[i].allocs, res[i].bytes, i + 1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+int bench_main(const char *json_path, const char *filter) {
+    static fm_transmitter_t tx;
+    static bench_ctx_t c;
+    static bench_result_t res[BENCH_MAX_CASES];
+    int n = 0;
+
+    // Пробное выделение: считает ли подмененный malloc
+    bench_counting = 1;
+    void *volatile probe = malloc(16);
+    bench_counting = 0;
+    free(probe);
+    bench_allocs_counted = bench_allocs > 0;
+    bench_allocs = 0;
+
+    unlink(BENCH_REGS_FILE);
+    if (fm_init_sim(&tx, BENCH_REGS_FILE) != 0) return 1;
+    tx.regs[REG_CTRL / 4] = 0x3;
+    tx.regs[REG_FREQ / 4] = (uint32_t)(100.1e6 / DDS_STEP);
+    fm_update_state(&tx);
+
+    // Пустой терминал: интерфейс пишет в /dev/null без подтверждений DSR
+    tui_init();
+    close(tui_out.fd);
+    tui_out.fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    tui_out.ack = 0;
+
+    // Музыкоподобный сигнал: два тона и шум, около -12 dBFS
+    int samples = BENCH_PERIODS * AUDIO_PERIOD * 2;
+    c.tx = &tx;
+    c.pcm = malloc(samples * sizeof(int16_t));
+    c.out = malloc(AUDIO_PERIOD * 2 * sizeof(int16_t));
+    c.f32 = malloc(samples * sizeof(float));
+    c.loud = malloc(sizeof(loudness_t));
+    c.phase = malloc(sizeof(phase_meter_t));
+    c.proc = proc_create(5, AUDIO_RATE, DITHER_TPDF);
+    c.delay = delay_create(AUDIO_RATE, DELAY_MAX_SEC);
+    if (!c.pcm || !c.out || !c.f32 || !c.loud || !c.phase || !c.proc || !c.delay) return 1;
+    uint32_t seed = 1;
+    for (int i = 0; i < samples; i += 2) {
+        double t = (double)(i / 2) / AUDIO_RATE;
+        seed = seed * 1664525u + 1013904223u;
+        double n1 = ((int32_t)seed >> 8) / 8388608.0 * 0.05;
+        double s = 0.2 * sin(2 * M_PI * 440 * t) + 0.05 * sin(2 * M_PI * 3100 * t);
+        c.f32[i] = s + n1;
+        c.f32[i + 1] = 0.8 * s - n1;
+        c.pcm[i] = (int16_t)lrint(c.f32[i] * AUDIO_MAX);
+        c.pcm[i + 1] = (int16_t)lrint(c.f32[i + 1] * AUDIO_MAX);
+    }
+    loudness_init(c.loud, AUDIO_RATE, AUDIO_CHANNELS);
+    phase_init(c.phase, AUDIO_RATE);
+    pcm_conv_init(&c.conv, DITHER_TPDF);
+    for (int i = 0; i < BENCH_PERIODS; i++) {
+        loudness_process(c.loud, c.pcm + i * AUDIO_PERIOD * 2, AUDIO_PERIOD);
+        phase_process(c.phase, c.pcm + i * AUDIO_PERIOD * 2, AUDIO_PERIOD);
+    }
+
+    // Таблица - в stderr, чтобы JSON без файла можно было перенаправить
+    fprintf(stderr, "%sHot path benchmark (%s), best of %d runs of %d ms%s\n",
+            BOLD, FM_SIMD_NAME, BENCH_RUNS, BENCH_RUN_MS, COLOR_RESET);
+    fprintf(stderr, "%-26s %-7s %12s %12s %10s %10s\n", "case", "group", "ns/op", "median", "allocs/op", "bytes/op");
+    for (size_t k = 0; k < sizeof(bench_cases) / sizeof(bench_cases[0]) && n < BENCH_MAX_CASES; k++) {
+        const bench_case_t *bc = &bench_cases[k];
+        if (filter && !strstr(bc->name, filter) && strcmp(bc->group, filter) != 0) continue;
+        bench_run(bc, &c, &res[n]);
+        fprintf(stderr, "%-26s %-7s %12.1f %12.1f %10.3f %10.1f\n", res[n].name, res[n].group,
+                res[n].ns, res[n].ns_median, res[n].allocs, res[n].bytes);
+        n++;
+    }
+    if (!bench_allocs_counted) fprintf(stderr, "%sallocations are not counted (static or non-glibc build)%s\n", COLOR_YELLOW, COLOR_RESET);
+
+    int ret = 0;
+    if (json_path) {
+        FILE *f = fopen(json_path, "w");
+        if (f) {
+            bench_write_json(f, res, n);
+            fclose(f);
+            fprintf(stderr, "Saved %s\n", json_path);
+        } else {
+            fprintf(stderr, "%sОшибка: Не могу записать %s%s\n", COLOR_RED, json_path, COLOR_RESET);
+            ret = 1;
+        }
+    } else {
+        bench_write_json(stdout, res, n);
+    }
+
+    tx.running = 0;
+    proc_destroy(c.proc);
+    delay_destroy(c.delay);
+    free(c.pcm);
+    free(c.out);
+    free(c.f32);
+    free(c.loud);
+    free(c.phase);
+    fm_close(&tx);
+    unlink(BENCH_REGS_FILE);
+    return ret;
+}
+
+// ---------- Сравнение двух прогонов ----------
+
+static double bench_json_num(const char *line, const char *key) {
+    const char *p = strstr(line, key);
+    return p ? strtod(p + strlen(key), NULL) : NAN;
+}
+
+static int bench_load(const char *path, bench_result_t *res) {
+    FILE *f = fopen(path, "r");
+    char line[512];
+    int n = 0;
+
+    if (!f) {
+        printf("%sОшибка: Не могу открыть %s%s\n", COLOR_RED, path, COLOR_RESET);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f) && n < BENCH_MAX_CASES) {
+        char *p = strstr(line, "\"name\": \"");
+        if (!p) continue;
+        p += 9;
+        char *q = strchr(p, '"');
+        if (!q) continue;
+        bench_result_t *r = &res[n++];
+        snprintf(r->name, sizeof(r->name), "%.*s", (int)(q - p), p);
+        r->ns = bench_json_num(line, "\"ns_per_op\": ");
+        r->ns_median = bench_json_num(line, "\"ns_median\": ");
+        r->allocs = bench_json_num(line, "\"allocs_per_op\": ");
+        r->bytes = bench_json_num(line, "\"bytes_per_op\": ");
+    }
+    fclose(f);
+    if (n == 0) printf("%sОшибка: В %s нет результатов --bench%s\n", COLOR_RED, path, COLOR_RESET);
+    return n;
+}
+
+// Регрессия: время выросло больше порога (и больше шума таймера),
+// появились выделения памяти или вывод в терминал вырос
+int bench_compare(const char *old_path, const char *new_path, double threshold) {
+    static bench_result_t a[BENCH_MAX_CASES], b[BENCH_MAX_CASES];
+    int na = bench_load(old_path, a), nb = bench_load(new_path, b);
+    int regressions = 0;
+
+    if (na <= 0 || nb <= 0) return 2;
+    printf("%sBenchmark comparison%s %s -> %s, threshold %.0f%%\n", BOLD, COLOR_RESET, old_path, new_path, threshold);
+    printf("%-26s %12s %12s %9s %12s %12s\n", "case", "old ns/op", "new ns/op", "change", "allocs/op", "bytes/op");
+    for (int i = 0; i < nb; i++) {
+        const bench_result_t *o = NULL, *r = &b[i];
+        for (int k = 0; k < na; k++) {
+            if (strcmp(a[k].name, r->name) == 0) o = &a[k];
+        }
+        if (!o) {
+            printf("%-26s %12s %12.1f %9s %12.3f %12.1f  %snew%s\n", r->name, "-", r->ns, "", r->allocs, r->bytes,
+                   COLOR_CYAN, COLOR_RESET);
+            continue;
+        }
+        double pct = o->ns > 0 ? (r->ns - o->ns) / o->ns * 100.0 : 0.0;
+        int slower = pct > threshold && r->ns - o->ns > BENCH_MIN_DIFF_NS;
+        int faster = pct < -threshold && o->ns - r->ns > BENCH_MIN_DIFF_NS;
+        int more_allocs = r->allocs > o->allocs + 0.0005;
+        int more_bytes = r->bytes > o->bytes * 1.01 + 0.5;
+        const char *verdict = "";
+        if (slower) verdict = "SLOWER";
+        else if (more_allocs) verdict = "ALLOCS";
+        else if (more_bytes) verdict = "BYTES";
+        else if (faster) verdict = "faster";
+        int bad = slower || more_allocs || more_bytes;
+        regressions += bad;
+
+        char allocs[32], bytes[32];
+        if (more_allocs) snprintf(allocs, sizeof(allocs), "%.3f->%.3f", o->allocs, r->allocs);
+        else snprintf(allocs, sizeof(allocs), "%.3f", r->allocs);
+        if (more_bytes) snprintf(bytes, sizeof(bytes), "%.0f->%.0f", o->bytes, r->bytes);
+        else snprintf(bytes, sizeof(bytes), "%.1f", r->bytes);
+        printf("%-26s %12.1f %12.1f %s%+8.1f%%%s %12s %12s  %s%s%s\n", r->name, o->ns, r->ns,
+               slower ? COLOR_RED : faster ? COLOR_GREEN : "", pct, COLOR_RESET, allocs, bytes,
+               bad ? COLOR_RED : COLOR_GREEN, verdict, COLOR_RESET);
+    }
+    for (int k = 0; k < na; k++) {
+        int found = 0;
+        for (int i = 0; i < nb; i++) found |= strcmp(a[k].name, b[i].name) == 0;
+        if (!found) printf("%-26s %12.1f %12s  %sgone%s\n", a[k].name, a[k].ns, "-", COLOR_YELLOW, COLOR_RESET);
+    }
+
+    if (regressions) {
+        printf("%s%d regression%s%s\n", COLOR_RED, regressions, regressions == 1 ? "" : "s", COLOR_RESET);
+        return 1;
+    }
+    printf("%sNo regressions%s\n", COLOR_GREEN, COLOR_RESET);
+    return 0;
+}
@@ -0,0 +1,26 @@
+#ifndef FM_BENCH_H
+#define FM_BENCH_H
+
+// Замер горячих путей (регистры, отрисовка, измерители, DSP) на симуляторе
+// и пустом терминале. Результат - JSON, сравнение двух прогонов ищет регрессии
+#define BENCH_REGS_FILE    "/tmp/fm_bench_regs"
+#define BENCH_RUNS         5         // Прогонов на случай, в отчет идет лучший
+#define BENCH_RUN_MS       60        // Длительность одного прогона
+#define BENCH_MAX_CASES    64
+#define BENCH_THRESHOLD    10.0      // Порог регрессии по умолчанию, %
+#define BENCH_MIN_DIFF_NS  1.0       // Меньшая разница - шум таймера, не регрессия
+
+typedef struct {
+    char name[48];
+    char group[16];
+    long iters;
+    double ns;                       // Лучший прогон, нс на операцию
+    double ns_median;
+    double allocs;                   // Выделений памяти на операцию
+    double bytes;                    // Байт в терминал на операцию
+} bench_result_t;
+
+int bench_main(const char *json_path, const char *filter);
+int bench_compare(const char *old_path, const char *new_path, double threshold);
+
+#endif // FM_BENCH_H
@@ -0,0 +1,146 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "fm.h"
+#include "fm_boot.h"
+
+// Время от загрузки ядра; в начале загрузки совпадает с метками dmesg
+static double boot_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_BOOTTIME, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Момент exec() процесса от загрузки ядра (поле starttime), -1 без /proc
+static double boot_exec_time(void) {
+    char buf[512];
+    unsigned long long start;
+    int fd = open(BOOT_STAT_FILE, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+
+    // После имени процесса в скобках: поля с 3-го, starttime - 22-е
+    char *p = strrchr(buf, ')');
+    if (!p) return -1;
+    p++;
+    for (int field = 3; field < 22 && p; field++) p = strchr(p + 1, ' ');
+    if (!p || sscanf(p, " %llu", &start) != 1) return -1;
+    return (double)start / sysconf(_SC_CLK_TCK);
+}
+
+static void boot_id(char *out, size_t size) {
+    int fd = open(BOOT_ID_FILE, O_RDONLY | O_CLOEXEC);
+    ssize_t n = fd >= 0 ? read(fd, out, size - 1) : -1;
+    if (fd >= 0) close(fd);
+    if (n <= 0) n = snprintf(out, size, "-");
+    out[n] = '\0';
+    out[strcspn(out, "\n")] = '\0';
+}
+
+// Строка в stdout и в журнал ядра: без цвета, консоль может быть последовательной
+static void boot_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void boot_log(const char *fmt, ...) {
+    char msg[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(msg, sizeof(msg), fmt, ap);
+    va_end(ap);
+
+    printf("fm early: %s\n", msg);
+    fflush(stdout);
+    int fd = open(BOOT_KMSG, O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        dprintf(fd, "<6>fm: %s\n", msg);
+        close(fd);
+    }
+}
+
+// Регистры без fm_init: его сообщения об ошибках цветные, а SIM_VERSION здесь не нужен
+static volatile uint32_t *boot_map(const char *sim_path, void **base) {
+    int fd;
+    off_t page = 0, offset = 0;
+
+    if (sim_path) {
+        fd = open(sim_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0 && ftruncate(fd, PAGE_SIZE) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    } else {
+        fd = open("/dev/mem", O_RDWR | O_SYNC | O_CLOEXEC);
+        page = BASE_ADDR & ~(PAGE_SIZE - 1);
+        offset = BASE_ADDR - page;
+    }
+    if (fd < 0) {
+        boot_log("cannot open %s: %s", sim_path ? sim_path : "/dev/mem", strerror(errno));
+        return NULL;
+    }
+    *base = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, page);
+    close(fd);
+    if (*base == MAP_FAILED) {
+        boot_log("mmap: %s", strerror(errno));
+        return NULL;
+    }
+    return (volatile uint32_t *)((char *)*base + offset);
+}
+
+int boot_apply(const char *sim_path, const char *log_path) {
+    double t_main = boot_clock();
+    double t_exec = boot_exec_time();
+    fm_transmitter_t tx = {0};
+    void *base;
+    fm_txn_t txn;
+
+    tx.regs = boot_map(sim_path, &base);
+    if (!tx.regs) return 1;
+    double t_map = boot_clock();
+
+    // Неуказанное в конфиге остается как в регистрах
+    fm_update_state(&tx);
+    if (!load_settings(&tx)) {
+        boot_log("no %s, registers left as they are", CONFIG_FILE);
+        munmap(base, PAGE_SIZE);
+        return 1;
+    }
+    double t_cfg = boot_clock();
+
+    settings_txn(&tx, &txn);
+    fm_txn_write(&tx, &txn);
+    double t_done = boot_clock();
+    uint32_t ctrl = tx.regs[REG_CTRL / 4];
+    munmap(base, PAGE_SIZE);
+
+    char exec[32] = "?";
+    if (t_exec >= 0) snprintf(exec, sizeof(exec), "%.3f", t_exec);
+    boot_log("%.3f MHz, CTRL 0x%02X (TX %s), %d write%s; exec at boot+%s s, %s at boot+%.3f s, "
+             "%.2f ms in main (map %.2f, config %.2f, write %.3f)",
+             tx.freq_mhz, ctrl, ctrl & 0x1 ? "on" : "off", txn.count, txn.count == 1 ? "" : "s",
+             exec, ctrl & 0x1 ? "carrier" : "applied", t_done, (t_done - t_main) * 1000.0, (t_map - t_main) * 1000.0,
+             (t_cfg - t_map) * 1000.0, (t_done - t_cfg) * 1000.0);
+
+    // Строка на загрузку для отслеживания времени до несущей от версии к версии
+    if (log_path) {
+        char id[64];
+        boot_id(id, sizeof(id));
+        FILE *f = fopen(log_path, "a");
+        if (!f) {
+            boot_log("cannot append to %s: %s", log_path, strerror(errno));
+            return 0;
+        }
+        fprintf(f, "boot_id=%s exec=%s carrier=%.3f main_ms=%.2f writes=%d freq=%.3f ctrl=0x%02X\n",
+                id, exec, t_done, (t_done - t_main) * 1000.0, txn.count, tx.freq_mhz, ctrl);
+        fclose(f);
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+#ifndef FM_BOOT_H
+#define FM_BOOT_H
+
+// Ранний запуск: сохраненные частота и CTRL пишутся сразу после загрузки ядра,
+// из initramfs или первым пунктом init. Без терминала, цвета и пауз после записи
+#define BOOT_KMSG        "/dev/kmsg"  // Строка в dmesg с меткой времени ядра
+#define BOOT_ID_FILE     "/proc/sys/kernel/random/boot_id"
+#define BOOT_STAT_FILE   "/proc/self/stat"
+
+int boot_apply(const char *sim_path, const char *log_path);
+
+#endif // FM_BOOT_H
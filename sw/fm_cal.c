@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "fm.h"
+#include "fm_cal.h"
+#include "fm_rt.h"
+
+static cal_tone_t cal_tone;
+static cal_model_t cal_model;
+static volatile int cal_stop;
+
+static double cal_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static const char *cal_signal_names[] = { "silence", "L+R", "L only", "R only" };
+
+// Мгновенные значения тестового сигнала, доля полной шкалы
+static void cal_signal_at(double t, double *l, double *r) {
+    double s = cal_tone.amp * sin(2 * M_PI * CAL_TONE_HZ * (t - cal_tone.t0));
+    int sig = cal_tone.signal;
+    *l = sig == CAL_MONO || sig == CAL_LEFT ? s : 0.0;
+    *r = sig == CAL_MONO || sig == CAL_RIGHT ? s : 0.0;
+}
+
+// MPX в кГц со знаком (регистр - 24 бита в шагах DDS)
+static double cal_mpx_khz(uint32_t raw) {
+    int32_t v = (int32_t)(raw << 8) >> 8;
+    return v * DDS_STEP / 1000.0;
+}
+
+// Воспроизведение тестового сигнала в звуковой тракт
+static void *cal_play_thread(void *arg) {
+    audio_dev_t *dev = arg;
+    int16_t buf[AUDIO_PERIOD * 2];
+    double t = cal_tone.t0;
+
+    rt_set_current(RT_ROLE_AUDIO);
+    while (!cal_stop) {
+        for (int i = 0; i < AUDIO_PERIOD; i++, t += 1.0 / AUDIO_RATE) {
+            double l, r;
+            cal_signal_at(t, &l, &r);
+            buf[2 * i] = (int16_t)lrint(l * AUDIO_MAX);
+            buf[2 * i + 1] = (int16_t)lrint(r * AUDIO_MAX);
+        }
+        if (audio_write(dev, buf, AUDIO_PERIOD) < 0) break;
+    }
+    return NULL;
+}
+
+// Модель PL для --sim: усиление каналов из REG_BALANCE, счетчики уровней и MPX
+// со стереокодером и пилот-тоном, с заданной ошибкой девиации и баланса.
+// Считается перед каждым чтением регистров: отдельный поток на одном ядре
+// отдает регистры с опозданием на квант планировщика, и амплитуда тона занижается
+static void cal_model_update(fm_transmitter_t *tx, double t) {
+    static unsigned seed = 1;
+    // Номинал: -9 dBFS моно плюс пилот дают 75 кГц
+    double k = (CAL_TARGET_KHZ - CAL_PILOT_KHZ) / pow(10.0, CAL_LEVEL_DB / 20.0);
+    double dev = k * pow(10.0, cal_model.gain_db / 20.0);
+    double hw_l = pow(10.0, cal_model.bal_db / 40.0), hw_r = 1.0 / hw_l;
+    double l, r;
+
+    uint32_t bal = tx->regs[REG_BALANCE / 4], ctrl = tx->regs[REG_CTRL / 4];
+    cal_signal_at(t, &l, &r);
+    l *= hw_l * BALANCE_GAIN(bal, 0);
+    r *= hw_r * BALANCE_GAIN(bal, 16);
+    if (ctrl & CTRL_MUTE_BIT) l = r = 0;
+
+    double mpx = dev * (l + r) / 2;
+    if (ctrl & 0x2) {
+        double p = 2 * M_PI * 19000.0 * t;
+        mpx += dev * (l - r) / 2 * sin(2 * p) + cal_model.pilot_khz * sin(p);
+    }
+    // Шум: сумма трех равномерных, примерно нормальный
+    double n = 0;
+    for (int i = 0; i < 3; i++) n += (double)rand_r(&seed) / RAND_MAX - 0.5;
+    mpx += cal_model.noise_khz * n * 2.0;
+
+    tx->regs[REG_LEFT / 4] = (uint16_t)(int16_t)lrint(fmax(-1.0, fmin(1.0, l)) * AUDIO_MAX);
+    tx->regs[REG_RIGHT / 4] = (uint16_t)(int16_t)lrint(fmax(-1.0, fmin(1.0, r)) * AUDIO_MAX);
+    tx->regs[REG_MPXLVL / 4] = (uint32_t)lrint(mpx * 1000.0 / DDS_STEP) & MPX_MAX;
+}
+
+// Синус-подгонка по трем параметрам (a sin + b cos + c) на частоте тона по меткам
+// времени отсчетов: тон отделяется от пилот-тона, поднесущей и шума
+typedef struct {
+    double ss, cc, sc, s, c, n;
+    double ys[3], yc[3], y1[3], y2[3];
+} cal_fit_t;
+
+static void cal_fit_add(cal_fit_t *f, double t, const double y[3]) {
+    double w = 2 * M_PI * CAL_TONE_HZ * (t - cal_tone.t0);
+    double s = sin(w), c = cos(w);
+    f->ss += s * s; f->cc += c * c; f->sc += s * c;
+    f->s += s; f->c += c; f->n += 1;
+    for (int i = 0; i < 3; i++) {
+        f->ys[i] += y[i] * s; f->yc[i] += y[i] * c;
+        f->y1[i] += y[i]; f->y2[i] += y[i] * y[i];
+    }
+}
+
+static double cal_det3(const double m[3][3]) {
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+         - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+         + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+// Амплитуда тона в канале i (правило Крамера для нормальных уравнений)
+static double cal_fit_amp(const cal_fit_t *f, int i) {
+    double m[3][3] = { { f->ss, f->sc, f->s }, { f->sc, f->cc, f->c }, { f->s, f->c, f->n } };
+    double v[3] = { f->ys[i], f->yc[i], f->y1[i] };
+    double d = cal_det3(m);
+    if (fabs(d) < 1e-12) return 0;
+    double x[2];
+    for (int k = 0; k < 2; k++) {
+        double mk[3][3];
+        memcpy(mk, m, sizeof(mk));
+        for (int r = 0; r < 3; r++) mk[r][k] = v[r];
+        x[k] = cal_det3(mk) / d;
+    }
+    return hypot(x[0], x[1]);
+}
+
+// Один шаг: сигнал, пауза на установление, частый опрос регистров
+static void cal_step(fm_transmitter_t *tx, cal_step_t *st) {
+    cal_fit_t f;
+    memset(&f, 0, sizeof(f));
+    cal_tone.amp = st->signal == CAL_SILENCE ? 0.0 : pow(10.0, st->level_db / 20.0);
+    cal_tone.signal = st->signal;
+    // Один канал - без стерео: поднесущая 38 кГц той же амплитуды, что и тон,
+    // при неравномерном опросе попадает в подгонку. Сумма (L+R)/2 та же
+    uint32_t ctrl = fm_read(tx, REG_CTRL);
+    uint32_t want = st->signal == CAL_LEFT || st->signal == CAL_RIGHT ? ctrl & ~0x2 : ctrl | 0x2;
+    if (want != ctrl) fm_write(tx, REG_CTRL, want);
+    usleep(CAL_SETTLE_MS * 1000);
+
+    double end = cal_now() + CAL_MEASURE_MS / 1000.0, t;
+    struct timespec ts = { 0, CAL_POLL_US * 1000 };
+    while ((t = cal_now()) < end && tx->running) {
+        double y[3];
+        if (tx->simulated) cal_model_update(tx, t);
+        y[0] = cal_mpx_khz(fm_read(tx, REG_MPXLVL));
+        y[1] = (int16_t)fm_read(tx, REG_LEFT) / (double)AUDIO_MAX;
+        y[2] = (int16_t)fm_read(tx, REG_RIGHT) / (double)AUDIO_MAX;
+        cal_fit_add(&f, t, y);
+        nanosleep(&ts, NULL);
+    }
+    st->samples = (long)f.n;
+    if (f.n < 16) return;
+    st->mpx_khz = cal_fit_amp(&f, 0);
+    st->left = cal_fit_amp(&f, 1);
+    st->right = cal_fit_amp(&f, 2);
+    double mean = f.y1[0] / f.n;
+    st->mpx_rms_khz = sqrt(fmax(0.0, f.y2[0] / f.n - mean * mean));
+}
+
+static void cal_print_step(const cal_step_t *st) {
+    char level[16] = "";
+    if (st->signal != CAL_SILENCE) snprintf(level, sizeof(level), "%.0f dBFS", st->level_db);
+    printf("  %-10s %-8s %-9s %8.2f %8.2f %9.4f %9.4f %7ld\n", st->name, cal_signal_names[st->signal], level,
+           st->mpx_khz, st->mpx_rms_khz, st->left, st->right, st->samples);
+}
+
+static double cal_db(double x) {
+    return x > 0 ? 20.0 * log10(x) : -120.0;
+}
+
+int cal_main(fm_transmitter_t *tx, const char *play_dev, const char *model) {
+    static audio_dev_t dev;
+    pthread_t play_thread;
+    double start = cal_now();
+
+    cal_tone.t0 = start;
+    cal_tone.signal = CAL_SILENCE;
+    if (tx->simulated) {
+        cal_model.gain_db = -1.2;
+        cal_model.bal_db = 0.6;
+        cal_model.pilot_khz = CAL_PILOT_KHZ;
+        cal_model.noise_khz = 0.3;
+        if (model) sscanf(model, "%lf,%lf", &cal_model.gain_db, &cal_model.bal_db);
+    } else {
+        if (audio_open(&dev, play_dev, AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) return 1;
+        if (rt_thread_create(&play_thread, RT_ROLE_AUDIO, cal_play_thread, &dev) != 0) {
+            printf("%sОшибка: поток воспроизведения не создан%s\n", COLOR_RED, COLOR_RESET);
+            audio_close(&dev);
+            return 1;
+        }
+    }
+
+    // Во время измерения нужны стерео (пилот) и звук; состояние вернется в конце
+    uint32_t ctrl = fm_read(tx, REG_CTRL), old_balance = fm_read(tx, REG_BALANCE);
+    fm_write(tx, REG_CTRL, (ctrl | 0x2) & ~CTRL_MUTE_BIT);
+
+    printf("%sCalibrating%s %s: %.0f Hz tone, %d ms per step%s\n", BOLD, COLOR_RESET,
+           tx->simulated ? "the simulated PL" : play_dev, CAL_TONE_HZ, CAL_SETTLE_MS + CAL_MEASURE_MS,
+           tx->simulated ? "" : " (the tones are on air if TX is on)");
+    if (tx->simulated) {
+        printf("Model error: deviation %+.2f dB, L/R balance %+.2f dB, pilot %.2f kHz\n",
+               cal_model.gain_db, cal_model.bal_db, cal_model.pilot_khz);
+    }
+    printf("\n  %-10s %-8s %-9s %8s %8s %9s %9s %7s\n", "Step", "Signal", "Level", "MPX kHz", "RMS kHz", "REG_LEFT", "REG_RIGHT", "Samples");
+
+    cal_step_t steps[] = {
+        { .name = "pilot", .signal = CAL_SILENCE, .level_db = 0 },
+        { .name = "mono-21", .signal = CAL_MONO, .level_db = -21 },
+        { .name = "mono-15", .signal = CAL_MONO, .level_db = -15 },
+        { .name = "mono-9", .signal = CAL_MONO, .level_db = CAL_LEVEL_DB },
+        { .name = "left", .signal = CAL_LEFT, .level_db = CAL_LEVEL_DB },
+        { .name = "right", .signal = CAL_RIGHT, .level_db = CAL_LEVEL_DB },
+    };
+    int n_steps = sizeof(steps) / sizeof(steps[0]);
+    for (int i = 0; i < n_steps && tx->running; i++) {
+        cal_step(tx, &steps[i]);
+        cal_print_step(&steps[i]);
+    }
+
+    // Пилот: СКЗ при тишине; тон: наклон по трем уровням (прямая через ноль)
+    double pilot = steps[0].mpx_rms_khz * M_SQRT2;
+    double sxy = 0, sxx = 0, lin_err = 0;
+    for (int i = 1; i <= 3; i++) {
+        double x = pow(10.0, steps[i].level_db / 20.0);
+        sxy += x * steps[i].mpx_khz;
+        sxx += x * x;
+    }
+    double slope = sxy / sxx;
+    for (int i = 1; i <= 3; i++) {
+        double x = pow(10.0, steps[i].level_db / 20.0);
+        double e = fabs(steps[i].mpx_khz / (slope * x) - 1.0);
+        if (e > lin_err) lin_err = e;
+    }
+    double a9 = pow(10.0, CAL_LEVEL_DB / 20.0);
+    double gain = (CAL_TARGET_KHZ - pilot) / (slope * a9);
+    // Одиночный канал дает половину моно-составляющей; поправка делится поровну
+    double bal = steps[4].mpx_khz > 0 && steps[5].mpx_khz > 0 ? steps[4].mpx_khz / steps[5].mpx_khz : 1.0;
+    double corr_l = gain / sqrt(bal), corr_r = gain * sqrt(bal);
+    double sep = cal_db(steps[4].right / fmax(steps[4].left, 1e-9));
+
+    printf("\n%sFit:%s deviation %.2f kHz at %.0f dBFS + pilot %.2f kHz = %.2f kHz, linearity %.2f%%\n",
+           BOLD, COLOR_RESET, slope * a9, CAL_LEVEL_DB, pilot, slope * a9 + pilot, lin_err * 100.0);
+    printf("     L/R %+.2f dB on MPX, meters L %.1f / R %.1f dBFS, L->R leakage %.1f dB\n",
+           cal_db(bal), cal_db(steps[4].left), cal_db(steps[5].right), sep);
+    printf("     correction L %+.2f dB, R %+.2f dB\n", cal_db(corr_l), cal_db(corr_r));
+
+    int ret = 0;
+    if (!tx->running) {
+        ret = 1;
+    } else if (steps[3].mpx_khz < 1.0 || fabs(cal_db(corr_l)) > CAL_MAX_CORR_DB || fabs(cal_db(corr_r)) > CAL_MAX_CORR_DB) {
+        printf("%sОшибка: поправка вне ±%.0f dB или нет тона в MPX - проверьте звуковой тракт, BALANCE не изменен%s\n",
+               COLOR_RED, CAL_MAX_CORR_DB, COLOR_RESET);
+        ret = 1;
+    } else {
+        double gl = BALANCE_GAIN(old_balance, 0) * corr_l, gr = BALANCE_GAIN(old_balance, 16) * corr_r;
+        uint32_t l = (uint32_t)fmin(lrint(gl * BALANCE_UNITY), 0xFFFF), r = (uint32_t)fmin(lrint(gr * BALANCE_UNITY), 0xFFFF);
+        uint32_t balance = r << 16 | l;
+        fm_write(tx, REG_BALANCE, balance);
+        printf("     REG_BALANCE 0x%08X -> %s0x%08X%s (L %.4f, R %.4f)\n", old_balance, COLOR_GREEN, balance, COLOR_RESET, gl, gr);
+
+        // Проверка после записи
+        cal_step_t check[] = {
+            { .name = "check-mono", .signal = CAL_MONO, .level_db = CAL_LEVEL_DB },
+            { .name = "check-left", .signal = CAL_LEFT, .level_db = CAL_LEVEL_DB },
+            { .name = "check-right", .signal = CAL_RIGHT, .level_db = CAL_LEVEL_DB },
+        };
+        printf("\n");
+        for (int i = 0; i < 3 && tx->running; i++) {
+            cal_step(tx, &check[i]);
+            cal_print_step(&check[i]);
+        }
+        double total = check[0].mpx_khz + pilot;
+        double after = cal_db(check[1].mpx_khz / fmax(check[2].mpx_khz, 1e-9));
+        int ok = fabs(total - CAL_TARGET_KHZ) < 0.5 && fabs(after) < 0.1;
+        printf("\n%sResult:%s %s%.2f kHz%s at %.0f dBFS (target %.0f), L/R %+.3f dB\n", BOLD, COLOR_RESET,
+               ok ? COLOR_GREEN : COLOR_YELLOW, total, COLOR_RESET, CAL_LEVEL_DB, CAL_TARGET_KHZ, after);
+        if (!ok) ret = 1;
+
+        cal_tone.signal = CAL_SILENCE;
+        fm_write(tx, REG_CTRL, ctrl);
+
+        // Поправка сохраняется в конфиг, чтобы --auto применял ее после загрузки
+        if (!tx->simulated) {
+            fm_transmitter_t cfg = *tx;
+            fm_update_state(&cfg);
+            load_settings(&cfg);
+            cfg.balance = balance;
+            if (save_settings(&cfg) == 0) printf("Saved BALANCE=0x%08X to %s\n", balance, CONFIG_FILE);
+            else printf("%sОшибка: Не могу сохранить %s%s\n", COLOR_RED, CONFIG_FILE, COLOR_RESET);
+        }
+    }
+
+    cal_tone.signal = CAL_SILENCE;
+    if (fm_read(tx, REG_CTRL) != ctrl) fm_write(tx, REG_CTRL, ctrl);
+    cal_stop = 1;
+    if (!tx->simulated) {
+        pthread_join(play_thread, NULL);
+        audio_close(&dev);
+    }
+    printf("Sweep took %.1f s\n", cal_now() - start);
+    return ret;
+}
@@ -0,0 +1,55 @@
+#ifndef FM_CAL_H
+#define FM_CAL_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+
+// Калибровка девиации и баланса: тестовые тоны в звуковой тракт, уровни из регистров
+#define CAL_TONE_HZ        997.0     // Не кратна частоте опроса и пилот-тону
+#define CAL_SETTLE_MS      120       // После смены тона: буфер ALSA и фильтры PL
+#define CAL_MEASURE_MS     200       // Опрос регистров на шаг
+#define CAL_POLL_US        5         // Период опроса регистров
+#define CAL_TARGET_KHZ     75.0      // Полная девиация вместе с пилот-тоном при -9 dBFS
+#define CAL_LEVEL_DB       (-9.0)
+#define CAL_MAX_CORR_DB    6.0       // Большая поправка - ошибка тракта, а не калибровки
+#define CAL_PILOT_KHZ      6.75      // Номинальный пилот-тон, 9% девиации (для модели)
+
+typedef enum {
+    CAL_SILENCE = 0,
+    CAL_MONO,
+    CAL_LEFT,
+    CAL_RIGHT
+} cal_signal_t;
+
+// Текущий тестовый сигнал; его читают поток воспроизведения и модель
+typedef struct {
+    volatile int signal;
+    volatile double amp;             // Доля полной шкалы
+    double t0;                       // Начало отсчета фазы, CLOCK_MONOTONIC
+} cal_tone_t;
+
+// Модель тракта для --sim: регистры следуют за тестовым сигналом
+typedef struct {
+    double gain_db;                  // Ошибка девиации
+    double bal_db;                   // L громче R на столько
+    double pilot_khz;
+    double noise_khz;
+} cal_model_t;
+
+// Результат одного шага: амплитуды 997 Гц по синус-подгонке и СКЗ MPX
+typedef struct {
+    const char *name;
+    cal_signal_t signal;
+    double level_db;
+    double mpx_khz;                  // Амплитуда тона в MPX
+    double mpx_rms_khz;
+    double left, right;              // Амплитуды тона в REG_LEFT/REG_RIGHT, доля шкалы
+    long samples;
+} cal_step_t;
+
+int cal_main(fm_transmitter_t *tx, const char *play_dev, const char *model);
+
+#endif // FM_CAL_H
@@ -0,0 +1,180 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "fm.h"
+#include "fm_config.h"
+#include "fm_rt.h"
+
+static double config_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void config_log(config_watch_t *w, const char *color, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static void config_log(config_watch_t *w, const char *color, const char *fmt, ...) {
+    struct timespec ts;
+    struct tm tm;
+    char stamp[16];
+    va_list ap;
+
+    if (w->quiet) return;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    localtime_r(&ts.tv_sec, &tm);
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+    printf("%s[config] %s.%03ld ", color, stamp, ts.tv_nsec / 1000000);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("%s\n", COLOR_RESET);
+    fflush(stdout);
+}
+
+// Имя файла конфига без каталога - по нему отбираются события каталога
+static const char *config_name(void) {
+    const char *slash = strrchr(CONFIG_FILE, '/');
+    return slash ? slash + 1 : CONFIG_FILE;
+}
+
+// Перечитать конфиг поверх текущих регистров и записать только отличающиеся
+static void config_reload(config_watch_t *w, double event_at) {
+    fm_transmitter_t cfg = *w->tx;
+    struct stat st;
+    struct timespec real;
+
+    uint32_t ctrl = fm_read(w->tx, REG_CTRL);
+    uint32_t freq = fm_read(w->tx, REG_FREQ);
+    fm_update_state(&cfg);
+    if (!load_settings(&cfg)) {
+        w->errors++;
+        config_log(w, COLOR_RED, "cannot read %s", CONFIG_FILE);
+        return;
+    }
+    int n = auto_apply_settings(&cfg);
+    double done = config_now();
+    clock_gettime(CLOCK_REALTIME, &real);
+
+    double apply_ms = (done - event_at) * 1000.0;
+    double lag_ms = -1;
+    if (stat(CONFIG_FILE, &st) == 0) {
+        lag_ms = (real.tv_sec - st.st_mtim.tv_sec) * 1000.0 + (real.tv_nsec - st.st_mtim.tv_nsec) / 1e6;
+    }
+
+    w->reloads++;
+    w->writes += n;
+    w->apply_sum_ms += apply_ms;
+    if (apply_ms > w->apply_max_ms) w->apply_max_ms = apply_ms;
+    if (lag_ms >= 0) {
+        w->lag_sum_ms += lag_ms;
+        if (lag_ms > w->lag_max_ms) w->lag_max_ms = lag_ms;
+    }
+    w->last_writes = n;
+    w->last_ms = apply_ms;
+    w->last_at = real.tv_sec;
+    __sync_synchronize();
+    w->applied++;
+
+    if (n == 0) {
+        w->unchanged++;
+        config_log(w, COLOR_CYAN, "reloaded, registers unchanged (%.2f ms)", apply_ms);
+        return;
+    }
+
+    char what[128] = "";
+    uint32_t new_freq = fm_read(w->tx, REG_FREQ), new_ctrl = fm_read(w->tx, REG_CTRL);
+    if (new_freq != freq) {
+        snprintf(what, sizeof(what), "FREQ %.3f -> %.3f MHz", freq * DDS_STEP / 1e6, new_freq * DDS_STEP / 1e6);
+    }
+    if (new_ctrl != ctrl) {
+        size_t len = strlen(what);
+        snprintf(what + len, sizeof(what) - len, "%sCTRL 0x%02X -> 0x%02X", len ? ", " : "", ctrl, new_ctrl);
+    }
+    config_log(w, COLOR_GREEN, "applied %s: %d write%s in %.2f ms, %.2f ms after the file changed",
+               what, n, n == 1 ? "" : "s", apply_ms, lag_ms);
+}
+
+static void *config_thread(void *arg) {
+    config_watch_t *w = arg;
+    char buf[CONFIG_EVENT_BUF] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char *name = config_name();
+    struct pollfd pfd = { w->fd, POLLIN, 0 };
+
+    while (!w->stop) {
+        int r = poll(&pfd, 1, CONFIG_POLL_MS);
+        if (r <= 0) continue;
+        double event_at = config_now();
+
+        // Несколько событий подряд (запись + rename) - одно перечитывание
+        int hit = 0;
+        ssize_t len;
+        while ((len = read(w->fd, buf, sizeof(buf))) > 0) {
+            for (char *p = buf; p < buf + len; ) {
+                struct inotify_event *ev = (struct inotify_event *)p;
+                if (ev->len && strcmp(ev->name, name) == 0) {
+                    w->events++;
+                    hit = 1;
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+        if (hit) config_reload(w, event_at);
+    }
+    return NULL;
+}
+
+int config_watch_start(config_watch_t *w, fm_transmitter_t *tx, int quiet) {
+    char dir[256];
+
+    w->tx = tx;
+    w->quiet = quiet;
+    w->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (w->fd < 0) {
+        printf("%sОшибка: inotify: %s%s\n", COLOR_RED, strerror(errno), COLOR_RESET);
+        return -1;
+    }
+
+    // Следим за каталогом: при сохранении через rename у файла меняется inode
+    snprintf(dir, sizeof(dir), "%s", CONFIG_FILE);
+    char *slash = strrchr(dir, '/');
+    if (slash) *(slash == dir ? slash + 1 : slash) = 0;
+    else snprintf(dir, sizeof(dir), ".");
+    if (inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        printf("%sОшибка: inotify %s: %s%s\n", COLOR_RED, dir, strerror(errno), COLOR_RESET);
+        close(w->fd);
+        return -1;
+    }
+
+    if (!quiet) {
+        printf("Watching %s, changed registers are applied on save\n", CONFIG_FILE);
+        fflush(stdout);
+    }
+    if (rt_thread_create(&w->thread, RT_ROLE_CONTROL, config_thread, w) != 0) {
+        close(w->fd);
+        return -1;
+    }
+    return 0;
+}
+
+void config_watch_stop(config_watch_t *w) {
+    w->stop = 1;
+    pthread_join(w->thread, NULL);
+    close(w->fd);
+
+    if (w->quiet) return;
+    if (w->reloads == 0) {
+        printf("%sConfig: no reloads%s\n", COLOR_GREEN, COLOR_RESET);
+        return;
+    }
+    printf("%sConfig:%s %ld reloads (%ld without register changes), %ld register writes, %ld errors\n",
+           BOLD, COLOR_RESET, w->reloads, w->unchanged, w->writes, w->errors);
+    printf("        event to applied avg %.2f / max %.2f ms, file change to applied avg %.2f / max %.2f ms\n",
+           w->apply_sum_ms / w->reloads, w->apply_max_ms, w->lag_sum_ms / w->reloads, w->lag_max_ms);
+}
@@ -0,0 +1,38 @@
+#ifndef FM_CONFIG_H
+#define FM_CONFIG_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fm.h"
+
+// Слежение за сохраненным конфигом через inotify и применение изменений в работающем процессе
+#define CONFIG_POLL_MS     200      // Проверка флага остановки
+#define CONFIG_EVENT_BUF   4096
+
+typedef struct {
+    fm_transmitter_t *tx;
+    int quiet;                      // Интерфейс на экране: без строк журнала
+    int fd;
+    pthread_t thread;
+    volatile int stop;
+    // Последнее применение (для интерфейса)
+    volatile long applied;          // Растет после каждого применения
+    volatile int last_writes;
+    volatile double last_ms;
+    volatile time_t last_at;
+    // Статистика
+    long events;                    // Событий inotify по файлу конфига
+    long reloads;
+    long writes;                    // Записано регистров
+    long unchanged;                 // Перечитано без изменений регистров
+    long errors;
+    double apply_sum_ms, apply_max_ms;  // От события до записи регистров
+    double lag_sum_ms, lag_max_ms;      // От изменения файла (mtime) до записи регистров
+} config_watch_t;
+
+int config_watch_start(config_watch_t *w, fm_transmitter_t *tx, int quiet);
+void config_watch_stop(config_watch_t *w);
+
+#endif // FM_CONFIG_H
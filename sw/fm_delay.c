@@ -0,0 +1,462 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_rt.h"
+#include "fm_delay.h"
+
+#define DELAY_MASK (DELAY_RING_FRAMES - 1)
+
+static double delay_cpu_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static inline int16_t delay_sat(float v) {
+    if (v > 32767.0f) return 32767;
+    if (v < -32768.0f) return -32768;
+    return (int16_t)lrintf(v);
+}
+
+// Отрицательные позиции (тишина до начала) заворачиваются в конец кольца
+static inline int16_t *delay_at(delay_t *d, int64_t pos) {
+    return &d->ring[((uint64_t)pos & DELAY_MASK) * 2];
+}
+
+static inline float delay_mono(delay_t *d, int64_t pos) {
+    const int16_t *x = delay_at(d, pos);
+    return (float)x[0] + (float)x[1];
+}
+
+static int64_t delay_frames(delay_t *d, double seconds) {
+    if (seconds > DELAY_MAX_SEC) seconds = DELAY_MAX_SEC;
+    int64_t frames = llround(seconds * d->rate);
+    return frames < d->min_frames ? d->min_frames : frames;
+}
+
+// Кольцо и состояние - одна арена: заполняется нулями (все страницы отображены)
+// и закрепляется в RAM, чтобы в потоке звука не было ни выделений, ни page fault
+delay_t *delay_create(int rate, double target_sec) {
+    size_t head = (sizeof(delay_t) + 63) & ~(size_t)63;
+    size_t size = head + (size_t)DELAY_RING_FRAMES * 2 * sizeof(int16_t);
+    char *arena = aligned_alloc(64, size);
+
+    if (!arena) {
+        printf("%sОшибка: нет памяти под задержку (%zu байт)%s\n", COLOR_RED, size, COLOR_RESET);
+        return NULL;
+    }
+    memset(arena, 0, size);
+    delay_t *d = (delay_t *)arena;
+    d->ring = (int16_t *)(arena + head);
+    d->memory = size;
+    d->locked = mlock(arena, size) == 0;
+    d->rate = rate;
+    d->min_frames = (int64_t)rate * DELAY_MIN_MS / 1000;
+    d->target = delay_frames(d, target_sec);
+
+    // Старт с минимальной задержкой тишины, дальше набор до цели
+    d->wpos = d->min_frames;
+    d->seg = -DELAY_HOP;
+    d->hop_pos = DELAY_HOP;
+
+    for (int i = 0; i < DELAY_HOP; i++) {
+        float s = sinf((float)M_PI / 2.0f * (i + 0.5f) / DELAY_HOP);
+        d->win[i] = s * s;
+    }
+    for (int i = 0; i < DELAY_XFADE; i++) {
+        d->xfade[i] = sinf((float)M_PI / 2.0f * (i + 0.5f) / DELAY_XFADE);
+    }
+    return d;
+}
+
+void delay_destroy(delay_t *d) {
+    if (!d) return;
+    if (d->locked) munlock(d, d->memory);
+    free(d);
+}
+
+// Нормированная корреляция: сдвиг, на котором форма волны совпадает с продолжением
+static float delay_score(const float *ref, const float *x, int n, int step) {
+    float xy = 0.0f, yy = 1.0f;
+    for (int i = 0; i < n; i += step) {
+        xy += ref[i] * x[i];
+        yy += x[i] * x[i];
+    }
+    return xy / sqrtf(yy);
+}
+
+static int64_t delay_search(delay_t *d, int64_t nat, int64_t lo, int64_t hi) {
+    int range = (int)(hi - lo), best = 0;
+    float best_score = -INFINITY;
+
+    for (int i = 0; i < DELAY_HOP; i++) d->ref[i] = delay_mono(d, nat + i);
+    for (int i = 0; i < range + DELAY_HOP; i++) d->cand[i] = delay_mono(d, lo + i);
+
+    // Грубо: каждый DECIM-й сдвиг по прореженным отсчетам
+    for (int k = 0; k <= range; k += DELAY_DECIM) {
+        float s = delay_score(d->ref, d->cand + k, DELAY_HOP, DELAY_DECIM);
+        if (s > best_score) {
+            best_score = s;
+            best = k;
+        }
+    }
+    // Точно: соседние сдвиги по всем отсчетам
+    int from = best - DELAY_DECIM + 1, to = best + DELAY_DECIM - 1;
+    if (from < 0) from = 0;
+    if (to > range) to = range;
+    best_score = -INFINITY;
+    for (int k = from; k <= to; k++) {
+        float s = delay_score(d->ref, d->cand + k, DELAY_HOP, 1);
+        if (s > best_score) {
+            best_score = s;
+            best = k;
+        }
+    }
+    return lo + best;
+}
+
+// Следующий шаг выхода. Без растяжения - точная копия входа; при растяжении
+// сегмент берется на DELAY_STRETCH ближе или дальше естественного продолжения
+// (с поправкой на лучшее совпадение формы) и вплетается окном Ханна
+static void delay_next_hop(delay_t *d) {
+    int64_t nat = d->seg + DELAY_HOP, cur = d->wpos - nat, next = nat;
+
+    // Гистерезис: растяжение включается при уходе дальше двух шагов, выключается на цели
+    if (d->mode == 0 && (cur < d->target - 2 * DELAY_HOP || cur > d->target + 2 * DELAY_HOP)) {
+        d->mode = cur < d->target ? 1 : -1;
+        d->tau = (double)d->seg;
+    } else if ((d->mode > 0 && cur >= d->target) || (d->mode < 0 && cur <= d->target)) {
+        d->mode = 0;
+    }
+
+    if (d->mode != 0) {
+        d->tau += DELAY_HOP * (1.0 - d->mode * DELAY_STRETCH);
+        int64_t t = llround(d->tau), lo = t - DELAY_SEEK, hi = t + DELAY_SEEK;
+        // Сегмент и шаг после него уже должны быть в кольце
+        if (hi > d->wpos - 2 * DELAY_HOP) hi = d->wpos - 2 * DELAY_HOP;
+        if (lo > hi) lo = hi;
+        next = delay_search(d, nat, lo, hi);
+        d->stretched++;
+    }
+
+    if (next == nat) {
+        for (int i = 0; i < DELAY_HOP; i++) {
+            const int16_t *x = delay_at(d, nat + i);
+            d->hop[2 * i] = x[0];
+            d->hop[2 * i + 1] = x[1];
+        }
+    } else {
+        for (int i = 0; i < DELAY_HOP; i++) {
+            const int16_t *a = delay_at(d, nat + i), *b = delay_at(d, next + i);
+            float w = d->win[i];
+            d->hop[2 * i] = delay_sat(a[0] + (b[0] - a[0]) * w);
+            d->hop[2 * i + 1] = delay_sat(a[1] + (b[1] - a[1]) * w);
+        }
+    }
+    d->seg = next;
+    d->hop_pos = 0;
+}
+
+// Сброс: позиция записи отступает, и новые отсчеты ложатся поверх выброшенных.
+// Выброшенное - продолжение уже звучавшего, поэтому стык - обычный переход
+static void delay_apply(delay_t *d, const delay_cmd_t *c) {
+    if (c->type == DELAY_CMD_TARGET) {
+        d->target = delay_frames(d, c->seconds);
+        return;
+    }
+    int64_t drop = d->wpos - d->seg - d->hop_pos - d->min_frames;
+    if (c->seconds >= 0 && llround(c->seconds * d->rate) < drop) drop = llround(c->seconds * d->rate);
+    if (drop <= 0) return;
+    d->wpos -= drop;
+    d->xfade_left = DELAY_XFADE;
+    d->dumps++;
+    d->dumped += drop;
+}
+
+static void delay_write(delay_t *d, const int16_t *in, int frames) {
+    for (int f = 0; f < frames; f++) {
+        int16_t *x = delay_at(d, d->wpos + f);
+        if (d->xfade_left > 0) {
+            // Равномощный переход: сброшенный и новый звук не коррелированы
+            float g = d->xfade[DELAY_XFADE - d->xfade_left], o = d->xfade[d->xfade_left - 1];
+            x[0] = delay_sat(x[0] * o + in[2 * f] * g);
+            x[1] = delay_sat(x[1] * o + in[2 * f + 1] * g);
+            d->xfade_left--;
+        } else {
+            x[0] = in[2 * f];
+            x[1] = in[2 * f + 1];
+        }
+    }
+    d->wpos += frames;
+}
+
+void delay_process(delay_t *d, const int16_t *in, int16_t *out, int frames) {
+    uint32_t tail = d->cmd_tail;
+    while (tail != __atomic_load_n(&d->cmd_head, __ATOMIC_ACQUIRE)) {
+        delay_apply(d, &d->cmdq[tail & (DELAY_CMDQ - 1)]);
+        tail++;
+    }
+    __atomic_store_n(&d->cmd_tail, tail, __ATOMIC_RELEASE);
+
+    delay_write(d, in, frames);
+    for (int f = 0; f < frames; f++) {
+        if (d->hop_pos == DELAY_HOP) delay_next_hop(d);
+        out[2 * f] = d->hop[2 * d->hop_pos];
+        out[2 * f + 1] = d->hop[2 * d->hop_pos + 1];
+        d->hop_pos++;
+    }
+    d->stat_delay = d->wpos - d->seg - d->hop_pos;
+}
+
+static int delay_cmd_push(delay_t *d, const delay_cmd_t *c) {
+    uint32_t head = d->cmd_head;
+    if (head - __atomic_load_n(&d->cmd_tail, __ATOMIC_ACQUIRE) >= DELAY_CMDQ) return -1;
+    d->cmdq[head & (DELAY_CMDQ - 1)] = *c;
+    __atomic_store_n(&d->cmd_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void delay_status(delay_t *d, delay_status_t *st) {
+    double played = (double)d->processed / d->rate;
+    st->delay_sec = (double)d->stat_delay / d->rate;
+    st->target_sec = (double)d->target / d->rate;
+    st->mode = d->mode;
+    st->dumps = d->dumps;
+    st->dumped_sec = (double)d->dumped / d->rate;
+    st->cpu_pct = played > 0 ? d->cpu_sec / played * 100.0 : 0.0;
+    st->memory = d->memory;
+    st->locked = d->locked;
+}
+
+static const char *delay_mode_str(int mode) {
+    return mode > 0 ? "building" : mode < 0 ? "shrinking" : "holding";
+}
+
+static void delay_report(delay_t *d, FILE *out) {
+    delay_status_t st;
+    delay_status(d, &st);
+    fprintf(out, "Delay %.3f s (target %.3f s, %s) | %ld dump%s, %.3f s dropped | "
+            "CPU %.3f%% avg, %.0f us max/period | %.1f MiB %s\n",
+            st.delay_sec, st.target_sec, delay_mode_str(st.mode), st.dumps, st.dumps == 1 ? "" : "s",
+            st.dumped_sec, st.cpu_pct, d->cpu_max * 1e6, st.memory / 1048576.0,
+            st.locked ? "locked" : "NOT locked (mlock failed)");
+}
+
+int delay_command(delay_t *d, const char *line) {
+    char verb[16];
+    double sec = 0;
+    delay_cmd_t c;
+    int n = sscanf(line, "%15s %lf", verb, &sec);
+
+    if (n < 1) return 0;
+    if (strcmp(verb, "dump") == 0 || strcmp(verb, "d") == 0) {
+        if (n > 1 && sec <= 0) {
+            printf("%sОшибка: сбросить можно > 0 с%s\n", COLOR_RED, COLOR_RESET);
+            return -1;
+        }
+        c.type = DELAY_CMD_DUMP;
+        c.seconds = n > 1 ? sec : -1;
+    } else if (strcmp(verb, "delay") == 0 && n > 1) {
+        if (sec < 0 || sec > DELAY_MAX_SEC) {
+            printf("%sОшибка: задержка от 0 до %d с%s\n", COLOR_RED, DELAY_MAX_SEC, COLOR_RESET);
+            return -1;
+        }
+        c.type = DELAY_CMD_TARGET;
+        c.seconds = sec;
+    } else if (strcmp(verb, "status") == 0) {
+        delay_report(d, stdout);
+        fflush(stdout);
+        return 0;
+    } else {
+        printf("%sUnknown delay command: %s (dump [SEC], delay SEC, status)%s\n", COLOR_RED, line, COLOR_RESET);
+        return -1;
+    }
+
+    if (delay_cmd_push(d, &c) != 0) {
+        printf("%sОшибка: очередь команд полна%s\n", COLOR_RED, COLOR_RESET);
+        return -1;
+    }
+    return 0;
+}
+
+// Состояние для TUI и --serve: переименование, чтобы не читалась половина строки
+static void delay_write_status(delay_t *d) {
+    delay_status_t st;
+    FILE *f = fopen(DELAY_STATUS_FILE ".tmp", "w");
+
+    if (!f) return;
+    delay_status(d, &st);
+    fprintf(f, "delay=%.3f target=%.3f mode=%d dumps=%ld dumped=%.3f cpu=%.3f memory=%zu locked=%d\n",
+            st.delay_sec, st.target_sec, st.mode, st.dumps, st.dumped_sec, st.cpu_pct, st.memory, st.locked);
+    fclose(f);
+    rename(DELAY_STATUS_FILE ".tmp", DELAY_STATUS_FILE);
+}
+
+int delay_read_status(delay_status_t *st) {
+    struct stat sb;
+    FILE *f;
+    int n;
+
+    if (stat(DELAY_STATUS_FILE, &sb) != 0 || time(NULL) - sb.st_mtime > DELAY_STATUS_AGE) return -1;
+    if (!(f = fopen(DELAY_STATUS_FILE, "r"))) return -1;
+    n = fscanf(f, "delay=%lf target=%lf mode=%d dumps=%ld dumped=%lf cpu=%lf memory=%zu locked=%d",
+               &st->delay_sec, &st->target_sec, &st->mode, &st->dumps, &st->dumped_sec, &st->cpu_pct,
+               &st->memory, &st->locked);
+    fclose(f);
+    return n == 8 ? 0 : -1;
+}
+
+// Без читателя FIFO (режим не запущен) open() отказывает с ENXIO, а не блокируется
+int delay_send(const char *line) {
+    struct stat st;
+    int fd = open(DELAY_CTL_FIFO, O_WRONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode)) {
+        close(fd);
+        return -1;
+    }
+    int n = dprintf(fd, "%s\n", line);
+    close(fd);
+    return n > 0 ? 0 : -1;
+}
+
+// Управление: строки из FIFO (TUI, --serve, скрипты) и с терминала; файл состояния раз в секунду
+static void *delay_control(void *arg) {
+    delay_t *d = arg;
+    char line[256], buf[256];
+    int len = 0;
+    long seen_dumps = 0;
+    time_t last = 0;
+
+    // Команды сбрасывают эфир: FIFO только для владельца и группы, и только свой
+    if (mkfifo(DELAY_CTL_FIFO, 0660) != 0 && errno != EEXIST) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, DELAY_CTL_FIFO, strerror(errno), COLOR_RESET);
+    }
+    // O_RDWR: FIFO не отдает EOF, когда пишущий скрипт закрывается
+    int fd = open(DELAY_CTL_FIFO, O_RDWR | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && (fstat(fd, &st) != 0 || !S_ISFIFO(st.st_mode) || st.st_uid != geteuid())) {
+        printf("%sОшибка: %s - не наш FIFO, команды только с терминала%s\n", COLOR_RED, DELAY_CTL_FIFO, COLOR_RESET);
+        close(fd);
+        fd = -1;
+    } else if (fd >= 0 && (st.st_mode & 0007)) {
+        // Оставшийся от старой версии FIFO с записью для всех
+        fchmod(fd, 0660);
+    }
+    struct pollfd pfd[2] = {{fd, POLLIN, 0}, {isatty(STDIN_FILENO) ? STDIN_FILENO : -1, POLLIN, 0}};
+
+    while (!d->stop) {
+        if (time(NULL) != last) {
+            last = time(NULL);
+            delay_write_status(d);
+        }
+        if (d->dumps != seen_dumps) {
+            seen_dumps = d->dumps;
+            printf("Dumped: %.3f s dropped in total, delay now %.3f s, rebuilding to %.3f s\n",
+                   (double)d->dumped / d->rate, (double)d->stat_delay / d->rate, (double)d->target / d->rate);
+            fflush(stdout);
+        }
+        if (poll(pfd, 2, 100) <= 0) continue;
+        if (pfd[1].revents & POLLIN) {
+            ssize_t r = read(STDIN_FILENO, line, sizeof(line) - 1);
+            if (r > 0) {
+                line[r] = '\0';
+                line[strcspn(line, "\n")] = '\0';
+                delay_command(d, line);
+            }
+        }
+        if (pfd[0].revents & POLLIN) {
+            ssize_t r = read(fd, buf + len, sizeof(buf) - 1 - len);
+            if (r <= 0) continue;
+            len += r;
+            buf[len] = '\0';
+            char *start = buf, *nl;
+            while ((nl = strchr(start, '\n'))) {
+                *nl = '\0';
+                delay_command(d, start);
+                start = nl + 1;
+            }
+            len -= start - buf;
+            memmove(buf, start, len);
+            if (len >= (int)sizeof(buf) - 1) len = 0;
+        }
+    }
+    if (fd >= 0) close(fd);
+    unlink(DELAY_STATUS_FILE);
+    return NULL;
+}
+
+// Режим --delay: capture -> задержка -> playback
+int delay_main(double target_sec, const char *capture_dev, const char *play_dev) {
+    int16_t in[AUDIO_PERIOD * AUDIO_CHANNELS], out[AUDIO_PERIOD * AUDIO_CHANNELS];
+    audio_dev_t cap, play;
+    pthread_t ctl;
+    time_t last = time(NULL);
+
+    if (target_sec < 0 || target_sec > DELAY_MAX_SEC) {
+        printf("%sОшибка: задержка от 0 до %d с%s\n", COLOR_RED, DELAY_MAX_SEC, COLOR_RESET);
+        return 1;
+    }
+    delay_t *d = delay_create(AUDIO_RATE, target_sec);
+    if (!d) return 1;
+    // Файл читается в темпе реального времени: команды приходят по ходу программы,
+    // а после конца файла задержка доигрывается на тишине
+    if (audio_open(&cap, capture_dev, AUDIO_CAPTURE | AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) {
+        delay_destroy(d);
+        return 1;
+    }
+    if (audio_open(&play, play_dev, 0, AUDIO_RATE, AUDIO_CHANNELS) != 0) {
+        audio_close(&cap);
+        delay_destroy(d);
+        return 1;
+    }
+    if (rt_thread_create(&ctl, RT_ROLE_CONTROL, delay_control, d) != 0) {
+        printf("%sОшибка: поток управления не создан%s\n", COLOR_RED, COLOR_RESET);
+        audio_close(&play);
+        audio_close(&cap);
+        delay_destroy(d);
+        return 1;
+    }
+    if (rt_enabled) rt_set_current(RT_ROLE_AUDIO);
+
+    printf("Safety delay %s -> %s: target %.3f s, building from %d ms at %.0f%% tempo; commands on %s\n",
+           capture_dev, play_dev, (double)d->target / d->rate, DELAY_MIN_MS, DELAY_STRETCH * 100.0, DELAY_CTL_FIFO);
+    fflush(stdout);
+    while (global_tx->running) {
+        int n = audio_read(&cap, in, AUDIO_PERIOD);
+        if (n <= 0) break;
+        double t0 = delay_cpu_now();
+        delay_process(d, in, out, n);
+        double dt = delay_cpu_now() - t0;
+        d->cpu_sec += dt;
+        if (dt > d->cpu_max) d->cpu_max = dt;
+        d->processed += n;
+        if (audio_write(&play, out, n) < 0) break;
+
+        if (time(NULL) - last >= 10) {
+            last = time(NULL);
+            delay_report(d, stderr);
+        }
+    }
+
+    d->stop = 1;
+    pthread_join(ctl, NULL);
+    delay_report(d, stderr);
+    audio_close(&cap);
+    audio_close(&play);
+    delay_destroy(d);
+    return 0;
+}
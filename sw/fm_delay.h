@@ -0,0 +1,83 @@
+#ifndef FM_DELAY_H
+#define FM_DELAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Защитная задержка эфира: кольцо на 40 с, сброс последних секунд по команде,
+// набор задержки обратно незаметным растяжением времени (WSOLA)
+#define DELAY_MAX_SEC      40
+#define DELAY_RING_FRAMES  (1 << 21)       // 43.7 с при 48 кГц, 8 МБ; степень двойки
+#define DELAY_MIN_MS       100             // Задержка не опускается ниже: окно поиска и стык сброса
+#define DELAY_STRETCH      0.04            // Скорость набора/сброса: 4% темпа, 2.4 с задержки в минуту
+#define DELAY_HOP          768             // Шаг WSOLA, 16 мс; окно перекрытия той же длины
+#define DELAY_SEEK         480             // Поиск совмещения +-10 мс: период до 100 Гц
+#define DELAY_DECIM        4               // Грубый поиск по каждому 4-му отсчету
+#define DELAY_XFADE        480             // Переход на стыке сброса, 10 мс
+#define DELAY_CMDQ         16              // Очередь команд (степень двойки)
+#define DELAY_CTL_FIFO     "/tmp/fm_delay.ctl"
+#define DELAY_STATUS_FILE  "/tmp/fm_delay.status"
+#define DELAY_STATUS_AGE   3               // Файл старше - режим задержки не запущен
+
+typedef enum {
+    DELAY_CMD_TARGET = 0,
+    DELAY_CMD_DUMP
+} delay_cmd_type_t;
+
+typedef struct {
+    delay_cmd_type_t type;
+    double seconds;                        // Новая задержка или сколько сбросить (< 0 - все)
+} delay_cmd_t;
+
+typedef struct {
+    double delay_sec, target_sec;
+    int mode;                              // +1 набор, -1 сброс растяжением, 0 держится
+    long dumps;
+    double dumped_sec;
+    double cpu_pct;                        // Средняя загрузка ядра обработкой
+    size_t memory;                         // Байт в арене
+    int locked;                            // Арена закреплена в RAM (mlock)
+} delay_status_t;
+
+// Вся память выделяется в delay_create, delay_process не выделяет и не блокируется
+typedef struct {
+    int rate;
+    int16_t *ring;                         // Стерео S16, DELAY_RING_FRAMES кадров
+    int64_t wpos;                          // Кадров записано в кольцо
+    int64_t seg;                           // Начало текущего сегмента во входе
+    double tau;                            // Идеальное начало следующего сегмента при растяжении
+    int16_t hop[DELAY_HOP * 2];            // Готовый выход текущего шага
+    int hop_pos;
+    int64_t target, min_frames;
+    int mode;
+    int xfade_left;                        // Кадров стыка сброса осталось
+    float win[DELAY_HOP];                  // Нарастающая часть окна Ханна
+    float xfade[DELAY_XFADE];              // Равномощная кривая стыка сброса
+    float ref[DELAY_HOP];                  // Моно: продолжение без растяжения
+    float cand[DELAY_HOP + 2 * DELAY_SEEK];// Моно: область поиска
+    // Очередь команд: пишет поток управления, читает поток звука
+    delay_cmd_t cmdq[DELAY_CMDQ];
+    volatile uint32_t cmd_head, cmd_tail;
+    // Статистика (пишет поток звука)
+    volatile int64_t stat_delay;
+    volatile long dumps;
+    long stretched;
+    int64_t dumped, processed;
+    double cpu_sec, cpu_max;               // Время delay_process, CLOCK_THREAD_CPUTIME_ID
+    size_t memory;
+    int locked;
+    volatile int stop;
+} delay_t;
+
+delay_t *delay_create(int rate, double target_sec);
+void delay_destroy(delay_t *d);
+void delay_process(delay_t *d, const int16_t *in, int16_t *out, int frames);
+// "dump [SEC]", "d", "delay SEC"; поток управления, не более одного писателя
+int delay_command(delay_t *d, const char *line);
+void delay_status(delay_t *d, delay_status_t *st);
+// Команда работающему --delay из другого процесса (TUI, --serve)
+int delay_send(const char *line);
+int delay_read_status(delay_status_t *st);
+int delay_main(double target_sec, const char *capture_dev, const char *play_dev);
+
+#endif // FM_DELAY_H
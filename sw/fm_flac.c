@@ -0,0 +1,744 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "fm.h"
+#include "fm_flac.h"
+
+// Чтение битов MSB-first; кэш выровнен по старшему биту, за концом данных - нули
+typedef struct {
+    const uint8_t *p, *end;
+    uint64_t cache;
+    int bits;
+    int pad;                     // Байт, дочитанных за концом
+} flac_bits_t;
+
+static uint8_t flac_crc8_table[256];
+static uint16_t flac_crc16_table[256];
+
+static void flac_crc_init(void) {
+    for (int i = 0; i < 256; i++) {
+        uint8_t c8 = i;
+        uint16_t c16 = i << 8;
+        for (int b = 0; b < 8; b++) {
+            c8 = c8 & 0x80 ? (c8 << 1) ^ 0x07 : c8 << 1;
+            c16 = c16 & 0x8000 ? (c16 << 1) ^ 0x8005 : c16 << 1;
+        }
+        flac_crc8_table[i] = c8;
+        flac_crc16_table[i] = c16;
+    }
+}
+
+static uint8_t flac_crc8(const uint8_t *p, size_t n) {
+    uint8_t c = 0;
+    while (n--) c = flac_crc8_table[c ^ *p++];
+    return c;
+}
+
+static uint16_t flac_crc16(const uint8_t *p, size_t n) {
+    uint16_t c = 0;
+    while (n--) c = (c << 8) ^ flac_crc16_table[(c >> 8) ^ *p++];
+    return c;
+}
+
+static inline void fb_fill(flac_bits_t *b) {
+    while (b->bits <= 56) {
+        uint64_t byte = 0;
+        if (b->p < b->end) byte = *b->p++;
+        else b->pad++;
+        b->cache |= byte << (56 - b->bits);
+        b->bits += 8;
+    }
+}
+
+static inline uint32_t fb_read(flac_bits_t *b, int n) {
+    if (n == 0) return 0;
+    if (b->bits < n) fb_fill(b);
+    uint32_t v = (uint32_t)(b->cache >> (64 - n));
+    b->cache <<= n;
+    b->bits -= n;
+    return v;
+}
+
+static inline int32_t fb_sread(flac_bits_t *b, int n) {
+    if (n == 0) return 0;
+    return (int32_t)(fb_read(b, n) << (32 - n)) >> (32 - n);
+}
+
+// Нули до единицы; за концом данных - ошибка (UINT32_MAX)
+static inline uint32_t fb_unary(flac_bits_t *b) {
+    uint32_t z = 0;
+    for (;;) {
+        if (b->bits < 8) fb_fill(b);
+        if (b->cache == 0) {
+            z += b->bits;
+            b->bits = 0;
+            if (b->pad > 8) return UINT32_MAX;
+            continue;
+        }
+        int lz = __builtin_clzll(b->cache);
+        b->cache <<= lz;
+        b->cache <<= 1;
+        b->bits -= lz + 1;
+        return z + lz;
+    }
+}
+
+// Позиция в байтах от начала (после выравнивания)
+static size_t fb_tell(const flac_bits_t *b, const uint8_t *base) {
+    return (size_t)(b->p - base) + b->pad - b->bits / 8;
+}
+
+static int flac_residual(flac_bits_t *b, int32_t *x, int block, int order) {
+    int method = fb_read(b, 2);
+    if (method > 1) return -1;
+    int pbits = method ? 5 : 4, escape = method ? 31 : 15;
+    int porder = fb_read(b, 4);
+    int parts = 1 << porder, psize = block >> porder;
+    if ((psize << porder) != block || psize < order) return -1;
+
+    int i = order;
+    for (int part = 0; part < parts; part++) {
+        int n = part == 0 ? psize - order : psize;
+        int k = fb_read(b, pbits);
+        if (k == escape) {
+            int raw = fb_read(b, 5);
+            for (int j = 0; j < n; j++) x[i++] = fb_sread(b, raw);
+            continue;
+        }
+        for (int j = 0; j < n; j++) {
+            uint32_t q = fb_unary(b);
+            if (q == UINT32_MAX) return -1;
+            uint32_t u = q << k | fb_read(b, k);
+            x[i++] = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+        }
+    }
+    return b->pad > 8 ? -1 : 0;
+}
+
+static void flac_fixed(int32_t *x, int block, int order) {
+    switch (order) {
+    case 1:
+        for (int i = 1; i < block; i++) x[i] += x[i - 1];
+        break;
+    case 2:
+        for (int i = 2; i < block; i++) x[i] += 2 * x[i - 1] - x[i - 2];
+        break;
+    case 3:
+        for (int i = 3; i < block; i++) x[i] += 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3];
+        break;
+    case 4:
+        for (int i = 4; i < block; i++) x[i] += 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4];
+        break;
+    }
+}
+
+// Предсказание LPC: 32-битная сумма, если она заведомо не переполняется
+static void flac_lpc(int32_t *x, int block, const int32_t *c, int order, int shift, int wide) {
+    if (!wide) {
+        for (int i = order; i < block; i++) {
+            int32_t sum = 0;
+            for (int j = 0; j < order; j++) sum += c[j] * x[i - 1 - j];
+            x[i] += sum >> shift;
+        }
+        return;
+    }
+    for (int i = order; i < block; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++) sum += (int64_t)c[j] * x[i - 1 - j];
+        x[i] += (int32_t)(sum >> shift);
+    }
+}
+
+static int flac_subframe(flac_bits_t *b, int32_t *x, int block, int bps) {
+    if (fb_read(b, 1) != 0) return -1;
+    int type = fb_read(b, 6);
+    int wasted = 0;
+    if (fb_read(b, 1)) {
+        uint32_t w = fb_unary(b);
+        if (w == UINT32_MAX || (int)w + 1 >= bps) return -1;
+        wasted = w + 1;
+        bps -= wasted;
+    }
+
+    if (type == 0) {
+        int32_t v = fb_sread(b, bps);
+        for (int i = 0; i < block; i++) x[i] = v;
+    } else if (type == 1) {
+        for (int i = 0; i < block; i++) x[i] = fb_sread(b, bps);
+    } else if (type >= 8 && type <= 12) {
+        int order = type - 8;
+        if (order > block) return -1;
+        for (int i = 0; i < order; i++) x[i] = fb_sread(b, bps);
+        if (flac_residual(b, x, block, order) != 0) return -1;
+        flac_fixed(x, block, order);
+    } else if (type >= 32) {
+        int order = (type & 31) + 1;
+        int32_t c[FLAC_MAX_ORDER];
+        if (order > block) return -1;
+        for (int i = 0; i < order; i++) x[i] = fb_sread(b, bps);
+        int prec = fb_read(b, 4) + 1;
+        int shift = fb_sread(b, 5);
+        if (prec == 16 || shift < 0) return -1;
+        for (int i = 0; i < order; i++) c[i] = fb_sread(b, prec);
+        if (flac_residual(b, x, block, order) != 0) return -1;
+        int log2 = 0;
+        while ((1 << log2) < order) log2++;
+        flac_lpc(x, block, c, order, shift, bps + prec + log2 > 32);
+    } else {
+        return -1;
+    }
+    if (wasted) {
+        for (int i = 0; i < block; i++) x[i] = (int32_t)((uint32_t)x[i] << wasted);
+    }
+    return 0;
+}
+
+static const int flac_rates[12] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+static const int flac_sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 32 };
+
+// Один кадр с начала start; > 0 - отсчетов в кадре, < 0 - не кадр или поврежден
+static int flac_frame(flac_dec_t *f, size_t start) {
+    const uint8_t *h = f->data + start;
+    size_t left = f->size - start;
+    if (left < 6 || h[0] != 0xFF || (h[1] & 0xFE) != 0xF8) return -1;
+
+    int bs_code = h[2] >> 4, rate_code = h[2] & 15;
+    int ch_code = h[3] >> 4, size_code = (h[3] >> 1) & 7;
+    if (rate_code == 15 || ch_code > 10 || size_code == 3 || (h[3] & 1)) return -1;
+
+    // Номер кадра/отсчета в UTF-8 подобной записи
+    size_t i = 4;
+    int extra = 0;
+    uint64_t num = h[i];
+    if (num >= 0x80) {
+        if ((num & 0xE0) == 0xC0) { extra = 1; num &= 0x1F; }
+        else if ((num & 0xF0) == 0xE0) { extra = 2; num &= 0x0F; }
+        else if ((num & 0xF8) == 0xF0) { extra = 3; num &= 0x07; }
+        else if ((num & 0xFC) == 0xF8) { extra = 4; num &= 0x03; }
+        else if ((num & 0xFE) == 0xFC) { extra = 5; num &= 0x01; }
+        else if (num == 0xFE) { extra = 6; num = 0; }
+        else return -1;
+    }
+    i++;
+    for (int k = 0; k < extra; k++, i++) {
+        if (i >= left || (h[i] & 0xC0) != 0x80) return -1;
+        num = num << 6 | (h[i] & 0x3F);
+    }
+
+    int block;
+    if (bs_code == 0) return -1;
+    else if (bs_code == 1) block = 192;
+    else if (bs_code <= 5) block = 576 << (bs_code - 2);
+    else if (bs_code == 6) { if (i + 1 > left) return -1; block = h[i] + 1; i += 1; }
+    else if (bs_code == 7) { if (i + 2 > left) return -1; block = (h[i] << 8 | h[i + 1]) + 1; i += 2; }
+    else block = 256 << (bs_code - 8);
+
+    int rate = rate_code < 12 ? flac_rates[rate_code] : 0;
+    if (rate_code == 12) { if (i + 1 > left) return -1; rate = h[i] * 1000; i += 1; }
+    else if (rate_code >= 13) { if (i + 2 > left) return -1; rate = (h[i] << 8 | h[i + 1]) * (rate_code == 14 ? 10 : 1); i += 2; }
+    if (i + 1 > left || flac_crc8(h, i) != h[i]) return -1;
+    i++;
+
+    int channels = ch_code < 8 ? ch_code + 1 : 2;
+    int bps = size_code ? flac_sizes[size_code] : f->bps;
+    // Другие параметры, чем в STREAMINFO, - ложная синхронизация
+    if (channels != f->channels || bps != f->bps || block > f->max_block || (rate && rate != f->rate)) return -1;
+    f->sample = (h[1] & 1) ? num : num * (uint64_t)f->max_block;
+
+    flac_bits_t b = { h + i, f->data + f->size, 0, 0, 0 };
+    for (int c = 0; c < channels; c++) {
+        // Канал разности на бит шире
+        int side = (ch_code == 8 && c == 1) || (ch_code == 9 && c == 0) || (ch_code == 10 && c == 1);
+        if (flac_subframe(&b, f->out[c], block, bps + side) != 0) return -1;
+    }
+
+    int32_t *l = f->out[0], *r = f->out[1];
+    if (ch_code == 8) {
+        for (int k = 0; k < block; k++) r[k] = l[k] - r[k];
+    } else if (ch_code == 9) {
+        for (int k = 0; k < block; k++) l[k] += r[k];
+    } else if (ch_code == 10) {
+        for (int k = 0; k < block; k++) {
+            int32_t mid = (int32_t)((uint32_t)l[k] << 1) | (r[k] & 1), s = r[k];
+            l[k] = (mid + s) >> 1;
+            r[k] = (mid - s) >> 1;
+        }
+    }
+
+    // Выравнивание на байт и CRC-16 всего кадра
+    fb_read(&b, b.bits & 7);
+    size_t end = start + i + fb_tell(&b, h + i);
+    if (b.pad * 8 > b.bits || end + 2 > f->size) return -1;
+    if (flac_crc16(h, end - start) != (f->data[end] << 8 | f->data[end + 1])) {
+        // Щелчок от испорченных данных хуже короткой тишины
+        f->crc_errors++;
+        for (int c = 0; c < channels; c++) memset(f->out[c], 0, block * sizeof(int32_t));
+    }
+    f->pos = end + 2;
+    f->block = block;
+    f->frames++;
+    return block;
+}
+
+int flac_open(flac_dec_t *f, const uint8_t *data, size_t size) {
+    static int crc_ready;
+    size_t p = 0;
+
+    if (!crc_ready) {
+        flac_crc_init();
+        crc_ready = 1;
+    }
+    memset(f, 0, sizeof(*f));
+    f->data = data;
+    f->size = size;
+
+    // Тег ID3v2 перед потоком
+    if (size >= 10 && memcmp(data, "ID3", 3) == 0) {
+        p = 10 + ((data[6] & 0x7F) << 21 | (data[7] & 0x7F) << 14 | (data[8] & 0x7F) << 7 | (data[9] & 0x7F));
+    }
+    if (p + 4 > size || memcmp(data + p, "fLaC", 4) != 0) return -1;
+    p += 4;
+
+    int last = 0, have_info = 0;
+    while (!last && p + 4 <= size) {
+        last = data[p] >> 7;
+        int type = data[p] & 0x7F;
+        size_t len = data[p + 1] << 16 | data[p + 2] << 8 | data[p + 3];
+        p += 4;
+        if (p + len > size) return -1;
+        if (type == 0 && len >= 34) {
+            const uint8_t *s = data + p;
+            f->min_block = s[0] << 8 | s[1];
+            f->max_block = s[2] << 8 | s[3];
+            f->rate = s[10] << 12 | s[11] << 4 | s[12] >> 4;
+            f->channels = ((s[12] >> 1) & 7) + 1;
+            f->bps = ((s[12] & 1) << 4 | s[13] >> 4) + 1;
+            f->total = (uint64_t)(s[13] & 15) << 32 | (uint32_t)(s[14] << 24 | s[15] << 16 | s[16] << 8 | s[17]);
+            have_info = 1;
+        }
+        p += len;
+    }
+    if (!have_info || f->rate == 0 || f->bps < 4 || f->bps > 24 || f->max_block < 16) {
+        printf("%sОшибка: FLAC: нет STREAMINFO или больше 24 бит%s\n", COLOR_RED, COLOR_RESET);
+        return -1;
+    }
+    for (int c = 0; c < f->channels; c++) {
+        f->out[c] = malloc(f->max_block * sizeof(int32_t));
+        if (!f->out[c]) {
+            flac_close(f);
+            return -1;
+        }
+    }
+    f->first_frame = f->pos = p;
+    return 0;
+}
+
+int flac_next_frame(flac_dec_t *f) {
+    int lost = 0;
+    while (f->pos + 2 <= f->size) {
+        int n = flac_frame(f, f->pos);
+        if (n > 0) {
+            f->lost_sync += lost;
+            return n;
+        }
+        // Потеря синхронизации: следующий заголовок с верным CRC-8
+        lost = 1;
+        size_t p = f->pos + 1;
+        while (p + 1 < f->size && !(f->data[p] == 0xFF && (f->data[p + 1] & 0xFE) == 0xF8)) p++;
+        f->pos = p;
+    }
+    f->pos = f->size;
+    return 0;
+}
+
+void flac_close(flac_dec_t *f) {
+    for (int c = 0; c < FLAC_MAX_CHANNELS; c++) {
+        free(f->out[c]);
+        f->out[c] = NULL;
+    }
+}
+
+// ---- Кодер ----
+
+// Запись битов MSB-first; в acc не больше 7 недописанных битов
+typedef struct {
+    uint8_t *p;
+    uint64_t acc;
+    int n;
+} flac_bw_t;
+
+static inline void bw_put(flac_bw_t *w, uint32_t v, int bits) {
+    if (bits == 0) return;
+    w->acc = w->acc << bits | (v & (uint32_t)((1ULL << bits) - 1));
+    w->n += bits;
+    while (w->n >= 8) {
+        w->n -= 8;
+        *w->p++ = (uint8_t)(w->acc >> w->n);
+    }
+}
+
+static inline void bw_align(flac_bw_t *w) {
+    if (w->n) bw_put(w, 0, 8 - w->n);
+}
+
+static int flac_crc_ready;
+
+int flac_enc_init(flac_enc_t *e, int rate, int channels, int block, int lpc_order) {
+    memset(e, 0, sizeof(*e));
+    if (channels < 1 || channels > 2 || block < 16 || block > FLAC_MAX_BLOCK || lpc_order > FLAC_ENC_MAX_ORDER) return -1;
+    if (!flac_crc_ready) {
+        flac_crc_init();
+        flac_crc_ready = 1;
+    }
+    e->rate = rate;
+    e->channels = channels;
+    e->block = block;
+    e->lpc_order = lpc_order;
+    e->min_frame = UINT32_MAX;
+    for (int i = 0; i < 4; i++) e->x[i] = malloc(block * sizeof(int32_t));
+    for (int i = 0; i < 2; i++) e->res[i] = malloc(block * sizeof(int32_t));
+    e->win = malloc(block * sizeof(double));
+    if (!e->x[0] || !e->x[1] || !e->x[2] || !e->x[3] || !e->res[0] || !e->res[1] || !e->win) {
+        flac_enc_free(e);
+        return -1;
+    }
+    return 0;
+}
+
+void flac_enc_free(flac_enc_t *e) {
+    for (int i = 0; i < 4; i++) free(e->x[i]);
+    for (int i = 0; i < 2; i++) free(e->res[i]);
+    free(e->win);
+    memset(e, 0, sizeof(*e));
+}
+
+size_t flac_enc_header(const flac_enc_t *e, uint8_t *out, const flac_seekpoint_t *seek, int nseek, int slots) {
+    uint8_t *p = out;
+    memcpy(p, "fLaC", 4);
+    p += 4;
+
+    *p++ = slots ? 0x00 : 0x80;
+    *p++ = 0; *p++ = 0; *p++ = 34;
+    flac_bw_t w = { p, 0, 0 };
+    bw_put(&w, e->block, 16);
+    bw_put(&w, e->block, 16);
+    bw_put(&w, e->min_frame == UINT32_MAX ? 0 : e->min_frame, 24);
+    bw_put(&w, e->max_frame, 24);
+    bw_put(&w, e->rate, 20);
+    bw_put(&w, e->channels - 1, 3);
+    bw_put(&w, 16 - 1, 5);
+    bw_put(&w, (uint32_t)(e->total >> 32) & 15, 4);
+    bw_put(&w, (uint32_t)e->total, 32);
+    memset(w.p, 0, 16);              // MD5 не считается: допустимо по формату
+    p = w.p + 16;
+
+    if (slots) {
+        size_t len = (size_t)slots * FLAC_SEEKPOINT_SIZE;
+        *p++ = 0x80 | 3;
+        *p++ = len >> 16; *p++ = len >> 8; *p++ = len;
+        for (int i = 0; i < slots; i++) {
+            uint64_t sample = i < nseek ? seek[i].sample : UINT64_MAX;
+            uint64_t off = i < nseek ? seek[i].offset : 0;
+            int frames = i < nseek ? seek[i].frames : 0;
+            for (int k = 7; k >= 0; k--) *p++ = sample >> (k * 8);
+            for (int k = 7; k >= 0; k--) *p++ = off >> (k * 8);
+            *p++ = frames >> 8;
+            *p++ = frames;
+        }
+    }
+    return p - out;
+}
+
+// Биты на остаток при параметре Райса k: n * (k + 1) + сумма частных (оценка по сумме)
+static inline uint64_t rice_bits(uint64_t sum, int n, int k) {
+    return (uint64_t)n * (k + 1) + (sum >> k);
+}
+
+static inline int rice_param(uint64_t sum, int n) {
+    int k = 0;
+    while (k < 30 && ((uint64_t)n << (k + 1)) < sum) k++;
+    return k;
+}
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+// Лучший порядок разбиения для остатка res[order..n); возвращает биты, пишет порядок
+static uint64_t rice_partition(const int32_t *res, int n, int order, int *porder_out) {
+    uint64_t sums[1 << FLAC_ENC_MAX_PORDER];
+    int pmax = 0;
+    while (pmax < FLAC_ENC_MAX_PORDER && !(n & (1 << pmax)) && (n >> (pmax + 1)) > order) pmax++;
+
+    int parts = 1 << pmax, psize = n >> pmax;
+    for (int p = 0, i = order; p < parts; p++) {
+        uint64_t sum = 0;
+        for (int end = (p + 1) * psize; i < end; i++) sum += zigzag(res[i]);
+        sums[p] = sum;
+    }
+
+    uint64_t best = UINT64_MAX;
+    for (int po = pmax; po >= 0; po--) {
+        parts = 1 << po;
+        psize = n >> po;
+        uint64_t bits = 0;
+        for (int p = 0; p < parts; p++) {
+            int cnt = p == 0 ? psize - order : psize;
+            int k = rice_param(sums[p], cnt);
+            bits += 5 + rice_bits(sums[p], cnt, k);
+        }
+        if (bits < best) {
+            best = bits;
+            *porder_out = po;
+        }
+        // Слияние соседних разбиений для следующего, более грубого порядка
+        for (int p = 0; p < parts / 2; p++) sums[p] = sums[2 * p] + sums[2 * p + 1];
+    }
+    return best + 6;
+}
+
+static void rice_write(flac_bw_t *w, const int32_t *res, int n, int order, int porder) {
+    int parts = 1 << porder, psize = n >> porder;
+    int kk[1 << FLAC_ENC_MAX_PORDER], method = 0;
+
+    for (int p = 0, i = order; p < parts; p++) {
+        uint64_t sum = 0;
+        int end = (p + 1) * psize, cnt = end - i;
+        for (int j = i; j < end; j++) sum += zigzag(res[j]);
+        kk[p] = rice_param(sum, cnt);
+        if (kk[p] > 14) method = 1;
+        i = end;
+    }
+    bw_put(w, method, 2);
+    bw_put(w, porder, 4);
+    for (int p = 0, i = order; p < parts; p++) {
+        int k = kk[p], end = (p + 1) * psize;
+        bw_put(w, k, method ? 5 : 4);
+        for (; i < end; i++) {
+            uint32_t u = zigzag(res[i]);
+            uint32_t q = u >> k;
+            if (q + 1 + k <= 32) {
+                bw_put(w, (1u << k) | (u & ((1u << k) - 1)), q + 1 + k);
+            } else {
+                while (q >= 32) {
+                    bw_put(w, 0, 32);
+                    q -= 32;
+                }
+                bw_put(w, 1, q + 1);
+                bw_put(w, u, k);
+            }
+        }
+    }
+}
+
+static void fixed_residual(const int32_t *x, int n, int order, int32_t *res) {
+    switch (order) {
+    case 0:
+        for (int i = 0; i < n; i++) res[i] = x[i];
+        break;
+    case 1:
+        for (int i = 1; i < n; i++) res[i] = x[i] - x[i - 1];
+        break;
+    case 2:
+        for (int i = 2; i < n; i++) res[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+    case 3:
+        for (int i = 3; i < n; i++) res[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+    case 4:
+        for (int i = 4; i < n; i++) res[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        break;
+    }
+}
+
+// Коэффициенты LPC: окно Велча, автокорреляция, Левинсон-Дурбин, квантование
+// с переносом ошибки округления. 0 - предсказатель не нужен или не получился
+static int lpc_coeffs(flac_enc_t *e, const int32_t *x, int n, int order, int32_t *q, int *shift) {
+    double r[FLAC_ENC_MAX_ORDER + 1] = { 0 }, a[FLAC_ENC_MAX_ORDER] = { 0 }, t[FLAC_ENC_MAX_ORDER];
+    double *y = e->win;
+
+    double half = (n - 1) / 2.0, norm = (n + 1) / 2.0;
+    for (int i = 0; i < n; i++) {
+        double d = (i - half) / norm;
+        y[i] = x[i] * (1.0 - d * d);
+    }
+    for (int lag = 0; lag <= order; lag++) {
+        double sum = 0.0;
+        for (int i = lag; i < n; i++) sum += y[i] * y[i - lag];
+        r[lag] = sum;
+    }
+    if (r[0] <= 0.0) return 0;
+    r[0] *= 1.0 + 1e-9;
+
+    double err = r[0];
+    for (int i = 0; i < order; i++) {
+        double acc = r[i + 1];
+        for (int j = 0; j < i; j++) acc -= a[j] * r[i - j];
+        double k = acc / err;
+        for (int j = 0; j < i; j++) t[j] = a[j] - k * a[i - 1 - j];
+        for (int j = 0; j < i; j++) a[j] = t[j];
+        a[i] = k;
+        err *= 1.0 - k * k;
+        if (err <= 0.0) return 0;
+    }
+
+    double cmax = 0.0;
+    for (int i = 0; i < order; i++) if (fabs(a[i]) > cmax) cmax = fabs(a[i]);
+    if (cmax <= 0.0) return 0;
+    int log2cmax;
+    frexp(cmax, &log2cmax);
+    int s = FLAC_ENC_PRECISION - 1 - log2cmax;
+    if (s > 15) s = 15;
+    if (s < 0) return 0;
+
+    int qmax = (1 << (FLAC_ENC_PRECISION - 1)) - 1;
+    double carry = 0.0;
+    for (int i = 0; i < order; i++) {
+        double v = a[i] * (1 << s) + carry;
+        long qi = lround(v);
+        if (qi > qmax) qi = qmax;
+        if (qi < -qmax - 1) qi = -qmax - 1;
+        carry = v - qi;
+        q[i] = (int32_t)qi;
+    }
+    *shift = s;
+    return order;
+}
+
+static void lpc_residual(const int32_t *x, int n, const int32_t *q, int order, int shift, int32_t *res) {
+    for (int i = order; i < n; i++) {
+        int64_t sum = 0;
+        for (int j = 0; j < order; j++) sum += (int64_t)q[j] * x[i - 1 - j];
+        res[i] = x[i] - (int32_t)(sum >> shift);
+    }
+}
+
+// Подкадр: постоянный, фиксированный 0-4, LPC или дословный - что короче по оценке
+static void flac_enc_subframe(flac_enc_t *e, flac_bw_t *w, const int32_t *x, int n, int bps) {
+    int constant = 1;
+    for (int i = 1; i < n && constant; i++) constant = x[i] == x[0];
+    if (constant) {
+        bw_put(w, 0, 8);
+        bw_put(w, (uint32_t)x[0], bps);
+        return;
+    }
+
+    int32_t *try = e->res[0], *best = e->res[1];
+    uint64_t best_bits = (uint64_t)n * bps;
+    int best_type = 1, best_order = 0, best_porder = 0, porder;
+    for (int order = 0; order <= 4 && order < n; order++) {
+        fixed_residual(x, n, order, try);
+        uint64_t bits = (uint64_t)order * bps + rice_partition(try, n, order, &porder);
+        if (bits < best_bits) {
+            best_bits = bits;
+            best_type = 8 + order;
+            best_order = order;
+            best_porder = porder;
+            int32_t *t = try; try = best; best = t;
+        }
+    }
+
+    int32_t q[FLAC_ENC_MAX_ORDER];
+    int shift = 0, order = e->lpc_order < n ? e->lpc_order : 0;
+    if (order > 0 && lpc_coeffs(e, x, n, order, q, &shift)) {
+        lpc_residual(x, n, q, order, shift, try);
+        uint64_t bits = (uint64_t)order * (bps + FLAC_ENC_PRECISION) + 9 + rice_partition(try, n, order, &porder);
+        if (bits < best_bits) {
+            best_type = 32 + order - 1;
+            best_order = order;
+            best_porder = porder;
+            best = try;
+        }
+    }
+
+    bw_put(w, best_type << 1, 8);
+    if (best_type == 1) {
+        for (int i = 0; i < n; i++) bw_put(w, (uint32_t)x[i], bps);
+        return;
+    }
+    for (int i = 0; i < best_order; i++) bw_put(w, (uint32_t)x[i], bps);
+    if (best_type >= 32) {
+        bw_put(w, FLAC_ENC_PRECISION - 1, 4);
+        bw_put(w, shift, 5);
+        for (int i = 0; i < best_order; i++) bw_put(w, (uint32_t)q[i], FLAC_ENC_PRECISION);
+    }
+    rice_write(w, best, n, best_order, best_porder);
+}
+
+// Грубая оценка канала для выбора стерео режима: сумма |остатка| фиксированного порядка 2
+static uint64_t flac_enc_cost(const int32_t *x, int n) {
+    uint64_t sum = 0;
+    for (int i = 2; i < n; i++) sum += zigzag(x[i] - 2 * x[i - 1] + x[i - 2]);
+    return sum;
+}
+
+size_t flac_enc_frame(flac_enc_t *e, const int16_t *pcm, int frames, uint8_t *out) {
+    int n = frames, chs = e->channels;
+    int32_t *l = e->x[0], *r = e->x[1], *m = e->x[2], *s = e->x[3];
+
+    for (int i = 0; i < n; i++) {
+        l[i] = pcm[i * chs];
+        if (chs == 2) {
+            r[i] = pcm[i * 2 + 1];
+            m[i] = (l[i] + r[i]) >> 1;
+            s[i] = l[i] - r[i];
+        }
+    }
+
+    // Стерео: независимые, L/S, S/R или M/S - по наименьшей оценке
+    int ch_code = chs - 1;
+    const int32_t *sub[2] = { l, r };
+    int side = -1;
+    if (chs == 2) {
+        uint64_t cl = flac_enc_cost(l, n), cr = flac_enc_cost(r, n);
+        uint64_t cm = flac_enc_cost(m, n), cs = flac_enc_cost(s, n);
+        uint64_t best = cl + cr;
+        if (cl + cs < best) { best = cl + cs; ch_code = 8; sub[1] = s; side = 1; }
+        if (cs + cr < best) { best = cs + cr; ch_code = 9; sub[0] = s; sub[1] = r; side = 0; }
+        if (cm + cs < best) { ch_code = 10; sub[0] = m; sub[1] = s; side = 1; }
+    }
+
+    // Заголовок кадра
+    uint8_t *h = out;
+    int bs_code = n == 4096 ? 12 : n == 4608 ? 5 : 7;
+    int rate_code = 0;
+    for (int i = 1; i < 12; i++) if (flac_rates[i] == e->rate) rate_code = i;
+    h[0] = 0xFF;
+    h[1] = 0xF8;
+    h[2] = bs_code << 4 | rate_code;
+    h[3] = ch_code << 4 | 4 << 1;
+    size_t i = 4;
+    uint32_t num = e->frame;
+    if (num < 0x80) {
+        h[i++] = num;
+    } else {
+        int extra = num < 0x800 ? 1 : num < 0x10000 ? 2 : num < 0x200000 ? 3 : num < 0x4000000 ? 4 : 5;
+        h[i++] = (uint8_t)((0xFF << (7 - extra)) | (num >> (6 * extra)));
+        for (int k = extra - 1; k >= 0; k--) h[i++] = 0x80 | ((num >> (6 * k)) & 0x3F);
+    }
+    if (bs_code == 7) {
+        h[i++] = (n - 1) >> 8;
+        h[i++] = n - 1;
+    }
+    h[i] = flac_crc8(h, i);
+    i++;
+
+    flac_bw_t w = { h + i, 0, 0 };
+    for (int c = 0; c < chs; c++) flac_enc_subframe(e, &w, sub[c], n, 16 + (c == side));
+    bw_align(&w);
+    size_t len = w.p - out;
+    uint16_t crc = flac_crc16(out, len);
+    out[len++] = crc >> 8;
+    out[len++] = crc;
+
+    e->frame++;
+    e->total += n;
+    if (n == e->block) {
+        if (len < e->min_frame) e->min_frame = len;
+    }
+    if (len > e->max_frame) e->max_frame = len;
+    return len;
+}
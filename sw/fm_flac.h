@@ -0,0 +1,65 @@
+#ifndef FM_FLAC_H
+#define FM_FLAC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Декодер FLAC из памяти (mmap файла) и кодер 16-битного PCM, без внешних библиотек
+#define FLAC_MAX_CHANNELS  8
+#define FLAC_MAX_BLOCK     65535
+#define FLAC_MAX_ORDER     32
+#define FLAC_ENC_MAX_ORDER 12        // Порядок LPC в пределах подмножества (subset) FLAC
+#define FLAC_ENC_PRECISION 12        // Бит на коэффициент LPC
+#define FLAC_ENC_MAX_PORDER 8        // Разбиений остатка для Rice не больше 2^8
+#define FLAC_SEEKPOINT_SIZE 18
+#define FLAC_ENC_HEADER_SIZE(slots) (4 + 4 + 34 + ((slots) ? 4 + (slots) * FLAC_SEEKPOINT_SIZE : 0))
+// Худший случай кадра: дословные отсчеты (канал разности 17 бит) и заголовки
+#define FLAC_ENC_MAX_FRAME(block, channels) ((size_t)(block) * (channels) * 17 / 8 + 64)
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    size_t pos;                  // Начало следующего кадра
+    size_t first_frame;
+    // STREAMINFO
+    int rate, channels, bps;
+    int min_block, max_block;
+    uint64_t total;              // Отсчетов на канал, 0 - неизвестно
+    // Текущий кадр
+    int32_t *out[FLAC_MAX_CHANNELS];
+    int block;
+    int frame_bps;
+    uint64_t sample;             // Номер первого отсчета кадра
+    long frames, crc_errors, lost_sync;
+} flac_dec_t;
+
+typedef struct {
+    int rate, channels, block;
+    int lpc_order;                   // 0 - только фиксированные предсказатели
+    uint32_t frame;                  // Номер следующего кадра
+    uint64_t total;                  // Закодировано отсчетов на канал
+    uint32_t min_frame, max_frame;   // Байт, для STREAMINFO
+    int32_t *x[4];                   // L, R, M, S текущего блока
+    int32_t *res[2];                 // Остаток: пробный и лучший
+    double *win;                     // Окно Велча для автокорреляции
+} flac_enc_t;
+
+typedef struct {
+    uint64_t sample;                 // Первый отсчет кадра
+    uint64_t offset;                 // Байт от первого кадра
+    uint16_t frames;                 // Отсчетов в кадре
+} flac_seekpoint_t;
+
+int flac_open(flac_dec_t *f, const uint8_t *data, size_t size);
+int flac_next_frame(flac_dec_t *f);      // Отсчетов в кадре, 0 - конец, < 0 - ошибка
+void flac_close(flac_dec_t *f);
+
+int flac_enc_init(flac_enc_t *e, int rate, int channels, int block, int lpc_order);
+// Заголовок: "fLaC", STREAMINFO по текущим итогам и SEEKTABLE на slots точек
+// (недостающие - заполнители), чтобы потом перезаписать его на месте
+size_t flac_enc_header(const flac_enc_t *e, uint8_t *out, const flac_seekpoint_t *seek, int nseek, int slots);
+// Один кадр из frames <= block кадров S16; короче block может быть только последний
+size_t flac_enc_frame(flac_enc_t *e, const int16_t *pcm, int frames, uint8_t *out);
+void flac_enc_free(flac_enc_t *e);
+
+#endif // FM_FLAC_H
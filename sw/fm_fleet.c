@@ -0,0 +1,754 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+
+#include "fm.h"
+#include "fm_fleet.h"
+#include "fm_phase.h"
+#include "fm_loudness.h"
+#include "fm_delay.h"
+#include "fm_ptp.h"
+#include "fm_xadc.h"
+
+enum { FLEET_DOWN = 0, FLEET_CONNECTING, FLEET_IDLE, FLEET_WAIT };
+enum { FLEET_R_NONE = 0, FLEET_R_OK, FLEET_R_FAILED, FLEET_R_ROLLED_BACK, FLEET_R_ROLLBACK_FAILED };
+
+static double fleet_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// ---------- Сторона передатчика ----------
+
+typedef struct {
+    int fd;
+    char buf[FLEET_LINE];
+    int len;
+} fleet_client_t;
+
+static void fleet_reply(int fd, const char *fmt, ...) {
+    char buf[FLEET_LINE];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+    va_end(ap);
+    if (n > (int)sizeof(buf) - 2) n = sizeof(buf) - 2;
+    buf[n++] = '\n';
+    // Ответы короткие и помещаются в буфер сокета
+    send(fd, buf, n, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static void fleet_state_str(const fm_transmitter_t *tx, char *out, size_t size) {
+    snprintf(out, size, "TX=%d STEREO=%d RDS=%d MUTE=%d PREEMPHASIS=%d FREQUENCY=%.6f BALANCE=0x%08X",
+             tx->tx_en, tx->stereo_en, tx->rds_en, tx->mute_en, tx->preemphasis_mode, tx->freq_mhz,
+             tx->balance);
+}
+
+// Значение ключа SET: apply_setting молча приводит мусор к 0, а MUTE=yes снял бы mute у всей группы
+static int fleet_value_ok(const char *key, const char *value) {
+    char num[64], *end;
+
+    if (!value[0] || strlen(value) >= sizeof(num)) return 0;
+    if (strcmp(key, "TX") == 0 || strcmp(key, "STEREO") == 0 || strcmp(key, "RDS") == 0 ||
+        strcmp(key, "MUTE") == 0) {
+        return strcmp(value, "0") == 0 || strcmp(value, "1") == 0;
+    }
+    if (strcmp(key, "PREEMPHASIS") == 0) return value[1] == 0 && value[0] >= '0' && value[0] <= '2';
+    if (strcmp(key, "FREQUENCY") == 0) {
+        // Запятая допускается, как в str_to_double
+        snprintf(num, sizeof(num), "%s", value);
+        for (char *c = num; *c; c++) if (*c == ',') *c = '.';
+        double f = strtod(num, &end);
+        return *end == 0 && f > 0 && f < 200;
+    }
+    if (strcmp(key, "BALANCE") == 0) {
+        errno = 0;
+        unsigned long v = strtoul(value, &end, 0);
+        return *end == 0 && errno == 0 && value[0] != '-' && v <= 0xFFFFFFFFUL;
+    }
+    return 1;
+}
+
+// SET применяется целиком или не применяется: все ключи и значения проверяются до записи
+static void fleet_handle(fm_transmitter_t *tx, int fd, char *line) {
+    char state[FLEET_LINE];
+
+    if (strcmp(line, "PING") == 0) {
+        fleet_reply(fd, "OK");
+    } else if (strcmp(line, "GET") == 0) {
+        fm_update_state(tx);
+        fleet_state_str(tx, state, sizeof(state));
+        fleet_reply(fd, "OK %s", state);
+    } else if (strcmp(line, "PHASE") == 0) {
+        // Корреляция по PCM тракта, если передатчик запущен с --meter
+        phase_snapshot_t ph;
+        if (!phase_meter) {
+            fleet_reply(fd, "ERR no meter, start with --meter DEV");
+            return;
+        }
+        phase_get(phase_meter, &ph);
+        fleet_reply(fd, "OK CORR=%+.3f CORR_MIN=%+.3f NEG=%.1f BALANCE=%+.2f SIDE=%+.1f LEVEL=%.1f SILENT=%d",
+                    ph.corr, ph.corr_min, ph.neg_pct, ph.balance_db, ph.side_db, ph.level_db, ph.silent);
+    } else if (strcmp(line, "LOUD") == 0) {
+        // Громкость BS.1770 и истинный пик по PCM тракта, если запущен с --meter
+        loudness_snapshot_t loud;
+        if (!tui_loudness) {
+            fleet_reply(fd, "ERR no meter, start with --meter DEV");
+            return;
+        }
+        loudness_get(tui_loudness, &loud);
+        fleet_reply(fd, "OK M=%.1f S=%.1f I=%.1f TP=%.1f TP_MAX=%.1f",
+                    loud.momentary, loud.shortterm, loud.integrated, loud.true_peak, loud.true_peak_max);
+    } else if (strcmp(line, "PTP") == 0) {
+        // Медиачасы, если передатчик запущен с --ptp
+        if (!ptp_clock) {
+            fleet_reply(fd, "ERR no PTP, start with --ptp IFACE");
+            return;
+        }
+        ptp_format(ptp_clock, state, sizeof(state));
+        fleet_reply(fd, "OK %s", state);
+    } else if (strcmp(line, "TELEM") == 0) {
+        // Окна XADC, если передатчик запущен с --xadc
+        if (!xadc_active) {
+            fleet_reply(fd, "ERR no telemetry, start with --xadc");
+            return;
+        }
+        if (xadc_format(xadc_active, state, sizeof(state)) != 0) {
+            fleet_reply(fd, "ERR no fresh XADC windows");
+            return;
+        }
+        fleet_reply(fd, "OK %s", state);
+    } else if (strcmp(line, "DUMP") == 0 || strncmp(line, "DUMP ", 5) == 0 ||
+               strcmp(line, "DELAY") == 0 || strncmp(line, "DELAY ", 6) == 0) {
+        // Защитная задержка - отдельный процесс --delay; команда уходит в его FIFO,
+        // поэтому значения проверяются здесь: отказ процесса задержки виден только на его терминале
+        char cmd[64], *end;
+        int dump = line[1] == 'U';
+        const char *arg = line + (dump ? 4 : 5);
+        while (*arg == ' ' || *arg == '\t') arg++;
+        delay_status_t st;
+        if (*arg || dump) {
+            double sec = 0;
+            if (*arg) {
+                sec = strtod(arg, &end);
+                while (*end == ' ' || *end == '\t') end++;
+                if (end == arg || *end) {
+                    fleet_reply(fd, "ERR bad seconds %s", arg);
+                    return;
+                }
+            }
+            if (dump && *arg && !(sec > 0 && sec <= DELAY_MAX_SEC)) {
+                fleet_reply(fd, "ERR dump 0..%d s, above 0", DELAY_MAX_SEC);
+                return;
+            }
+            if (!dump && !(sec >= 0 && sec <= DELAY_MAX_SEC)) {
+                fleet_reply(fd, "ERR delay 0..%d s", DELAY_MAX_SEC);
+                return;
+            }
+            if (dump) snprintf(cmd, sizeof(cmd), *arg ? "dump %.3f" : "dump", sec);
+            else snprintf(cmd, sizeof(cmd), "delay %.3f", sec);
+            if (delay_send(cmd) != 0) {
+                fleet_reply(fd, "ERR no delay, start with --delay SEC");
+                return;
+            }
+            fleet_reply(fd, "OK");
+            return;
+        }
+        if (delay_read_status(&st) != 0) {
+            fleet_reply(fd, "ERR no delay, start with --delay SEC");
+            return;
+        }
+        fleet_reply(fd, "OK DELAY=%.3f TARGET=%.3f MODE=%d DUMPS=%ld DUMPED=%.3f CPU=%.3f",
+                    st.delay_sec, st.target_sec, st.mode, st.dumps, st.dumped_sec, st.cpu_pct);
+    } else if (strncmp(line, "SET ", 4) == 0) {
+        // Неуказанные ключи - из регистров: BALANCE мог смениться калибровкой
+        fm_update_state(tx);
+        fm_transmitter_t next = *tx;
+        char *save, *tok;
+        for (tok = strtok_r(line + 4, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)) {
+            char *eq = strchr(tok, '=');
+            if (!eq) {
+                fleet_reply(fd, "ERR bad setting %s", tok);
+                return;
+            }
+            *eq = '\0';
+            if (!apply_setting(&next, tok, eq + 1)) {
+                fleet_reply(fd, "ERR unknown key %s", tok);
+                return;
+            }
+            if (!fleet_value_ok(tok, eq + 1)) {
+                fleet_reply(fd, "ERR bad value %s=%s", tok, eq + 1);
+                return;
+            }
+        }
+        if (next.freq_mhz <= 0 || next.freq_mhz >= 200) {
+            fleet_reply(fd, "ERR bad frequency");
+            return;
+        }
+
+        fm_txn_t txn;
+        fm_txn_begin(&txn);
+        fm_txn_add_state(&txn, &next);
+        fm_txn_commit(tx, &txn);
+        tx->tx_en = next.tx_en;
+        tx->stereo_en = next.stereo_en;
+        tx->rds_en = next.rds_en;
+        tx->mute_en = next.mute_en;
+        tx->preemphasis_mode = next.preemphasis_mode;
+        tx->freq_mhz = next.freq_mhz;
+        tx->balance = next.balance;
+
+        fleet_state_str(tx, state, sizeof(state));
+        printf("Applied: %s\n", state);
+        fflush(stdout);
+        fleet_reply(fd, "OK");
+    } else {
+        fleet_reply(fd, "ERR unknown command");
+    }
+}
+
+static int fleet_parse_listen(const char *spec, struct sockaddr_in *sa) {
+    char host[64] = "0.0.0.0";
+    int port = FLEET_PORT;
+
+    memset(sa, 0, sizeof(*sa));
+    sa->sin_family = AF_INET;
+    if (spec) {
+        const char *colon = strrchr(spec, ':');
+        if (colon) {
+            size_t len = colon - spec;
+            if (len >= sizeof(host)) return -1;
+            memcpy(host, spec, len);
+            host[len] = '\0';
+            port = atoi(colon + 1);
+        } else {
+            port = atoi(spec);
+        }
+    }
+    sa->sin_port = htons(port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, host, &sa->sin_addr) != 1) return -1;
+    return 0;
+}
+
+// Режим --serve: точка управления платой для --fleet
+int fleet_serve(fm_transmitter_t *tx, const char *listen_spec) {
+    static fleet_client_t clients[FLEET_MAX_CLIENTS];
+    struct sockaddr_in sa;
+    struct epoll_event ev, events[16];
+    int one = 1;
+
+    if (fleet_parse_listen(listen_spec, &sa) != 0) {
+        printf("%sОшибка: неверный адрес %s%s\n", COLOR_RED, listen_spec, COLOR_RESET);
+        return 1;
+    }
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (lfd < 0) return 1;
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) != 0 || listen(lfd, FLEET_MAX_CLIENTS) != 0) {
+        printf("%sОшибка: порт %d: %s%s\n", COLOR_RED, ntohs(sa.sin_port), strerror(errno), COLOR_RESET);
+        close(lfd);
+        return 1;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+    for (int i = 0; i < FLEET_MAX_CLIENTS; i++) clients[i].fd = -1;
+    printf("Control endpoint on %s:%d\n", inet_ntoa(sa.sin_addr), ntohs(sa.sin_port));
+    fflush(stdout);
+
+    while (tx->running) {
+        int n = epoll_wait(epfd, events, 16, 500);
+        for (int e = 0; e < n; e++) {
+            fleet_client_t *c = events[e].data.ptr;
+            if (!c) {
+                int fd;
+                while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    int slot = 0;
+                    while (slot < FLEET_MAX_CLIENTS && clients[slot].fd >= 0) slot++;
+                    if (slot == FLEET_MAX_CLIENTS) {
+                        close(fd);
+                        continue;
+                    }
+                    clients[slot].fd = fd;
+                    clients[slot].len = 0;
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = &clients[slot];
+                    epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+                }
+                continue;
+            }
+
+            ssize_t r = recv(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len, 0);
+            if (r < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            if (r <= 0) {
+                close(c->fd);  // Закрытие сокета убирает его из epoll
+                c->fd = -1;
+                continue;
+            }
+            c->len += r;
+            c->buf[c->len] = '\0';
+
+            char *start = c->buf, *nl;
+            while ((nl = strchr(start, '\n'))) {
+                *nl = '\0';
+                if (nl > start && nl[-1] == '\r') nl[-1] = '\0';
+                fleet_handle(tx, c->fd, start);
+                start = nl + 1;
+            }
+            c->len -= start - c->buf;
+            memmove(c->buf, start, c->len);
+            if (c->len >= (int)sizeof(c->buf) - 1) {
+                fleet_reply(c->fd, "ERR line too long");
+                c->len = 0;
+            }
+        }
+    }
+
+    for (int i = 0; i < FLEET_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) close(clients[i].fd);
+    }
+    close(epfd);
+    close(lfd);
+    return 0;
+}
+
+// ---------- Контроллер ----------
+
+static char *fleet_trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n' || end[-1] == '\r')) *--end = '\0';
+    return s;
+}
+
+// Файл: "HOST[:PORT] [KEY=VALUE ...]" - плата и ее параметры плана,
+// "preset NAME KEY=VALUE ..." - именованный набор изменений
+int fleet_load(fleet_t *f, const char *path) {
+    FILE *fp = fopen(path, "r");
+    char line[FLEET_LINE];
+    int lineno = 0;
+
+    if (!fp) {
+        printf("%sОшибка: не удалось открыть %s%s\n", COLOR_RED, path, COLOR_RESET);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *s = fleet_trim(line);
+        if (*s == '\0' || *s == '#') continue;
+
+        char *rest = s + strcspn(s, " \t");
+        if (*rest) *rest++ = '\0';
+        rest = fleet_trim(rest);
+
+        if (strcmp(s, "preset") == 0) {
+            if (f->npresets == FLEET_MAX_PRESETS) continue;
+            fleet_preset_t *p = &f->presets[f->npresets];
+            char *settings = rest + strcspn(rest, " \t");
+            if (*settings) *settings++ = '\0';
+            snprintf(p->name, sizeof(p->name), "%s", rest);
+            snprintf(p->settings, sizeof(p->settings), "%s", fleet_trim(settings));
+            if (p->name[0] && p->settings[0]) f->npresets++;
+            continue;
+        }
+
+        if (f->ntargets == FLEET_MAX_TARGETS) {
+            printf("%sОшибка: больше %d плат%s\n", COLOR_RED, FLEET_MAX_TARGETS, COLOR_RESET);
+            break;
+        }
+        fleet_target_t *t = &f->targets[f->ntargets];
+        char host[80], port[16];
+        snprintf(t->name, sizeof(t->name), "%s", s);
+        snprintf(host, sizeof(host), "%s", s);
+        char *colon = strrchr(host, ':');
+        if (colon) {
+            *colon = '\0';
+            snprintf(port, sizeof(port), "%s", colon + 1);
+        } else {
+            snprintf(port, sizeof(port), "%d", FLEET_PORT);
+        }
+
+        struct addrinfo hints = {0}, *ai;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(host, port, &hints, &ai) != 0) {
+            printf("%sОшибка: %s:%d: не найден адрес %s%s\n", COLOR_RED, path, lineno, s, COLOR_RESET);
+            continue;
+        }
+        memcpy(&t->sa, ai->ai_addr, sizeof(t->sa));
+        freeaddrinfo(ai);
+        snprintf(t->plan, sizeof(t->plan), "%s", rest);
+        t->fd = -1;
+        f->ntargets++;
+    }
+    fclose(fp);
+    return f->ntargets > 0 ? 0 : -1;
+}
+
+static void fleet_close(fleet_t *f, fleet_target_t *t) {
+    if (t->fd >= 0) {
+        epoll_ctl(f->epfd, EPOLL_CTL_DEL, t->fd, NULL);
+        close(t->fd);
+    }
+    t->fd = -1;
+    t->state = FLEET_DOWN;
+    t->rlen = 0;
+}
+
+// Поздний ответ сбил бы построчный протокол, поэтому при ошибке соединение рвется
+static void fleet_fail(fleet_t *f, fleet_target_t *t, const char *why) {
+    t->ok = 0;
+    snprintf(t->err, sizeof(t->err), "%s", why);
+    fleet_close(f, t);
+}
+
+static void fleet_event(fleet_t *f, fleet_target_t *t, uint32_t events, double now) {
+    if (t->state == FLEET_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(t->fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err || (events & (EPOLLERR | EPOLLHUP))) {
+            fleet_fail(f, t, strerror(err ? err : ECONNREFUSED));
+            return;
+        }
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = t};
+        epoll_ctl(f->epfd, EPOLL_CTL_MOD, t->fd, &ev);
+        t->state = FLEET_IDLE;
+        t->ok = 1;
+        t->latency_ms = (now - t->sent) * 1000.0;
+        return;
+    }
+
+    ssize_t r = recv(t->fd, t->rbuf + t->rlen, sizeof(t->rbuf) - 1 - t->rlen, 0);
+    if (r < 0 && (errno == EAGAIN || errno == EINTR)) return;
+    if (r <= 0) {
+        fleet_fail(f, t, "connection closed");
+        return;
+    }
+    t->rlen += r;
+    t->rbuf[t->rlen] = '\0';
+
+    char *nl = strchr(t->rbuf, '\n');
+    if (!nl) {
+        if (t->rlen >= (int)sizeof(t->rbuf) - 1) fleet_fail(f, t, "reply too long");
+        return;
+    }
+    *nl = '\0';
+    if (t->state == FLEET_WAIT) {
+        snprintf(t->reply, sizeof(t->reply), "%s", t->rbuf);
+        t->ok = strncmp(t->reply, "OK", 2) == 0;
+        if (!t->ok) snprintf(t->err, sizeof(t->err), "%.*s", (int)sizeof(t->err) - 1, t->reply);
+        t->latency_ms = (now - t->sent) * 1000.0;
+        t->state = FLEET_IDLE;
+    }
+    t->rlen -= nl + 1 - t->rbuf;
+    memmove(t->rbuf, nl + 1, t->rlen);
+}
+
+// Обработка событий, пока все платы не ответят или не выйдут сроки
+static void fleet_wait(fleet_t *f) {
+    struct epoll_event events[64];
+
+    for (;;) {
+        double now = fleet_now(), next = now + 1.0;
+        int pending = 0;
+        for (int i = 0; i < f->ntargets; i++) {
+            fleet_target_t *t = &f->targets[i];
+            if (t->state != FLEET_CONNECTING && t->state != FLEET_WAIT) continue;
+            if (t->deadline <= now) {
+                fleet_fail(f, t, "timeout");
+                continue;
+            }
+            pending++;
+            if (t->deadline < next) next = t->deadline;
+        }
+        if (!pending) return;
+
+        int n = epoll_wait(f->epfd, events, 64, (int)ceil((next - now) * 1000.0));
+        now = fleet_now();
+        for (int e = 0; e < n; e++) fleet_event(f, events[e].data.ptr, events[e].events, now);
+    }
+}
+
+// with_cmd: только платы с командой следующего шага, ошибки остальных остаются для отчета
+static void fleet_connect(fleet_t *f, int with_cmd) {
+    double now = fleet_now();
+
+    for (int i = 0; i < f->ntargets; i++) {
+        fleet_target_t *t = &f->targets[i];
+        if (t->state != FLEET_DOWN || (with_cmd && !t->cmd[0])) continue;
+        t->err[0] = '\0';
+        t->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (t->fd < 0) {
+            fleet_fail(f, t, strerror(errno));
+            continue;
+        }
+        int one = 1;
+        setsockopt(t->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        t->sent = now;
+        t->deadline = now + f->timeout_ms / 1000.0;
+        struct epoll_event ev = {.events = EPOLLOUT | EPOLLIN, .data.ptr = t};
+        epoll_ctl(f->epfd, EPOLL_CTL_ADD, t->fd, &ev);
+        if (connect(t->fd, (struct sockaddr *)&t->sa, sizeof(t->sa)) == 0 || errno == EINPROGRESS) {
+            t->state = FLEET_CONNECTING;
+        } else {
+            fleet_fail(f, t, strerror(errno));
+        }
+    }
+    fleet_wait(f);
+}
+
+// Одна команда на каждую плату с непустым t->cmd, ответы параллельно
+static void fleet_exchange(fleet_t *f) {
+    double now = fleet_now();
+
+    for (int i = 0; i < f->ntargets; i++) {
+        fleet_target_t *t = &f->targets[i];
+        t->ok = 0;
+        t->delivered = 0;
+        t->reply[0] = '\0';
+        if (!t->cmd[0]) continue;
+        if (t->state != FLEET_IDLE) {
+            if (!t->err[0]) snprintf(t->err, sizeof(t->err), "not connected");
+            continue;
+        }
+        char line[FLEET_LINE + 1];
+        int len = snprintf(line, sizeof(line), "%s\n", t->cmd);
+        if (len >= (int)sizeof(line)) {
+            snprintf(t->err, sizeof(t->err), "command too long");
+            continue;
+        }
+        if (send(t->fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len) {
+            fleet_fail(f, t, "send failed");
+            continue;
+        }
+        t->delivered = 1;
+        t->sent = now;
+        t->deadline = now + f->timeout_ms / 1000.0;
+        t->state = FLEET_WAIT;
+    }
+    fleet_wait(f);
+}
+
+static int fleet_cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void fleet_report(fleet_t *f, double wall_ms) {
+    static const char *names[] = {"unchanged", "OK", "FAILED", "ROLLED BACK", "ROLLBACK FAILED"};
+    static const char *colors[] = {"", COLOR_GREEN, COLOR_RED, COLOR_YELLOW, COLOR_RED BOLD};
+    double lat[FLEET_MAX_TARGETS];
+    int count[5] = {0}, nlat = 0;
+
+    printf("%-24s %-16s %10s  %s\n", "BOARD", "RESULT", "SET ms", "ERROR");
+    for (int i = 0; i < f->ntargets; i++) {
+        fleet_target_t *t = &f->targets[i];
+        count[t->result]++;
+        // Без ответа на SET (срок истек) времени нет, хоть плата и откачена
+        int has_lat = (t->result == FLEET_R_OK || t->result == FLEET_R_ROLLED_BACK ||
+                       t->result == FLEET_R_ROLLBACK_FAILED) && t->latency_ms >= 0;
+        if (has_lat) lat[nlat++] = t->latency_ms;
+        printf("%-24s %s%-16s%s ", t->name, colors[t->result], names[t->result], COLOR_RESET);
+        if (has_lat) printf("%10.2f", t->latency_ms);
+        else printf("%10s", "-");
+        printf("  %s\n", t->result == FLEET_R_OK || t->result == FLEET_R_NONE ? "" : t->err);
+    }
+
+    printf("%s%d OK, %d failed, %d rolled back, %d rollback failed, %d unchanged; %.1f ms total%s\n",
+           BOLD, count[FLEET_R_OK], count[FLEET_R_FAILED], count[FLEET_R_ROLLED_BACK],
+           count[FLEET_R_ROLLBACK_FAILED], count[FLEET_R_NONE], wall_ms, COLOR_RESET);
+    if (nlat > 0) {
+        qsort(lat, nlat, sizeof(lat[0]), fleet_cmp_double);
+        printf("SET latency: min %.2f ms, median %.2f ms, p95 %.2f ms, max %.2f ms\n",
+               lat[0], lat[nlat / 2], lat[(nlat * 95) / 100 < nlat ? (nlat * 95) / 100 : nlat - 1], lat[nlat - 1]);
+    }
+}
+
+// Изменение на всех платах: снимок состояния, SET, при любой ошибке откат всех, кому ушел SET
+static int fleet_apply(fleet_t *f, const char *common, int use_plan) {
+    double t0 = fleet_now();
+    int failed = 0;
+
+    fleet_connect(f, 0);
+
+    for (int i = 0; i < f->ntargets; i++) {
+        f->targets[i].result = FLEET_R_NONE;
+        f->targets[i].old[0] = '\0';
+        snprintf(f->targets[i].cmd, sizeof(f->targets[i].cmd), "GET");
+    }
+    fleet_exchange(f);
+
+    for (int i = 0; i < f->ntargets; i++) {
+        fleet_target_t *t = &f->targets[i];
+        t->cmd[0] = '\0';
+        if (!t->ok) {
+            t->result = FLEET_R_FAILED;
+            failed++;
+            continue;
+        }
+        snprintf(t->old, sizeof(t->old), "%s", t->reply + 3);
+        const char *plan = use_plan ? t->plan : "";
+        if (!plan[0] && !common[0]) continue;
+        if (snprintf(t->cmd, sizeof(t->cmd), "SET %s %s", plan, common) >= (int)sizeof(t->cmd)) {
+            snprintf(t->err, sizeof(t->err), "command too long");
+            t->cmd[0] = '\0';
+            t->result = FLEET_R_FAILED;
+            failed++;
+        }
+    }
+
+    if (!failed || !f->rollback) {
+        fleet_exchange(f);
+        for (int i = 0; i < f->ntargets; i++) {
+            fleet_target_t *t = &f->targets[i];
+            if (!t->cmd[0]) continue;
+            t->result = t->ok ? FLEET_R_OK : FLEET_R_FAILED;
+            if (!t->ok && !t->reply[0]) t->latency_ms = -1;
+            if (!t->ok) failed++;
+        }
+    } else {
+        // Платы без снимка уже есть - изменение не начинаем вовсе
+        for (int i = 0; i < f->ntargets; i++) f->targets[i].cmd[0] = '\0';
+        printf("%sChange aborted: %d boards failed before SET%s\n", COLOR_RED, failed, COLOR_RESET);
+    }
+
+    // Откат всем, кому ушел SET: плата с истекшим сроком могла его уже применить
+    if (failed && f->rollback) {
+        int restore = 0;
+        for (int i = 0; i < f->ntargets; i++) {
+            fleet_target_t *t = &f->targets[i];
+            int sent = t->cmd[0] && t->delivered;
+            t->cmd[0] = '\0';
+            if (sent && t->old[0]) {
+                snprintf(t->cmd, sizeof(t->cmd), "SET %s", t->old);
+                restore++;
+            }
+        }
+        double set_lat[FLEET_MAX_TARGETS];
+        for (int i = 0; i < f->ntargets; i++) set_lat[i] = f->targets[i].latency_ms;
+        // Соединения с истекшим сроком разорваны - подключаемся заново
+        if (restore) fleet_connect(f, 1);
+        fleet_exchange(f);
+        for (int i = 0; i < f->ntargets; i++) {
+            fleet_target_t *t = &f->targets[i];
+            if (!t->cmd[0]) continue;
+            t->result = t->ok ? FLEET_R_ROLLED_BACK : FLEET_R_ROLLBACK_FAILED;
+            t->latency_ms = set_lat[i];
+        }
+    }
+
+    fleet_report(f, (fleet_now() - t0) * 1000.0);
+    return failed ? 1 : 0;
+}
+
+static int fleet_status(fleet_t *f) {
+    int up = 0;
+
+    fleet_connect(f, 0);
+    for (int i = 0; i < f->ntargets; i++) snprintf(f->targets[i].cmd, sizeof(f->targets[i].cmd), "GET");
+    fleet_exchange(f);
+    for (int i = 0; i < f->ntargets; i++) {
+        fleet_target_t *t = &f->targets[i];
+        if (t->ok) {
+            up++;
+            printf("%-24s %s%8.2f ms%s  %s\n", t->name, COLOR_GREEN, t->latency_ms, COLOR_RESET, t->reply + 3);
+        } else {
+            printf("%-24s %s%11s%s  %s\n", t->name, COLOR_RED, "DOWN", COLOR_RESET, t->err);
+        }
+    }
+    printf("%d of %d boards reachable\n", up, f->ntargets);
+    return up == f->ntargets ? 0 : 1;
+}
+
+// Команды: "KEY=VALUE ...", "plan", "preset NAME", "status"
+int fleet_command(fleet_t *f, const char *line) {
+    char buf[FLEET_LINE];
+    snprintf(buf, sizeof(buf), "%s", line);
+    char *s = fleet_trim(buf);
+
+    if (*s == '\0' || *s == '#') return 0;
+    if (strcmp(s, "status") == 0) return fleet_status(f);
+    if (strcmp(s, "plan") == 0) return fleet_apply(f, "", 1);
+    if (strncmp(s, "preset ", 7) == 0) {
+        const char *name = fleet_trim(s + 7);
+        for (int i = 0; i < f->npresets; i++) {
+            if (strcmp(f->presets[i].name, name) == 0) return fleet_apply(f, f->presets[i].settings, 0);
+        }
+        printf("%sОшибка: нет пресета %s%s\n", COLOR_RED, name, COLOR_RESET);
+        return 1;
+    }
+    if (strchr(s, '=')) return fleet_apply(f, s, 0);
+
+    printf("%sUnknown command: %s (KEY=VALUE ..., plan, preset NAME, status, quit)%s\n",
+           COLOR_RED, s, COLOR_RESET);
+    return 1;
+}
+
+// Режим --fleet: постоянные соединения со всеми платами, команды из аргумента или stdin
+int fleet_main(const char *path, const char *command, int timeout_ms, int rollback) {
+    static fleet_t fleet;
+    fleet_t *f = &fleet;
+    struct epoll_event events[64];
+    char line[FLEET_LINE];
+    int ret = 0;
+
+    f->timeout_ms = timeout_ms > 0 ? timeout_ms : FLEET_TIMEOUT_MS;
+    f->rollback = rollback;
+    if (fleet_load(f, path) != 0) return 1;
+    f->epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    double t0 = fleet_now();
+    fleet_connect(f, 0);
+    int up = 0;
+    for (int i = 0; i < f->ntargets; i++) up += f->targets[i].state == FLEET_IDLE;
+    printf("Connected to %d of %d boards in %.1f ms\n", up, f->ntargets, (fleet_now() - t0) * 1000.0);
+
+    if (command) {
+        ret = fleet_command(f, command);
+    } else {
+        int tty = isatty(STDIN_FILENO);
+        // Без буфера stdio: иначе строки, уже прочитанные в буфер, не видны poll
+        setvbuf(stdin, NULL, _IONBF, 0);
+        // Один цикл: stdin и сокеты плат; в простое замечаем обрывы соединений
+        while (global_tx->running) {
+            if (tty) {
+                printf("fleet> ");
+                fflush(stdout);
+            }
+            struct pollfd pfd[2] = {{STDIN_FILENO, POLLIN, 0}, {f->epfd, POLLIN, 0}};
+            int got_line = 0;
+            while (global_tx->running && !got_line) {
+                if (poll(pfd, 2, 1000) <= 0) continue;
+                if (pfd[1].revents) {
+                    int n = epoll_wait(f->epfd, events, 64, 0);
+                    for (int e = 0; e < n; e++) fleet_event(f, events[e].data.ptr, events[e].events, fleet_now());
+                }
+                if (pfd[0].revents) got_line = 1;
+            }
+            if (!got_line || !fgets(line, sizeof(line), stdin)) break;
+            char *s = fleet_trim(line);
+            if (strcmp(s, "quit") == 0 || strcmp(s, "exit") == 0) break;
+            ret = fleet_command(f, s);
+        }
+    }
+
+    for (int i = 0; i < f->ntargets; i++) fleet_close(f, &f->targets[i]);
+    close(f->epfd);
+    return ret;
+}
@@ -0,0 +1,56 @@
+#ifndef FM_FLEET_H
+#define FM_FLEET_H
+
+#include <netinet/in.h>
+
+#include "fm.h"
+
+// Управление группой передатчиков по TCP.
+// Протокол построчный: "PING", "GET", "SET KEY=VALUE ..." -> "OK [...]" или "ERR причина"
+#define FLEET_PORT        5078
+#define FLEET_TIMEOUT_MS  2000     // Ответ каждой платы на каждом шаге
+#define FLEET_MAX_TARGETS 512
+#define FLEET_MAX_CLIENTS 64       // Одновременных подключений к одной плате
+#define FLEET_MAX_PRESETS 32
+#define FLEET_LINE        512
+
+typedef struct {
+    char name[80];               // Как в файле, для отчета
+    struct sockaddr_in sa;
+    char plan[FLEET_LINE];       // Параметры этой платы из плана
+    int fd;
+    int state;
+    char rbuf[FLEET_LINE];
+    int rlen;
+    char cmd[FLEET_LINE];        // Команда текущего шага
+    char reply[FLEET_LINE];
+    char old[FLEET_LINE];        // Состояние до изменения, для отката
+    double sent, deadline;
+    double latency_ms;           // Время ответа на SET
+    int ok;                      // Результат текущего шага
+    int delivered;               // Команда текущего шага ушла: без ответа могла и примениться
+    int result;                  // Итог изменения: FLEET_R_*
+    char err[64];
+} fleet_target_t;
+
+typedef struct {
+    char name[32];
+    char settings[FLEET_LINE];
+} fleet_preset_t;
+
+typedef struct {
+    fleet_target_t targets[FLEET_MAX_TARGETS];
+    int ntargets;
+    fleet_preset_t presets[FLEET_MAX_PRESETS];
+    int npresets;
+    int epfd;
+    int timeout_ms;
+    int rollback;
+} fleet_t;
+
+int fleet_serve(fm_transmitter_t *tx, const char *listen_spec);
+int fleet_load(fleet_t *f, const char *path);
+int fleet_command(fleet_t *f, const char *line);
+int fleet_main(const char *path, const char *command, int timeout_ms, int rollback);
+
+#endif // FM_FLEET_H
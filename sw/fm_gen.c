@@ -0,0 +1,297 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_gen.h"
+
+// Терцовые частоты, округленные до сетки GEN_MULTI_STEP, до края полосы FM 15 кГц
+static const int gen_multi_hz[] = {
+    40, 50, 60, 80, 100, 130, 160, 200, 250, 310, 400, 500, 630, 800,
+    1000, 1250, 1600, 2000, 2500, 3150, 4000, 5000, 6300, 8000, 10000, 12500, 15000
+};
+#define GEN_MULTI_N ((int)(sizeof(gen_multi_hz) / sizeof(gen_multi_hz[0])))
+
+static const char *gen_signal_names[] = { "tone", "sweep", "pink", "multi" };
+static const char *gen_channel_names[] = { "L+R", "L only", "R only", "L-R anti-phase" };
+
+// Состояние расчета одного прохода по петле
+typedef struct {
+    uint32_t rng;
+    double b[7];                     // Фильтр розового шума
+    double sweep_k;                  // ln(to/from)
+    double sweep_scale;              // Целое число периодов на петлю
+} gen_state_t;
+
+static double gen_cpu_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int gen_gcd(int a, int b) {
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int gen_parse(gen_t *g, const char *spec) {
+    char buf[256];
+    char *save, *tok;
+
+    memset(g, 0, sizeof(*g));
+    snprintf(buf, sizeof(buf), "%s", spec);
+    tok = strtok_r(buf, ",", &save);
+    int found = 0;
+    for (int i = 0; tok && i < (int)(sizeof(gen_signal_names) / sizeof(gen_signal_names[0])); i++) {
+        if (strcmp(tok, gen_signal_names[i]) == 0) {
+            g->signal = (gen_signal_t)i;
+            found = 1;
+        }
+    }
+    if (!found) {
+        printf("%sОшибка: сигнал %s (tone, sweep, pink или multi)%s\n", COLOR_RED, tok ? tok : "", COLOR_RESET);
+        return -1;
+    }
+    g->hz = 1000;
+    g->from_hz = 20;
+    g->to_hz = 20000;
+    g->sweep_sec = 10.0;
+    g->db = (g->signal == GEN_TONE || g->signal == GEN_SWEEP) ? GEN_TONE_DB : GEN_NOISE_DB;
+
+    while ((tok = strtok_r(NULL, ",", &save))) {
+        if (strncmp(tok, "hz=", 3) == 0) g->hz = atoi(tok + 3);
+        else if (strncmp(tok, "db=", 3) == 0) g->db = atof(tok + 3);
+        else if (strncmp(tok, "from=", 5) == 0) g->from_hz = atoi(tok + 5);
+        else if (strncmp(tok, "to=", 3) == 0) g->to_hz = atoi(tok + 3);
+        else if (strncmp(tok, "sec=", 4) == 0) g->sweep_sec = atof(tok + 4);
+        else if (strcmp(tok, "ch=both") == 0) g->channels = GEN_CH_BOTH;
+        else if (strcmp(tok, "ch=l") == 0) g->channels = GEN_CH_LEFT;
+        else if (strcmp(tok, "ch=r") == 0) g->channels = GEN_CH_RIGHT;
+        else if (strcmp(tok, "ch=anti") == 0) g->channels = GEN_CH_ANTI;
+        else {
+            printf("%sОшибка: параметр %s%s\n", COLOR_RED, tok, COLOR_RESET);
+            return -1;
+        }
+    }
+
+    if (g->hz < 1 || g->hz >= AUDIO_RATE / 2 ||
+        g->from_hz < 1 || g->to_hz <= g->from_hz || g->to_hz >= AUDIO_RATE / 2) {
+        printf("%sОшибка: частоты от 1 до %d Гц, from < to%s\n", COLOR_RED, AUDIO_RATE / 2 - 1, COLOR_RESET);
+        return -1;
+    }
+    if (g->sweep_sec < 0.1 || g->sweep_sec > GEN_MAX_LOOP_SEC) {
+        printf("%sОшибка: длительность свипа от 0.1 до %d с%s\n", COLOR_RED, GEN_MAX_LOOP_SEC, COLOR_RESET);
+        return -1;
+    }
+    if (g->db > 0.0) {
+        printf("%sОшибка: уровень %.1f dBFS выше полной шкалы%s\n", COLOR_RED, g->db, COLOR_RESET);
+        return -1;
+    }
+    return 0;
+}
+
+// Длина петли: целое число периодов сигнала, не короче GEN_MIN_LOOP_SEC
+static long gen_loop_frames(const gen_t *g) {
+    long base;
+    switch (g->signal) {
+        case GEN_TONE:
+            base = AUDIO_RATE / gen_gcd(AUDIO_RATE, g->hz);
+            break;
+        case GEN_MULTI:
+            base = AUDIO_RATE / gen_gcd(AUDIO_RATE, GEN_MULTI_STEP);
+            break;
+        case GEN_SWEEP:
+            return lround(g->sweep_sec * AUDIO_RATE);
+        default:
+            return (long)GEN_NOISE_SEC * AUDIO_RATE;
+    }
+    long min = (long)GEN_MIN_LOOP_SEC * AUDIO_RATE;
+    return (min + base - 1) / base * base;
+}
+
+static void gen_state_init(const gen_t *g, gen_state_t *st) {
+    memset(st, 0, sizeof(*st));
+    st->rng = 0x2545F491u;
+    st->sweep_k = log((double)g->to_hz / g->from_hz);
+    // Набег фазы за петлю округляется до целого, частоты меняются на доли ppm
+    double cycles = g->from_hz * (g->loop / (double)AUDIO_RATE) * (g->to_hz / (double)g->from_hz - 1.0) / st->sweep_k;
+    st->sweep_scale = round(cycles) / cycles;
+}
+
+// Отсчет n петли при единичной амплитуде; шум - последовательно, по одному отсчету
+static double gen_sample(const gen_t *g, gen_state_t *st, long n) {
+    switch (g->signal) {
+        case GEN_TONE: {
+            // Фаза из целых: ровно повторяется через период
+            long ph = (long)((long long)g->hz * n % AUDIO_RATE);
+            return sin(2.0 * M_PI * ph / AUDIO_RATE);
+        }
+        case GEN_SWEEP: {
+            double t_loop = g->loop / (double)AUDIO_RATE;
+            double cycles = g->from_hz * t_loop / st->sweep_k * (exp(st->sweep_k * n / g->loop) - 1.0);
+            cycles *= st->sweep_scale;
+            return sin(2.0 * M_PI * (cycles - floor(cycles)));
+        }
+        case GEN_MULTI: {
+            double s = 0.0;
+            for (int k = 0; k < GEN_MULTI_N; k++) {
+                long ph = (long)((long long)gen_multi_hz[k] * n % AUDIO_RATE);
+                double schroeder = -M_PI * k * (k + 1) / GEN_MULTI_N;
+                s += cos(2.0 * M_PI * ph / AUDIO_RATE + schroeder);
+            }
+            return s;
+        }
+        case GEN_PINK: {
+            uint32_t x = st->rng;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            st->rng = x;
+            double w = (double)(int32_t)x / 2147483648.0;
+            // Фильтр -3 дБ/окт (P. Kellet), точность +-0.05 дБ выше 9 Гц
+            double *b = st->b;
+            b[0] = 0.99886 * b[0] + w * 0.0555179;
+            b[1] = 0.99332 * b[1] + w * 0.0750759;
+            b[2] = 0.96900 * b[2] + w * 0.1538520;
+            b[3] = 0.86650 * b[3] + w * 0.3104856;
+            b[4] = 0.55000 * b[4] + w * 0.5329522;
+            b[5] = -0.7616 * b[5] - w * 0.0168980;
+            double s = b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + w * 0.5362;
+            b[6] = w * 0.115926;
+            return s;
+        }
+    }
+    return 0.0;
+}
+
+static void gen_measure(const int16_t *pcm, long frames, int ch, double *peak_db, double *rms_db) {
+    double sum = 0.0;
+    int peak = 0;
+    for (long i = 0; i < frames; i++) {
+        int v = pcm[i * 2 + ch];
+        sum += (double)v * v;
+        if (abs(v) > peak) peak = abs(v);
+    }
+    *peak_db = peak ? 20.0 * log10(peak / 32768.0) : -100.0;
+    *rms_db = sum > 0 ? 10.0 * log10(sum / frames * 2.0) - 20.0 * log10(32768.0) : -100.0;
+}
+
+// Петля считается в double, квантуется обычным преобразователем с дизерингом
+int gen_build(gen_t *g, pcm_dither_t dither) {
+    gen_state_t st;
+    pcm_conv_t conv;
+    float chunk[AUDIO_PERIOD * 2];
+
+    g->loop = gen_loop_frames(g);
+    if (g->loop > (long)GEN_MAX_LOOP_SEC * AUDIO_RATE) {
+        printf("%sОшибка: петля %ld кадров длиннее %d с%s\n", COLOR_RED, g->loop, GEN_MAX_LOOP_SEC, COLOR_RESET);
+        return -1;
+    }
+    g->table = malloc(g->loop * 2 * sizeof(int16_t));
+    if (!g->table) {
+        printf("%sОшибка: нет памяти на петлю %ld кадров%s\n", COLOR_RED, g->loop, COLOR_RESET);
+        return -1;
+    }
+
+    // Шум: первый проход приводит фильтр в установившийся режим, и петля
+    // замыкается без скачка; второй - пик и СКЗ для точного уровня
+    gen_state_init(g, &st);
+    if (g->signal == GEN_PINK) {
+        for (long n = 0; n < g->loop; n++) gen_sample(g, &st, n);
+        st.rng = 0x2545F491u;
+    }
+    gen_state_t start = st;
+    double peak = 0.0, sum = 0.0;
+    for (long n = 0; n < g->loop; n++) {
+        double s = gen_sample(g, &st, n);
+        sum += s * s;
+        if (fabs(s) > peak) peak = fabs(s);
+    }
+    double rms = sqrt(sum / g->loop);
+
+    double scale = (g->signal == GEN_TONE || g->signal == GEN_SWEEP)
+                   ? pow(10.0, g->db / 20.0) / peak
+                   : pow(10.0, g->db / 20.0) / M_SQRT2 / rms;
+    // 0 dBFS - это 32767: верхний отсчет прижимается к нему, ограничением это не считается
+    if (peak * scale > 32767.0 / 32768.0 && peak * scale <= 1.0 + 1e-9) scale = 32767.0 / 32768.0 / peak;
+    if (peak * scale > 32767.0 / 32768.0) {
+        printf("%sОшибка: при %.1f dB пик %+.1f dBFS, сигнал ограничится%s\n",
+               COLOR_RED, g->db, 20.0 * log10(peak * scale), COLOR_RESET);
+        gen_free(g);
+        return -1;
+    }
+
+    st = start;
+    pcm_conv_init(&conv, dither);
+    for (long pos = 0; pos < g->loop; pos += AUDIO_PERIOD) {
+        int n = g->loop - pos < AUDIO_PERIOD ? (int)(g->loop - pos) : AUDIO_PERIOD;
+        for (int i = 0; i < n; i++) {
+            float s = (float)(gen_sample(g, &st, pos + i) * scale);
+            chunk[i * 2] = g->channels == GEN_CH_RIGHT ? 0.0f : s;
+            chunk[i * 2 + 1] = g->channels == GEN_CH_LEFT ? 0.0f : g->channels == GEN_CH_ANTI ? -s : s;
+        }
+        pcm_f32_to_s16(&conv, chunk, g->table + pos * 2, n * 2, 2);
+    }
+    gen_measure(g->table, g->loop, g->channels == GEN_CH_RIGHT ? 1 : 0, &g->peak_db, &g->rms_db);
+    return 0;
+}
+
+void gen_free(gen_t *g) {
+    free(g->table);
+    g->table = NULL;
+}
+
+// --gen: петля по кругу на устройство воспроизведения; сообщения в stderr,
+// stdout может быть самим выходом ("-")
+int gen_main(const char *spec, const char *play_dev, int seconds, pcm_dither_t dither) {
+    gen_t g;
+    audio_dev_t dev;
+
+    if (gen_parse(&g, spec) != 0) return 1;
+    double t0 = gen_cpu_now();
+    if (gen_build(&g, dither) != 0) return 1;
+    double build_ms = (gen_cpu_now() - t0) * 1000.0;
+
+    if (audio_open(&dev, play_dev, 0, AUDIO_RATE, AUDIO_CHANNELS) != 0) {
+        gen_free(&g);
+        return 1;
+    }
+
+    char what[64];
+    switch (g.signal) {
+        case GEN_TONE: snprintf(what, sizeof(what), "%d Hz tone", g.hz); break;
+        case GEN_SWEEP: snprintf(what, sizeof(what), "%d-%d Hz log sweep", g.from_hz, g.to_hz); break;
+        case GEN_PINK: snprintf(what, sizeof(what), "pink noise"); break;
+        case GEN_MULTI: snprintf(what, sizeof(what), "%d-tone multitone", GEN_MULTI_N); break;
+    }
+    fprintf(stderr, "%s, %s: peak %.2f dBFS, RMS %.2f dBFS (AES17); loop %ld frames (%.3f s, %ld KB) built in %.1f ms\n",
+            what, gen_channel_names[g.channels], g.peak_db, g.rms_db, g.loop, g.loop / (double)AUDIO_RATE,
+            g.loop * 4 / 1024, build_ms);
+
+    long total = (long)seconds * AUDIO_RATE, done = 0, pos = 0;
+    t0 = gen_cpu_now();
+    while (global_tx->running && (seconds == 0 || done < total)) {
+        long n = AUDIO_PERIOD * 4;
+        if (n > g.loop - pos) n = g.loop - pos;
+        if (seconds > 0 && n > total - done) n = total - done;
+        if (audio_write(&dev, g.table + pos * 2, (int)n) != n) break;
+        done += n;
+        pos += n;
+        if (pos == g.loop) pos = 0;
+    }
+    double cpu = gen_cpu_now() - t0;
+    fprintf(stderr, "Played %.1f s, CPU %.3f s (%.3f%% of real time)\n",
+            done / (double)AUDIO_RATE, cpu, done ? cpu * 100.0 * AUDIO_RATE / done : 0.0);
+
+    audio_close(&dev);
+    gen_free(&g);
+    return 0;
+}
@@ -0,0 +1,50 @@
+#ifndef FM_GEN_H
+#define FM_GEN_H
+
+#include <stdint.h>
+
+#include "fm_pcm.h"
+
+// Генератор тестовых сигналов: вся петля сигнала считается заранее и
+// квантуется один раз, в работе только запись таблицы по кругу
+#define GEN_MIN_LOOP_SEC   1         // Короткие петли повторяются до этой длины: период дизеринга
+#define GEN_MAX_LOOP_SEC   30        // Самая длинная петля (свип), 5.8 МБ
+#define GEN_NOISE_SEC      8         // Петля розового шума
+#define GEN_TONE_DB        (-9.0)    // Тон и свип: пик, 75 кГц девиации после калибровки
+#define GEN_NOISE_DB       (-20.0)   // Шум и мультитон: СКЗ по AES17 (синус 0 dBFS = 0 dB)
+#define GEN_MULTI_STEP     10        // Частоты мультитона кратны 10 Гц: период 100 мс
+
+typedef enum {
+    GEN_TONE = 0,
+    GEN_SWEEP,                       // Логарифмический, фаза непрерывна и на стыке петли
+    GEN_PINK,
+    GEN_MULTI                        // Терцовые частоты 40 Гц - 15 кГц, фазы по Шредеру
+} gen_signal_t;
+
+typedef enum {
+    GEN_CH_BOTH = 0,                 // L = R: только M, моно девиация
+    GEN_CH_LEFT,
+    GEN_CH_RIGHT,
+    GEN_CH_ANTI                      // R = -L: только S, проверка переходного затухания
+} gen_channels_t;
+
+typedef struct {
+    gen_signal_t signal;
+    gen_channels_t channels;
+    int hz;                          // Тон
+    int from_hz, to_hz;              // Свип
+    double sweep_sec;
+    double db;
+    // Таблица
+    int16_t *table;                  // Стерео S16, loop кадров
+    long loop;
+    double peak_db, rms_db;          // По квантованной таблице, канал с сигналом
+} gen_t;
+
+// "SIGNAL[,hz=F][,db=DB][,ch=both|l|r|anti][,from=F][,to=F][,sec=S]"
+int gen_parse(gen_t *g, const char *spec);
+int gen_build(gen_t *g, pcm_dither_t dither);
+void gen_free(gen_t *g);
+int gen_main(const char *spec, const char *play_dev, int seconds, pcm_dither_t dither);
+
+#endif // FM_GEN_H
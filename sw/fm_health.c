@@ -0,0 +1,470 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "fm.h"
+#include "fm_rt.h"
+#include "fm_health.h"
+
+extern char **environ;
+
+// Супервизор этого процесса: его записи в регистры - намеренные, не сбой
+static health_t *health_active = NULL;
+
+static const char *health_names[HEALTH_FAULT_COUNT] = {
+    "ok", "wedged", "version", "ctrl", "freq", "balance", "stall", "process"
+};
+
+static double health_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Строка журнала с местным временем до миллисекунд
+static void health_log(const char *color, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void health_log(const char *color, const char *fmt, ...) {
+    struct timespec ts;
+    struct tm tm;
+    char stamp[16];
+    va_list ap;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    localtime_r(&ts.tv_sec, &tm);
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+    printf("%s[health] %s.%03ld ", color, stamp, ts.tv_nsec / 1000000);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("%s\n", COLOR_RESET);
+    fflush(stdout);
+}
+
+// HEALTH_RESET=, HEALTH_RESTART=, HEALTH_PROCESS=, HEALTH_STALL_MS= в общем конфиге
+void health_load_profile(health_t *h, const char *path) {
+    h->stall_ms = HEALTH_STALL_MS;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[512];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "HEALTH_", 7) != 0) continue;
+        line[strcspn(line, "\n")] = 0;
+        char *value = strchr(line, '=');
+        if (!value) continue;
+        *value++ = 0;
+
+        if (strcmp(line, "HEALTH_RESET") == 0) snprintf(h->reset_cmd, sizeof(h->reset_cmd), "%s", value);
+        else if (strcmp(line, "HEALTH_RESTART") == 0) snprintf(h->restart_cmd, sizeof(h->restart_cmd), "%s", value);
+        else if (strcmp(line, "HEALTH_PROCESS") == 0) snprintf(h->process, sizeof(h->process), "%s", value);
+        else if (strcmp(line, "HEALTH_STALL_MS") == 0) h->stall_ms = atoi(value);
+    }
+    fclose(f);
+}
+
+// Вызывается из fm_write/fm_txn_commit до записи в регистр
+void health_note_write(uint32_t offset, uint32_t value) {
+    health_t *h = health_active;
+    if (!h) return;
+    if (offset == REG_CTRL) h->expect_ctrl = value & 0x3F;
+    else if (offset == REG_FREQ) h->expect_freq = value;
+    else if (offset == REG_BALANCE) h->expect_balance = value;
+}
+
+// Ожидаемое состояние из сохраненного конфига поверх текущих регистров
+static int health_load_config(health_t *h) {
+    fm_transmitter_t cfg = *h->tx;
+    struct stat st;
+
+    fm_update_state(&cfg);
+    int found = load_settings(&cfg);
+    h->config_mtime = stat(CONFIG_FILE, &st) == 0 ? st.st_mtime : 0;
+
+    h->expect_ctrl = fm_ctrl_word(&cfg) & 0x3F;
+    if (cfg.freq_mhz > 0 && cfg.freq_mhz < 200) h->expect_freq = fm_freq_to_ftw(cfg.freq_mhz);
+    else h->expect_freq = fm_read(h->tx, REG_FREQ);
+    h->expect_balance = cfg.balance;
+    return found;
+}
+
+// Повторная запись ожидаемого состояния с проверкой чтением, не дольше HEALTH_RECOVER_MS
+static int health_reapply(health_t *h) {
+    double deadline = health_now() + HEALTH_RECOVER_MS / 1000.0;
+    int attempts = 0;
+
+    do {
+        fm_txn_t txn;
+        uint32_t ctrl = h->expect_ctrl, freq = h->expect_freq, balance = h->expect_balance;
+        fm_txn_begin(&txn);
+        fm_txn_add(&txn, REG_FREQ, freq);
+        fm_txn_add(&txn, REG_BALANCE, balance);
+        fm_txn_add(&txn, REG_CTRL, ctrl);
+        fm_txn_commit(h->tx, &txn);
+        attempts++;
+        if ((fm_read(h->tx, REG_CTRL) & 0x3F) == ctrl && fm_read(h->tx, REG_FREQ) == freq &&
+            fm_read(h->tx, REG_BALANCE) == balance) return attempts;
+    } while (health_now() < deadline && !h->stop);
+    return -attempts;
+}
+
+static void health_spawn(const char *what, const char *cmd) {
+    pid_t pid;
+    char *argv[] = {"/bin/sh", "-c", (char *)cmd, NULL};
+    if (posix_spawn(&pid, "/bin/sh", NULL, NULL, argv, environ) != 0) {
+        health_log(COLOR_RED, "%s failed: %s", what, cmd);
+    } else {
+        health_log(COLOR_YELLOW, "%s: %s", what, cmd);
+    }
+}
+
+// Поиск процесса плеера по /proc/N/comm
+static pid_t health_find_process(const char *name) {
+    DIR *d = opendir("/proc");
+    struct dirent *e;
+    pid_t found = 0;
+
+    if (!d) return 0;
+    while (!found && (e = readdir(d))) {
+        char path[300], comm[64];
+        if (e->d_name[0] < '0' || e->d_name[0] > '9') continue;
+        snprintf(path, sizeof(path), "/proc/%s/comm", e->d_name);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        if (fgets(comm, sizeof(comm), f)) {
+            comm[strcspn(comm, "\n")] = 0;
+            if (strcmp(comm, name) == 0) found = atoi(e->d_name);
+        }
+        fclose(f);
+    }
+    closedir(d);
+    return found;
+}
+
+// Момент внесения сбоя из файла симулятора, если он относится к этому сбою
+static double health_sim_stamp(health_t *h, double since, double now) {
+    if (!h->tx->simulated) return 0;
+    uint64_t ns = fm_read(h->tx, HEALTH_SIM_STAMP) | (uint64_t)fm_read(h->tx, HEALTH_SIM_STAMP + 4) << 32;
+    double t = ns / 1e9;
+    return (t >= since - 0.010 && t <= now) ? t : 0;
+}
+
+static void health_describe(health_t *h, health_fault_t f, char *out, size_t size) {
+    fm_transmitter_t *tx = h->tx;
+    switch (f) {
+    case HEALTH_WEDGED:
+        snprintf(out, size, "VERSION=0x%08X STATUS=0x%08X",
+                 fm_read(tx, REG_VERSION), fm_read(tx, REG_STATUS));
+        break;
+    case HEALTH_VERSION:
+        snprintf(out, size, "VERSION 0x%08X -> 0x%08X", h->version, fm_read(tx, REG_VERSION));
+        break;
+    case HEALTH_CTRL:
+        snprintf(out, size, "CTRL=0x%02X expected 0x%02X", fm_read(tx, REG_CTRL) & 0x3F, h->expect_ctrl);
+        break;
+    case HEALTH_FREQ:
+        snprintf(out, size, "%.3f MHz expected %.3f MHz",
+                 fm_read(tx, REG_FREQ) * DDS_STEP / 1e6, h->expect_freq * DDS_STEP / 1e6);
+        break;
+    case HEALTH_BALANCE:
+        snprintf(out, size, "BALANCE=0x%08X expected 0x%08X", fm_read(tx, REG_BALANCE), h->expect_balance);
+        break;
+    case HEALTH_STALL:
+        snprintf(out, size, "levels frozen for %d ms with carrier on", h->stall_ms);
+        break;
+    case HEALTH_PROCESS:
+        snprintf(out, size, "%s not running", h->process);
+        break;
+    default:
+        snprintf(out, size, "-");
+        break;
+    }
+}
+
+// Действие по текущему состоянию сбоя; повтор команд не чаще HEALTH_RETRY_MS
+static void health_act(health_t *h, health_fault_t f, double now) {
+    int retry = now - h->last_action >= HEALTH_RETRY_MS / 1000.0;
+
+    switch (f) {
+    case HEALTH_WEDGED:
+        // Шина не отвечает - писать бесполезно, нужна перезагрузка PL
+        if (retry && h->reset_cmd[0]) {
+            health_spawn("reset", h->reset_cmd);
+            h->last_action = now;
+        }
+        break;
+    case HEALTH_VERSION:
+        h->version = fm_read(h->tx, REG_VERSION);
+        // Новая прошивка стартует со сброшенными регистрами
+        __attribute__((fallthrough));
+    case HEALTH_CTRL:
+    case HEALTH_FREQ:
+    case HEALTH_BALANCE: {
+        // После неудачи не занимаем шину непрерывно - повтор по HEALTH_RETRY_MS
+        if (h->apply_failed && !retry) break;
+        int n = health_reapply(h);
+        if (n < 0) {
+            health_log(COLOR_RED, "re-apply not confirmed after %d writes in %d ms", -n, HEALTH_RECOVER_MS);
+            if (!h->apply_failed) h->stats[h->fault].failed++;
+            h->apply_failed = 1;
+            h->last_action = now;
+            if (h->reset_cmd[0]) health_spawn("reset", h->reset_cmd);
+        }
+        break;
+    }
+    case HEALTH_STALL:
+    case HEALTH_PROCESS:
+        if (retry && h->restart_cmd[0]) {
+            health_spawn("restart", h->restart_cmd);
+            h->last_action = now;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Проверки одного опроса, в порядке серьезности
+static health_fault_t health_check(health_t *h, double now, double *since) {
+    fm_transmitter_t *tx = h->tx;
+    static uint32_t last_l, last_r, last_mpx;
+    static double level_at, proc_at, proc_check;
+
+    uint32_t ver = fm_read(tx, REG_VERSION);
+    uint32_t status = fm_read(tx, REG_STATUS);
+    if (ver == 0 || ver == 0xFFFFFFFF || status == 0xFFFFFFFF) return HEALTH_WEDGED;
+    if (h->version == 0) h->version = ver;
+    if (ver != h->version) return HEALTH_VERSION;
+    if ((fm_read(tx, REG_CTRL) & 0x3F) != h->expect_ctrl) return HEALTH_CTRL;
+    if (fm_read(tx, REG_FREQ) != h->expect_freq) return HEALTH_FREQ;
+    if (fm_read(tx, REG_BALANCE) != h->expect_balance) return HEALTH_BALANCE;
+
+    // Живость уровней: при несущей без mute регистры уровней должны меняться
+    uint32_t l = fm_read(tx, REG_LEFT), r = fm_read(tx, REG_RIGHT), mpx = fm_read(tx, REG_MPXLVL);
+    int on_air = (h->expect_ctrl & 0x1) && !(h->expect_ctrl & CTRL_MUTE_BIT);
+    if (!on_air || level_at == 0 || l != last_l || r != last_r || mpx != last_mpx) level_at = now;
+    last_l = l;
+    last_r = r;
+    last_mpx = mpx;
+    if (h->stall_ms > 0 && now - level_at > h->stall_ms / 1000.0) {
+        *since = level_at;
+        return HEALTH_STALL;
+    }
+
+    // Процесс плеера: kill(pid, 0) дешев, поиск по /proc - только если он пропал
+    if (h->process[0]) {
+        if (now - proc_check >= HEALTH_PROC_MS / 1000.0) {
+            proc_check = now;
+            if (h->pid <= 0 || kill(h->pid, 0) != 0) h->pid = health_find_process(h->process);
+            if (h->pid > 0) proc_at = now;
+        }
+        if (h->pid <= 0) {
+            *since = proc_at ? proc_at : now;
+            return HEALTH_PROCESS;
+        }
+    }
+    return HEALTH_OK;
+}
+
+static void *health_thread(void *arg) {
+    health_t *h = arg;
+    const long step_ns = HEALTH_POLL_US * 1000L;
+    double last_ok = health_now(), config_check = 0;
+    struct timespec next;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!h->stop && h->tx->running) {
+        double now = health_now();
+        double since = last_ok;
+        health_fault_t f = health_check(h, now, &since);
+
+        if (f == HEALTH_OK) {
+            if (h->fault != HEALTH_OK) {
+                health_stat_t *s = &h->stats[h->fault];
+                double recover_ms = (now - h->detected_at) * 1000.0;
+                s->recovered++;
+                s->recover_sum_ms += recover_ms;
+                if (recover_ms > s->recover_max_ms) s->recover_max_ms = recover_ms;
+                health_log(COLOR_GREEN, "recovered %s in %.2f ms", health_names[h->fault], recover_ms);
+                h->fault = HEALTH_OK;
+                h->last_action = 0;
+                h->apply_failed = 0;
+            }
+            h->pending = 0;
+            last_ok = now;
+
+            // Настройки сохранили заново - это новое ожидаемое состояние, а не сбой
+            if (now - config_check >= HEALTH_CONFIG_MS / 1000.0) {
+                struct stat st;
+                config_check = now;
+                if (stat(CONFIG_FILE, &st) == 0 && st.st_mtime != h->config_mtime) {
+                    health_load_config(h);
+                    health_log(COLOR_CYAN, "config changed: CTRL=0x%02X FREQ=%.3f MHz BALANCE=0x%08X",
+                               h->expect_ctrl, h->expect_freq * DDS_STEP / 1e6, h->expect_balance);
+                    health_reapply(h);
+                }
+            }
+        } else if (h->fault == HEALTH_OK) {
+            // Одиночное расхождение может быть нашей же записью в процессе
+            if (++h->pending >= HEALTH_CONFIRM || f == HEALTH_STALL || f == HEALTH_PROCESS) {
+                char what[96];
+                health_stat_t *s = &h->stats[f];
+                // Для замерших уровней и процесса момент сбоя известен и так
+                double stamp = f < HEALTH_STALL ? health_sim_stamp(h, since, now) : 0;
+                double detect_ms = (now - (stamp ? stamp : since)) * 1000.0;
+
+                s->count++;
+                s->detect_sum_ms += detect_ms;
+                if (detect_ms > s->detect_max_ms) s->detect_max_ms = detect_ms;
+                health_describe(h, f, what, sizeof(what));
+                health_log(COLOR_RED, "fault %s: %s, detected in %s%.2f ms",
+                           health_names[f], what, stamp ? "" : "<", detect_ms);
+                h->fault = f;
+                h->detected_at = now;
+                health_act(h, f, now);
+            }
+        } else {
+            // Сбой еще не ушел; состояние могло смениться (PL перезагрузили - теперь CTRL)
+            health_act(h, f, now);
+        }
+
+        next.tv_nsec += step_ns;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        // После долгого восстановления не догоняем пропущенные опросы
+        struct timespec t;
+        clock_gettime(CLOCK_MONOTONIC, &t);
+        if (t.tv_sec > next.tv_sec || (t.tv_sec == next.tv_sec && t.tv_nsec > next.tv_nsec)) next = t;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !h->stop);
+    }
+    return NULL;
+}
+
+int health_start(health_t *h, fm_transmitter_t *tx) {
+    h->tx = tx;
+    h->version = fm_read(tx, REG_VERSION);
+    if (h->version == 0xFFFFFFFF) h->version = 0;
+    int found = health_load_config(h);
+
+    // Команды сброса/перезапуска не ждем
+    signal(SIGCHLD, SIG_IGN);
+
+    health_active = h;
+    if ((fm_read(tx, REG_CTRL) & 0x3F) != h->expect_ctrl || fm_read(tx, REG_FREQ) != h->expect_freq ||
+        fm_read(tx, REG_BALANCE) != h->expect_balance) {
+        health_reapply(h);
+    }
+    printf("Supervising VERSION=0x%08X, CTRL=0x%02X, %.3f MHz, BALANCE=0x%08X (%s), polling every %d us\n",
+           h->version, h->expect_ctrl, h->expect_freq * DDS_STEP / 1e6, h->expect_balance,
+           found ? "saved config" : "current registers", HEALTH_POLL_US);
+    fflush(stdout);
+    if (rt_thread_create(&h->thread, RT_ROLE_SAMPLER, health_thread, h) != 0) {
+        health_active = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void health_stop(health_t *h) {
+    h->stop = 1;
+    pthread_join(h->thread, NULL);
+    health_active = NULL;
+
+    long total = 0;
+    for (int f = 1; f < HEALTH_FAULT_COUNT; f++) total += h->stats[f].count;
+    if (total == 0) {
+        printf("%sHealth: no faults%s\n", COLOR_GREEN, COLOR_RESET);
+        return;
+    }
+    printf("%sHealth:   fault  count failed  detect avg/max ms  recover avg/max ms%s\n", BOLD, COLOR_RESET);
+    for (int f = 1; f < HEALTH_FAULT_COUNT; f++) {
+        health_stat_t *s = &h->stats[f];
+        if (s->count == 0) continue;
+        printf("        %8s %6ld %6ld %9.2f / %-8.2f", health_names[f], s->count, s->failed,
+               s->detect_sum_ms / s->count, s->detect_max_ms);
+        if (s->recovered > 0) printf(" %9.2f / %-8.2f\n", s->recover_sum_ms / s->recovered, s->recover_max_ms);
+        else printf("         - / -\n");
+    }
+}
+
+// --inject для --sim: меняет регистры в файле так, как это сделало бы железо
+int health_inject(fm_transmitter_t *tx, const char *fault, int ms) {
+    if (!tx->simulated) {
+        printf("%sОшибка: --inject работает только с --sim%s\n", COLOR_RED, COLOR_RESET);
+        return 1;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    uint32_t ctrl = fm_read(tx, REG_CTRL), freq = fm_read(tx, REG_FREQ);
+
+    // Момент внесения пишется первым, в той же транзакции, что и сбой
+    fm_txn_t txn;
+    fm_txn_begin(&txn);
+    fm_txn_add(&txn, HEALTH_SIM_STAMP, (uint32_t)ns);
+    fm_txn_add(&txn, HEALTH_SIM_STAMP + 4, (uint32_t)(ns >> 32));
+
+    if (strcmp(fault, "ctrl") == 0) {
+        fm_txn_add(&txn, REG_CTRL, ctrl ^ 0x1);
+    } else if (strcmp(fault, "freq") == 0) {
+        fm_txn_add(&txn, REG_FREQ, freq + fm_freq_to_ftw(0.1));
+    } else if (strcmp(fault, "reload") == 0 || strcmp(fault, "version") == 0) {
+        if (fault[0] == 'v') fm_txn_add(&txn, REG_VERSION, fm_read(tx, REG_VERSION) + 1);
+        fm_txn_add(&txn, REG_CTRL, 0);
+        fm_txn_add(&txn, REG_FREQ, 0);
+        fm_txn_add(&txn, REG_MPXLVL, 0);
+        fm_txn_add(&txn, REG_BALANCE, 0);
+    } else if (strcmp(fault, "wedge") == 0) {
+        // Шина отвечает единицами, пока PL не перезагрузят (ms), затем регистры сброшены
+        uint32_t version = fm_read(tx, REG_VERSION);
+        if (ms <= 0) ms = 500;
+        fm_txn_commit(tx, &txn);
+        printf("Injected wedge for %d ms\n", ms);
+        fflush(stdout);
+        for (int i = 0; i < ms && tx->running; i++) {
+            for (uint32_t off = REG_VERSION; off <= REG_BALANCE; off += 4) tx->regs[off / 4] = 0xFFFFFFFF;
+            usleep(1000);
+        }
+        for (uint32_t off = REG_CTRL; off <= REG_BALANCE; off += 4) tx->regs[off / 4] = 0;
+        tx->regs[REG_VERSION / 4] = version;
+        printf("PL reloaded\n");
+        return 0;
+    } else if (strcmp(fault, "levels") == 0) {
+        // Уровни как от работающего звукового тракта; после остановки они замирают
+        if (ms > 0) printf("Driving levels for %d ms\n", ms);
+        else printf("Driving levels, Ctrl+C to stall\n");
+        fflush(stdout);
+        for (long i = 0; tx->running && (ms <= 0 || i < ms); i++) {
+            double env = 0.5 + 0.4 * sin(i * 0.0131) * sin(i * 0.0007);
+            int l = (int)(AUDIO_MAX * 0.35 * env * (0.8 + 0.2 * ((i * 7919) % 101) / 100.0));
+            int r = (int)(AUDIO_MAX * 0.35 * env * (0.8 + 0.2 * ((i * 6271) % 97) / 97.0));
+            tx->regs[REG_LEFT / 4] = (uint16_t)l;
+            tx->regs[REG_RIGHT / 4] = (uint16_t)r;
+            tx->regs[REG_MPXLVL / 4] = (uint32_t)(75.0 * (l + r) / AUDIO_MAX * 1000.0 / DDS_STEP) & MPX_MAX;
+            usleep(1000);
+        }
+        printf("Levels stopped\n");
+        return 0;
+    } else {
+        printf("%sUnknown fault: %s (ctrl, freq, reload, version, wedge [MS], levels [MS])%s\n",
+               COLOR_RED, fault, COLOR_RESET);
+        return 1;
+    }
+
+    fm_txn_commit(tx, &txn);
+    printf("Injected %s\n", fault);
+    return 0;
+}
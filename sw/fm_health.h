@@ -0,0 +1,72 @@
+#ifndef FM_HEALTH_H
+#define FM_HEALTH_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "fm.h"
+
+// Надзор за передатчиком: перезагрузка/зависание PL, CTRL/FREQ/BALANCE, живость уровней, процесс плеера
+#define HEALTH_POLL_US       1000      // Период опроса регистров
+#define HEALTH_CONFIRM       2         // Опросов подряд с расхождением до признания сбоя
+#define HEALTH_RECOVER_MS    50        // Предел восстановления записью регистров
+#define HEALTH_STALL_MS      1000      // Уровни не меняются при включенной несущей
+#define HEALTH_PROC_MS       100       // Проверка процесса плеера
+#define HEALTH_CONFIG_MS     500       // Проверка изменений сохраненного конфига
+#define HEALTH_RETRY_MS      5000      // Повтор команд сброса/перезапуска, пока сбой не ушел
+#define HEALTH_SIM_STAMP     0x100     // --sim: момент внесения сбоя (CLOCK_MONOTONIC, нс), 2 слова
+#define HEALTH_CMD_LEN       256
+
+typedef enum {
+    HEALTH_OK = 0,
+    HEALTH_WEDGED,       // VERSION/STATUS читаются как 0 или 0xFFFFFFFF
+    HEALTH_VERSION,      // Загружена другая прошивка PL
+    HEALTH_CTRL,         // CTRL не совпадает с ожидаемым (несущая, mute, стерео...)
+    HEALTH_FREQ,
+    HEALTH_BALANCE,      // Калибровка L/R потеряна (перезагрузка PL обнуляет регистр)
+    HEALTH_STALL,        // Уровни замерли
+    HEALTH_PROCESS,      // Процесс плеера пропал
+    HEALTH_FAULT_COUNT
+} health_fault_t;
+
+typedef struct {
+    long count;
+    long failed;                      // Восстановление не уложилось в предел
+    long recovered;
+    double detect_sum_ms, detect_max_ms;
+    double recover_sum_ms, recover_max_ms;
+} health_stat_t;
+
+typedef struct {
+    fm_transmitter_t *tx;
+    // Ожидаемое состояние: сохраненный конфиг плюс все записи этого процесса
+    volatile uint32_t expect_ctrl;
+    volatile uint32_t expect_freq;
+    volatile uint32_t expect_balance;
+    uint32_t version;
+    time_t config_mtime;
+    // Настройки из конфига (HEALTH_*)
+    char reset_cmd[HEALTH_CMD_LEN];   // Перезагрузка PL при зависании
+    char restart_cmd[HEALTH_CMD_LEN]; // Перезапуск звукового тракта
+    char process[32];                 // Имя процесса плеера (comm)
+    int stall_ms;
+    // Текущий сбой
+    health_fault_t fault;
+    int pending;                      // Опросов подряд с расхождением
+    double detected_at;
+    double last_action;
+    int apply_failed;                 // Запись не подтвердилась в этом сбое
+    pid_t pid;
+    health_stat_t stats[HEALTH_FAULT_COUNT];
+    pthread_t thread;
+    volatile int stop;
+} health_t;
+
+void health_load_profile(health_t *h, const char *path);
+void health_note_write(uint32_t offset, uint32_t value);
+int health_start(health_t *h, fm_transmitter_t *tx);
+void health_stop(health_t *h);
+int health_inject(fm_transmitter_t *tx, const char *fault, int ms);
+
+#endif // FM_HEALTH_H
@@ -0,0 +1,261 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_rt.h"
+#include "fm_latency.h"
+
+#define LAT_RING_FRAMES (LAT_RING_SEC * AUDIO_RATE)
+
+// Захват: моно-кольцо и привязка номера кадра ко времени.
+// Планировщик может только задержать пробуждение, поэтому минимум
+// (время - кадр / частота) по всем блокам - лучшая оценка смещения часов
+typedef struct {
+    audio_dev_t dev;
+    float ring[LAT_RING_FRAMES];
+    double offset;                   // Время кадра 0, с
+    volatile long frames;            // Всего захвачено кадров
+    volatile int stop;
+    pthread_mutex_t lock;
+} lat_capture_t;
+
+static double now_sec(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Последовательность максимальной длины (LFSR, x^12 + x^11 + x^10 + x^4 + 1)
+static void lat_make_mls(float *out, int len) {
+    uint32_t lfsr = 1;
+    for (int i = 0; i < len; i++) {
+        out[i] = (lfsr & 1) ? 1.0f : -1.0f;
+        uint32_t bit = ((lfsr >> 0) ^ (lfsr >> 1) ^ (lfsr >> 2) ^ (lfsr >> 8)) & 1;
+        lfsr = (lfsr >> 1) | (bit << (LAT_MLS_ORDER - 1));
+    }
+}
+
+// Комплексное БПФ по основанию 2, на месте
+static void lat_fft(float *re, float *im, int n, int inverse) {
+    for (int i = 1, j = 0; i < n; i++) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1) {
+        double ang = 2 * M_PI / len * (inverse ? 1 : -1);
+        float wr = cos(ang), wi = sin(ang);
+        for (int i = 0; i < n; i += len) {
+            float cr = 1, ci = 0;
+            for (int k = 0; k < len / 2; k++) {
+                int a = i + k, b = i + k + len / 2;
+                float xr = re[b] * cr - im[b] * ci;
+                float xi = re[b] * ci + im[b] * cr;
+                re[b] = re[a] - xr; im[b] = im[a] - xi;
+                re[a] += xr; im[a] += xi;
+                float t = cr * wr - ci * wi;
+                ci = cr * wi + ci * wr;
+                cr = t;
+            }
+        }
+    }
+    if (inverse) {
+        for (int i = 0; i < n; i++) { re[i] /= n; im[i] /= n; }
+    }
+}
+
+static void *lat_capture_thread(void *arg) {
+    lat_capture_t *c = arg;
+    int16_t buf[AUDIO_PERIOD * AUDIO_CHANNELS];
+
+    while (!c->stop) {
+        if (audio_read(&c->dev, buf, AUDIO_PERIOD) != AUDIO_PERIOD) break;
+        double t = now_sec();
+
+        long base = c->frames;
+        for (int i = 0; i < AUDIO_PERIOD; i++) {
+            float s = 0;
+            for (int ch = 0; ch < AUDIO_CHANNELS; ch++) s += buf[i * AUDIO_CHANNELS + ch];
+            c->ring[(base + i) % LAT_RING_FRAMES] = s / (AUDIO_CHANNELS * 32768.0f);
+        }
+        pthread_mutex_lock(&c->lock);
+        double offset = t - (double)(base + AUDIO_PERIOD) / AUDIO_RATE;
+        if (base == 0 || offset < c->offset) c->offset = offset;
+        c->frames = base + AUDIO_PERIOD;
+        pthread_mutex_unlock(&c->lock);
+    }
+    return NULL;
+}
+
+// Поиск метки в захвате начиная с момента t_from; возвращает время пика или -1
+static double lat_find(lat_capture_t *c, const float *mls, int mls_len,
+                       double t_from, double *psr_out) {
+    // Кадр захвата, соответствующий t_from
+    pthread_mutex_lock(&c->lock);
+    long last = c->frames;
+    double offset = c->offset;
+    pthread_mutex_unlock(&c->lock);
+
+    long first = (long)((t_from - offset) * AUDIO_RATE);
+    if (first < 0) first = 0;
+    if (last - first > LAT_RING_FRAMES - AUDIO_PERIOD) first = last - LAT_RING_FRAMES + AUDIO_PERIOD;
+
+    int seg = (int)(last - first);
+    int n = 1;
+    while (n < seg + mls_len) n <<= 1;
+
+    float *xr = calloc(n, sizeof(float)), *xi = calloc(n, sizeof(float));
+    float *yr = calloc(n, sizeof(float)), *yi = calloc(n, sizeof(float));
+    if (!xr || !xi || !yr || !yi) {
+        free(xr); free(xi); free(yr); free(yi);
+        return -1;
+    }
+
+    for (int i = 0; i < seg; i++) xr[i] = c->ring[(first + i) % LAT_RING_FRAMES];
+    for (int i = 0; i < mls_len; i++) yr[i] = mls[i];
+
+    lat_fft(xr, xi, n, 0);
+    lat_fft(yr, yi, n, 0);
+    for (int i = 0; i < n; i++) {
+        // X * conj(Y)
+        float r = xr[i] * yr[i] + xi[i] * yi[i];
+        float im = xi[i] * yr[i] - xr[i] * yi[i];
+        xr[i] = r;
+        xi[i] = im;
+    }
+    lat_fft(xr, xi, n, 1);
+
+    int best = 0;
+    double energy = 0;
+    for (int i = 0; i < seg; i++) {
+        energy += xr[i] * xr[i];
+        if (fabsf(xr[i]) > fabsf(xr[best])) best = i;
+    }
+    double rms = sqrt(energy / (seg > 0 ? seg : 1));
+    *psr_out = rms > 0 ? fabs(xr[best]) / rms : 0;
+
+    // Параболическая интерполяция пика до долей отсчета
+    double frac = 0;
+    if (best > 0 && best < seg - 1) {
+        double a = fabs(xr[best - 1]), b = fabs(xr[best]), d = fabs(xr[best + 1]);
+        double den = a - 2 * b + d;
+        if (den != 0) frac = 0.5 * (a - d) / den;
+    }
+
+    double t = offset + (first + best + frac) / AUDIO_RATE;
+    free(xr); free(xi); free(yr); free(yi);
+    return *psr_out >= LAT_MIN_PSR ? t : -1;
+}
+
+// Режим --latency: N повторов, среднее и разброс
+int latency_probe(const char *play_dev, const char *capture_dev, int repeats) {
+    int mls_len = (1 << LAT_MLS_ORDER) - 1;
+    float *mls = malloc(mls_len * sizeof(float));
+    lat_capture_t *cap = calloc(1, sizeof(*cap));
+    audio_dev_t play;
+    int16_t buf[AUDIO_PERIOD * AUDIO_CHANNELS];
+    double sum = 0, sum2 = 0, lat_min = 0, lat_max = 0;
+    double play_offset = 0;
+    int found = 0;
+
+    if (!mls || !cap) {
+        free(mls);
+        free(cap);
+        return 1;
+    }
+    lat_make_mls(mls, mls_len);
+    pthread_mutex_init(&cap->lock, NULL);
+
+    if (audio_open(&play, play_dev, AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) {
+        free(mls);
+        free(cap);
+        return 1;
+    }
+    if (audio_open(&cap->dev, capture_dev, AUDIO_CAPTURE | AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) {
+        audio_close(&play);
+        free(mls);
+        free(cap);
+        return 1;
+    }
+
+    printf("%sLatency probe: play %s, capture %s, period %d, buffer %d us, %d runs%s\n",
+           BOLD, play_dev, capture_dev, AUDIO_PERIOD, audio_buffer_us, repeats, COLOR_RESET);
+
+    pthread_t th;
+    if (rt_thread_create(&th, RT_ROLE_AUDIO, lat_capture_thread, cap) != 0) {
+        printf("%sОшибка: поток захвата не создан%s\n", COLOR_RED, COLOR_RESET);
+        audio_close(&play);
+        audio_close(&cap->dev);
+        free(mls);
+        free(cap);
+        return 1;
+    }
+
+    int pregap = LAT_PREGAP_MS * AUDIO_RATE / 1000;
+    int window = LAT_MAX_MS * AUDIO_RATE / 1000;
+    int total = pregap + mls_len + window;
+
+    for (int r = 0; r < repeats && global_tx->running; r++) {
+        long marker_frame = 0;
+        long delay = 0;
+
+        for (int pos = 0; pos < total; pos += AUDIO_PERIOD) {
+            for (int i = 0; i < AUDIO_PERIOD; i++) {
+                int k = pos + i - pregap;
+                int16_t v = (k >= 0 && k < mls_len) ? (int16_t)(mls[k] * LAT_MLS_LEVEL * AUDIO_MAX) : 0;
+                for (int ch = 0; ch < AUDIO_CHANNELS; ch++) buf[i * AUDIO_CHANNELS + ch] = v;
+            }
+            // Смещение часов воспроизведения - так же, как для захвата
+            double offset = now_sec() - (double)play.frames / AUDIO_RATE;
+            if (play.frames == 0 || offset < play_offset) play_offset = offset;
+            if (pos <= pregap && pregap < pos + AUDIO_PERIOD) {
+                delay = audio_delay(&play);
+                marker_frame = play.frames + (pregap - pos);
+            }
+            if (audio_write(&play, buf, AUDIO_PERIOD) != AUDIO_PERIOD) break;
+        }
+
+        double t_inject = play_offset + (double)marker_frame / AUDIO_RATE;
+        double psr = 0;
+        double t_found = lat_find(cap, mls, mls_len, t_inject - 0.05, &psr);
+        if (t_found < 0) {
+            printf("  run %2d: %smarker not found (PSR %.1f)%s\n", r + 1, COLOR_RED, psr, COLOR_RESET);
+            continue;
+        }
+
+        double lat_ms = (t_found - t_inject) * 1000.0;
+        printf("  run %2d: %8.2f ms  (device queue %.2f ms, PSR %.0f)\n",
+               r + 1, lat_ms, delay * 1000.0 / AUDIO_RATE, psr);
+        if (found == 0 || lat_ms < lat_min) lat_min = lat_ms;
+        if (found == 0 || lat_ms > lat_max) lat_max = lat_ms;
+        sum += lat_ms;
+        sum2 += lat_ms * lat_ms;
+        found++;
+    }
+
+    cap->stop = 1;
+    pthread_join(th, NULL);
+    audio_close(&play);
+    audio_close(&cap->dev);
+
+    if (found > 0) {
+        double mean = sum / found;
+        double var = found > 1 ? (sum2 - sum * sum / found) / (found - 1) : 0;
+        printf("%sLatency: mean %.2f ms, stddev %.2f ms, min %.2f, max %.2f (%d/%d found)%s\n",
+               COLOR_GREEN, mean, sqrt(var > 0 ? var : 0), lat_min, lat_max, found, repeats, COLOR_RESET);
+    }
+
+    free(mls);
+    free(cap);
+    return found > 0 ? 0 : 2;
+}
@@ -0,0 +1,15 @@
+#ifndef FM_LATENCY_H
+#define FM_LATENCY_H
+
+// Измерение сквозной задержки: метка MLS в воспроизведение,
+// поиск ее в захвате взаимной корреляцией
+#define LAT_MLS_ORDER   12       // Длина метки 2^12 - 1 отсчетов (85 мс)
+#define LAT_MLS_LEVEL   0.1      // Амплитуда метки (-20 dBFS)
+#define LAT_PREGAP_MS   200      // Тишина перед меткой
+#define LAT_MAX_MS      1000     // Максимальная ожидаемая задержка
+#define LAT_RING_SEC    8        // Кольцевой буфер захвата
+#define LAT_MIN_PSR     8.0      // Минимальное отношение пика к фону корреляции
+
+int latency_probe(const char *play_dev, const char *capture_dev, int repeats);
+
+#endif // FM_LATENCY_H
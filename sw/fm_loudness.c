@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "fm.h"
+#include "fm_simd.h"
+#include "fm_audio.h"
+#include "fm_rt.h"
+#include "fm_loudness.h"
+
+// Полифазный FIR 4x из BS.1770-4, приложение 2 (48 отводов, 4 фазы)
+static const float loud_tp_coef[4][LOUD_TP_TAPS] = {
+    { 0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+     -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+      0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f},
+    {-0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+     -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+      0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f},
+    {-0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+     -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+      0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f},
+    {-0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+     -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+      0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f},
+};
+
+// Коэффициенты, переставленные под SIMD: [отвод от старого к новому][фаза]
+static float loud_tp_tab[LOUD_TP_TAPS][4] __attribute__((aligned(16)));
+
+static double loud_lufs(double energy) {
+    return energy > 0 ? -0.691 + 10.0 * log10(energy) : LOUD_SILENCE;
+}
+
+static double loud_db(double lin) {
+    return lin > 0 ? 20.0 * log10(lin) : LOUD_SILENCE;
+}
+
+void loudness_init(loudness_t *m, int rate, int channels) {
+    memset(m, 0, sizeof(*m));
+    m->channels = channels > 2 ? 2 : channels;
+    m->block_frames = rate * LOUD_BLOCK_MS / 1000;
+    pthread_mutex_init(&m->lock, NULL);
+
+    // K-фильтр через аналоговые прототипы - точные коэффициенты стандарта при 48 кГц
+    double f0 = 1681.974450955533, g = 3.999843853973347, q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / rate);
+    double vh = pow(10.0, g / 20.0), vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    m->kb[0][0] = (vh + vb * k / q + k * k) / a0;
+    m->kb[0][1] = 2.0 * (k * k - vh) / a0;
+    m->kb[0][2] = (vh - vb * k / q + k * k) / a0;
+    m->ka[0][1] = 2.0 * (k * k - 1.0) / a0;
+    m->ka[0][2] = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / rate);
+    a0 = 1.0 + k / q + k * k;
+    m->kb[1][0] = 1.0;
+    m->kb[1][1] = -2.0;
+    m->kb[1][2] = 1.0;
+    m->ka[1][1] = 2.0 * (k * k - 1.0) / a0;
+    m->ka[1][2] = (1.0 - k / q + k * k) / a0;
+
+    for (int t = 0; t < LOUD_TP_TAPS; t++) {
+        for (int p = 0; p < 4; p++) loud_tp_tab[t][p] = loud_tp_coef[p][LOUD_TP_TAPS - 1 - t];
+    }
+
+    m->snap.momentary = m->snap.shortterm = m->snap.integrated = LOUD_SILENCE;
+    m->snap.true_peak = m->snap.true_peak_max = LOUD_SILENCE;
+}
+
+// Максимум модуля четырех промежуточных отсчетов по окну w (от старого к новому)
+static inline float loud_tp_phases(const float *w) {
+#if FM_NEON
+    float32x4_t acc = vdupq_n_f32(0);
+    for (int t = 0; t < LOUD_TP_TAPS; t++) acc = vmlaq_n_f32(acc, vld1q_f32(loud_tp_tab[t]), w[t]);
+    float32x2_t m = vpmax_f32(vget_low_f32(vabsq_f32(acc)), vget_high_f32(vabsq_f32(acc)));
+    return vget_lane_f32(vpmax_f32(m, m), 0);
+#elif FM_SSE2
+    __m128 acc = _mm_setzero_ps();
+    for (int t = 0; t < LOUD_TP_TAPS; t++) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(loud_tp_tab[t]), _mm_set1_ps(w[t])));
+    }
+    acc = _mm_andnot_ps(_mm_set1_ps(-0.0f), acc);
+    acc = _mm_max_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    acc = _mm_max_ps(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    return _mm_cvtss_f32(acc);
+#else
+    float best = 0;
+    for (int p = 0; p < 4; p++) {
+        float acc = 0;
+        for (int t = 0; t < LOUD_TP_TAPS; t++) acc += loud_tp_tab[t][p] * w[t];
+        if (fabsf(acc) > best) best = fabsf(acc);
+    }
+    return best;
+#endif
+}
+
+// Интегральная громкость по гистограмме: абсолютный и относительный пороги
+static double loud_integrated(const loudness_t *m) {
+    double e = 0;
+    long n = 0;
+    for (int i = 0; i < LOUD_HIST_BINS; i++) {
+        e += m->hist_energy[i];
+        n += m->hist_count[i];
+    }
+    if (n == 0) return LOUD_SILENCE;
+
+    double gate = loud_lufs(e / n) + LOUD_REL_GATE;
+    int first = (int)ceil((gate - LOUD_HIST_MIN) / LOUD_HIST_STEP);
+    if (first < 0) first = 0;
+
+    e = 0;
+    n = 0;
+    for (int i = first; i < LOUD_HIST_BINS; i++) {
+        e += m->hist_energy[i];
+        n += m->hist_count[i];
+    }
+    return n > 0 ? loud_lufs(e / n) : LOUD_SILENCE;
+}
+
+// Завершение 100-мс блока
+static void loud_block_done(loudness_t *m) {
+    double energy = 0;
+    for (int ch = 0; ch < m->channels; ch++) {
+        energy += m->block_sum[ch] / m->block_frames;
+        m->block_sum[ch] = 0;
+    }
+    m->blocks[m->nblocks % LOUD_SHORT_BLOCKS] = energy;
+    m->block_tp[m->nblocks % LOUD_MOM_BLOCKS] = m->tp_block;
+    m->tp_block = 0;
+    m->nblocks++;
+
+    double mom = 0, st = 0;
+    int nm = m->nblocks < LOUD_MOM_BLOCKS ? (int)m->nblocks : LOUD_MOM_BLOCKS;
+    int ns = m->nblocks < LOUD_SHORT_BLOCKS ? (int)m->nblocks : LOUD_SHORT_BLOCKS;
+    for (int i = 0; i < ns; i++) {
+        double b = m->blocks[(m->nblocks - 1 - i) % LOUD_SHORT_BLOCKS];
+        st += b;
+        if (i < nm) mom += b;
+    }
+    mom /= nm;
+    st /= ns;
+
+    // Стробирующие блоки 400 мс с перекрытием 75% - это и есть мгновенная громкость
+    if (m->nblocks >= LOUD_MOM_BLOCKS) {
+        double l = loud_lufs(mom);
+        if (l > LOUD_ABS_GATE) {
+            int bin = (int)((l - LOUD_HIST_MIN) / LOUD_HIST_STEP);
+            if (bin >= LOUD_HIST_BINS) bin = LOUD_HIST_BINS - 1;
+            m->hist_energy[bin] += mom;
+            m->hist_count[bin]++;
+        }
+    }
+
+    float tp = 0;
+    for (int i = 0; i < nm; i++) {
+        if (m->block_tp[i] > tp) tp = m->block_tp[i];
+    }
+
+    pthread_mutex_lock(&m->lock);
+    m->snap.momentary = loud_lufs(mom);
+    m->snap.shortterm = loud_lufs(st);
+    m->snap.integrated = loud_integrated(m);
+    m->snap.true_peak = loud_db(tp);
+    if (m->snap.true_peak > m->snap.true_peak_max) m->snap.true_peak_max = m->snap.true_peak;
+    pthread_mutex_unlock(&m->lock);
+}
+
+// Обработка чередующихся S16 отсчетов
+void loudness_process(loudness_t *m, const int16_t *pcm, int frames) {
+    const int step = m->channels;
+    const double b0 = m->kb[0][0], b1 = m->kb[0][1], b2 = m->kb[0][2];
+    const double a1 = m->ka[0][1], a2 = m->ka[0][2];
+    const double c1 = m->ka[1][1], c2 = m->ka[1][2];
+
+    for (int i = 0; i < frames; i++) {
+        m->tp_pos = (m->tp_pos + 1) % LOUD_TP_TAPS;
+
+        // Каналы обрабатываются в одной итерации; биквады скалярные (зависимость по состоянию)
+        for (int ch = 0; ch < step; ch++) {
+            float xf = pcm[i * step + ch] * (1.0f / 32768.0f);
+            double x = xf;
+
+            // Ступень 1: полочный фильтр (транспонированная форма II)
+            double *z = m->z[ch][0];
+            double y = b0 * x + z[0];
+            z[0] = b1 * x - a1 * y + z[1];
+            z[1] = b2 * x - a2 * y;
+
+            // Ступень 2: ФВЧ RLB
+            z = m->z[ch][1];
+            double y2 = y + z[0];
+            z[0] = -2.0 * y - c1 * y2 + z[1];
+            z[1] = y - c2 * y2;
+
+            m->block_sum[ch] += y2 * y2;
+
+            // Истинный пик: двойная история дает непрерывное окно
+            float *h = m->tp_hist[ch];
+            h[m->tp_pos] = xf;
+            h[m->tp_pos + LOUD_TP_TAPS] = xf;
+            float tp = loud_tp_phases(h + m->tp_pos + 1);
+            if (tp > m->tp_block) m->tp_block = tp;
+        }
+
+        if (++m->block_pos == m->block_frames) {
+            m->block_pos = 0;
+            loud_block_done(m);
+        }
+    }
+}
+
+void loudness_get(loudness_t *m, loudness_snapshot_t *out) {
+    pthread_mutex_lock(&m->lock);
+    *out = m->snap;
+    pthread_mutex_unlock(&m->lock);
+}
+
+static void *loud_thread(void *arg) {
+    loudness_t *m = arg;
+    audio_dev_t dev;
+    int16_t buf[AUDIO_PERIOD * AUDIO_CHANNELS];
+
+    if (audio_open(&dev, m->device, AUDIO_CAPTURE | AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) return NULL;
+    while (!m->stop) {
+        if (audio_read(&dev, buf, AUDIO_PERIOD) != AUDIO_PERIOD) break;
+        loudness_process(m, buf, AUDIO_PERIOD);
+        if (m->phase) phase_process(m->phase, buf, AUDIO_PERIOD);
+    }
+    audio_close(&dev);
+    return NULL;
+}
+
+// Фоновое измерение с устройства захвата (петля, FIFO с PCM плеера)
+// Коррелометр, заданный до запуска (m->phase), получает тот же PCM
+int loudness_start(loudness_t *m, const char *capture_dev) {
+    phase_meter_t *phase = m->phase;
+    loudness_init(m, AUDIO_RATE, AUDIO_CHANNELS);
+    m->phase = phase;
+    m->device = capture_dev;
+    return rt_thread_create(&m->thread, RT_ROLE_SAMPLER, loud_thread, m);
+}
+
+void loudness_stop(loudness_t *m) {
+    m->stop = 1;
+    pthread_join(m->thread, NULL);
+}
+
+// Режим --loudness: измерение файла или потока до конца, максимально быстро
+int loudness_analyze(const char *capture_dev) {
+    loudness_t *m = malloc(sizeof(*m));
+    phase_meter_t *ph = malloc(sizeof(*ph));
+    phase_snapshot_t phs = {0};
+    double corr_min = 1.0;
+    audio_dev_t dev;
+    int16_t buf[AUDIO_PERIOD * AUDIO_CHANNELS];
+    double mom_max = LOUD_SILENCE, st_max = LOUD_SILENCE;
+    long frames = 0;
+    int n;
+
+    if (!m || !ph) {
+        free(m);
+        free(ph);
+        return 1;
+    }
+    loudness_init(m, AUDIO_RATE, AUDIO_CHANNELS);
+    phase_init(ph, AUDIO_RATE);
+    if (audio_open(&dev, capture_dev, AUDIO_CAPTURE, AUDIO_RATE, AUDIO_CHANNELS) != 0) {
+        free(m);
+        free(ph);
+        return 1;
+    }
+
+    while ((n = audio_read(&dev, buf, AUDIO_PERIOD)) > 0) {
+        long before = m->nblocks;
+        loudness_process(m, buf, n);
+        phase_process(ph, buf, n);
+        frames += n;
+        if (m->nblocks != before) {
+            if (m->nblocks >= LOUD_MOM_BLOCKS && m->snap.momentary > mom_max) mom_max = m->snap.momentary;
+            if (m->nblocks >= LOUD_SHORT_BLOCKS && m->snap.shortterm > st_max) st_max = m->snap.shortterm;
+        }
+        // Минимум по полному окну корреляции, без тишины
+        phase_get(ph, &phs);
+        if (ph->nblocks >= PHASE_WIN_BLOCKS && !phs.silent && phs.corr < corr_min) corr_min = phs.corr;
+    }
+    audio_close(&dev);
+
+    printf("Duration:        %.1f s\n", (double)frames / AUDIO_RATE);
+    printf("Integrated:      %.1f LUFS\n", m->snap.integrated);
+    printf("Momentary max:   %.1f LUFS\n", mom_max);
+    printf("Short-term max:  %.1f LUFS\n", st_max);
+    printf("True peak max:   %.1f dBTP\n", m->snap.true_peak_max);
+    // Короче одного блока - корреляции нет
+    if (ph->nblocks > 0) {
+        printf("Correlation:     %+.2f, min %+.2f over %d ms\n", phs.corr_total, corr_min, PHASE_WIN_BLOCKS * PHASE_BLOCK_MS);
+    }
+    free(m);
+    free(ph);
+    return 0;
+}
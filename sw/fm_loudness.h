@@ -0,0 +1,71 @@
+#ifndef FM_LOUDNESS_H
+#define FM_LOUDNESS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "fm_phase.h"
+
+// Громкость по ITU-R BS.1770 (LUFS) и истинный пик с 4x передискретизацией
+#define LOUD_BLOCK_MS     100      // Шаг измерения
+#define LOUD_SHORT_BLOCKS 30       // Кратковременная: 3 с
+#define LOUD_MOM_BLOCKS   4        // Мгновенная: 400 мс
+#define LOUD_ABS_GATE     (-70.0)  // Абсолютный порог для интегральной
+#define LOUD_REL_GATE     (-10.0)  // Относительный порог, LU
+#define LOUD_HIST_MIN     (-70.0)  // Гистограмма блоков для интегральной громкости
+#define LOUD_HIST_STEP    0.1
+#define LOUD_HIST_BINS    800
+#define LOUD_TP_TAPS      12       // Отводов на фазу FIR истинного пика
+#define LOUD_SILENCE      (-100.0)
+
+typedef struct {
+    double momentary;        // LUFS, 400 мс
+    double shortterm;        // LUFS, 3 с
+    double integrated;       // LUFS, с порогами
+    double true_peak;        // dBTP, максимум за последние 400 мс
+    double true_peak_max;    // dBTP, максимум с начала измерения
+} loudness_snapshot_t;
+
+typedef struct {
+    int channels;
+    int block_frames;
+    // K-фильтр: полочный фильтр и ФВЧ RLB, состояние по каналам
+    double kb[2][3];
+    double ka[2][3];
+    double z[2][2][2];
+    // Текущий блок
+    double block_sum[2];
+    int block_pos;
+    // Энергии последних блоков
+    double blocks[LOUD_SHORT_BLOCKS];
+    float block_tp[LOUD_MOM_BLOCKS];
+    long nblocks;
+    // Гистограмма 400-мс блоков для стробирования
+    double hist_energy[LOUD_HIST_BINS];
+    long hist_count[LOUD_HIST_BINS];
+    // История для полифазного FIR
+    float tp_hist[2][LOUD_TP_TAPS * 2];
+    int tp_pos;
+    float tp_block;
+    // Публикуемые значения
+    loudness_snapshot_t snap;
+    pthread_mutex_t lock;
+    // Фазовый коррелометр на том же PCM или NULL
+    phase_meter_t *phase;
+    // Поток измерения
+    pthread_t thread;
+    const char *device;
+    volatile int stop;
+} loudness_t;
+
+// Измеритель для интерфейса (fm.c), NULL без --meter
+extern loudness_t *tui_loudness;
+
+void loudness_init(loudness_t *m, int rate, int channels);
+void loudness_process(loudness_t *m, const int16_t *pcm, int frames);
+void loudness_get(loudness_t *m, loudness_snapshot_t *out);
+int loudness_start(loudness_t *m, const char *capture_dev);
+void loudness_stop(loudness_t *m);
+int loudness_analyze(const char *capture_dev);
+
+#endif // FM_LOUDNESS_H
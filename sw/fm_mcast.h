@@ -0,0 +1,53 @@
+#ifndef FM_MCAST_H
+#define FM_MCAST_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <netinet/in.h>
+
+#include "fm.h"
+
+// Рассылка показаний индикаторов по UDP multicast для мониторной стены
+#define MCAST_ADDR        "239.255.70.77:5077"
+#define MCAST_MAGIC       0x464D4D54   // "FMMT"
+#define MCAST_VERSION     1
+#define MCAST_RATE        10           // Пакетов в секунду по умолчанию
+#define MCAST_SAMPLE_HZ   100          // Опрос регистров; в пакет идет максимум за интервал
+#define MCAST_TTL         1
+#define MCAST_BATCH       64           // Пакетов на один recvmmsg/sendmmsg
+#define MCAST_MAX_SENDERS 2048
+#define MCAST_DRAW_MS     500          // Период перерисовки сводки
+#define MCAST_STALE_INTERVALS 3        // Передатчик пропал после 3 интервалов + 1 с
+
+// Пакет 24 байта, все поля в сетевом порядке байт
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t ctrl;          // Биты REG_CTRL 0-5
+    uint16_t freq;         // МГц * 100
+    uint32_t id;           // Идентификатор платы
+    uint32_t seq;          // Номер пакета
+    uint16_t peak_l;       // Пик за интервал, 0..32767
+    uint16_t peak_r;
+    uint16_t mpx;          // Пик девиации за интервал, кГц * 100
+    uint16_t interval_ms;  // Период отправки
+} mcast_pkt_t;
+
+typedef struct {
+    fm_transmitter_t *tx;
+    struct sockaddr_in dst;
+    int fd;
+    int rate;
+    uint32_t id;
+    pthread_t thread;
+    volatile int stop;
+} mcast_sender_t;
+
+int mcast_parse_addr(const char *s, struct sockaddr_in *sa);
+uint32_t mcast_default_id(void);
+int mcast_sender_start(mcast_sender_t *s, fm_transmitter_t *tx, const char *addr, int rate, uint32_t id);
+void mcast_sender_stop(mcast_sender_t *s);
+int mcast_monitor(const char *addr);
+int mcast_test(const char *addr, int senders, double loss, int rate);
+
+#endif // FM_MCAST_H
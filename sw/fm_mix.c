@@ -0,0 +1,476 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "fm.h"
+#include "fm_simd.h"
+#include "fm_rt.h"
+#include "fm_mix.h"
+
+// Векторный тип GCC (NEON/SSE), пара стерео кадров на вектор
+typedef float v4f __attribute__((vector_size(16)));
+
+#define MIX_P AUDIO_PERIOD
+
+static const volatile int *mix_stop_flag;
+
+static double mix_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double mix_cpu_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int mix_find(mix_t *m, const char *name) {
+    for (int i = 0; i < m->ninputs; i++) {
+        if (strcmp(m->inputs[i].name, name) == 0) return i;
+    }
+    printf("%sОшибка: нет входа %s%s\n", COLOR_RED, name, COLOR_RESET);
+    return -1;
+}
+
+// "NAME=DEV[,gain=DB][,prio=N][,duck=DB]"; DEV - устройство fm_audio или tone:HZ.
+// Запятые внутри имени ALSA (hw:0,0) сохраняются
+int mix_add_input(mix_t *m, const char *spec) {
+    char buf[256], dev[128] = "";
+    const char *eq = strchr(spec, '=');
+
+    if (!eq || eq == spec || m->ninputs == MIX_MAX_INPUTS) {
+        printf("%sОшибка: вход %s (NAME=DEV, не больше %d)%s\n", COLOR_RED, spec, MIX_MAX_INPUTS, COLOR_RESET);
+        return -1;
+    }
+    mix_input_t *in = &m->inputs[m->ninputs];
+    memset(in, 0, sizeof(*in));
+    snprintf(in->name, sizeof(in->name), "%.*s", (int)(eq - spec), spec);
+    in->duck_db = MIX_DUCK_DB;
+    in->gain = in->gain_target = 1.0f;
+    in->duck = 1.0f;
+
+    snprintf(buf, sizeof(buf), "%s", eq + 1);
+    char *save, *tok;
+    for (tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (strncmp(tok, "gain=", 5) == 0) in->gain = in->gain_target = powf(10.0f, atof(tok + 5) / 20.0f);
+        else if (strncmp(tok, "prio=", 5) == 0) in->prio = atoi(tok + 5);
+        else if (strncmp(tok, "duck=", 5) == 0) in->duck_db = atof(tok + 5);
+        else {
+            size_t len = strlen(dev);
+            snprintf(dev + len, sizeof(dev) - len, "%s%s", len ? "," : "", tok);
+        }
+    }
+    if (strncmp(dev, "tone:", 5) == 0) {
+        in->tone_hz = atoi(dev + 5);
+    } else {
+        snprintf(in->next_dev, sizeof(in->next_dev), "%s", dev);
+        in->next_seq = 1;
+    }
+
+    // В эфире сразу: первый программный вход и все приоритетные
+    int program_on = 0;
+    for (int i = 0; i < m->ninputs; i++) program_on |= m->inputs[i].prio == 0;
+    in->pos = in->pos_target = (in->prio > 0 || !program_on) ? 1.0f : 0.0f;
+    m->ninputs++;
+    return 0;
+}
+
+static int mix_cmd_push(mix_t *m, const mix_cmd_t *c) {
+    uint32_t head = m->cmd_head;
+    if (head - __atomic_load_n(&m->cmd_tail, __ATOMIC_ACQUIRE) >= MIX_CMDQ) return -1;
+    m->cmdq[head & (MIX_CMDQ - 1)] = *c;
+    __atomic_store_n(&m->cmd_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void mix_fade(mix_input_t *in, float target, int frames) {
+    in->pos_target = target;
+    in->pos_step = frames > 0 ? 1.0f / frames : 1.0f;
+}
+
+// Команды применяются в начале периода; оба конца перехода стартуют с одного отсчета
+static void mix_apply(mix_t *m, const mix_cmd_t *c) {
+    mix_input_t *in = &m->inputs[c->input];
+
+    switch (c->type) {
+        case MIX_CMD_GAIN:
+            in->gain_target = powf(10.0f, c->value / 20.0f);
+            break;
+        case MIX_CMD_FADE:
+            mix_fade(in, c->value, c->frames);
+            break;
+        case MIX_CMD_SWITCH:
+            for (int i = 0; i < m->ninputs; i++) {
+                if (m->inputs[i].prio == 0) mix_fade(&m->inputs[i], i == c->input ? 1.0f : 0.0f, c->frames);
+            }
+            break;
+    }
+    if (c->type != MIX_CMD_GAIN) {
+        // До первого отсчета в миксе плюс то, что уже лежит в буфере устройства
+        double ms = (mix_now() - c->stamp) * 1000.0 + audio_delay(&m->out) * 1000.0 / AUDIO_RATE;
+        m->switch_last_ms = ms;
+        if (ms > m->switch_max_ms) m->switch_max_ms = ms;
+        m->switches++;
+    }
+}
+
+// Вход: кольцо или генератор -> m->tmp (float, стерео)
+static void mix_pull(mix_t *m, mix_input_t *in) {
+    float *x = m->tmp;
+
+    if (in->tone_hz > 0) {
+        double step = 2.0 * M_PI * in->tone_hz / AUDIO_RATE;
+        for (int f = 0; f < MIX_P; f++) {
+            float v = 0.125f * (float)sin(in->tone_phase);
+            x[2 * f] = x[2 * f + 1] = v;
+            in->tone_phase += step;
+        }
+        in->tone_phase = fmod(in->tone_phase, 2.0 * M_PI);
+        return;
+    }
+
+    uint32_t tail = in->ring.tail;
+    uint32_t avail = __atomic_load_n(&in->ring.head, __ATOMIC_ACQUIRE) - tail;
+    int n = avail < MIX_P ? (int)avail : MIX_P;
+    for (int f = 0; f < n; f++) {
+        const int16_t *s = &in->ring.buf[((tail + f) & (MIX_RING_FRAMES - 1)) * 2];
+        x[2 * f] = s[0] * (1.0f / 32768.0f);
+        x[2 * f + 1] = s[1] * (1.0f / 32768.0f);
+    }
+    __atomic_store_n(&in->ring.tail, tail + n, __ATOMIC_RELEASE);
+    if (n < MIX_P) {
+        memset(x + 2 * n, 0, (MIX_P - n) * 2 * sizeof(float));
+        // Пустое кольцо приоритетного входа - это просто тишина между объявлениями
+        if (in->prio == 0 && in->pos > 0 && !in->eof) in->underruns++;
+    }
+}
+
+static float mix_peak(const float *x) {
+    float p = 0;
+    for (int i = 0; i < MIX_P * 2; i++) p = fmaxf(p, fabsf(x[i]));
+    return p;
+}
+
+void mix_period(mix_t *m, int16_t *out) {
+    const float att = 1.0f - expf(-(float)MIX_P / (MIX_DUCK_ATTACK * AUDIO_RATE));
+    const float rel = 1.0f - expf(-(float)MIX_P / (MIX_DUCK_RELEASE * AUDIO_RATE));
+    const float key_rel = 1.0f - expf(-(float)MIX_P / (MIX_KEY_RELEASE * AUDIO_RATE));
+    const float thr = powf(10.0f, MIX_DUCK_THRESHOLD / 20.0f);
+    static float in_buf[MIX_MAX_INPUTS][MIX_P * 2] __attribute__((aligned(16)));
+    double cpu[MIX_MAX_INPUTS];
+
+    uint32_t head = __atomic_load_n(&m->cmd_head, __ATOMIC_ACQUIRE);
+    while (m->cmd_tail != head) {
+        mix_apply(m, &m->cmdq[m->cmd_tail & (MIX_CMDQ - 1)]);
+        __atomic_store_n(&m->cmd_tail, m->cmd_tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // Сначала все входы: огибающие ключей нужны до расчета приглушения
+    for (int i = 0; i < m->ninputs; i++) {
+        mix_input_t *in = &m->inputs[i];
+        double t0 = mix_cpu_now();
+        mix_pull(m, in);
+        memcpy(in_buf[i], m->tmp, sizeof(in_buf[i]));
+        if (in->prio > 0) {
+            float p = mix_peak(in_buf[i]) * in->gain * m->curve[(int)(in->pos * MIX_CURVE_N)];
+            in->key_env = p > in->key_env ? p : in->key_env * (1.0f - key_rel);
+        }
+        cpu[i] = mix_cpu_now() - t0;
+    }
+
+    memset(m->acc, 0, MIX_P * 2 * sizeof(float));
+    for (int i = 0; i < m->ninputs; i++) {
+        mix_input_t *in = &m->inputs[i];
+        double t0 = mix_cpu_now();
+
+        // Приглушение от приоритетных входов выше этого
+        float duck_db = 0;
+        for (int k = 0; k < m->ninputs; k++) {
+            const mix_input_t *key = &m->inputs[k];
+            if (key->prio > in->prio && key->key_env > thr && key->duck_db < duck_db) duck_db = key->duck_db;
+        }
+        float duck_target = powf(10.0f, duck_db / 20.0f);
+        float duck_new = in->duck + (duck_target < in->duck ? att : rel) * (duck_target - in->duck);
+
+        // Усиление по отсчетам: громкость и приглушение линейно за период, кривая перехода точно
+        float g0 = in->gain * in->duck, g1 = in->gain_target * duck_new;
+        float gs = (g1 - g0) / MIX_P;
+        float pos = in->pos;
+        for (int f = 0; f < MIX_P; f++) {
+            if (pos < in->pos_target) pos = fminf(pos + in->pos_step, in->pos_target);
+            else if (pos > in->pos_target) pos = fmaxf(pos - in->pos_step, in->pos_target);
+            float idx = pos * MIX_CURVE_N;
+            int k = (int)idx;
+            float c = k >= MIX_CURVE_N ? m->curve[MIX_CURVE_N]
+                                       : m->curve[k] + (idx - k) * (m->curve[k + 1] - m->curve[k]);
+            m->gain[f] = (g0 + gs * (f + 1)) * c;
+        }
+        in->pos = pos;
+        in->gain = in->gain_target;
+        in->duck = duck_new;
+
+        if (pos > 0 || in->pos_target > 0) {
+            const v4f *x = (const v4f *)in_buf[i];
+            v4f *acc = (v4f *)m->acc;
+            for (int f = 0; f < MIX_P / 2; f++) {
+                v4f g = {m->gain[2 * f], m->gain[2 * f], m->gain[2 * f + 1], m->gain[2 * f + 1]};
+                acc[f] += x[f] * g;
+            }
+        }
+        in->cpu += cpu[i] + mix_cpu_now() - t0;
+    }
+
+    pcm_f32_to_s16(&m->conv, m->acc, out, MIX_P * 2, 2);
+    m->periods++;
+}
+
+void mix_stats(mix_t *m) {
+    double audio_sec = (double)m->periods * MIX_P / AUDIO_RATE;
+    double period_us = MIX_P * 1e6 / AUDIO_RATE;
+
+    printf("%sMixer (%s): %.1f s of audio, %ld switches, last %.2f ms, max %.2f ms command to mix%s\n",
+           BOLD, FM_SIMD_NAME, audio_sec, m->switches, m->switch_last_ms, m->switch_max_ms, COLOR_RESET);
+    printf("%-12s %4s %6s %8s %8s %8s %9s %12s %7s\n",
+           "INPUT", "PRIO", "POS", "GAIN dB", "DUCK dB", "RING ms", "UNDERRUN", "CPU us/per", "CPU");
+    for (int i = 0; i < m->ninputs; i++) {
+        mix_input_t *in = &m->inputs[i];
+        uint32_t fill = in->ring.head - in->ring.tail;
+        double us = m->periods ? in->cpu / m->periods * 1e6 : 0;
+        printf("%-12s %4d %6.2f %8.1f %8.1f %8.1f %9ld %12.2f %6.3f%%\n",
+               in->name, in->prio, in->pos, 20.0 * log10(in->gain + 1e-9), 20.0 * log10(in->duck + 1e-9),
+               in->tone_hz ? 0.0 : fill * 1000.0 / AUDIO_RATE, in->underruns, us, us / period_us * 100.0);
+    }
+    fflush(stdout);
+}
+
+// "switch NAME [MS]", "on|off NAME [MS]", "gain NAME DB", "play NAME DEV", "stats"
+int mix_command(mix_t *m, const char *line) {
+    char verb[16] = "", name[32] = "", arg[128] = "";
+    mix_cmd_t c = {0};
+    int n = sscanf(line, "%15s %31s %127s", verb, name, arg);
+
+    if (n < 1) return 0;
+    if (strcmp(verb, "stats") == 0) {
+        mix_stats(m);
+        return 0;
+    }
+    if (n < 2 || (c.input = mix_find(m, name)) < 0) {
+        if (n < 2) printf("%sUsage: switch|on|off NAME [MS], gain NAME DB, play NAME DEV, stats%s\n", COLOR_RED, COLOR_RESET);
+        return -1;
+    }
+    mix_input_t *in = &m->inputs[c.input];
+    c.frames = (int)((n > 2 ? atof(arg) : MIX_FADE_MS) * AUDIO_RATE / 1000.0);
+    c.stamp = mix_now();
+
+    if (strcmp(verb, "switch") == 0) {
+        if (in->prio > 0) {
+            printf("%sОшибка: %s - приоритетный вход%s\n", COLOR_RED, name, COLOR_RESET);
+            return -1;
+        }
+        c.type = MIX_CMD_SWITCH;
+    } else if (strcmp(verb, "on") == 0 || strcmp(verb, "off") == 0) {
+        c.type = MIX_CMD_FADE;
+        c.value = verb[1] == 'n' ? 1.0f : 0.0f;
+    } else if (strcmp(verb, "gain") == 0 && n > 2) {
+        c.type = MIX_CMD_GAIN;
+        c.value = atof(arg);
+    } else if (strcmp(verb, "play") == 0 && n > 2) {
+        // Смена источника делается самим производителем: у кольца всегда один писатель
+        if (in->tone_hz) return -1;
+        snprintf(in->next_dev, sizeof(in->next_dev), "%s", arg);
+        __sync_synchronize();
+        in->next_seq++;
+        return 0;
+    } else {
+        printf("%sUnknown mixer command: %s%s\n", COLOR_RED, line, COLOR_RESET);
+        return -1;
+    }
+
+    if (mix_cmd_push(m, &c) != 0) {
+        printf("%sОшибка: очередь команд полна%s\n", COLOR_RED, COLOR_RESET);
+        return -1;
+    }
+    return 0;
+}
+
+// Производитель: читает устройство в кольцо, ждет места; смена устройства по next_seq
+static void *mix_producer(void *arg) {
+    mix_input_t *in = arg;
+    int16_t buf[MIX_P * 2];
+    audio_dev_t dev;
+    int opened = 0, seq = 0;
+
+    while (!*mix_stop_flag) {
+        if (in->next_seq != seq) {
+            if (opened) audio_close(&dev);
+            seq = in->next_seq;
+            __sync_synchronize();
+            opened = audio_open(&dev, in->next_dev, AUDIO_CAPTURE, AUDIO_RATE, AUDIO_CHANNELS) == 0;
+            in->eof = !opened;
+        }
+        if (!opened) {
+            usleep(10000);
+            continue;
+        }
+        uint32_t head = in->ring.head;
+        if (MIX_RING_FRAMES - (head - __atomic_load_n(&in->ring.tail, __ATOMIC_ACQUIRE)) < MIX_P) {
+            usleep(2000);
+            continue;
+        }
+        int n = audio_read(&dev, buf, MIX_P);
+        if (n <= 0) {
+            audio_close(&dev);
+            opened = 0;
+            in->eof = 1;
+            continue;
+        }
+        for (int f = 0; f < n; f++) {
+            int16_t *d = &in->ring.buf[((head + f) & (MIX_RING_FRAMES - 1)) * 2];
+            d[0] = buf[2 * f];
+            d[1] = buf[2 * f + 1];
+        }
+        __atomic_store_n(&in->ring.head, head + n, __ATOMIC_RELEASE);
+    }
+    if (opened) audio_close(&dev);
+    return NULL;
+}
+
+// Управление: строки из FIFO (для скриптов) и с терминала
+static void *mix_control(void *arg) {
+    mix_t *m = arg;
+    char line[256], buf[256];
+    int len = 0;
+
+    if (mkfifo(MIX_CTL_FIFO, 0666) != 0 && errno != EEXIST) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, MIX_CTL_FIFO, strerror(errno), COLOR_RESET);
+    }
+    // O_RDWR: FIFO не отдает EOF, когда пишущий скрипт закрывается
+    int fd = open(MIX_CTL_FIFO, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    struct pollfd pfd[2] = {{fd, POLLIN, 0}, {isatty(STDIN_FILENO) ? STDIN_FILENO : -1, POLLIN, 0}};
+
+    while (!m->stop) {
+        if (poll(pfd, 2, 200) <= 0) continue;
+        if (pfd[1].revents & POLLIN) {
+            ssize_t r = read(STDIN_FILENO, line, sizeof(line) - 1);
+            if (r > 0) {
+                line[r] = '\0';
+                line[strcspn(line, "\n")] = '\0';
+                mix_command(m, line);
+            }
+        }
+        if (pfd[0].revents & POLLIN) {
+            ssize_t r = read(fd, buf + len, sizeof(buf) - 1 - len);
+            if (r <= 0) continue;
+            len += r;
+            buf[len] = '\0';
+            char *start = buf, *nl;
+            while ((nl = strchr(start, '\n'))) {
+                *nl = '\0';
+                mix_command(m, start);
+                start = nl + 1;
+            }
+            len -= start - buf;
+            memmove(buf, start, len);
+            if (len >= (int)sizeof(buf) - 1) len = 0;
+        }
+    }
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+static int mix_init(mix_t *m, pcm_dither_t dither) {
+    for (int k = 0; k <= MIX_CURVE_N; k++) m->curve[k] = sinf((float)k / MIX_CURVE_N * (float)M_PI / 2.0f);
+    m->acc = aligned_alloc(16, MIX_P * 2 * sizeof(float));
+    m->tmp = aligned_alloc(16, MIX_P * 2 * sizeof(float));
+    m->gain = aligned_alloc(16, MIX_P * sizeof(float));
+    if (!m->acc || !m->tmp || !m->gain) return -1;
+    pcm_conv_init(&m->conv, dither);
+    m->out.fd = -1;
+    mix_stop_flag = &m->stop;
+    return 0;
+}
+
+// Режим --mix: входы -> микшер -> устройство воспроизведения
+int mix_main(mix_t *m, pcm_dither_t dither, const char *play_dev) {
+    int16_t out[MIX_P * 2];
+    pthread_t ctl;
+
+    if (m->ninputs == 0) {
+        printf("%sОшибка: нет входов (--input NAME=DEV)%s\n", COLOR_RED, COLOR_RESET);
+        return 1;
+    }
+    if (mix_init(m, dither) != 0) return 1;
+    if (audio_open(&m->out, play_dev, AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) return 1;
+
+    for (int i = 0; i < m->ninputs; i++) {
+        mix_input_t *in = &m->inputs[i];
+        if (in->tone_hz) continue;
+        in->has_thread = rt_thread_create(&in->thread, RT_ROLE_CONTROL, mix_producer, in) == 0;
+    }
+    int has_ctl = rt_thread_create(&ctl, RT_ROLE_CONTROL, mix_control, m) == 0;
+    if (!has_ctl) printf("%sОшибка: поток управления не создан, команды не принимаются%s\n", COLOR_RED, COLOR_RESET);
+    if (rt_enabled) rt_set_current(RT_ROLE_AUDIO);
+
+    printf("Mixing %d inputs to %s; commands on %s\n", m->ninputs, play_dev, MIX_CTL_FIFO);
+    fflush(stdout);
+    while (global_tx->running) {
+        mix_period(m, out);
+        if (audio_write(&m->out, out, MIX_P) < 0) break;
+    }
+
+    m->stop = 1;
+    if (has_ctl) pthread_join(ctl, NULL);
+    mix_stats(m);
+    audio_close(&m->out);
+    // Производитель может ждать данных в FIFO - не ждем его
+    for (int i = 0; i < m->ninputs; i++) {
+        if (m->inputs[i].has_thread) pthread_detach(m->inputs[i].thread);
+    }
+    return 0;
+}
+
+// Режим --mix-bench: N внутренних генераторов, переходы каждые 0.5 с, без устройства
+int mix_bench(int inputs, int seconds) {
+    static mix_t m;
+    int16_t out[MIX_P * 2];
+    char spec[64];
+
+    if (inputs < 1 || inputs > MIX_MAX_INPUTS) {
+        printf("%sОшибка: входов от 1 до %d%s\n", COLOR_RED, MIX_MAX_INPUTS, COLOR_RESET);
+        return 1;
+    }
+    for (int i = 0; i < inputs; i++) {
+        // Последний вход - приоритетный, чтобы работал и путь приглушения
+        snprintf(spec, sizeof(spec), "in%d=tone:%d%s", i, 220 * (i + 1), i == inputs - 1 && inputs > 1 ? ",prio=1" : "");
+        mix_add_input(&m, spec);
+    }
+    if (mix_init(&m, DITHER_TPDF) != 0) return 1;
+
+    long periods = (long)seconds * AUDIO_RATE / MIX_P, every = AUDIO_RATE / 2 / MIX_P;
+    int program = inputs > 1 ? inputs - 1 : 1, next = 0;
+    double t0 = mix_cpu_now();
+    for (long p = 0; p < periods && global_tx->running; p++) {
+        if (p % every == 0) {
+            snprintf(spec, sizeof(spec), "switch in%d 100", next);
+            mix_command(&m, spec);
+            next = (next + 1) % program;
+        }
+        mix_period(&m, out);
+    }
+    double cpu = mix_cpu_now() - t0;
+
+    mix_stats(&m);
+    printf("Total %.3f s CPU for %.1f s of audio (%.2f%% of one core)\n",
+           cpu, (double)periods * MIX_P / AUDIO_RATE, cpu / ((double)periods * MIX_P / AUDIO_RATE) * 100.0);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#ifndef FM_MIX_H
+#define FM_MIX_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_pcm.h"
+
+// Микшер источников перед i2s_transmitter: плавные переходы, приглушение, вставки
+#define MIX_MAX_INPUTS     8
+#define MIX_RING_FRAMES    16384          // Кольцо входа, кадров (степень двойки, ~340 мс)
+#define MIX_CMDQ           64             // Очередь команд управления (степень двойки)
+#define MIX_CTL_FIFO       "/tmp/fm_mix.ctl"
+#define MIX_FADE_MS        1000           // Длительность перехода по умолчанию
+#define MIX_DUCK_DB        (-15.0)        // Приглушение по умолчанию для приоритетных входов
+#define MIX_DUCK_THRESHOLD (-40.0)        // Уровень ключа, dBFS, выше которого включается приглушение
+#define MIX_DUCK_ATTACK    0.020          // с
+#define MIX_DUCK_RELEASE   0.500          // с
+#define MIX_KEY_RELEASE    0.050          // Спад огибающей ключа, с (паузы между словами)
+#define MIX_CURVE_N        1024           // Таблица равномощной кривой перехода
+
+// Кольцо одного производителя и одного потребителя, без блокировок
+typedef struct {
+    int16_t buf[MIX_RING_FRAMES * 2];
+    volatile uint32_t head;               // Пишет производитель
+    volatile uint32_t tail;               // Пишет микшер
+} mix_ring_t;
+
+typedef enum {
+    MIX_CMD_GAIN = 0,
+    MIX_CMD_FADE,        // Плавно включить/выключить один вход
+    MIX_CMD_SWITCH,      // Переход: все программные входы выключаются, выбранный включается
+} mix_cmd_type_t;
+
+typedef struct {
+    mix_cmd_type_t type;
+    int input;
+    float value;         // dB для GAIN, 0/1 для FADE
+    int frames;          // Длительность перехода
+    double stamp;        // Время приема команды (CLOCK_MONOTONIC)
+} mix_cmd_t;
+
+typedef struct {
+    char name[32];
+    int prio;                             // > 0 - приоритетный вход, ключ приглушения
+    float duck_db;
+    int tone_hz;                          // Внутренний генератор вместо кольца
+    double tone_phase;
+    // Состояние микшера (меняет только поток микшера)
+    float gain, gain_target;
+    float pos, pos_step, pos_target;      // Положение на кривой перехода 0..1
+    float duck;                           // Текущее усиление приглушения
+    float key_env;                        // Огибающая как ключа
+    long underruns;
+    double cpu;
+    // Производитель
+    mix_ring_t ring;
+    pthread_t thread;
+    int has_thread;
+    char next_dev[128];
+    volatile int next_seq;
+    volatile int eof;
+} mix_input_t;
+
+typedef struct {
+    mix_input_t inputs[MIX_MAX_INPUTS];
+    int ninputs;
+    mix_cmd_t cmdq[MIX_CMDQ];
+    volatile uint32_t cmd_head, cmd_tail;
+    float curve[MIX_CURVE_N + 1];
+    float *acc, *tmp, *gain;               // Рабочие буферы периода
+    pcm_conv_t conv;
+    audio_dev_t out;
+    long periods;
+    double switch_last_ms, switch_max_ms;  // Команда -> первый отсчет перехода в миксе
+    long switches;
+    volatile int stop;
+} mix_t;
+
+int mix_add_input(mix_t *m, const char *spec);
+int mix_command(mix_t *m, const char *line);
+void mix_period(mix_t *m, int16_t *out);
+void mix_stats(mix_t *m);
+int mix_main(mix_t *m, pcm_dither_t dither, const char *play_dev);
+int mix_bench(int inputs, int seconds);
+
+#endif // FM_MIX_H
@@ -0,0 +1,51 @@
+#ifndef FM_PCM_H
+#define FM_PCM_H
+
+#include <stdint.h>
+
+// Преобразование форматов в S16 для 16-битного I2S передатчика
+typedef enum {
+    PCM_FMT_S16 = 0,
+    PCM_FMT_S24,       // S24_LE в 32-битном контейнере
+    PCM_FMT_S32,
+    PCM_FMT_F32
+} pcm_format_t;
+
+typedef enum {
+    DITHER_NONE = 0,
+    DITHER_TPDF,       // Треугольный дизеринг +-1 LSB
+    DITHER_SHAPED      // TPDF + формирование шума за пределы 15 кГц
+} pcm_dither_t;
+
+#define PCM_LANES 4            // Независимых генераторов дизеринга (ширина SIMD)
+#define PCM_SHAPE_ORDER 4      // Порядок фильтра формирования шума
+#define PCM_MAX_CHANNELS 8
+
+typedef struct {
+    pcm_dither_t dither;
+    uint32_t rng[PCM_LANES];                          // xorshift32 по дорожкам
+    float err[PCM_MAX_CHANNELS][PCM_SHAPE_ORDER];     // История ошибки квантования
+} pcm_conv_t;
+
+void pcm_conv_init(pcm_conv_t *c, pcm_dither_t dither);
+int pcm_format_size(pcm_format_t fmt);
+int pcm_parse_format(const char *name, pcm_format_t *fmt);
+int pcm_parse_dither(const char *name, pcm_dither_t *dither);
+
+// Быстрые ядра (NEON / SSE2 / скалярный запасной вариант)
+void pcm_f32_to_s16(pcm_conv_t *c, const float *src, int16_t *dst, int n, int channels);
+void pcm_s32_to_f32(const int32_t *src, float *dst, int n, int shift);
+void pcm_s32_to_s16(const int32_t *src, int16_t *dst, int n, int shift);
+void pcm_interleave2_s16(const int16_t *l, const int16_t *r, int16_t *dst, int frames);
+void pcm_convert(pcm_conv_t *c, pcm_format_t fmt, const void *src, int16_t *dst,
+                 float *scratch, int n, int channels);
+
+// Скалярные эталоны для побитовой проверки
+void pcm_f32_to_s16_ref(pcm_conv_t *c, const float *src, int16_t *dst, int n, int channels);
+void pcm_s32_to_s16_ref(const int32_t *src, int16_t *dst, int n, int shift);
+void pcm_interleave2_s16_ref(const int16_t *l, const int16_t *r, int16_t *dst, int frames);
+
+int pcm_pipe(pcm_format_t fmt, pcm_dither_t dither, const char *play_dev);
+int pcm_bench(void);
+
+#endif // FM_PCM_H
@@ -0,0 +1,291 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "fm.h"
+#include "fm_simd.h"
+#include "fm_audio.h"
+#include "fm_phase.h"
+
+#define PHASE_BENCH_S   10           // Секунд PCM в замере скорости
+
+phase_meter_t *phase_meter = NULL;
+
+static double phase_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double phase_db(double energy) {
+    return energy > 0 ? 10.0 * log10(energy) : -120.0;
+}
+
+void phase_init(phase_meter_t *m, int rate) {
+    memset(m, 0, sizeof(*m));
+    m->block_frames = rate * PHASE_BLOCK_MS / 1000;
+    pthread_mutex_init(&m->lock, NULL);
+    for (int i = 0; i < PHASE_HOLD_BLOCKS; i++) m->corr_hist[i] = NAN;
+    m->snap.silent = 1;
+    m->snap.level_db = -120.0;
+}
+
+// Суммы LL, RR, LR по чередующимся отсчетам, скалярный вариант (и хвост SIMD)
+static void phase_mac_scalar(const int16_t *pcm, int frames, float acc[3]) {
+    float ll = 0, rr = 0, lr = 0;
+    for (int i = 0; i < frames; i++) {
+        float l = pcm[2 * i], r = pcm[2 * i + 1];
+        ll += l * l;
+        rr += r * r;
+        lr += l * r;
+    }
+    acc[0] += ll;
+    acc[1] += rr;
+    acc[2] += lr;
+}
+
+static void phase_mac(const int16_t *pcm, int frames, float acc[3]) {
+    int i = 0;
+#if FM_NEON
+    float32x4_t all = vdupq_n_f32(0), arr = vdupq_n_f32(0), alr = vdupq_n_f32(0);
+    for (; i + 8 <= frames; i += 8) {
+        int16x8x2_t v = vld2q_s16(pcm + 2 * i);
+        float32x4_t l0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[0])));
+        float32x4_t l1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[0])));
+        float32x4_t r0 = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v.val[1])));
+        float32x4_t r1 = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v.val[1])));
+        all = vmlaq_f32(vmlaq_f32(all, l0, l0), l1, l1);
+        arr = vmlaq_f32(vmlaq_f32(arr, r0, r0), r1, r1);
+        alr = vmlaq_f32(vmlaq_f32(alr, l0, r0), l1, r1);
+    }
+    float t[4];
+    vst1q_f32(t, all);
+    acc[0] += t[0] + t[1] + t[2] + t[3];
+    vst1q_f32(t, arr);
+    acc[1] += t[0] + t[1] + t[2] + t[3];
+    vst1q_f32(t, alr);
+    acc[2] += t[0] + t[1] + t[2] + t[3];
+#elif FM_SSE2
+    // Без разделения каналов: квадраты дают LL/RR в четных/нечетных дорожках,
+    // произведение с переставленными парами - LR дважды
+    __m128 sq = _mm_setzero_ps(), x = _mm_setzero_ps();
+    for (; i + 4 <= frames; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(pcm + 2 * i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        sq = _mm_add_ps(sq, _mm_add_ps(_mm_mul_ps(lo, lo), _mm_mul_ps(hi, hi)));
+        x = _mm_add_ps(x, _mm_add_ps(_mm_mul_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 3, 0, 1))),
+                                     _mm_mul_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 3, 0, 1)))));
+    }
+    float s[4], c[4];
+    _mm_storeu_ps(s, sq);
+    _mm_storeu_ps(c, x);
+    acc[0] += s[0] + s[2];
+    acc[1] += s[1] + s[3];
+    acc[2] += (c[0] + c[1] + c[2] + c[3]) * 0.5f;
+#endif
+    if (i < frames) phase_mac_scalar(pcm + 2 * i, frames - i, acc);
+}
+
+// Точки векторскопа: каждый PHASE_SCOPE_DECIM-й отсчет, усиление по СКЗ прошлого окна
+static void phase_plot(phase_meter_t *m, const int16_t *pcm, int frames) {
+    int i = m->decim;
+    if (m->gain > 0) {
+        float g = m->gain * 0.5f / AUDIO_MAX;
+        for (; i < frames; i += PHASE_SCOPE_DECIM) {
+            float l = pcm[2 * i], r = pcm[2 * i + 1];
+            int col = lrintf(((r - l) * g + 1.0f) * 0.5f * (PHASE_SCOPE_W - 1));
+            int row = lrintf((1.0f - (l + r) * g) * 0.5f * (PHASE_SCOPE_H - 1));
+            if (col >= 0 && col < PHASE_SCOPE_W && row >= 0 && row < PHASE_SCOPE_H) m->grid[row][col] += 1.0f;
+        }
+    } else {
+        while (i < frames) i += PHASE_SCOPE_DECIM;
+    }
+    m->decim = i - frames;
+}
+
+static void phase_block_done(phase_meter_t *m) {
+    const double scale = 1.0 / ((double)AUDIO_MAX * AUDIO_MAX);
+    int slot = m->nblocks % PHASE_WIN_BLOCKS;
+    m->ll[slot] = m->acc[0] * scale;
+    m->rr[slot] = m->acc[1] * scale;
+    m->lr[slot] = m->acc[2] * scale;
+    m->tot[0] += m->ll[slot];
+    m->tot[1] += m->rr[slot];
+    m->tot[2] += m->lr[slot];
+    m->acc[0] = m->acc[1] = m->acc[2] = 0;
+    m->nblocks++;
+
+    // Окно пересчитывается целиком: 30 блоков дешевле, чем накопление ошибки
+    int n = m->nblocks < PHASE_WIN_BLOCKS ? m->nblocks : PHASE_WIN_BLOCKS;
+    double ll = 0, rr = 0, lr = 0;
+    for (int i = 0; i < n; i++) {
+        ll += m->ll[i];
+        rr += m->rr[i];
+        lr += m->lr[i];
+    }
+    double frames = (double)n * m->block_frames;
+    double mid = (ll + rr + 2 * lr) / 4, side = (ll + rr - 2 * lr) / 4;
+    int silent = phase_db((ll + rr) / 2 / frames) < PHASE_SILENCE_DB;
+    double corr = !silent && ll * rr > 0 ? lr / sqrt(ll * rr) : 0.0;
+
+    m->corr_hist[(m->nblocks - 1) % PHASE_HOLD_BLOCKS] = silent ? NAN : corr;
+    double corr_min = 1.0;
+    int valid = 0, neg = 0;
+    for (int i = 0; i < PHASE_HOLD_BLOCKS; i++) {
+        float c = m->corr_hist[i];
+        if (isnan(c)) continue;
+        valid++;
+        if (c < corr_min) corr_min = c;
+        if (c < 0) neg++;
+    }
+
+    // Послесвечение векторскопа и яркость относительно самой яркой точки
+    float peak = 0;
+    for (int r = 0; r < PHASE_SCOPE_H; r++) {
+        for (int c = 0; c < PHASE_SCOPE_W; c++) {
+            m->grid[r][c] *= PHASE_SCOPE_DECAY;
+            if (m->grid[r][c] > peak) peak = m->grid[r][c];
+        }
+    }
+    m->gain = silent ? 0.0f : (float)(1.0 / (PHASE_SCOPE_RMS * sqrt((ll + rr) / 2 / frames)));
+
+    pthread_mutex_lock(&m->lock);
+    phase_snapshot_t *s = &m->snap;
+    s->silent = silent;
+    s->corr = corr;
+    s->corr_min = valid ? corr_min : 0.0;
+    s->neg_pct = valid ? 100.0 * neg / valid : 0.0;
+    s->corr_total = m->tot[0] * m->tot[1] > 0 ? m->tot[2] / sqrt(m->tot[0] * m->tot[1]) : 0.0;
+    s->balance_db = fmax(-60.0, fmin(60.0, phase_db(ll) - phase_db(rr)));
+    s->side_db = fmax(-60.0, fmin(60.0, phase_db(side) - phase_db(mid)));
+    s->level_db = phase_db(mid / frames);
+    for (int r = 0; r < PHASE_SCOPE_H; r++) {
+        for (int c = 0; c < PHASE_SCOPE_W; c++) {
+            float v = peak > 0 ? m->grid[r][c] / peak : 0;
+            int level = v < 0.01f ? 0 : 1 + (int)lrintf(sqrtf(v) * (PHASE_SCOPE_LEVELS - 2));
+            s->scope[r][c] = level < PHASE_SCOPE_LEVELS ? level : PHASE_SCOPE_LEVELS - 1;
+        }
+    }
+    pthread_mutex_unlock(&m->lock);
+}
+
+// Чередующийся стерео PCM; окно сдвигается поблочно
+void phase_process(phase_meter_t *m, const int16_t *pcm, int frames) {
+    while (frames > 0) {
+        int n = m->block_frames - m->block_pos;
+        if (n > frames) n = frames;
+        phase_mac(pcm, n, m->acc);
+        phase_plot(m, pcm, n);
+        pcm += 2 * n;
+        frames -= n;
+        m->block_pos += n;
+        if (m->block_pos == m->block_frames) {
+            m->block_pos = 0;
+            phase_block_done(m);
+        }
+    }
+}
+
+void phase_get(phase_meter_t *m, phase_snapshot_t *out) {
+    pthread_mutex_lock(&m->lock);
+    *out = m->snap;
+    pthread_mutex_unlock(&m->lock);
+}
+
+// ---------- Проверка и замер скорости ----------
+
+typedef struct {
+    const char *name;
+    double expect;                   // Ожидаемая корреляция
+} phase_case_t;
+
+static float phase_noise(uint32_t *seed) {
+    *seed = *seed * 1664525u + 1013904223u;
+    return ((int32_t)*seed >> 8) * (1.0f / 8388608.0f);
+}
+
+// Тестовые сигналы: 1 кГц и шум, -12 dBFS
+static void phase_gen(int kind, int16_t *pcm, int frames) {
+    uint32_t seed = 12345;
+    for (int i = 0; i < frames; i++) {
+        double w = 2 * M_PI * 1000.0 * i / AUDIO_RATE;
+        float s = sin(w), l = 0, r = 0;
+        float n1 = phase_noise(&seed), n2 = phase_noise(&seed);
+        switch (kind) {
+        case 0: l = r = s; break;                        // Моно
+        case 1: l = s; r = -s; break;                    // Противофаза
+        case 2: l = s; r = 0; break;                     // Один канал
+        case 3: l = s; r = cos(w); break;                // Сдвиг 90 градусов
+        case 4: l = n1; r = n2; break;                   // Некоррелированный шум
+        case 5: l = s + n1 * 1.2247f; r = s + n2 * 1.2247f; break;  // Половина общего сигнала
+        }
+        pcm[2 * i] = (int16_t)lrintf(l * 0.25f * AUDIO_MAX);
+        pcm[2 * i + 1] = (int16_t)lrintf(r * 0.25f * AUDIO_MAX);
+    }
+}
+
+int phase_bench(void) {
+    static const phase_case_t cases[] = {
+        { "mono (L = R)", 1.0 },
+        { "out of phase (L = -R)", -1.0 },
+        { "left only", 0.0 },
+        { "90 degrees", 0.0 },
+        { "uncorrelated noise", 0.0 },
+        { "half common", 0.5 },
+    };
+    int frames = AUDIO_RATE * PHASE_BENCH_S;
+    int16_t *pcm = malloc((size_t)frames * 2 * sizeof(int16_t));
+    phase_meter_t *m = malloc(sizeof(*m));
+    phase_snapshot_t s;
+    int ok = 1;
+
+    if (!pcm || !m) return 1;
+
+    printf("%sPhase correlation meter (%s)%s\n", BOLD, FM_SIMD_NAME, COLOR_RESET);
+    printf("%-24s %8s %8s %8s %9s %8s\n", "signal", "expect", "corr", "min 3s", "bal dB", "S/M dB");
+    for (size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++) {
+        phase_gen(k, pcm, AUDIO_RATE);
+        phase_init(m, AUDIO_RATE);
+        phase_process(m, pcm, AUDIO_RATE);
+        phase_get(m, &s);
+        int good = fabs(s.corr - cases[k].expect) < 0.02;
+        ok &= good;
+        printf("%-24s %+8.2f %s%+8.3f%s %+8.3f %+9.2f %+8.1f\n", cases[k].name, cases[k].expect,
+               good ? COLOR_GREEN : COLOR_RED, s.corr, COLOR_RESET, s.corr_min, s.balance_db, s.side_db);
+    }
+
+    // Скорость: музыкоподобный сигнал, порции по периоду ALSA, как в потоке измерения
+    phase_gen(5, pcm, frames);
+    phase_init(m, AUDIO_RATE);
+    double t0 = phase_now();
+    for (int i = 0; i + AUDIO_PERIOD <= frames; i += AUDIO_PERIOD) phase_process(m, pcm + 2 * i, AUDIO_PERIOD);
+    double full = phase_now() - t0;
+
+    float a[3] = { 0, 0, 0 }, b[3] = { 0, 0, 0 };
+    t0 = phase_now();
+    for (int i = 0; i + AUDIO_PERIOD <= frames; i += AUDIO_PERIOD) phase_mac_scalar(pcm + 2 * i, AUDIO_PERIOD, a);
+    double scalar = phase_now() - t0;
+    t0 = phase_now();
+    for (int i = 0; i + AUDIO_PERIOD <= frames; i += AUDIO_PERIOD) phase_mac(pcm + 2 * i, AUDIO_PERIOD, b);
+    double simd = phase_now() - t0;
+    double diff = 0;
+    for (int i = 0; i < 3; i++) diff = fmax(diff, fabs(a[i] - b[i]) / fmax(fabs(a[i]), 1.0));
+
+    printf("\n%-24s %12s %10s\n", "kernel", "Mframes/s", "CPU/core");
+    printf("%-24s %12.1f %9.3f%%\n", "MAC scalar", frames / scalar / 1e6, scalar / PHASE_BENCH_S * 100.0);
+    printf("%-24s %12.1f %9.3f%%  (x%.1f, rel. diff %.1e)\n", "MAC " FM_SIMD_NAME, frames / simd / 1e6,
+           simd / PHASE_BENCH_S * 100.0, scalar / simd, diff);
+    printf("%-24s %12.1f %9.3f%%  %.1f ns/frame\n", "meter + vectorscope", frames / full / 1e6,
+           full / PHASE_BENCH_S * 100.0, full / frames * 1e9);
+    if (diff > 1e-4) ok = 0;
+
+    free(pcm);
+    free(m);
+    printf("%s%s%s\n", ok ? COLOR_GREEN : COLOR_RED, ok ? "OK" : "FAILED", COLOR_RESET);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+#ifndef FM_PHASE_H
+#define FM_PHASE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Фазовая корреляция L/R (-1..+1) и векторскоп по PCM тракта. Противофаза
+// пропадает при моноприеме и раздувает девиацию поднесущей L-R
+#define PHASE_BLOCK_MS      10       // Шаг скользящего окна
+#define PHASE_WIN_BLOCKS    30       // Окно корреляции: 300 мс
+#define PHASE_HOLD_BLOCKS   300      // Удержание минимума: 3 с
+#define PHASE_SILENCE_DB    (-60.0)  // Тише - корреляция не определена
+#define PHASE_SCOPE_W       29       // Векторскоп: M вверх, S вбок, L слева, R справа
+#define PHASE_SCOPE_H       7
+#define PHASE_SCOPE_DECIM   8        // На векторскоп идет каждый 8-й отсчет
+#define PHASE_SCOPE_DECAY   0.75f    // Послесвечение за блок
+#define PHASE_SCOPE_RMS     2.0      // Край векторскопа - СКЗ окна, умноженное на столько
+#define PHASE_SCOPE_LEVELS  5        // Яркость точки: " .:o#"
+
+typedef struct {
+    double corr;                     // Корреляция за окно
+    double corr_min;                 // Минимум за 3 с
+    double corr_total;               // С начала измерения
+    double balance_db;               // L относительно R
+    double side_db;                  // Энергия S относительно M: ширина стереобазы
+    double level_db;                 // СКЗ (L+R)/2, dBFS
+    double neg_pct;                  // Доля времени с корреляцией ниже нуля за 3 с
+    int silent;
+    uint8_t scope[PHASE_SCOPE_H][PHASE_SCOPE_W];  // Яркость 0..PHASE_SCOPE_LEVELS-1
+} phase_snapshot_t;
+
+typedef struct {
+    int block_frames;
+    int block_pos;
+    float acc[3];                    // LL, RR, LR текущего блока
+    // Энергии последних блоков для скользящего окна
+    double ll[PHASE_WIN_BLOCKS], rr[PHASE_WIN_BLOCKS], lr[PHASE_WIN_BLOCKS];
+    double tot[3];
+    float corr_hist[PHASE_HOLD_BLOCKS];  // Корреляция окна по блокам, NAN - тишина
+    long nblocks;
+    // Векторскоп
+    float grid[PHASE_SCOPE_H][PHASE_SCOPE_W];
+    float gain;
+    int decim;
+    // Публикуемые значения
+    phase_snapshot_t snap;
+    pthread_mutex_t lock;
+} phase_meter_t;
+
+// Измеритель, запущенный с --meter: для интерфейса и команды PHASE по --serve
+extern phase_meter_t *phase_meter;
+
+void phase_init(phase_meter_t *m, int rate);
+void phase_process(phase_meter_t *m, const int16_t *pcm, int frames);
+void phase_get(phase_meter_t *m, phase_snapshot_t *out);
+int phase_bench(void);
+
+#endif // FM_PHASE_H
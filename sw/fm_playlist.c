@@ -0,0 +1,621 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <libgen.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "fm.h"
+#include "fm_rt.h"
+#include "fm_playlist.h"
+
+#define PL_STALL_US 200          // Дольше - ждали носитель, а не просто отображали страницу из кэша
+
+static long pl_page;
+
+static double pl_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double pl_thread_cpu(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void pl_log(const char *color, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void pl_log(const char *color, const char *fmt, ...) {
+    time_t now = time(NULL);
+    struct tm tm;
+    char stamp[16];
+    va_list ap;
+
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+    printf("%s[playlist] %s ", color, stamp);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("%s\n", COLOR_RESET);
+    fflush(stdout);
+}
+
+static const char *pl_name(const pl_t *p, int index) {
+    const char *s = strrchr(p->paths[index], '/');
+    return s ? s + 1 : p->paths[index];
+}
+
+static int pl_supported(const char *name) {
+    const char *dot = strrchr(name, '.');
+    return dot && (strcasecmp(dot, ".wav") == 0 || strcasecmp(dot, ".flac") == 0);
+}
+
+static int pl_dir_filter(const struct dirent *d) {
+    return d->d_name[0] != '.' && pl_supported(d->d_name);
+}
+
+// Каталог (WAV/FLAC по имени) или список M3U: строка - путь, # - комментарий
+int pl_load(pl_t *p, const char *path) {
+    struct stat st;
+
+    p->count = 0;
+    if (stat(path, &st) != 0) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, path, strerror(errno), COLOR_RESET);
+        return -1;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        struct dirent **list;
+        int n = scandir(path, &list, pl_dir_filter, alphasort);
+        if (n < 0) {
+            printf("%sОшибка: %s: %s%s\n", COLOR_RED, path, strerror(errno), COLOR_RESET);
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            if (p->count < PL_MAX_TRACKS) {
+                snprintf(p->paths[p->count++], PL_PATH_MAX, "%.*s/%.*s", PL_PATH_MAX / 2, path, PL_PATH_MAX / 2 - 2, list[i]->d_name);
+            }
+            free(list[i]);
+        }
+        free(list);
+    } else {
+        char line[PL_PATH_MAX], dir[PL_PATH_MAX];
+        FILE *f = fopen(path, "r");
+        if (!f) {
+            printf("%sОшибка: %s: %s%s\n", COLOR_RED, path, strerror(errno), COLOR_RESET);
+            return -1;
+        }
+        snprintf(dir, sizeof(dir), "%s", path);
+        char *base = dirname(dir);
+        while (fgets(line, sizeof(line), f) && p->count < PL_MAX_TRACKS) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#') continue;
+            // Пути в списке - относительно каталога списка
+            if (line[0] == '/') snprintf(p->paths[p->count++], PL_PATH_MAX, "%s", line);
+            else snprintf(p->paths[p->count++], PL_PATH_MAX, "%.*s/%.*s", PL_PATH_MAX / 2, base, PL_PATH_MAX / 2 - 2, line);
+        }
+        fclose(f);
+    }
+    if (p->count == 0) {
+        printf("%sОшибка: %s: нет файлов WAV/FLAC%s\n", COLOR_RED, path, COLOR_RESET);
+        return -1;
+    }
+    return 0;
+}
+
+static uint32_t pl_le(const uint8_t *p, int bytes) {
+    uint32_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+static int pl_wav_open(pl_track_t *t) {
+    const uint8_t *h = t->map;
+    int fmt_ok = 0;
+
+    if (t->size < 12 || memcmp(h + 8, "WAVE", 4) != 0) return -1;
+    for (size_t off = 12; off + 8 <= t->size; ) {
+        uint32_t size = pl_le(h + off + 4, 4);
+        if (memcmp(h + off, "fmt ", 4) == 0 && off + 24 <= t->size) {
+            int fmt = pl_le(h + off + 8, 2);
+            // WAVE_FORMAT_EXTENSIBLE: настоящий формат в начале GUID подтипа
+            if (fmt == 0xFFFE && size >= 40 && off + 34 <= t->size) fmt = pl_le(h + off + 32, 2);
+            t->channels = pl_le(h + off + 10, 2);
+            t->rate = pl_le(h + off + 12, 4);
+            t->bits = pl_le(h + off + 22, 2);
+            t->wav_float = fmt == 3;
+            if (!((fmt == 1 && (t->bits == 16 || t->bits == 24 || t->bits == 32)) || (fmt == 3 && t->bits == 32)) ||
+                t->channels < 1 || t->rate < 8000 || t->rate > 192000) return -1;
+            t->frame_bytes = t->channels * t->bits / 8;
+            fmt_ok = 1;
+        } else if (memcmp(h + off, "data", 4) == 0) {
+            if (!fmt_ok) return -1;
+            size_t len = size;
+            if (off + 8 + len > t->size) len = t->size - off - 8;
+            t->pcm = h + off + 8;
+            t->total = len / t->frame_bytes;
+            return 0;
+        }
+        off += 8 + (size_t)size + (size & 1);
+    }
+    return -1;
+}
+
+static void pl_close(pl_track_t *t) {
+    if (t->index < 0) return;
+    if (t->format == PL_FMT_FLAC) flac_close(&t->flac);
+    if (t->map) munmap((void *)t->map, t->size);
+    if (t->fd >= 0) close(t->fd);
+    t->map = NULL;
+    t->fd = -1;
+    t->index = -1;
+}
+
+// Открытие, mmap и разбор заголовка; чтение вперед начинается сразу
+static int pl_open(pl_t *p, pl_track_t *t, int index) {
+    double t0 = pl_now();
+    struct stat st;
+
+    memset(t, 0, sizeof(*t));
+    t->index = -1;
+    t->fd = open(p->paths[index], O_RDONLY | O_CLOEXEC);
+    if (t->fd < 0 || fstat(t->fd, &st) != 0 || st.st_size < 16) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, p->paths[index], t->fd < 0 ? strerror(errno) : "пустой файл", COLOR_RESET);
+        if (t->fd >= 0) close(t->fd);
+        return -1;
+    }
+    t->size = st.st_size;
+    void *m = mmap(NULL, t->size, PROT_READ, MAP_PRIVATE, t->fd, 0);
+    if (m == MAP_FAILED) {
+        printf("%sОшибка: mmap %s: %s%s\n", COLOR_RED, p->paths[index], strerror(errno), COLOR_RESET);
+        close(t->fd);
+        return -1;
+    }
+    t->map = m;
+    t->index = index;
+    if (p->readahead) {
+        madvise(m, t->size, MADV_SEQUENTIAL);
+        t->advised = t->size < PL_READAHEAD ? t->size : PL_READAHEAD;
+        madvise(m, t->advised, MADV_WILLNEED);
+    } else {
+        // Без подсказок и без чтения вперед ядра: каждая страница - отдельное чтение
+        madvise(m, t->size, MADV_RANDOM);
+    }
+
+    int ok;
+    if (memcmp(t->map, "RIFF", 4) == 0) {
+        t->format = PL_FMT_WAV;
+        ok = pl_wav_open(t) == 0;
+    } else {
+        t->format = PL_FMT_FLAC;
+        ok = flac_open(&t->flac, t->map, t->size) == 0;
+        if (ok) {
+            t->rate = t->flac.rate;
+            t->channels = t->flac.channels;
+            t->bits = t->flac.bps;
+            t->total = t->flac.total;
+        }
+    }
+    if (!ok) {
+        printf("%sОшибка: %s: не WAV (PCM/float) и не FLAC%s\n", COLOR_RED, p->paths[index], COLOR_RESET);
+        t->format = PL_FMT_WAV;
+        pl_close(t);
+        return -1;
+    }
+
+    double dt = pl_now() - t0;
+    p->open_s += dt;
+    if (dt > p->open_max) p->open_max = dt;
+    return 0;
+}
+
+// Следующий по списку трек открывается заранее, пока играет текущий
+static void pl_prepare(pl_t *p) {
+    for (int tries = 0; p->prepared.index < 0 && tries < p->count; tries++) {
+        if (p->next >= p->count) {
+            if (!p->loop) return;
+            p->next = 0;
+        }
+        int index = p->next++;
+        if (pl_open(p, &p->prepared, index) != 0) p->errors++;
+    }
+}
+
+// Трек из заготовки; отметка начала в кольце через offset кадров от текущей головы
+static int pl_take(pl_t *p, pl_track_t *t, int offset) {
+    pl_prepare(p);
+    if (p->prepared.index < 0) return -1;
+    *t = p->prepared;
+    p->prepared.index = -1;
+    p->prepared.fd = -1;
+    p->prepared.map = NULL;
+    memset(&p->prepared.flac, 0, sizeof(p->prepared.flac));
+
+    uint32_t head = p->mark_head;
+    if (head - p->mark_tail < PL_MARKS) {
+        p->marks[head % PL_MARKS].at = p->ring.head + offset;
+        p->marks[head % PL_MARKS].index = t->index;
+        __atomic_store_n(&p->mark_head, head + 1, __ATOMIC_RELEASE);
+    }
+    p->tracks++;
+    pl_prepare(p);
+    return 0;
+}
+
+// Чтение вперед окнами, освобождение позади и замер ожидания нерезидентных страниц
+static void pl_touch(pl_t *p, pl_track_t *t, size_t off, size_t len) {
+    if (off >= t->size) return;
+    if (off + len > t->size) len = t->size - off;
+
+    if (p->readahead) {
+        if (t->advised < t->size && off + len + PL_READAHEAD / 2 > t->advised) {
+            size_t from = t->advised & ~(size_t)(pl_page - 1);
+            size_t n = t->size - from < PL_READAHEAD ? t->size - from : PL_READAHEAD;
+            madvise((void *)(t->map + from), n, MADV_WILLNEED);
+            t->advised = from + n;
+        }
+        if (off > t->released + PL_KEEP_BEHIND + PL_READAHEAD) {
+            size_t to = (off - PL_KEEP_BEHIND) & ~(size_t)(pl_page - 1);
+            madvise((void *)(t->map + t->released), to - t->released, MADV_DONTNEED);
+            t->released = to;
+        }
+    }
+
+    unsigned char vec[64];
+    size_t a = off & ~(size_t)(pl_page - 1), end = off + len;
+    double t0 = 0;
+    while (a < end) {
+        size_t n = (end - a + pl_page - 1) / pl_page;
+        if (n > sizeof(vec)) n = sizeof(vec);
+        if (mincore((void *)(t->map + a), n * pl_page < t->size - a ? n * pl_page : t->size - a, vec) != 0) break;
+        for (size_t i = 0; i < n; i++) {
+            if (vec[i] & 1) continue;
+            if (t0 == 0) t0 = pl_now();
+            (void)*(volatile const uint8_t *)(t->map + a + i * pl_page);
+        }
+        a += n * pl_page;
+    }
+    if (t0 > 0) {
+        double dt = pl_now() - t0;
+        if (dt * 1e6 >= PL_STALL_US) {
+            p->stalls++;
+            p->stall_s += dt;
+            if (dt > p->stall_max) p->stall_max = dt;
+        }
+    }
+}
+
+static inline float pl_sample(const pl_track_t *t, const uint8_t *s) {
+    if (t->wav_float) {
+        float v;
+        memcpy(&v, s, sizeof(v));
+        return v;
+    }
+    if (t->bits == 16) return (int16_t)pl_le(s, 2) * (1.0f / 32768.0f);
+    if (t->bits == 24) return (int32_t)(pl_le(s, 3) << 8) * (1.0f / 2147483648.0f);
+    return (int32_t)pl_le(s, 4) * (1.0f / 2147483648.0f);
+}
+
+// До n кадров входной частоты в l/r (моно - в оба, из многоканальных - первые два); 0 - конец
+static int pl_read(pl_t *p, pl_track_t *t, float *l, float *r, int n) {
+    int c1 = t->channels > 1 ? 1 : 0;
+
+    if (t->format == PL_FMT_WAV) {
+        int k = t->total - t->pos < (uint64_t)n ? (int)(t->total - t->pos) : n;
+        const uint8_t *s = t->pcm + t->pos * t->frame_bytes;
+        int bytes = t->bits / 8;
+        pl_touch(p, t, s - t->map, (size_t)k * t->frame_bytes);
+        for (int f = 0; f < k; f++, s += t->frame_bytes) {
+            l[f] = pl_sample(t, s);
+            r[f] = pl_sample(t, s + c1 * bytes);
+        }
+        t->pos += k;
+        return k;
+    }
+
+    flac_dec_t *d = &t->flac;
+    float scale = 1.0f / (float)(1 << (d->bps - 1));
+    int got = 0;
+    while (got < n) {
+        if (t->flac_pos >= d->block) {
+            pl_touch(p, t, d->pos, PL_TOUCH);
+            if (flac_next_frame(d) <= 0) break;
+            t->flac_pos = 0;
+        }
+        int k = d->block - t->flac_pos < n - got ? d->block - t->flac_pos : n - got;
+        const int32_t *x0 = d->out[0] + t->flac_pos, *x1 = d->out[c1] + t->flac_pos;
+        for (int f = 0; f < k; f++) {
+            l[got + f] = x0[f] * scale;
+            r[got + f] = x1[f] * scale;
+        }
+        t->flac_pos += k;
+        got += k;
+    }
+    t->pos += got;
+    return got;
+}
+
+static void pl_voice_begin(pl_voice_t *v) {
+    v->active = 1;
+    v->drained = 0;
+    if (v->track.rate != AUDIO_RATE) stream_rs_init(&v->rs, v->track.rate);
+}
+
+// До n кадров 48 кГц стерео; меньше - голос закончился. С chain следующий трек той же
+// частоты идет в тот же ресемплер без единого потерянного отсчета
+static int pl_voice_pull(pl_t *p, pl_voice_t *v, float *out, int n, int chain) {
+    int got = 0;
+
+    while (got < n && v->active) {
+        pl_track_t *t = &v->track;
+        int k;
+        if (t->rate == AUDIO_RATE) {
+            k = pl_read(p, t, p->l, p->r, n - got < PL_CHUNK ? n - got : PL_CHUNK);
+            for (int f = 0; f < k; f++) {
+                out[2 * (got + f)] = p->l[f];
+                out[2 * (got + f) + 1] = p->r[f];
+            }
+            got += k;
+        } else {
+            got += stream_rs_run(&v->rs, out + 2 * got, n - got);
+            if (got == n) break;
+            int space = STREAM_RS_SPACE(&v->rs) < PL_CHUNK ? STREAM_RS_SPACE(&v->rs) : PL_CHUNK;
+            k = v->drained ? 0 : pl_read(p, t, v->rs.x[0] + v->rs.fill, v->rs.x[1] + v->rs.fill, space);
+            v->rs.fill += k;
+        }
+        if (k > 0) continue;
+
+        // Конец трека
+        int next_rate = 0;
+        if (chain) {
+            pl_prepare(p);
+            if (p->prepared.index >= 0) next_rate = p->prepared.rate;
+        }
+        if (next_rate && next_rate == t->rate && !v->drained) {
+            pl_close(t);
+            pl_take(p, t, got);
+            continue;
+        }
+        if (t->rate != AUDIO_RATE && !v->drained) {
+            // Хвост фильтра: нули до выхода последних отсчетов
+            memset(v->rs.x[0] + v->rs.fill, 0, STREAM_RS_TAPS * sizeof(float));
+            memset(v->rs.x[1] + v->rs.fill, 0, STREAM_RS_TAPS * sizeof(float));
+            v->rs.fill += STREAM_RS_TAPS;
+            v->drained = 1;
+            continue;
+        }
+        pl_close(t);
+        if (next_rate && pl_take(p, t, got) == 0) {
+            pl_voice_begin(v);
+            continue;
+        }
+        v->active = 0;
+    }
+    return got;
+}
+
+// Осталось кадров 48 кГц до конца трека; длина неизвестна - INT_MAX
+static long pl_left(const pl_voice_t *v) {
+    const pl_track_t *t = &v->track;
+    if (t->total == 0 || t->pos > t->total) return INT_MAX;
+    return (long)((t->total - t->pos) * AUDIO_RATE / t->rate);
+}
+
+// Поток декодера: голоса -> переход -> S16 в кольцо, пока есть место
+static void *pl_decode(void *arg) {
+    pl_t *p = arg;
+    double cpu0 = pl_thread_cpu();
+
+    while (!p->stop) {
+        pl_voice_t *a = &p->voice[p->cur], *b = &p->voice[!p->cur];
+        if (!a->active) {
+            if (pl_take(p, &a->track, 0) != 0) break;
+            pl_voice_begin(a);
+        }
+        if (p->fade > 0 && !p->fading && pl_left(a) <= p->fade) {
+            pl_prepare(p);
+            if (p->prepared.index >= 0 && pl_take(p, &b->track, 0) == 0) {
+                pl_voice_begin(b);
+                p->fading = 1;
+                p->fade_pos = 0;
+            }
+        }
+
+        int n = pl_voice_pull(p, a, p->a, PL_BLOCK, !p->fading);
+        if (p->fading) {
+            memset(p->a + 2 * n, 0, (PL_BLOCK - n) * 2 * sizeof(float));
+            int nb = pl_voice_pull(p, b, p->b, PL_BLOCK, 0);
+            memset(p->b + 2 * nb, 0, (PL_BLOCK - nb) * 2 * sizeof(float));
+            // Равная мощность: cos/sin четверти периода
+            for (int f = 0; f < PL_BLOCK; f++) {
+                float g = p->fade_pos < p->fade ? (float)p->fade_pos / p->fade : 1.0f;
+                float ga = cosf(g * (float)M_PI_2), gb = sinf(g * (float)M_PI_2);
+                p->a[2 * f] = p->a[2 * f] * ga + p->b[2 * f] * gb;
+                p->a[2 * f + 1] = p->a[2 * f + 1] * ga + p->b[2 * f + 1] * gb;
+                p->fade_pos++;
+            }
+            n = PL_BLOCK;
+            if (p->fade_pos >= p->fade) {
+                if (a->active) pl_close(&a->track);
+                a->active = 0;
+                p->cur = !p->cur;
+                p->fading = 0;
+            }
+        }
+        if (n == 0) continue;
+        pcm_f32_to_s16(&p->conv, p->a, p->s16, n * 2, 2);
+        stream_ring_push(&p->ring, p->s16, n, &p->stop);
+        p->frames_out += n;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        if (p->voice[i].active) pl_close(&p->voice[i].track);
+        p->voice[i].active = 0;
+    }
+    pl_close(&p->prepared);
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    p->majflt = ru.ru_majflt;
+    p->decode_cpu = pl_thread_cpu() - cpu0;
+    p->done = 1;
+    return NULL;
+}
+
+static int pl_init(pl_t *p, const char *path, int crossfade_ms, int loop, pcm_dither_t dither) {
+    // Кольцо и буферы - в статической структуре, memset делает их резидентными заранее
+    memset(p, 0, sizeof(*p));
+    pl_page = sysconf(_SC_PAGESIZE);
+    if (pl_load(p, path) != 0) return -1;
+    p->fade = crossfade_ms > 0 ? crossfade_ms * (AUDIO_RATE / 1000) : 0;
+    p->loop = loop;
+    p->readahead = 1;
+    p->prepared.index = -1;
+    p->voice[0].track.index = p->voice[1].track.index = -1;
+    pcm_conv_init(&p->conv, dither);
+    return 0;
+}
+
+static void pl_report(pl_t *p, uint32_t fill_min, double fill_avg) {
+    pl_log("", "buffer min %u ms, avg %.0f ms; I/O stalls %ld (%.1f ms total, max %.1f ms); open max %.1f ms; RSS %.1f MB",
+           fill_min * 1000 / AUDIO_RATE, fill_avg * 1000.0 / AUDIO_RATE, p->stalls, p->stall_s * 1000.0,
+           p->stall_max * 1000.0, p->open_max * 1000.0, stream_mem_mb("VmRSS"));
+}
+
+// Режим --playlist: поток декодера впереди, этот поток отдает кольцо устройству
+int pl_main(const char *path, const char *play_dev, int crossfade_ms, int loop, pcm_dither_t dither) {
+    static pl_t p;
+    audio_dev_t out;
+    int16_t period[AUDIO_PERIOD * 2];
+    int prebuffer = PL_PREBUFFER_MS * AUDIO_RATE / 1000, playing = 0;
+    long underruns = 0;
+
+    if (pl_init(&p, path, crossfade_ms, loop, dither) != 0) return 1;
+    if (audio_open(&out, play_dev, AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) return 1;
+    printf("Playing %d tracks from %s to %s, %s%s\n", p.count, path, play_dev,
+           p.fade ? "crossfade" : "gapless", loop ? ", loop" : "");
+    if (p.fade) printf("Crossfade %d ms\n", crossfade_ms);
+    fflush(stdout);
+    if (rt_thread_create(&p.thread, RT_ROLE_CONTROL, pl_decode, &p) != 0) {
+        audio_close(&out);
+        return 1;
+    }
+    if (rt_enabled) rt_set_current(RT_ROLE_AUDIO);
+
+    double next_report = pl_now() + PL_STATS_S;
+    uint32_t fill_min = STREAM_RING_FRAMES;
+    double fill_sum = 0;
+    long fill_n = 0;
+    while (global_tx->running) {
+        uint32_t avail = __atomic_load_n(&p.ring.head, __ATOMIC_ACQUIRE) - p.ring.tail;
+        if (p.done && avail == 0) break;
+        if (!playing && avail < (uint32_t)prebuffer && !p.done) {
+            usleep(2000);
+            continue;
+        }
+        playing = 1;
+        if (avail < fill_min) fill_min = avail;
+        fill_sum += avail;
+        fill_n++;
+
+        int n = stream_ring_pull(&p.ring, period, AUDIO_PERIOD);
+        if (n < AUDIO_PERIOD) {
+            memset(period + 2 * n, 0, (AUDIO_PERIOD - n) * 2 * sizeof(int16_t));
+            if (!p.done) {
+                underruns++;
+                playing = 0;
+                pl_log(COLOR_YELLOW, "buffer empty, decoder behind");
+            }
+        }
+        // Отметки начала трека, которые дошли до вывода
+        while (p.mark_tail != __atomic_load_n(&p.mark_head, __ATOMIC_ACQUIRE) &&
+               (int32_t)(p.ring.tail - p.marks[p.mark_tail % PL_MARKS].at) >= 0) {
+            int index = p.marks[p.mark_tail % PL_MARKS].index;
+            pl_log(COLOR_CYAN, "track %d/%d: %s", index + 1, p.count, pl_name(&p, index));
+            p.mark_tail++;
+        }
+        if (audio_write(&out, period, AUDIO_PERIOD) < 0) break;
+
+        if (pl_now() >= next_report) {
+            pl_report(&p, fill_min, fill_n ? fill_sum / fill_n : 0);
+            fill_min = STREAM_RING_FRAMES;
+            fill_sum = 0;
+            fill_n = 0;
+            next_report = pl_now() + PL_STATS_S;
+        }
+    }
+
+    p.stop = 1;
+    pthread_join(p.thread, NULL);
+    audio_close(&out);
+    printf("\n%sPlaylist summary:%s\n", BOLD, COLOR_RESET);
+    printf("  %ld tracks, %.1f s of audio, %ld unreadable files, %ld underruns\n",
+           p.tracks, p.frames_out / (double)AUDIO_RATE, p.errors, underruns);
+    printf("  I/O stalls %ld, %.1f ms total, max %.1f ms; %ld major faults; open max %.1f ms\n",
+           p.stalls, p.stall_s * 1000.0, p.stall_max * 1000.0, p.majflt, p.open_max * 1000.0);
+    printf("  Decoder CPU %.2f s, RSS %.1f MB, peak %.1f MB\n", p.decode_cpu, stream_mem_mb("VmRSS"), stream_mem_mb("VmHWM"));
+    return 0;
+}
+
+// Сброс файлов из страничного кэша: каждый прогон начинается с холодного чтения
+static int pl_drop_cache(pl_t *p) {
+    int cold = 1;
+    for (int i = 0; i < p->count; i++) {
+        int fd = open(p->paths[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        if (i == 0) {
+            // tmpfs и подобные не отдают страницы - предупредим, что замер будет "горячим"
+            unsigned char vec = 0;
+            void *m = mmap(NULL, 1, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED) {
+                if (mincore(m, 1, &vec) == 0 && (vec & 1)) cold = 0;
+                munmap(m, 1);
+            }
+        }
+        close(fd);
+    }
+    return cold;
+}
+
+// Режим --playlist-bench: весь список без устройства и без темпа, без чтения вперед и с ним
+int pl_bench(const char *path, int crossfade_ms) {
+    static pl_t p;
+    static const char *modes[2] = { "no read-ahead", "mmap read-ahead" };
+    int16_t buf[AUDIO_PERIOD * 8];
+
+    printf("%s%-16s %9s %8s %8s %7s %10s %8s %8s %8s%s\n", BOLD, "Mode", "Audio, s", "Wall, s", "Speed",
+           "Stalls", "Stall, ms", "Max, ms", "Open, ms", "Maj.flt", COLOR_RESET);
+    for (int mode = 0; mode < 2 && global_tx->running; mode++) {
+        if (pl_init(&p, path, crossfade_ms, 0, DITHER_TPDF) != 0) return 1;
+        p.readahead = mode;
+        int cold = pl_drop_cache(&p);
+        double t0 = pl_now();
+        if (rt_thread_create(&p.thread, RT_ROLE_CONTROL, pl_decode, &p) != 0) return 1;
+        while (global_tx->running && !(p.done && p.ring.head == p.ring.tail)) {
+            if (stream_ring_pull(&p.ring, buf, AUDIO_PERIOD * 4) == 0) usleep(200);
+        }
+        p.stop = 1;
+        pthread_join(p.thread, NULL);
+        double wall = pl_now() - t0, audio = p.frames_out / (double)AUDIO_RATE;
+        printf("%-16s %9.1f %8.2f %7.0fx %7ld %10.1f %8.1f %8.1f %8ld%s\n", modes[mode], audio, wall,
+               wall > 0 ? audio / wall : 0.0, p.stalls, p.stall_s * 1000.0, p.stall_max * 1000.0,
+               p.open_max * 1000.0, p.majflt, cold ? "" : "  (page cache not dropped)");
+        fflush(stdout);
+    }
+    printf("%d files, %ld played, %ld unreadable; decoder CPU %.2f s in the last run\n",
+           p.count, p.tracks, p.errors, p.decode_cpu);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef FM_PLAYLIST_H
+#define FM_PLAYLIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_pcm.h"
+#include "fm_flac.h"
+#include "fm_stream.h"
+
+// Плейлист из локальных файлов: mmap с чтением вперед, WAV/FLAC, стык без паузы или с переходом
+#define PL_MAX_TRACKS      1024
+#define PL_PATH_MAX        256
+#define PL_READAHEAD       (1024 * 1024)   // Окно madvise(MADV_WILLNEED) впереди декодера
+#define PL_KEEP_BEHIND     (256 * 1024)    // Позади декодера страницы отдаются (MADV_DONTNEED)
+#define PL_TOUCH           65536           // Проверка резидентности перед кадром FLAC
+#define PL_BLOCK           1024            // Кадров 48 кГц за шаг декодера
+#define PL_CHUNK           4096            // Входных кадров за чтение из файла
+#define PL_PREBUFFER_MS    300
+#define PL_STATS_S         10
+#define PL_MARKS           16              // Очередь отметок начала трека в кольце
+
+typedef enum {
+    PL_FMT_WAV = 0,
+    PL_FMT_FLAC
+} pl_format_t;
+
+typedef struct {
+    int index;                             // Номер в плейлисте, -1 - не открыт
+    int fd;
+    const uint8_t *map;
+    size_t size;
+    size_t advised;                        // Чтение вперед запрошено до этого смещения
+    size_t released;                       // Страницы до этого смещения отданы
+    pl_format_t format;
+    int rate, channels, bits;
+    uint64_t total, pos;                   // Входных кадров всего / прочитано
+    // WAV
+    const uint8_t *pcm;
+    int wav_float;
+    int frame_bytes;
+    // FLAC
+    flac_dec_t flac;
+    int flac_pos;                          // Прочитано из текущего блока
+} pl_track_t;
+
+typedef struct {
+    pl_track_t track;
+    int active;
+    int drained;                           // В ресемплер дописаны нули хвоста
+    stream_rs_t rs;
+} pl_voice_t;
+
+typedef struct {
+    uint32_t at;                           // Позиция в кольце (head)
+    int index;
+} pl_mark_t;
+
+typedef struct {
+    char paths[PL_MAX_TRACKS][PL_PATH_MAX];
+    int count;
+    int next;                              // Следующий трек для открытия
+    int loop;
+    int fade;                              // Переход, кадров 48 кГц; 0 - встык
+    int readahead;                         // 0 - без madvise (для сравнения в --playlist-bench)
+    pl_track_t prepared;                   // Следующий трек, открытый заранее
+    pl_voice_t voice[2];
+    int cur;
+    int fading, fade_pos;
+    float a[PL_BLOCK * 2], b[PL_BLOCK * 2];
+    float l[PL_CHUNK], r[PL_CHUNK];
+    int16_t s16[PL_BLOCK * 2];
+    pcm_conv_t conv;
+    stream_ring_t ring;
+    pl_mark_t marks[PL_MARKS];
+    volatile uint32_t mark_head, mark_tail;
+    pthread_t thread;
+    volatile int stop;
+    volatile int done;
+    // Статистика
+    long stalls;                           // Обращений к нерезидентным страницам
+    double stall_s, stall_max;
+    double open_s, open_max;               // Открытие и разбор следующего файла
+    long majflt;                           // Мажорные отказы страниц потока декодера
+    double decode_cpu;
+    long tracks, errors;
+    uint64_t frames_out;
+} pl_t;
+
+int pl_load(pl_t *p, const char *path);
+int pl_main(const char *path, const char *play_dev, int crossfade_ms, int loop, pcm_dither_t dither);
+int pl_bench(const char *path, int crossfade_ms);
+
+#endif // FM_PLAYLIST_H
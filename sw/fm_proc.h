@@ -0,0 +1,46 @@
+#ifndef FM_PROC_H
+#define FM_PROC_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "fm.h"
+#include "fm_pcm.h"
+
+// Обработка звука на плате: АРУ -> многополосный компрессор -> лимитер
+#define PROC_MAX_BANDS   5
+#define PROC_SUBBLOCK    16          // Кадров на шаг управления усилением
+#define PROC_ARENA_SIZE  (256 * 1024) // Вся память цепочки, выделяется один раз
+#define PROC_CPU_BUDGET  30.0        // Допустимая загрузка одного ядра, %
+
+// АРУ: медленно приводит средний уровень к целевому
+#define PROC_AGC_TARGET  (-20.0)     // dBFS RMS
+#define PROC_AGC_RANGE   12.0        // Максимальная коррекция, дБ
+#define PROC_AGC_RATE    2.0         // Скорость изменения, дБ/с
+#define PROC_AGC_GATE    (-45.0)     // Ниже этого уровня усиление замораживается
+#define PROC_AGC_TAU     3.0         // Постоянная времени детектора, с
+
+// Лимитер: потолок -9 dBFS соответствует девиации 75 кГц
+#define PROC_LIM_CEILING DBFS_MINUS_9
+#define PROC_LIM_LOOKAHEAD 3         // Подблоков упреждения (1 мс)
+#define PROC_LIM_RELEASE 0.050       // с
+
+typedef enum {
+    PROC_STAGE_CONV = 0,
+    PROC_STAGE_AGC,
+    PROC_STAGE_XOVER,
+    PROC_STAGE_COMP,
+    PROC_STAGE_LIMIT,
+    PROC_STAGE_COUNT
+} proc_stage_t;
+
+typedef struct proc proc_t;
+
+proc_t *proc_create(int bands, int rate, pcm_dither_t dither);
+void proc_destroy(proc_t *p);
+void proc_process(proc_t *p, const int16_t *in, int16_t *out, int frames);
+void proc_report(proc_t *p, FILE *out);
+int proc_run(int bands, pcm_dither_t dither, const char *capture_dev, const char *play_dev);
+int proc_bench(int bands, int seconds);
+
+#endif // FM_PROC_H
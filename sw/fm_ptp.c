@@ -0,0 +1,531 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/net_tstamp.h>
+
+#include "fm.h"
+#include "fm_rt.h"
+#include "fm_ptp.h"
+
+ptp_t *ptp_clock;
+
+// Типы сообщений и флаги заголовка
+#define PTP_SYNC           0x0
+#define PTP_DELAY_REQ      0x1
+#define PTP_FOLLOW_UP      0x8
+#define PTP_DELAY_RESP     0x9
+#define PTP_ANNOUNCE       0xB
+#define PTP_HDR_LEN        34
+#define PTP_TWO_STEP       0x02           // flagField[0]
+
+static const char *ptp_state_names[] = { "LISTENING", "UNCALIBRATED", "TRACKING", "LOCKED" };
+
+static int64_t ptp_realtime(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static int64_t ptp_mono(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static uint16_t ptp_get16(const uint8_t *b) {
+    return (uint16_t)(b[0] << 8 | b[1]);
+}
+
+static void ptp_put16(uint8_t *b, uint16_t v) {
+    b[0] = v >> 8;
+    b[1] = v & 0xFF;
+}
+
+// Метка времени: 48 бит секунд + 32 бита наносекунд
+static int64_t ptp_get_ts(const uint8_t *b) {
+    int64_t sec = 0;
+    uint32_t ns = 0;
+    for (int i = 0; i < 6; i++) sec = sec << 8 | b[i];
+    for (int i = 6; i < 10; i++) ns = ns << 8 | b[i];
+    return sec * 1000000000LL + ns;
+}
+
+// correctionField: нс * 2^16, со знаком
+static int64_t ptp_get_corr(const uint8_t *m) {
+    uint64_t v = 0;
+    for (int i = 8; i < 16; i++) v = v << 8 | m[i];
+    return (int64_t)v >> 16;
+}
+
+static void ptp_id_str(const uint8_t *id, char *out, size_t size) {
+    snprintf(out, size, "%02x%02x%02x.%02x%02x.%02x%02x%02x", id[0], id[1], id[2], id[3], id[4], id[5], id[6], id[7]);
+}
+
+// ---------- Сервопетля ----------
+
+static void ptp_servo_init(ptp_servo_t *s, double kp, double ki, int64_t step_ns, int64_t lock_ns, int estimate) {
+    memset(s, 0, sizeof(*s));
+    s->estimate = estimate;
+    s->kp = kp;
+    s->ki = ki;
+    s->step_ns = step_ns;
+    s->lock_ns = lock_ns;
+}
+
+static int64_t ptp_model_at(const ptp_model_t *m, int64_t l) {
+    return m->base_m + (int64_t)llround((double)(l - m->base_l) * (1.0 + m->freq));
+}
+
+static double ptp_clamp_freq(double f) {
+    if (f > PTP_MAX_PPM * 1e-6) return PTP_MAX_PPM * 1e-6;
+    if (f < -PTP_MAX_PPM * 1e-6) return -PTP_MAX_PPM * 1e-6;
+    return f;
+}
+
+// Пара "местное l - удаленное r". Первые две точки задают фазу и частоту,
+// дальше ПИ: фаза поправляется сразу на kp ошибки, частота копит ki ошибки
+static void ptp_servo_sample(ptp_servo_t *s, int64_t l, int64_t r) {
+    if (s->samples > 0 && l <= s->last_l) return;
+    if (s->samples == 0) {
+        s->m.freq = 0;
+        s->m.state = PTP_UNCALIBRATED;
+    } else if (s->samples == 1 && s->estimate) {
+        if (l - s->m.base_l < PTP_ESTIMATE_NS) return;
+        s->m.freq = ptp_clamp_freq((double)(r - s->m.base_m) / (double)(l - s->m.base_l) - 1.0);
+        s->m.state = PTP_TRACKING;
+    } else {
+        int64_t pred = ptp_model_at(&s->m, l);
+        s->err = r - pred;
+        if (llabs(s->err) > s->step_ns) {
+            // Мастер переставил время или сменился: новая фаза, частота остается
+            s->m.base_l = l;
+            s->m.base_m = r;
+            s->steps++;
+            s->in_lock = 0;
+            s->m.state = PTP_TRACKING;
+            s->last_l = l;
+            return;
+        }
+        s->m.freq = ptp_clamp_freq(s->m.freq + s->ki * (double)s->err / (double)(l - s->last_l));
+        r = pred + llround(s->kp * (double)s->err);
+        if (llabs(s->err) < s->lock_ns) {
+            if (++s->in_lock >= PTP_LOCK_COUNT) s->m.state = PTP_LOCKED;
+        } else {
+            // Захват теряется только на большой ошибке: одиночные выбросы меток не в счет
+            s->in_lock = 0;
+            if (s->m.state != PTP_LOCKED || llabs(s->err) > 4 * s->lock_ns) s->m.state = PTP_TRACKING;
+        }
+    }
+    s->m.base_l = l;
+    s->m.base_m = r;
+    s->last_l = l;
+    s->samples++;
+}
+
+// ---------- Публикация: seqlock, запись только из потока PTP ----------
+
+static void ptp_publish(ptp_t *p) {
+    uint32_t seq = p->seq;
+    __atomic_store_n(&p->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    p->pub = p->servo.m;
+    if (p->best < 0) p->pub.state = PTP_LISTENING;
+    p->pub_offset = p->servo.err;
+    p->pub_delay = p->path_delay;
+    p->pub_state = p->pub.state;
+    __atomic_store_n(&p->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void ptp_read_model(ptp_t *p, ptp_model_t *m) {
+    uint32_t s1, s2;
+    do {
+        s1 = __atomic_load_n(&p->seq, __ATOMIC_ACQUIRE);
+        *m = p->pub;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&p->seq, __ATOMIC_RELAXED);
+    } while ((s1 & 1) || s1 != s2);
+}
+
+int ptp_now(ptp_t *p, int64_t *ptp_ns) {
+    ptp_model_t m;
+    ptp_read_model(p, &m);
+    if (m.state > PTP_LISTENING) *ptp_ns = ptp_model_at(&m, ptp_realtime());
+    return m.state;
+}
+
+double ptp_rate(ptp_t *p) {
+    ptp_model_t m;
+    ptp_read_model(p, &m);
+    return 1.0 + m.freq;
+}
+
+void ptp_format(ptp_t *p, char *out, size_t size) {
+    ptp_model_t m;
+    char gm[32] = "-";
+    ptp_read_model(p, &m);
+    int best = p->best;
+    if (best >= 0) ptp_id_str(p->masters[best].gm, gm, sizeof(gm));
+    snprintf(out, size, "STATE=%s OFFSET=%+lld DELAY=%lld FREQ=%+.3f GM=%s SYNCS=%ld STEPS=%ld TS=%s",
+             ptp_state_names[m.state], (long long)p->pub_offset, (long long)p->pub_delay, m.freq * 1e6, gm,
+             p->syncs, p->servo.steps, p->kernel_ts ? "kernel" : "user");
+}
+
+// Часы вывода: позиция в кадрах против медиачасов, раз в секунду из потока вывода
+void ptp_dac_update(ptp_t *p, ptp_dac_t *d, int64_t frames_played, int rate) {
+    int64_t now = ptp_realtime(), media;
+    if (now < d->next) return;
+    d->next = now + 1000000000LL;
+    if (d->servo.kp == 0) ptp_servo_init(&d->servo, PTP_DAC_KP, PTP_DAC_KI, PTP_DAC_STEP_NS, 0, 0);
+    if (ptp_now(p, &media) < PTP_TRACKING) return;
+    ptp_servo_sample(&d->servo, media, frames_played * 1000000000LL / rate);
+    d->ppb = (int32_t)lrint(d->servo.m.freq * 1e9);
+}
+
+// ---------- Протокол ----------
+
+static void ptp_header(ptp_t *p, uint8_t *m, int type, int len, uint16_t seq, int control, int log) {
+    memset(m, 0, len);
+    m[0] = type;
+    m[1] = 2;
+    ptp_put16(m + 2, len);
+    m[4] = p->domain;
+    memcpy(m + 20, p->self, 10);
+    ptp_put16(m + 30, seq);
+    m[32] = control;
+    m[33] = log;
+}
+
+// Метка приема (или отправки из очереди ошибок) из SCM_TIMESTAMPING; 0 - нет метки ядра
+static int ptp_recv(int fd, uint8_t *buf, int size, int64_t *ts, int errqueue) {
+    char ctrl[256];
+    struct iovec iov = { buf, size };
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    ssize_t n = recvmsg(fd, &msg, MSG_DONTWAIT | (errqueue ? MSG_ERRQUEUE : 0));
+    if (n < 0) return -1;
+    *ts = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SO_TIMESTAMPING) {
+            struct timespec t[3];
+            memcpy(t, CMSG_DATA(c), sizeof(t));
+            if (t[0].tv_sec || t[0].tv_nsec) *ts = t[0].tv_sec * 1000000000LL + t[0].tv_nsec;
+        }
+    }
+    return (int)n;
+}
+
+static void ptp_send_delay_req(ptp_t *p) {
+    uint8_t m[44], buf[256];
+    struct sockaddr_in to = { .sin_family = AF_INET, .sin_port = htons(PTP_EVENT_PORT) };
+    int64_t ts;
+
+    inet_pton(AF_INET, PTP_MCAST_ADDR, &to.sin_addr);
+    ptp_header(p, m, PTP_DELAY_REQ, sizeof(m), ++p->dreq_seq, 1, 0x7F);
+    p->t3 = ptp_realtime();
+    if (sendto(p->ev_fd, m, sizeof(m), 0, (struct sockaddr *)&to, sizeof(to)) != (ssize_t)sizeof(m)) return;
+    p->dreq_pending = 1;
+    p->dreq_sent = ptp_mono();
+
+    // Метка ядра приходит в очередь ошибок сокета; без нее остается время до sendto()
+    if (!p->kernel_ts) return;
+    struct pollfd e = { p->ev_fd, 0, 0 };
+    for (int i = 0; i < 4 && poll(&e, 1, PTP_TXTS_MS) > 0 && (e.revents & POLLERR); i++) {
+        if (ptp_recv(p->ev_fd, buf, sizeof(buf), &ts, 1) < 0) break;
+        if (ts) {
+            p->t3 = ts;
+            break;
+        }
+    }
+}
+
+// Сравнение наборов данных мастеров по порядку IEEE 1588 (меньше - лучше)
+static int ptp_better(const ptp_master_t *a, const ptp_master_t *b) {
+    if (a->prio1 != b->prio1) return a->prio1 < b->prio1;
+    if (a->cls != b->cls) return a->cls < b->cls;
+    if (a->acc != b->acc) return a->acc < b->acc;
+    if (a->var != b->var) return a->var < b->var;
+    if (a->prio2 != b->prio2) return a->prio2 < b->prio2;
+    int c = memcmp(a->gm, b->gm, 8);
+    if (c) return c < 0;
+    if (a->steps_removed != b->steps_removed) return a->steps_removed < b->steps_removed;
+    return memcmp(a->id, b->id, 10) < 0;
+}
+
+static void ptp_select(ptp_t *p) {
+    int64_t now = ptp_mono();
+    int best = -1;
+
+    for (int i = 0; i < PTP_MAX_MASTERS; i++) {
+        ptp_master_t *m = &p->masters[i];
+        if (!m->last) continue;
+        double interval = ldexp(1.0, m->log_interval);
+        if (now - m->last > (int64_t)(PTP_ANNOUNCE_LOST * interval * 1e9)) {
+            m->last = 0;
+            continue;
+        }
+        if (best < 0 || ptp_better(m, &p->masters[best])) best = i;
+    }
+    if (best == p->best) return;
+
+    char gm[32], port[32];
+    if (best >= 0) {
+        ptp_id_str(p->masters[best].gm, gm, sizeof(gm));
+        ptp_id_str(p->masters[best].id, port, sizeof(port));
+        printf("PTP: grandmaster %s via port %s-%d (priority1 %d, class %d)\n", gm, port,
+               ptp_get16(p->masters[best].id + 8), p->masters[best].prio1, p->masters[best].cls);
+    } else {
+        printf("%sPTP: grandmaster lost%s\n", COLOR_YELLOW, COLOR_RESET);
+    }
+    fflush(stdout);
+    // Новый мастер - новая оценка; частота прежнего не переносится
+    p->best = best;
+    p->sync_pending = 0;
+    p->dreq_pending = 0;
+    p->ndelays = 0;
+    p->path_delay = 0;
+    p->t1 = p->t2 = 0;
+    ptp_servo_init(&p->servo, PTP_KP, PTP_KI, PTP_STEP_NS, PTP_LOCK_NS, 1);
+    ptp_publish(p);
+}
+
+static void ptp_announce(ptp_t *p, const uint8_t *m, int len) {
+    int slot = -1, victim = -1;
+    if (len < 64) return;
+    for (int i = 0; i < PTP_MAX_MASTERS; i++) {
+        ptp_master_t *c = &p->masters[i];
+        if (c->last && memcmp(c->id, m + 20, 10) == 0) {
+            slot = i;
+            break;
+        }
+        // Новому порту - свободный слот, иначе давнее всех слышанный; выбранный мастер
+        // не вытесняется: сервопетля осталась бы на его индексе с чужими часами
+        if (i == p->best) continue;
+        if (victim < 0 || (p->masters[victim].last && (!c->last || c->last < p->masters[victim].last))) victim = i;
+    }
+    if (slot < 0) slot = victim;
+    if (slot < 0) return;
+    ptp_master_t *e = &p->masters[slot];
+    memcpy(e->id, m + 20, 10);
+    e->prio1 = m[47];
+    e->cls = m[48];
+    e->acc = m[49];
+    e->var = ptp_get16(m + 50);
+    e->prio2 = m[52];
+    memcpy(e->gm, m + 53, 8);
+    e->steps_removed = ptp_get16(m + 61);
+    e->log_interval = (int8_t)m[33];
+    e->last = ptp_mono();
+    ptp_select(p);
+}
+
+// Полная пара t1/t2: при известной задержке пути - точка для сервопетли
+static void ptp_sync_done(ptp_t *p, int64_t t1) {
+    p->t1 = t1;
+    p->t2 = p->sync_t2;
+    p->syncs++;
+    if (p->ndelays > 0) {
+        ptp_servo_sample(&p->servo, p->t2, p->t1 + p->path_delay);
+        ptp_publish(p);
+    }
+    int64_t interval = (int64_t)(ldexp(1.0, p->dreq_log) * 1e9);
+    if (p->dreq_pending && ptp_mono() - p->dreq_sent > 1000000000LL) {
+        p->dreq_pending = 0;
+        p->timeouts++;
+    }
+    if (!p->dreq_pending && ptp_mono() - p->dreq_sent >= interval) ptp_send_delay_req(p);
+}
+
+static int ptp_cmp64(const void *a, const void *b) {
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void ptp_delay_resp(ptp_t *p, const uint8_t *m, int len) {
+    if (len < 54 || !p->dreq_pending || ptp_get16(m + 30) != p->dreq_seq) return;
+    if (memcmp(m + 44, p->self, 10) != 0 || !p->t2) return;
+    p->dreq_pending = 0;
+    p->dresps++;
+    p->dreq_log = (int8_t)m[33];
+    if (p->dreq_log < -4 || p->dreq_log > 6) p->dreq_log = 0;
+
+    int64_t t4 = ptp_get_ts(m + 34) - ptp_get_corr(m);
+    int64_t delay = ((p->t2 - p->t1) + (t4 - p->t3)) / 2;
+    if (delay < 0) return;
+
+    // Медиана последних измерений: очереди коммутатора дают редкие большие выбросы
+    int64_t sorted[PTP_DELAY_FILTER];
+    memmove(p->delays + 1, p->delays, (PTP_DELAY_FILTER - 1) * sizeof(int64_t));
+    p->delays[0] = delay;
+    if (p->ndelays < PTP_DELAY_FILTER) p->ndelays++;
+    memcpy(sorted, p->delays, p->ndelays * sizeof(int64_t));
+    qsort(sorted, p->ndelays, sizeof(int64_t), ptp_cmp64);
+    p->path_delay = sorted[p->ndelays / 2];
+}
+
+static void ptp_handle(ptp_t *p, const uint8_t *m, int len, int64_t ts) {
+    if (len < PTP_HDR_LEN || (m[1] & 0x0F) != 2 || m[4] != p->domain) return;
+    int type = m[0] & 0x0F;
+
+    if (type == PTP_ANNOUNCE) {
+        ptp_announce(p, m, len);
+        return;
+    }
+    if (p->best < 0 || memcmp(m + 20, p->masters[p->best].id, 10) != 0) return;
+
+    if (type == PTP_SYNC && len >= 44) {
+        p->sync_t2 = ts;
+        p->sync_seq = ptp_get16(m + 30);
+        if (m[6] & PTP_TWO_STEP) {
+            p->sync_pending = 1;
+            p->sync_corr = ptp_get_corr(m);
+        } else {
+            p->sync_pending = 0;
+            ptp_sync_done(p, ptp_get_ts(m + 34) + ptp_get_corr(m));
+        }
+    } else if (type == PTP_FOLLOW_UP && len >= 44) {
+        if (!p->sync_pending || ptp_get16(m + 30) != p->sync_seq) return;
+        p->sync_pending = 0;
+        ptp_sync_done(p, ptp_get_ts(m + 34) + p->sync_corr + ptp_get_corr(m));
+    } else if (type == PTP_DELAY_RESP) {
+        ptp_delay_resp(p, m, len);
+    }
+}
+
+static void *ptp_thread(void *arg) {
+    ptp_t *p = arg;
+    struct pollfd pfd[2] = {{p->ev_fd, POLLIN, 0}, {p->gen_fd, POLLIN, 0}};
+    uint8_t buf[256];
+    int64_t ts, last_select = 0;
+    int n;
+
+    while (!p->stop) {
+        int r = poll(pfd, 2, 100);
+        int64_t woke = ptp_realtime();
+        if (r > 0 && (pfd[0].revents & POLLERR)) {
+            // Опоздавшая метка отправки: иначе poll() не уснет
+            while (ptp_recv(p->ev_fd, buf, sizeof(buf), &ts, 1) >= 0) {}
+        }
+        if (r > 0 && (pfd[0].revents & POLLIN)) {
+            while ((n = ptp_recv(p->ev_fd, buf, sizeof(buf), &ts, 0)) >= 0) ptp_handle(p, buf, n, ts ? ts : woke);
+        }
+        if (r > 0 && (pfd[1].revents & POLLIN)) {
+            while ((n = ptp_recv(p->gen_fd, buf, sizeof(buf), &ts, 0)) >= 0) ptp_handle(p, buf, n, woke);
+        }
+        // Пропажа мастера без новых Announce
+        if (ptp_mono() - last_select > 500000000LL) {
+            last_select = ptp_mono();
+            ptp_select(p);
+        }
+    }
+    return NULL;
+}
+
+static int ptp_socket(const char *iface, int ifindex, int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0), one = 1, zero = 0, ttl = 1;
+    struct sockaddr_in sa = { .sin_family = AF_INET, .sin_port = htons(port), .sin_addr.s_addr = htonl(INADDR_ANY) };
+    struct ip_mreqn mr = { .imr_ifindex = ifindex };
+
+    if (fd < 0) return -1;
+    inet_pton(AF_INET, PTP_MCAST_ADDR, &mr.imr_multiaddr);
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, iface, strlen(iface)) != 0 ||
+        bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mr, sizeof(mr)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &mr, sizeof(mr)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) != 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &zero, sizeof(zero)) != 0) {
+        printf("%sОшибка: PTP порт %d на %s: %s%s\n", COLOR_RED, port, iface, strerror(errno), COLOR_RESET);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int ptp_start(ptp_t *p, const char *iface, int domain) {
+    struct ifreq ifr;
+    int ifindex = if_nametoindex(iface);
+
+    memset(p, 0, sizeof(*p));
+    snprintf(p->iface, sizeof(p->iface), "%s", iface);
+    p->domain = domain;
+    p->best = -1;
+    p->ev_fd = p->gen_fd = -1;
+    if (!ifindex) {
+        printf("%sОшибка: нет интерфейса %s%s\n", COLOR_RED, iface, COLOR_RESET);
+        return -1;
+    }
+    p->ev_fd = ptp_socket(iface, ifindex, PTP_EVENT_PORT);
+    p->gen_fd = ptp_socket(iface, ifindex, PTP_GENERAL_PORT);
+    if (p->ev_fd < 0 || p->gen_fd < 0) {
+        if (p->ev_fd >= 0) close(p->ev_fd);
+        if (p->gen_fd >= 0) close(p->gen_fd);
+        return -1;
+    }
+
+    // clockIdentity из MAC (EUI-48 -> EUI-64 вставкой FFFE), порт 1
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, sizeof(ifr.ifr_name), "%s", iface);
+    if (ioctl(p->ev_fd, SIOCGIFHWADDR, &ifr) == 0) {
+        const uint8_t *mac = (const uint8_t *)ifr.ifr_hwaddr.sa_data;
+        uint8_t id[8] = { mac[0], mac[1], mac[2], 0xFF, 0xFE, mac[3], mac[4], mac[5] };
+        memcpy(p->self, id, 8);
+    }
+    p->self[9] = 1;
+
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    p->kernel_ts = setsockopt(p->ev_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+    ptp_servo_init(&p->servo, PTP_KP, PTP_KI, PTP_STEP_NS, PTP_LOCK_NS, 1);
+    ptp_publish(p);
+
+    if (rt_thread_create(&p->thread, RT_ROLE_SAMPLER, ptp_thread, p) != 0) {
+        printf("%sОшибка: поток PTP не создан%s\n", COLOR_RED, COLOR_RESET);
+        close(p->ev_fd);
+        close(p->gen_fd);
+        return -1;
+    }
+    ptp_clock = p;
+    return 0;
+}
+
+void ptp_stop(ptp_t *p) {
+    p->stop = 1;
+    pthread_join(p->thread, NULL);
+    close(p->ev_fd);
+    close(p->gen_fd);
+    if (ptp_clock == p) ptp_clock = NULL;
+}
+
+// Режим --ptp IFACE без других режимов: состояние раз в секунду
+int ptp_main(const char *iface, int domain) {
+    static ptp_t p;
+    char line[256];
+
+    if (ptp_start(&p, iface, domain) != 0) return 1;
+    printf("PTP follower on %s, domain %d, %s timestamps\n", iface, domain,
+           p.kernel_ts ? "kernel software" : "user space");
+    fflush(stdout);
+    while (global_tx->running) {
+        sleep(1);
+        ptp_format(&p, line, sizeof(line));
+        printf("%s\n", line);
+        fflush(stdout);
+    }
+    ptp_stop(&p);
+    printf("PTP: %ld syncs, %ld delay responses, %ld timeouts, %ld steps\n",
+           p.syncs, p.dresps, p.timeouts, p.servo.steps);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#ifndef FM_PTP_H
+#define FM_PTP_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "fm.h"
+
+// Ведомый PTPv2 (IEEE 1588, E2E, UDP/IPv4): оценка медиачасов AES67 без подстройки
+// системных часов - к ней подтягиваются вывод и ресемплер
+#define PTP_EVENT_PORT      319
+#define PTP_GENERAL_PORT    320
+#define PTP_MCAST_ADDR      "224.0.1.129"
+#define PTP_DOMAIN          0             // Медиапрофиль AES67 по умолчанию
+#define PTP_MAX_MASTERS     4             // Слышимых мастеров для выбора (BMCA)
+#define PTP_ANNOUNCE_LOST   3             // Интервалов Announce без пакета - мастер пропал
+#define PTP_DELAY_FILTER    7             // Медиана задержки пути по стольким измерениям
+#define PTP_KP              0.1           // ПИ сервопетли, как у ptp4l для программных меток:
+#define PTP_KI              0.001         // шум меток в десятки мкс не раскачивает частоту
+#define PTP_ESTIMATE_NS     1000000000LL  // Начальная частота - по точкам не ближе секунды
+#define PTP_STEP_NS         1000000       // Ошибка больше - модель переставляется скачком
+#define PTP_LOCK_NS         50000         // Порог захвата для программных меток
+#define PTP_LOCK_COUNT      8             // Sync подряд внутри порога до состояния LOCKED
+#define PTP_MAX_PPM         500.0         // Предел расхождения частот
+#define PTP_TXTS_MS         20            // Ожидание метки отправки Delay_Req от ядра
+#define PTP_DAC_KP          0.05          // Петля часов вывода: позиция шумит на период (5 мс),
+#define PTP_DAC_KI          0.001         // поэтому полоса ~0.03 Гц и без оценки по двум точкам
+#define PTP_DAC_STEP_NS     50000000      // Рассинхрон вывода больше 50 мс - новый отсчет
+
+typedef enum {
+    PTP_LISTENING = 0,                    // Нет мастера
+    PTP_UNCALIBRATED,                     // Есть Sync, идет первая оценка частоты и задержки
+    PTP_TRACKING,                         // Сервопетля работает, ошибка выше порога
+    PTP_LOCKED
+} ptp_state_t;
+
+// Время мастера по локальным CLOCK_REALTIME: m(l) = base_m + (l - base_l) * (1 + freq)
+typedef struct {
+    int64_t base_l, base_m;
+    double freq;                          // Ход мастера относительно локальных часов
+    int state;
+} ptp_model_t;
+
+// Сервопетля ПИ для любой пары часов: ptp_t ведет по ней модель, вывод - свои часы
+typedef struct {
+    double kp, ki;
+    int64_t step_ns, lock_ns;
+    ptp_model_t m;
+    int64_t last_l;
+    int estimate;                         // Начальная частота по двум первым точкам
+    int samples, in_lock;
+    int64_t err;                          // Последняя ошибка, нс
+    long steps;
+} ptp_servo_t;
+
+typedef struct {
+    uint8_t id[10];                       // clockIdentity + portNumber
+    uint8_t gm[8];
+    uint8_t prio1, cls, acc, prio2;
+    uint16_t var, steps_removed;
+    int log_interval;
+    int64_t last;                         // CLOCK_MONOTONIC последнего Announce
+} ptp_master_t;
+
+typedef struct {
+    char iface[32];
+    int domain;
+    int ev_fd, gen_fd;
+    int kernel_ts;                        // Метки ядра (SO_TIMESTAMPING), иначе из пользователя
+    uint8_t self[10];
+    ptp_master_t masters[PTP_MAX_MASTERS];
+    int best;                             // Индекс выбранного мастера, -1 - нет
+    // Обмен
+    int64_t sync_t2;                      // Прием последнего Sync
+    uint16_t sync_seq;
+    int sync_pending;                     // Двухшаговый: ждем Follow_Up
+    int64_t sync_corr;
+    int64_t t1, t2;                       // Пара последнего полного Sync (t1 с поправкой)
+    uint16_t dreq_seq;
+    int64_t t3, dreq_sent;
+    int dreq_pending, dreq_log;
+    int64_t delays[PTP_DELAY_FILTER];
+    int ndelays;
+    int64_t path_delay;
+    ptp_servo_t servo;
+    long syncs, dresps, timeouts;
+    // Опубликованная модель: seqlock, читают поток вывода и --serve
+    volatile uint32_t seq;
+    ptp_model_t pub;
+    volatile int64_t pub_offset, pub_delay;
+    volatile int pub_state;
+    pthread_t thread;
+    volatile int stop;
+} ptp_t;
+
+// Часы вывода против медиачасов: позиция вывода раз в секунду, поправка шага ресемплера
+typedef struct {
+    ptp_servo_t servo;
+    int64_t next;                         // CLOCK_REALTIME следующего замера
+    volatile int32_t ppb;                 // На сколько вывод быстрее медиачасов
+} ptp_dac_t;
+
+extern ptp_t *ptp_clock;
+
+int ptp_start(ptp_t *p, const char *iface, int domain);
+void ptp_stop(ptp_t *p);
+// Время мастера сейчас, нс PTP (TAI); возвращает ptp_state_t, время - при состоянии > LISTENING
+int ptp_now(ptp_t *p, int64_t *ptp_ns);
+double ptp_rate(ptp_t *p);
+void ptp_format(ptp_t *p, char *out, size_t size);
+void ptp_dac_update(ptp_t *p, ptp_dac_t *d, int64_t frames_played, int rate);
+int ptp_main(const char *iface, int domain);
+
+#endif // FM_PTP_H
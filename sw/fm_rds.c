@@ -0,0 +1,617 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_rds.h"
+
+// Векторы GCC: NEON на плате, SSE на ПК; окно ФНЧ сдвигается на шаг децимации, поэтому без выравнивания
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v4fu __attribute__((vector_size(16), aligned(4)));
+
+#define RDS_POLY 0x5B9       // g(x) = x^10 + x^8 + x^7 + x^5 + x^4 + x^3 + 1
+
+// Смещения A, B, C, C', D и номер блока в группе для каждого
+static const uint16_t rds_offsets[5] = {0x0FC, 0x198, 0x168, 0x350, 0x1B4};
+static const int rds_block_of[5] = {0, 1, 2, 2, 3};
+static const char *rds_offset_names[5] = {"A", "B", "C", "C'", "D"};
+
+// Синдром -> исправляемый пакет ошибок (0 - нет, ~0 - неоднозначно)
+static uint32_t rds_fix[1024];
+static int rds_fix_ready = 0;
+
+static uint16_t rds_crc(uint16_t data) {
+    uint32_t reg = (uint32_t)data << 10;
+    for (int i = 25; i >= 10; i--) {
+        if (reg & (1u << i)) reg ^= (uint32_t)RDS_POLY << (i - 10);
+    }
+    return reg & 0x3FF;
+}
+
+static uint16_t rds_syndrome(uint32_t word) {
+    return rds_crc(word >> 10) ^ (word & 0x3FF);
+}
+
+static void rds_fix_init(void) {
+    if (rds_fix_ready) return;
+    for (uint32_t p = 1; p < (1u << RDS_MAX_BURST); p += 2) {
+        int len = 32 - __builtin_clz(p);
+        for (int s = 0; s + len <= 26; s++) {
+            uint32_t e = p << s;
+            uint16_t syn = rds_syndrome(e);
+            rds_fix[syn] = rds_fix[syn] ? 0xFFFFFFFF : e;
+        }
+    }
+    rds_fix_ready = 1;
+}
+
+static uint32_t rds_mjd(time_t t) {
+    return (uint32_t)(t / 86400 + 40587);
+}
+
+// ---------------- Модель: кодер RDS и MPX ----------------
+
+// Следующая группа: PS (0A) и RT (2A) по очереди, CT (4A) в начале каждой минуты
+static void rds_model_group(rds_model_t *m) {
+    uint16_t blk[4];
+    time_t now = m->start + m->sample / m->rate;
+    struct tm tm;
+    gmtime_r(&now, &tm);
+
+    blk[0] = m->pi;
+    if (tm.tm_min != m->last_minute) {
+        uint32_t mjd = rds_mjd(now);
+        m->last_minute = tm.tm_min;
+        blk[1] = (4 << 12) | (m->pty << 5) | (mjd >> 15);
+        blk[2] = (uint16_t)((mjd << 1) | (tm.tm_hour >> 4));
+        blk[3] = (uint16_t)(((tm.tm_hour & 0xF) << 12) | (tm.tm_min << 6));
+    } else if (m->group % 8 < 4) {
+        int seg = m->group % 4;
+        blk[1] = (0 << 12) | (m->pty << 5) | (1 << 3) | seg;
+        blk[2] = 0xE0CD;                                   // Нет альтернативных частот
+        blk[3] = (uint16_t)((uint8_t)m->ps[2 * seg] << 8 | (uint8_t)m->ps[2 * seg + 1]);
+    } else {
+        int seg = (int)((m->group / 8 * 4 + m->group % 8 - 4) % m->rt_segments);
+        const uint8_t *c = (const uint8_t *)m->rt + 4 * seg;
+        blk[1] = (2 << 12) | (m->pty << 5) | seg;
+        blk[2] = (uint16_t)(c[0] << 8 | c[1]);
+        blk[3] = (uint16_t)(c[2] << 8 | c[3]);
+    }
+    m->group++;
+
+    // 16 бит данных + 10 бит проверки, старшим вперед, дифференциальное кодирование
+    int n = 0;
+    for (int b = 0; b < 4; b++) {
+        uint32_t word = (uint32_t)blk[b] << 10 | (rds_crc(blk[b]) ^ rds_offsets[b == 3 ? 4 : b]);
+        for (int i = 25; i >= 0; i--) {
+            m->prev ^= (word >> i) & 1;
+            m->bits[n++] = m->prev ? 1 : -1;
+        }
+    }
+    m->bit = 0;
+}
+
+void rds_model_init(rds_model_t *m, int rate, uint16_t pi, const char *ps, const char *rt) {
+    memset(m, 0, sizeof(*m));
+    m->rate = rate;
+    m->pi = pi;
+    m->pty = 10;                 // Pop music
+    m->seed = 1;
+    m->start = time(NULL);
+    m->last_minute = -1;
+
+    memset(m->ps, ' ', sizeof(m->ps));
+    memcpy(m->ps, ps, strnlen(ps, sizeof(m->ps)));
+    memset(m->rt, ' ', sizeof(m->rt));
+    size_t len = strnlen(rt, sizeof(m->rt));
+    memcpy(m->rt, rt, len);
+    if (len < sizeof(m->rt)) m->rt[len++] = 0x0D;          // Конец текста
+    m->rt_segments = (int)((len + 3) / 4);
+    rds_model_group(m);
+}
+
+// MPX: (L+R)/2, (L-R)/2 на 38 кГц, пилот 19 кГц, RDS на 57 кГц, все от одной фазы пилота
+void rds_model_render(rds_model_t *m, int16_t *out, int n) {
+    const double bstep = RDS_BITRATE / m->rate;
+    const double pstep = 2.0 * M_PI * 19000.0 / m->rate;
+    const double astep[2] = {2.0 * M_PI * 400.0 / m->rate, 2.0 * M_PI * 1000.0 / m->rate};
+
+    for (int i = 0; i < n; i++) {
+        if (m->bphase >= 1.0) {
+            m->bphase -= 1.0;
+            if (++m->bit >= 104) rds_model_group(m);
+        }
+        double rds = m->bits[m->bit] * sin(2.0 * M_PI * m->bphase);
+        double l = 0.5 * sin(m->audio[0]), r = 0.5 * sin(m->audio[1]);
+        double mpx = 0.9 * ((l + r) * 0.5 + (l - r) * 0.5 * sin(2.0 * m->pilot))
+                   + 0.09 * sin(m->pilot) + RDS_LEVEL * rds * sin(3.0 * m->pilot);
+        if (m->noise > 0) {
+            // Приближенно гауссов шум: сумма четырех равномерных
+            double g = 0;
+            for (int k = 0; k < 4; k++) {
+                m->seed = m->seed * 1664525u + 1013904223u;
+                g += (double)(m->seed >> 8) / 16777216.0 - 0.5;
+            }
+            mpx += m->noise * g * 1.7320508;
+        }
+        long v = lrint(mpx * 32767.0);
+        out[i] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+
+        m->bphase += bstep;
+        m->pilot += pstep;
+        if (m->pilot > 2.0 * M_PI) m->pilot -= 2.0 * M_PI;
+        for (int k = 0; k < 2; k++) {
+            m->audio[k] += astep[k];
+            if (m->audio[k] > 2.0 * M_PI) m->audio[k] -= 2.0 * M_PI;
+        }
+        m->sample++;
+    }
+}
+
+// ---------------- Декодер ----------------
+
+static double rds_stream_time(const rds_dec_t *d) {
+    return d->n * (double)d->decim / d->rate;
+}
+
+static void rds_log(rds_dec_t *d, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void rds_log(rds_dec_t *d, const char *fmt, ...) {
+    va_list ap;
+    if (!d->verbose) return;
+    printf("[rds] %9.3f s  ", rds_stream_time(d));
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+    fflush(stdout);
+}
+
+static long rds_gcd(long a, long b) {
+    while (b) {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int rds_dec_init(rds_dec_t *d, int rate) {
+    memset(d, 0, sizeof(*d));
+    if (rate < 128000) {
+        printf("%sОшибка: частота MPX %d Гц ниже 128 кГц - поднесущая 57 кГц не помещается%s\n",
+               COLOR_RED, rate, COLOR_RESET);
+        return -1;
+    }
+    d->rate = rate;
+    d->decim = (int)lrint((double)rate / RDS_DECIM_RATE);
+    d->sps = (double)rate / d->decim / RDS_BITRATE;
+    d->nco_len = (int)(rate / rds_gcd(rate, (long)RDS_CARRIER));
+    if (d->nco_len > RDS_NCO_MAX || d->sps > RDS_MAX_SPS) {
+        printf("%sОшибка: частота MPX %d Гц не поддерживается%s\n", COLOR_RED, rate, COLOR_RESET);
+        return -1;
+    }
+
+    // Таблица 57 кГц на полный период, чтобы фаза не накапливала ошибку
+    d->nco = malloc(2 * d->nco_len * sizeof(float));
+    if (!d->nco) return -1;
+    for (int i = 0; i < d->nco_len; i++) {
+        double ph = 2.0 * M_PI * (double)((long long)RDS_CARRIER * i % rate) / rate;
+        d->nco[2 * i] = (float)cos(ph);
+        d->nco[2 * i + 1] = (float)-sin(ph);
+    }
+
+    // ФНЧ: окно Блэкмана, коэффициенты продублированы под чередование I/Q
+    double sum = 0, h[RDS_FIR_TAPS];
+    for (int k = 0; k < RDS_FIR_TAPS; k++) {
+        double x = k - (RDS_FIR_TAPS - 1) / 2.0;
+        double wc = 2.0 * RDS_FIR_CUTOFF / rate;
+        double w = 0.42 - 0.5 * cos(2.0 * M_PI * k / (RDS_FIR_TAPS - 1))
+                 + 0.08 * cos(4.0 * M_PI * k / (RDS_FIR_TAPS - 1));
+        h[k] = (x == 0 ? wc : sin(M_PI * wc * x) / (M_PI * x)) * w;
+        sum += h[k];
+    }
+    for (int k = 0; k < RDS_FIR_TAPS; k++) {
+        d->taps[2 * k] = d->taps[2 * k + 1] = (float)(h[k] / sum);
+    }
+
+    // Бифазный символ: положительная полуволна, затем отрицательная
+    d->tmpl_len = (int)lrint(d->sps);
+    for (int k = 0; k < d->tmpl_len; k++) {
+        d->tmpl[k] = (float)sin(2.0 * M_PI * (k + 0.5) / d->sps);
+    }
+    d->t_next = d->tmpl_len;
+
+    for (int i = 0; i < 5; i++) d->seen[i] = -1000;
+    memset(d->info.ps, ' ', 8);
+    memset(d->info.rt, ' ', 64);
+    d->rt_len = 64;
+    d->sync_at = -1;
+    d->verbose = 1;
+    rds_fix_init();
+    return 0;
+}
+
+void rds_dec_free(rds_dec_t *d) {
+    free(d->nco);
+    d->nco = NULL;
+}
+
+static void rds_show_text(rds_dec_t *d, const char *label, const char *text, int len, char *shown) {
+    char s[65];
+    memcpy(s, text, len);
+    s[len] = 0;
+    while (len > 0 && s[len - 1] == ' ') s[--len] = 0;
+    if (strcmp(s, shown) == 0) return;
+    strcpy(shown, s);
+    rds_log(d, "%s \"%s\"", label, s);
+}
+
+// Разбор группы: PI, PTY/TP, PS (0A/0B), RT (2A/2B), CT (4A)
+static void rds_group(rds_dec_t *d) {
+    if (!(d->grp_ok & 2)) return;
+    uint16_t b = d->grp[1], c = d->grp[2], dd = d->grp[3];
+    int type = b >> 12, ver = (b >> 11) & 1;
+    d->groups++;
+    d->group_types[type * 2 + ver]++;
+
+    // PI принимается после двух одинаковых значений подряд
+    int have_pi = (d->grp_ok & 1) || (ver && (d->grp_ok & 4));
+    if (have_pi) {
+        uint16_t pi = (d->grp_ok & 1) ? d->grp[0] : c;
+        if (pi == d->pi_cand && pi != d->info.pi) {
+            d->info.pi = pi;
+            rds_log(d, "PI %04X", pi);
+        }
+        d->pi_cand = pi;
+    }
+    if (d->info.pty != ((b >> 5) & 0x1F) || d->info.tp != ((b >> 10) & 1)) {
+        d->info.pty = (b >> 5) & 0x1F;
+        d->info.tp = (b >> 10) & 1;
+        rds_log(d, "PTY %d TP %d", d->info.pty, d->info.tp);
+    }
+
+    if (type == 0 && (d->grp_ok & 8)) {
+        int seg = b & 3;
+        d->info.ps[2 * seg] = (char)(dd >> 8);
+        d->info.ps[2 * seg + 1] = (char)(dd & 0xFF);
+        d->ps_mask |= 1 << seg;
+        if (d->ps_mask == 0xF) rds_show_text(d, "PS", d->info.ps, 8, d->ps_shown);
+    } else if (type == 2) {
+        int ab = (b >> 4) & 1, seg = b & 0xF, per = ver ? 2 : 4;
+        // Смена флага A/B - передается новый текст
+        if (ab != d->rt_ab) {
+            d->rt_ab = ab;
+            d->rt_mask = 0;
+            d->rt_len = 64;
+            memset(d->info.rt, ' ', 64);
+        }
+        uint8_t ch[4] = {c >> 8, c & 0xFF, dd >> 8, dd & 0xFF};
+        const uint8_t *src = ver ? ch + 2 : ch;
+        if ((d->grp_ok & 8) && (ver || (d->grp_ok & 4))) {
+            for (int i = 0; i < per; i++) {
+                int pos = seg * per + i;
+                if (src[i] == 0x0D) {
+                    if (pos < d->rt_len) d->rt_len = pos;
+                } else if (pos < 64) {
+                    d->info.rt[pos] = (char)src[i];
+                }
+            }
+            d->rt_mask |= 1u << seg;
+            int need = (d->rt_len + per - 1) / per;
+            if (d->rt_len < 64 && need < 16) need = (d->rt_len + per) / per;   // С сегментом конца
+            uint32_t all = need >= 32 ? 0xFFFFFFFF : (1u << need) - 1;
+            if ((d->rt_mask & all) == all) rds_show_text(d, "RT", d->info.rt, d->rt_len, d->rt_shown);
+        }
+    } else if (type == 4 && !ver && (d->grp_ok & 0xC) == 0xC) {
+        long mjd = ((long)(b & 3) << 15) | (c >> 1);
+        int yp = (int)((mjd - 15078.2) / 365.25);
+        int mp = (int)((mjd - 14956.1 - (int)(yp * 365.25)) / 30.6001);
+        int k = (mp == 14 || mp == 15) ? 1 : 0;
+        rds_info_t *in = &d->info;
+        in->day = (int)(mjd - 14956 - (int)(yp * 365.25) - (int)(mp * 30.6001));
+        in->year = yp + k + 1900;
+        in->month = mp - 1 - k * 12;
+        in->hour = ((c & 1) << 4) | (dd >> 12);
+        in->minute = (dd >> 6) & 0x3F;
+        in->offset = (dd & 0x20) ? -(dd & 0x1F) : (dd & 0x1F);
+        in->ct_valid = 1;
+        rds_log(d, "CT %04d-%02d-%02d %02d:%02d UTC%+.1f h", in->year, in->month, in->day,
+                in->hour, in->minute, in->offset / 2.0);
+    }
+}
+
+// Принятый в синхронизации блок: проверка синдрома и исправление пакета ошибок
+static void rds_block(rds_dec_t *d) {
+    uint32_t w = d->reg;
+    uint16_t syn = rds_syndrome(w);
+    int idx = d->block == 3 ? 4 : d->block;
+    int ok = 0;
+
+    if (syn == rds_offsets[idx] || (d->block == 2 && syn == rds_offsets[3])) {
+        ok = 1;
+    } else {
+        uint32_t e = rds_fix[syn ^ rds_offsets[idx]];
+        if ((e == 0 || e == 0xFFFFFFFF) && d->block == 2) e = rds_fix[syn ^ rds_offsets[3]];
+        if (e != 0 && e != 0xFFFFFFFF) {
+            w ^= e;
+            ok = 2;
+        }
+    }
+
+    d->blocks++;
+    if (ok == 1) d->blocks_ok++;
+    else if (ok == 2) d->corrected++;
+    else d->uncorrectable++;
+
+    d->bad_hist = (d->bad_hist << 1) | (ok == 0);
+    if (__builtin_popcountll(d->bad_hist & 0xFFFFFFFFULL) > RDS_SYNC_LOSS) {
+        d->synced = 0;
+        d->sync_losses++;
+        for (int i = 0; i < 5; i++) d->seen[i] = -1000;
+        rds_log(d, "sync lost");
+        return;
+    }
+
+    if (d->block == 0) d->grp_ok = 0;
+    if (ok) {
+        d->grp[d->block] = (uint16_t)(w >> 10);
+        d->grp_ok |= 1 << d->block;
+    }
+    if (d->block == 3) {
+        rds_group(d);
+        d->grp_ok = 0;
+    }
+}
+
+// Очередной бит: поиск синхронизации по двум смещениям на правильном расстоянии
+static void rds_bit(rds_dec_t *d, int bit) {
+    d->reg = ((d->reg << 1) | bit) & 0x3FFFFFF;
+    d->bits++;
+
+    if (d->synced) {
+        if (++d->block_bits < 26) return;
+        d->block_bits = 0;
+        d->block = (d->block + 1) % 4;
+        rds_block(d);
+        return;
+    }
+
+    uint16_t syn = rds_syndrome(d->reg);
+    for (int t = 0; t < 5; t++) {
+        if (syn != rds_offsets[t]) continue;
+        for (int u = 0; u < 5 && !d->synced; u++) {
+            long dist = d->bits - d->seen[u];
+            if (dist <= 0 || dist % 26 != 0 || dist > 26 * 8) continue;
+            if ((rds_block_of[u] + dist / 26) % 4 != rds_block_of[t]) continue;
+            d->synced = 1;
+            d->block = rds_block_of[t];
+            d->block_bits = 0;
+            d->bad_hist = 0;
+            d->grp_ok = 0;
+            if (d->sync_at < 0) d->sync_at = rds_stream_time(d);
+            rds_log(d, "sync on %s/%s", rds_offset_names[u], rds_offset_names[t]);
+            rds_block(d);
+        }
+        d->seen[t] = d->bits;
+        break;
+    }
+}
+
+// Линейная интерполяция выхода согласованного фильтра в дробный момент
+static void rds_y_at(const rds_dec_t *d, double t, float *yi, float *yq) {
+    long i = (long)t;
+    float f = (float)(t - i);
+    *yi = d->yi[i & 63] * (1 - f) + d->yi[(i + 1) & 63] * f;
+    *yq = d->yq[i & 63] * (1 - f) + d->yq[(i + 1) & 63] * f;
+}
+
+// Отсчет после децимации: согласованный фильтр, early-late, дифференциальное детектирование
+static void rds_sample(rds_dec_t *d, float zi, float zq) {
+    const int len = d->tmpl_len;
+    const double dl = d->sps / 4;
+    float yi = 0, yq = 0;
+
+    d->zi[d->zpos] = d->zi[d->zpos + len] = zi;
+    d->zq[d->zpos] = d->zq[d->zpos + len] = zq;
+    d->zpos = (d->zpos + 1) % len;
+    for (int k = 0; k < len; k++) {
+        yi += d->tmpl[k] * d->zi[d->zpos + k];
+        yq += d->tmpl[k] * d->zq[d->zpos + k];
+    }
+    d->yi[d->n & 63] = yi;
+    d->yq[d->n & 63] = yq;
+    d->n++;
+
+    // Нужен отсчет и после позднего момента
+    while (d->t_next + dl + 1 < d->n) {
+        float si, sq, ei, eq, li, lq;
+        if (d->t_next - dl < d->n - 60) d->t_next = d->n - dl - 2;
+        rds_y_at(d, d->t_next, &si, &sq);
+        rds_y_at(d, d->t_next - dl, &ei, &eq);
+        rds_y_at(d, d->t_next + dl, &li, &lq);
+        float early = ei * ei + eq * eq, late = li * li + lq * lq;
+        d->t_next += d->sps * (1.0 + RDS_TIMING_GAIN * (late - early) / (late + early + 1e-20f));
+
+        // Фаза несущей неизвестна, но одинакова у соседних символов
+        float dot = si * d->prev_i + sq * d->prev_q;
+        d->prev_i = si;
+        d->prev_q = sq;
+        rds_bit(d, dot < 0);
+    }
+}
+
+// Перенос 57 кГц в ноль, ФНЧ и децимация; вычисляются только нужные выходные отсчеты
+void rds_dec_process(rds_dec_t *d, const int16_t *x, int n) {
+    const int cap = RDS_FIR_TAPS + RDS_CHUNK;
+
+    while (n > 0) {
+        int m = cap - d->fill;
+        if (m > n) m = n;
+        float *dst = d->buf + 2 * d->fill;
+        for (int i = 0; i < m;) {
+            int run = d->nco_len - d->nco_pos;
+            if (run > m - i) run = m - i;
+            const float *c = d->nco + 2 * d->nco_pos;
+            for (int k = 0; k < run; k++) {
+                float v = x[i + k] * (1.0f / 32768.0f);
+                dst[2 * (i + k)] = v * c[2 * k];
+                dst[2 * (i + k) + 1] = v * c[2 * k + 1];
+            }
+            i += run;
+            d->nco_pos += run;
+            if (d->nco_pos == d->nco_len) d->nco_pos = 0;
+        }
+        d->fill += m;
+        x += m;
+        n -= m;
+
+        const v4f *h = (const v4f *)d->taps;
+        while (d->next_out + RDS_FIR_TAPS <= d->fill) {
+            const v4fu *s = (const v4fu *)(d->buf + 2 * d->next_out);
+            v4f a0 = {0, 0, 0, 0}, a1 = {0, 0, 0, 0};
+            for (int k = 0; k < RDS_FIR_TAPS / 2; k += 2) {
+                a0 += s[k] * h[k];
+                a1 += s[k + 1] * h[k + 1];
+            }
+            a0 += a1;
+            rds_sample(d, a0[0] + a0[2], a0[1] + a0[3]);
+            d->next_out += d->decim;
+        }
+
+        int keep = d->fill - d->next_out;
+        memmove(d->buf, d->buf + 2 * d->next_out, keep * 2 * sizeof(float));
+        d->fill = keep;
+        d->next_out = 0;
+    }
+}
+
+void rds_dec_report(rds_dec_t *d, FILE *out) {
+    rds_info_t *in = &d->info;
+
+    if (d->groups == 0) {
+        fprintf(out, "No RDS groups decoded (%ld bits)\n", d->bits);
+        return;
+    }
+    fprintf(out, "PI:      %04X   PTY: %d   TP: %d\n", in->pi, in->pty, in->tp);
+    fprintf(out, "PS:      \"%s\"\n", d->ps_shown);
+    fprintf(out, "RT:      \"%s\"\n", d->rt_shown);
+    if (in->ct_valid) {
+        fprintf(out, "CT:      %04d-%02d-%02d %02d:%02d UTC%+.1f h\n", in->year, in->month, in->day,
+                in->hour, in->minute, in->offset / 2.0);
+    }
+    fprintf(out, "Blocks:  %ld, %ld ok, %ld corrected, %ld uncorrectable (BLER %.2f%%)\n",
+            d->blocks, d->blocks_ok, d->corrected, d->uncorrectable,
+            d->blocks ? 100.0 * d->uncorrectable / d->blocks : 0.0);
+    fprintf(out, "Groups:  %ld", d->groups);
+    for (int t = 0; t < 32; t++) {
+        if (d->group_types[t]) fprintf(out, "  %d%c: %ld", t / 2, t % 2 ? 'B' : 'A', d->group_types[t]);
+    }
+    fprintf(out, "\nSync:    after %.3f s, lost %ld times\n", d->sync_at, d->sync_losses);
+}
+
+static double rds_cpu_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// --rds-decode: MPX моно S16 из файла, stdin или устройства захвата
+int rds_decode(const char *dev_name, int rate) {
+    rds_dec_t *d = malloc(sizeof(*d));
+    int16_t buf[RDS_CHUNK];
+    audio_dev_t dev;
+    long samples = 0;
+    int n;
+
+    if (!d || rds_dec_init(d, rate) != 0) {
+        free(d);
+        return 1;
+    }
+    if (audio_open(&dev, dev_name, AUDIO_CAPTURE, rate, 1) != 0) {
+        rds_dec_free(d);
+        free(d);
+        return 1;
+    }
+
+    double cpu = 0;
+    while (global_tx->running && (n = audio_read(&dev, buf, RDS_CHUNK)) > 0) {
+        double t0 = rds_cpu_now();
+        rds_dec_process(d, buf, n);
+        cpu += rds_cpu_now() - t0;
+        samples += n;
+    }
+    audio_close(&dev);
+
+    rds_dec_report(d, stdout);
+    printf("Decoded %.1f s of MPX at %d Hz in %.3f s CPU (%.0fx real time)\n",
+           (double)samples / rate, rate, cpu, cpu > 0 ? samples / (double)rate / cpu : 0.0);
+    int ret = d->groups > 0 ? 0 : 1;
+    rds_dec_free(d);
+    free(d);
+    return ret;
+}
+
+// --rds-gen: MPX модели в файл или на устройство (0 секунд - до остановки)
+int rds_generate(const char *dev_name, int rate, int seconds, uint16_t pi, const char *ps, const char *rt) {
+    rds_model_t m;
+    int16_t buf[RDS_CHUNK];
+    audio_dev_t dev;
+
+    rds_model_init(&m, rate, pi, ps, rt);
+    if (audio_open(&dev, dev_name, 0, rate, 1) != 0) return 1;
+    printf("MPX at %d Hz: PI %04X, PS \"%.8s\", RT \"%s\"\n", rate, pi, m.ps, rt);
+    fflush(stdout);
+
+    long total = (long)seconds * rate;
+    while (global_tx->running && (seconds == 0 || m.sample < total)) {
+        int n = RDS_CHUNK;
+        if (seconds > 0 && total - m.sample < n) n = (int)(total - m.sample);
+        rds_model_render(&m, buf, n);
+        if (audio_write(&dev, buf, n) != n) break;
+    }
+    audio_close(&dev);
+    return 0;
+}
+
+// --rds-bench: модель с шумом и расхождением тактов -> декодер, проверка и скорость
+int rds_bench(int seconds) {
+    static const char *ps = "ANTMINER", *rt = "Antminer S9 FM transmitter - RDS loopback test";
+    const int rate = RDS_RATE;
+    rds_model_t m;
+    rds_dec_t *d = malloc(sizeof(*d));
+    int16_t buf[RDS_CHUNK];
+
+    if (!d || rds_dec_init(d, rate) != 0) {
+        free(d);
+        return 1;
+    }
+    d->verbose = 0;
+    // Такт модели на 48 ppm быстрее - как у независимого АЦП
+    rds_model_init(&m, rate + 11, 0x7A51, ps, rt);
+    m.noise = 0.06;
+
+    double cpu = 0;
+    long total = (long)seconds * rate;
+    while (global_tx->running && m.sample < total) {
+        rds_model_render(&m, buf, RDS_CHUNK);
+        double t0 = rds_cpu_now();
+        rds_dec_process(d, buf, RDS_CHUNK);
+        cpu += rds_cpu_now() - t0;
+    }
+
+    rds_dec_report(d, stdout);
+    int pass = d->info.pi == m.pi && strcmp(d->ps_shown, ps) == 0 && strcmp(d->rt_shown, rt) == 0 &&
+               d->info.ct_valid;
+    printf("Decoded %.1f s of MPX at %d Hz in %.3f s CPU (%.0fx real time)\n",
+           (double)m.sample / rate, rate, cpu, cpu > 0 ? m.sample / (double)rate / cpu : 0.0);
+    printf("%s%s%s\n", pass ? COLOR_GREEN : COLOR_RED, pass ? "PASS" : "FAIL: decoded text differs from the model",
+           COLOR_RESET);
+    rds_dec_free(d);
+    free(d);
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+#ifndef FM_RDS_H
+#define FM_RDS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+// Декодер RDS из отсчетов MPX: проверка того, что реально уходит в эфир
+#define RDS_RATE          228000   // MPX по умолчанию: 12 * 19 кГц, ровно 192 отсчета на бит
+#define RDS_BITRATE       1187.5
+#define RDS_CARRIER       57000.0
+#define RDS_DECIM_RATE    19000    // После децимации ~16 отсчетов на бит
+#define RDS_FIR_TAPS      96       // ФНЧ перед децимацией (кратно 2)
+#define RDS_FIR_CUTOFF    3000.0
+#define RDS_CHUNK         4096     // Входных отсчетов за проход
+#define RDS_NCO_MAX       65536    // Период таблицы 57 кГц на частоте MPX
+#define RDS_MAX_SPS       32       // Отсчетов на бит после децимации
+#define RDS_TIMING_GAIN   0.02     // Петля тактовой синхронизации (early-late)
+#define RDS_MAX_BURST     2        // Исправляемый пакет ошибок, бит (код позволяет 5, но растут ложные исправления)
+#define RDS_SYNC_LOSS     20       // Плохих блоков из последних 32 до потери синхронизации
+#define RDS_LEVEL         0.04     // Поднесущая RDS в модели, доля MPX (3 кГц девиации)
+
+// Кодер-модель: PI/PS/RT/CT -> MPX с пилот-тоном и стереозвуком
+typedef struct {
+    int rate;
+    uint16_t pi;
+    int pty;
+    char ps[8];
+    char rt[64];
+    int rt_segments;
+    double noise;                // СКО шума, доля полной шкалы
+    // Состояние
+    long group;                  // Номер группы
+    int bits[104];               // Биты текущей группы после дифференциального кодирования
+    int bit;                     // Номер бита в группе
+    int prev;                    // Предыдущий переданный бит
+    double bphase;               // Фаза бита 0..1
+    double pilot;                // Фаза 19 кГц
+    double audio[2];
+    long sample;
+    uint32_t seed;
+    time_t start;                // Часы модели для группы 4A
+    int last_minute;
+} rds_model_t;
+
+typedef struct {
+    uint16_t pi;
+    int pty, tp;
+    char ps[9];
+    char rt[65];
+    int ct_valid;
+    int year, month, day, hour, minute, offset;   // offset в получасах
+} rds_info_t;
+
+typedef struct {
+    int rate;
+    int decim;
+    double sps;                  // Отсчетов на бит после децимации
+    // Перенос 57 кГц в ноль и ФНЧ с децимацией
+    float *nco;                  // cos, -sin чередуются
+    int nco_len, nco_pos;
+    float taps[2 * RDS_FIR_TAPS] __attribute__((aligned(16)));
+    float buf[2 * (RDS_FIR_TAPS + RDS_CHUNK)] __attribute__((aligned(16)));
+    int fill;                    // Комплексных отсчетов в buf
+    int next_out;                // Начало окна следующего выходного отсчета
+    // Согласованный фильтр бифазного символа и тактовая синхронизация
+    float tmpl[RDS_MAX_SPS];
+    int tmpl_len;
+    float zi[2 * RDS_MAX_SPS], zq[2 * RDS_MAX_SPS];
+    int zpos;
+    float yi[64], yq[64];        // Выход согласованного фильтра
+    long n;                      // Номер отсчета после децимации
+    double t_next;               // Момент следующего символа
+    float prev_i, prev_q;
+    // Блоки и группы
+    uint32_t reg;                // Последние 26 бит
+    long bits;
+    int synced;
+    long seen[5];                // Номер бита последнего найденного смещения A, B, C, C', D
+    int block, block_bits;
+    uint64_t bad_hist;           // Плохие блоки (последние 32)
+    uint16_t grp[4];
+    int grp_ok;                  // Маска принятых блоков группы
+    // Разобранное
+    rds_info_t info;
+    int ps_mask;
+    uint32_t rt_mask;
+    int rt_ab, rt_len;
+    uint16_t pi_cand;
+    char ps_shown[9], rt_shown[65];
+    int verbose;
+    // Статистика
+    long blocks, blocks_ok, corrected, uncorrectable, groups, sync_losses;
+    long group_types[32];
+    double sync_at;              // Время потока до первой синхронизации, с
+} rds_dec_t;
+
+void rds_model_init(rds_model_t *m, int rate, uint16_t pi, const char *ps, const char *rt);
+void rds_model_render(rds_model_t *m, int16_t *out, int n);
+
+int rds_dec_init(rds_dec_t *d, int rate);
+void rds_dec_free(rds_dec_t *d);
+void rds_dec_process(rds_dec_t *d, const int16_t *x, int n);
+void rds_dec_report(rds_dec_t *d, FILE *out);
+
+int rds_decode(const char *dev, int rate);
+int rds_generate(const char *dev, int rate, int seconds, uint16_t pi, const char *ps, const char *rt);
+int rds_bench(int seconds);
+
+#endif // FM_RDS_H
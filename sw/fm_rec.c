@@ -0,0 +1,494 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_flac.h"
+#include "fm_rt.h"
+#include "fm_rec.h"
+
+// Кольцо захвата: один производитель (поток захвата), один потребитель (кодер)
+typedef struct {
+    audio_dev_t dev;
+    int live;                        // Устройство: при переполнении кадры теряются, а не ждут
+    int16_t *ring;
+    volatile uint32_t head, tail;
+    volatile int eof, stop;
+    long overruns;                   // Потерянных кадров
+} rec_capture_t;
+
+// Открытый сегмент
+typedef struct {
+    int fd, idx_fd;
+    char path[512];
+    int64_t start_ns, end_ns;        // Первый отсчет и граница сегмента
+    uint64_t samples;
+    uint64_t file_bytes;             // Передано в write() (смещение следующего куска)
+    size_t header;                   // Зарезервировано под заголовок
+    int slots;                       // Точек SEEKTABLE
+    rec_index_t *index;              // Все точки сегмента
+    int nindex, index_cap, index_flushed;
+    double write_ms_max;
+} rec_segment_t;
+
+static int64_t rec_realtime_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (int64_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static double rec_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double rec_cpu_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void *rec_capture_thread(void *arg) {
+    rec_capture_t *c = arg;
+    int16_t buf[AUDIO_PERIOD * AUDIO_CHANNELS];
+
+    while (!c->stop) {
+        uint32_t head = c->head;
+        uint32_t used = head - __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+        if (REC_RING_FRAMES - used < AUDIO_PERIOD && !c->live) {
+            usleep(1000);
+            continue;
+        }
+        int n = audio_read(&c->dev, buf, AUDIO_PERIOD);
+        if (n > 0) {
+            if (REC_RING_FRAMES - used < (uint32_t)n) {
+                c->overruns += n;
+            } else {
+                for (int i = 0; i < n; i++) {
+                    uint32_t k = (head + i) & (REC_RING_FRAMES - 1);
+                    c->ring[k * 2] = buf[i * 2];
+                    c->ring[k * 2 + 1] = buf[i * 2 + 1];
+                }
+                __atomic_store_n(&c->head, head + n, __ATOMIC_RELEASE);
+            }
+        }
+        if (n < AUDIO_PERIOD) break;
+    }
+    __atomic_store_n(&c->eof, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static int rec_write_all(int fd, const uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// Точки индекса, чьи кадры уже отданы на карту
+static void rec_index_flush(rec_segment_t *s, int all) {
+    int n = s->index_flushed;
+    while (n < s->nindex && (all || s->index[n].offset < s->file_bytes)) n++;
+    if (n > s->index_flushed && s->idx_fd >= 0) {
+        rec_write_all(s->idx_fd, (const uint8_t *)(s->index + s->index_flushed),
+                      (n - s->index_flushed) * sizeof(rec_index_t));
+    }
+    s->index_flushed = n;
+}
+
+// Кусок из начала буфера на карту; fdatasync, чтобы запись не копилась в кэше,
+// и кэш страниц освобождается - карта не должна вытеснять остальное
+static int rec_flush(rec_segment_t *s, uint8_t *wbuf, size_t *fill, size_t len) {
+    double t0 = rec_now();
+    if (rec_write_all(s->fd, wbuf, len) != 0) {
+        printf("%sОшибка: запись %s: %s%s\n", COLOR_RED, s->path, strerror(errno), COLOR_RESET);
+        return -1;
+    }
+    fdatasync(s->fd);
+    posix_fadvise(s->fd, s->file_bytes, len, POSIX_FADV_DONTNEED);
+    s->file_bytes += len;
+    double ms = (rec_now() - t0) * 1000.0;
+    if (ms > s->write_ms_max) s->write_ms_max = ms;
+
+    memmove(wbuf, wbuf + len, *fill - len);
+    *fill -= len;
+    rec_index_flush(s, 0);
+    return 0;
+}
+
+static int rec_open_segment(rec_segment_t *s, const char *dir, int64_t start_ns, int segment_sec,
+                            flac_enc_t *enc, uint8_t *wbuf, size_t *fill) {
+    char name[64];
+    time_t t = (time_t)(start_ns / 1000000000LL);
+    struct tm tm;
+    // Имя по UTC: в повторяющийся час перевода часов местное время дало бы то же имя
+    gmtime_r(&t, &tm);
+    strftime(name, sizeof(name), REC_NAME_FORMAT "Z", &tm);
+
+    memset(s, 0, sizeof(*s));
+    s->idx_fd = -1;
+    s->start_ns = start_ns;
+    int64_t seg_ns = (int64_t)segment_sec * 1000000000LL;
+    s->end_ns = (start_ns / seg_ns + 1) * seg_ns;
+    s->slots = segment_sec / REC_SEEK_SEC + 2;
+    s->index_cap = segment_sec + 16;
+    s->index = malloc(s->index_cap * sizeof(rec_index_t));
+
+    snprintf(s->path, sizeof(s->path), "%s/%s.flac", dir, name);
+    s->fd = open(s->path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (s->fd < 0 || !s->index) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, s->path, strerror(errno), COLOR_RESET);
+        if (s->fd >= 0) close(s->fd);
+        free(s->index);
+        return -1;
+    }
+    char idx[600];
+    snprintf(idx, sizeof(idx), "%s/%s%s", dir, name, REC_INDEX_EXT);
+    s->idx_fd = open(idx, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    // Заголовок с заполнителями идет первым в буфер: куски остаются выровненными,
+    // а итоги и SEEKTABLE перезаписываются на месте при закрытии
+    flac_enc_init(enc, AUDIO_RATE, AUDIO_CHANNELS, REC_BLOCK, REC_LPC_ORDER);
+    s->header = flac_enc_header(enc, wbuf, NULL, 0, s->slots);
+    *fill = s->header;
+    return 0;
+}
+
+static void rec_close_segment(rec_segment_t *s, flac_enc_t *enc, uint8_t *wbuf, size_t *fill,
+                              double cpu, long overruns) {
+    if (*fill > 0) rec_flush(s, wbuf, fill, *fill);
+
+    flac_seekpoint_t *seek = malloc(s->slots * sizeof(flac_seekpoint_t));
+    int nseek = 0;
+    for (int i = 0; seek && i < s->nindex && nseek < s->slots; i++) {
+        if (s->index[i].sample / AUDIO_RATE % REC_SEEK_SEC != 0) continue;
+        seek[nseek].sample = s->index[i].sample;
+        seek[nseek].offset = s->index[i].offset - s->header;
+        seek[nseek].frames = REC_BLOCK;
+        nseek++;
+    }
+    uint8_t *hdr = malloc(s->header);
+    if (hdr && seek) {
+        flac_enc_header(enc, hdr, seek, nseek, s->slots);
+        if (pwrite(s->fd, hdr, s->header, 0) != (ssize_t)s->header) {
+            printf("%sОшибка: заголовок %s: %s%s\n", COLOR_RED, s->path, strerror(errno), COLOR_RESET);
+        }
+    }
+    free(hdr);
+    free(seek);
+    fdatasync(s->fd);
+    close(s->fd);
+    rec_index_flush(s, 1);
+    if (s->idx_fd >= 0) close(s->idx_fd);
+
+    double sec = s->samples / (double)AUDIO_RATE;
+    double raw = s->samples * AUDIO_CHANNELS * 2.0;
+    printf("%s: %.1f s, %.2f MB (%.1f%% of PCM), %.1f MB/h, encoder CPU %.2f%%, longest write %.1f ms, %ld frames lost\n",
+           s->path, sec, s->file_bytes / 1e6, raw > 0 ? s->file_bytes * 100.0 / raw : 0.0,
+           sec > 0 ? s->file_bytes / 1e6 * 3600.0 / sec : 0.0, sec > 0 ? cpu * 100.0 / sec : 0.0,
+           s->write_ms_max, overruns);
+    fflush(stdout);
+    free(s->index);
+    flac_enc_free(enc);
+}
+
+// --record: захват -> FLAC по сегментам до остановки или конца файла
+int rec_main(const char *dir, const char *capture_dev, int segment_sec) {
+    static rec_capture_t cap;
+    rec_segment_t seg;
+    flac_enc_t enc;
+    uint8_t *wbuf = NULL;
+    size_t fill = 0;
+    if (segment_sec < REC_SEEK_SEC) segment_sec = REC_SEEK_SEC;
+    int16_t *block = malloc(REC_BLOCK * AUDIO_CHANNELS * sizeof(int16_t));
+    size_t wsize = REC_WRITE_BYTES + FLAC_ENC_MAX_FRAME(REC_BLOCK, AUDIO_CHANNELS) +
+                   FLAC_ENC_HEADER_SIZE(segment_sec / REC_SEEK_SEC + 2);
+
+    mkdir(dir, 0755);
+    memset(&cap, 0, sizeof(cap));
+    cap.ring = malloc(REC_RING_FRAMES * AUDIO_CHANNELS * sizeof(int16_t));
+    if (!block || !cap.ring || posix_memalign((void **)&wbuf, 4096, wsize) != 0) {
+        printf("%sОшибка: нет памяти%s\n", COLOR_RED, COLOR_RESET);
+        free(block);
+        free(cap.ring);
+        return 1;
+    }
+    // Файл читается с максимальной скоростью, время сегментов - по отсчетам от старта
+    cap.live = strncmp(capture_dev, "file:", 5) != 0;
+    if (audio_open(&cap.dev, capture_dev, AUDIO_CAPTURE, AUDIO_RATE, AUDIO_CHANNELS) != 0) {
+        free(block);
+        free(cap.ring);
+        free(wbuf);
+        return 1;
+    }
+    pthread_t th;
+    if (rt_thread_create(&th, RT_ROLE_AUDIO, rec_capture_thread, &cap) != 0) {
+        printf("%sОшибка: поток захвата не создан%s\n", COLOR_RED, COLOR_RESET);
+        audio_close(&cap.dev);
+        free(block);
+        free(cap.ring);
+        free(wbuf);
+        return 1;
+    }
+
+    printf("Recording %s to %s/ in %d s segments (FLAC, LPC order %d)\n", capture_dev, dir, segment_sec, REC_LPC_ORDER);
+    fflush(stdout);
+
+    int open = 0, ret = 0, joined = 0;
+    int64_t next_ns = rec_realtime_ns();
+    long overruns_seg = 0;
+    uint64_t total_samples = 0, total_bytes = 0;
+    double cpu_seg = 0, cpu_total = 0;
+
+    for (;;) {
+        // При остановке захват завершается первым, остаток кольца дописывается
+        if (!global_tx->running && !joined) {
+            cap.stop = 1;
+            pthread_join(th, NULL);
+            joined = 1;
+        }
+        int eof = __atomic_load_n(&cap.eof, __ATOMIC_ACQUIRE);
+        uint32_t avail = __atomic_load_n(&cap.head, __ATOMIC_ACQUIRE) - cap.tail;
+        if (avail == 0 && eof) break;
+
+        if (!open) {
+            if (avail == 0) {
+                usleep(10000);
+                continue;
+            }
+            // Начало сегмента по часам: отсчеты, еще лежащие в кольце, - в прошлом
+            if (cap.live) next_ns = rec_realtime_ns() - (int64_t)avail * 1000000000LL / AUDIO_RATE;
+            if (rec_open_segment(&seg, dir, next_ns, segment_sec, &enc, wbuf, &fill) != 0) {
+                ret = 1;
+                break;
+            }
+            open = 1;
+            overruns_seg = cap.overruns;
+            cpu_seg = 0;
+        }
+
+        // Перед границей кадр укорачивается: сегменты стыкуются до отсчета
+        int64_t pos_ns = seg.start_ns + (int64_t)(seg.samples * 1000000000ULL / AUDIO_RATE);
+        long to_end = (long)(((seg.end_ns - seg.start_ns) * AUDIO_RATE + 999999999LL) / 1000000000LL - (int64_t)seg.samples);
+        int want = to_end < 1 ? 1 : to_end < REC_BLOCK ? (int)to_end : REC_BLOCK;
+        if ((int)avail < want && !eof) {
+            usleep(10000);
+            continue;
+        }
+        int n = (int)avail < want ? (int)avail : want;
+
+        for (int i = 0; i < n; i++) {
+            uint32_t k = (cap.tail + i) & (REC_RING_FRAMES - 1);
+            block[i * 2] = cap.ring[k * 2];
+            block[i * 2 + 1] = cap.ring[k * 2 + 1];
+        }
+        __atomic_store_n(&cap.tail, cap.tail + n, __ATOMIC_RELEASE);
+
+        // Точка индекса на первый кадр каждой секунды
+        if ((seg.nindex == 0 || seg.samples / AUDIO_RATE > seg.index[seg.nindex - 1].sample / AUDIO_RATE) &&
+            seg.nindex < seg.index_cap) {
+            rec_index_t *r = &seg.index[seg.nindex++];
+            r->time_ns = pos_ns;
+            r->sample = seg.samples;
+            r->offset = seg.file_bytes + fill;
+        }
+
+        double t0 = rec_cpu_now();
+        fill += flac_enc_frame(&enc, block, n, wbuf + fill);
+        double dt = rec_cpu_now() - t0;
+        cpu_seg += dt;
+        cpu_total += dt;
+        seg.samples += n;
+        total_samples += n;
+
+        if (fill >= REC_WRITE_BYTES && rec_flush(&seg, wbuf, &fill, REC_WRITE_BYTES) != 0) {
+            ret = 1;
+            break;
+        }
+        if (n == to_end) {
+            next_ns = seg.start_ns + (int64_t)(seg.samples * 1000000000ULL / AUDIO_RATE);
+            rec_close_segment(&seg, &enc, wbuf, &fill, cpu_seg, cap.overruns - overruns_seg);
+            total_bytes += seg.file_bytes;
+            open = 0;
+        }
+    }
+    if (open) {
+        rec_close_segment(&seg, &enc, wbuf, &fill, cpu_seg, cap.overruns - overruns_seg);
+        total_bytes += seg.file_bytes;
+    }
+    if (!joined) {
+        cap.stop = 1;
+        pthread_join(th, NULL);
+    }
+    audio_close(&cap.dev);
+
+    double sec = total_samples / (double)AUDIO_RATE;
+    if (sec > 0) {
+        printf("Recorded %.1f s: %.1f MB/h vs %.1f MB/h PCM, encoder %.1fx real time (%.2f%% CPU), %ld frames lost\n",
+               sec, total_bytes / 1e6 * 3600.0 / sec, AUDIO_RATE * AUDIO_CHANNELS * 2 * 3600.0 / 1e6,
+               cpu_total > 0 ? sec / cpu_total : 0.0, cpu_total * 100.0 / sec, cap.overruns);
+    }
+    free(block);
+    free(cap.ring);
+    free(wbuf);
+    return ret;
+}
+
+static int rec_parse_time(const char *when, time_t *out) {
+    struct tm tm;
+    time_t now = time(NULL);
+    const char *end;
+
+    if (when[0] == '@') {
+        *out = (time_t)atoll(when + 1);
+        return 0;
+    }
+    // Неудачная попытка может успеть записать поля, поэтому каждый раз заново от сегодня
+    static const char *formats[] = { "%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%H:%M:%S" };
+    // Суффикс Z - время UTC: однозначно и в повторяющийся час перевода часов
+    for (int i = 0; i < 3; i++) {
+        localtime_r(&now, &tm);
+        if ((end = strptime(when, formats[i], &tm)) && !*end) {
+            tm.tm_isdst = -1;
+            *out = mktime(&tm);
+            return 0;
+        }
+        gmtime_r(&now, &tm);
+        if ((end = strptime(when, formats[i], &tm)) && strcmp(end, "Z") == 0) {
+            *out = timegm(&tm);
+            return 0;
+        }
+    }
+    printf("%sОшибка: время %s (YYYY-MM-DD HH:MM:SS, HH:MM:SS, с Z - UTC, или @UNIX)%s\n", COLOR_RED, when, COLOR_RESET);
+    return -1;
+}
+
+// Декодирование с найденного кадра; отсчеты до нужного момента пропускаются
+static int rec_play(const char *path, uint64_t offset, long skip, int seconds, const char *play_dev) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, path, strerror(errno), COLOR_RESET);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    const uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 1;
+
+    flac_dec_t f;
+    audio_dev_t out;
+    int16_t buf[REC_BLOCK * AUDIO_CHANNELS];
+    int ret = 1;
+    if (flac_open(&f, data, st.st_size) == 0 && f.channels == AUDIO_CHANNELS) {
+        f.pos = offset;
+        if (audio_open(&out, play_dev, 0, AUDIO_RATE, AUDIO_CHANNELS) == 0) {
+            long left = (long)seconds * AUDIO_RATE;
+            int n;
+            while (left > 0 && global_tx->running && (n = flac_next_frame(&f)) > 0) {
+                int from = skip < n ? (int)skip : n;
+                skip -= from;
+                int cnt = 0;
+                for (int i = from; i < n && cnt < left; i++, cnt++) {
+                    buf[cnt * 2] = (int16_t)f.out[0][i];
+                    buf[cnt * 2 + 1] = (int16_t)f.out[1][i];
+                }
+                if (cnt > 0 && audio_write(&out, buf, cnt) != cnt) break;
+                left -= cnt;
+            }
+            audio_close(&out);
+            ret = 0;
+        }
+        flac_close(&f);
+    }
+    munmap((void *)data, st.st_size);
+    return ret;
+}
+
+// --rec-seek: сегмент по имени, кадр по индексу (двоичный поиск в mmap)
+int rec_seek(const char *dir, const char *when, int seconds, const char *play_dev) {
+    time_t target;
+    if (rec_parse_time(when, &target) != 0) return 1;
+    double t0 = rec_now();
+
+    // Последний сегмент, начавшийся не позже target
+    DIR *d = opendir(dir);
+    if (!d) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, dir, strerror(errno), COLOR_RESET);
+        return 1;
+    }
+    char best[64] = "";
+    time_t best_t = 0;
+    struct dirent *e;
+    while ((e = readdir(d))) {
+        struct tm tm = { 0 };
+        const char *end = strptime(e->d_name, REC_NAME_FORMAT, &tm);
+        if (!end || strcmp(end, "Z.flac") != 0 || strlen(e->d_name) >= sizeof(best)) continue;
+        time_t t = timegm(&tm);
+        if (t <= target && t >= best_t) {
+            best_t = t;
+            snprintf(best, sizeof(best), "%s", e->d_name);
+        }
+    }
+    closedir(d);
+    if (!best[0]) {
+        printf("%sОшибка: нет записи на это время в %s%s\n", COLOR_RED, dir, COLOR_RESET);
+        return 1;
+    }
+
+    char path[512], idx[600];
+    snprintf(path, sizeof(path), "%s/%s", dir, best);
+    snprintf(idx, sizeof(idx), "%s/%.*s%s", dir, (int)(strlen(best) - 5), best, REC_INDEX_EXT);
+    int fd = open(idx, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(rec_index_t)) {
+        printf("%sОшибка: нет индекса %s%s\n", COLOR_RED, idx, COLOR_RESET);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    const rec_index_t *ix = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (ix == MAP_FAILED) return 1;
+    long n = st.st_size / sizeof(rec_index_t);
+
+    int64_t target_ns = (int64_t)target * 1000000000LL;
+    long lo = 0, hi = n - 1;
+    while (lo < hi) {
+        long mid = (lo + hi + 1) / 2;
+        if (ix[mid].time_ns <= target_ns) lo = mid;
+        else hi = mid - 1;
+    }
+    rec_index_t r = ix[lo];
+    munmap((void *)ix, st.st_size);
+    double lookup_us = (rec_now() - t0) * 1e6;
+
+    if (target_ns - r.time_ns > 2000000000LL) {
+        printf("%sОшибка: %s кончается раньше (последняя точка %.1f s)%s\n",
+               COLOR_RED, path, r.sample / (double)AUDIO_RATE, COLOR_RESET);
+        return 1;
+    }
+    long skip = target_ns > r.time_ns ? (long)((target_ns - r.time_ns) * AUDIO_RATE / 1000000000LL) : 0;
+    printf("%s: byte %llu, sample %llu + %ld (%.3f s into the segment), found in %.0f us\n",
+           path, (unsigned long long)r.offset, (unsigned long long)r.sample, skip,
+           (r.sample + skip) / (double)AUDIO_RATE, lookup_us);
+    fflush(stdout);
+
+    return seconds > 0 ? rec_play(path, r.offset, skip, seconds, play_dev) : 0;
+}
@@ -0,0 +1,29 @@
+#ifndef FM_REC_H
+#define FM_REC_H
+
+#include <stdint.h>
+
+// Запись эфира с i2s_receiver в FLAC по часовым сегментам: LPC + Райс,
+// запись на карту большими выровненными кусками, индекс для поиска по времени
+#define REC_SEGMENT_SEC    3600      // Границы сегментов кратны этому от 00:00 UTC
+#define REC_BLOCK          4096      // Отсчетов в кадре FLAC, 85 мс
+#define REC_LPC_ORDER      8
+#define REC_WRITE_BYTES    (1 << 20) // Кусок записи на карту, смещения в файле кратны ему
+#define REC_RING_FRAMES    (1 << 19) // Кольцо захвата: ~11 с на задержки записи на карту
+#define REC_SEEK_SEC       10        // Шаг точек SEEKTABLE в самом файле
+#define REC_INDEX_EXT      ".idx"    // Рядом с сегментом: точка на каждую секунду
+#define REC_NAME_FORMAT    "%Y%m%d-%H%M%S" // Имя сегмента - время начала по UTC, с суффиксом Z
+
+// Запись индекса; добавляется после того, как кусок с кадром записан на карту
+typedef struct {
+    int64_t time_ns;                 // CLOCK_REALTIME первого отсчета кадра
+    uint64_t sample;                 // От начала сегмента
+    uint64_t offset;                 // Байт от начала файла
+} rec_index_t;
+
+int rec_main(const char *dir, const char *capture_dev, int segment_sec);
+// Поиск по времени "YYYY-MM-DD HH:MM:SS", "HH:MM:SS" (сегодня) или "@UNIX";
+// seconds > 0 - воспроизвести столько с найденного отсчета на play_dev
+int rec_seek(const char *dir, const char *when, int seconds, const char *play_dev);
+
+#endif // FM_REC_H
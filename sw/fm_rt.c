@@ -0,0 +1,278 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "fm.h"
+#include "fm_rt.h"
+
+// Профиль по умолчанию для двух ядер A9: звук и RDS на ядре 1,
+// опрос и управление на ядре 0 вместе с VLC и sshd
+rt_role_cfg_t rt_roles[RT_ROLE_COUNT] = {
+    [RT_ROLE_AUDIO]   = {"audio",   80,  1,  5333,  2000},  // 256 отсчетов при 48 кГц
+    [RT_ROLE_RDS]     = {"rds",     70,  1, 10000,  5000},
+    [RT_ROLE_SAMPLER] = {"sampler", 60,  0,  1000,   500},
+    [RT_ROLE_CONTROL] = {"control", 50,  0, 40000, 20000},  // кадр TUI при 25 Гц
+};
+
+int rt_enabled = 0;
+
+// Ядро из профиля, если оно есть в системе (на ПК ядер может быть меньше)
+static int rt_cpu_valid(int cpu) {
+    return cpu >= 0 && cpu < CPU_SETSIZE && cpu < sysconf(_SC_NPROCESSORS_ONLN);
+}
+
+// Переопределение профиля из файла настроек: RT_AUDIO_PRIO=80, RT_AUDIO_CPU=1
+void rt_load_profile(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "RT_", 3) != 0) continue;
+        line[strcspn(line, "\n")] = 0;
+        char *value = strchr(line, '=');
+        if (!value) continue;
+        *value++ = 0;
+
+        for (int r = 0; r < RT_ROLE_COUNT; r++) {
+            char key[32];
+            char upper[16];
+            int i;
+            for (i = 0; rt_roles[r].name[i] && i < 15; i++) upper[i] = rt_roles[r].name[i] - 'a' + 'A';
+            upper[i] = 0;
+
+            snprintf(key, sizeof(key), "RT_%s_PRIO", upper);
+            if (strcmp(line, key) == 0) rt_roles[r].priority = atoi(value);
+            snprintf(key, sizeof(key), "RT_%s_CPU", upper);
+            if (strcmp(line, key) == 0) rt_roles[r].cpu = atoi(value);
+        }
+    }
+    fclose(f);
+}
+
+// Фиксация памяти процесса и прогрев кучи/стека, чтобы не ловить page fault
+int rt_process_setup(void) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        perror("mlockall");
+        return -1;
+    }
+
+    volatile char prefault[64 * 1024];
+    memset((char *)prefault, 0, sizeof(prefault));
+
+    rt_enabled = 1;
+    return 0;
+}
+
+// Применение роли к текущему потоку
+int rt_set_current(rt_role_t role) {
+    const rt_role_cfg_t *cfg = &rt_roles[role];
+    int ret = 0;
+
+    if (rt_cpu_valid(cfg->cpu)) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cfg->cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) ret = -1;
+    }
+
+    if (cfg->priority > 0) {
+        struct sched_param sp = {.sched_priority = cfg->priority};
+        if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp) != 0) ret = -1;
+    }
+    return ret;
+}
+
+typedef struct {
+    void *(*fn)(void *);
+    void *arg;
+} rt_start_t;
+
+// Прогрев стека отдельным кадром: после возврата страницы остаются (mlockall MCL_FUTURE)
+static __attribute__((noinline)) void rt_prefault_stack(void) {
+    volatile char touch[RT_STACK_SIZE - RT_STACK_SPARE];
+    memset((char *)touch, 0, sizeof(touch));
+}
+
+static void *rt_start(void *p) {
+    rt_start_t start = *(rt_start_t *)p;
+    free(p);
+    rt_prefault_stack();
+    return start.fn(start.arg);
+}
+
+// Создание потока с ролью; стек нужного размера прогревается до входа в fn.
+// Стек выделяет и освобождает pthread (после join), повторные запуски не текут.
+// Без rt_enabled поток создается обычным, чтобы было с чем сравнивать
+int rt_thread_create(pthread_t *thread, rt_role_t role, void *(*fn)(void *), void *arg) {
+    const rt_role_cfg_t *cfg = &rt_roles[role];
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    if (rt_enabled) {
+        rt_start_t *start = malloc(sizeof(*start));
+        if (start) {
+            start->fn = fn;
+            start->arg = arg;
+            fn = rt_start;
+            arg = start;
+            pthread_attr_setstacksize(&attr, RT_STACK_SIZE);
+        }
+
+        if (rt_cpu_valid(cfg->cpu)) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cfg->cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+
+        if (cfg->priority > 0) {
+            struct sched_param sp = {.sched_priority = cfg->priority};
+            pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+            pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+            pthread_attr_setschedparam(&attr, &sp);
+        }
+    }
+
+    int ret = pthread_create(thread, &attr, fn, arg);
+    if (ret == EPERM && rt_enabled) {
+        // Нет прав на SCHED_FIFO - запускаем обычный поток, но сообщаем
+        printf("%s[rt] %s: no permission for SCHED_FIFO, running as SCHED_OTHER%s\n",
+               COLOR_YELLOW, cfg->name, COLOR_RESET);
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        ret = pthread_create(thread, &attr, fn, arg);
+    }
+    if (ret != 0 && fn == rt_start) free(arg);
+    pthread_attr_destroy(&attr);
+    return ret;
+}
+
+// Самотест в стиле cyclictest: каждый поток спит до абсолютного момента
+// и измеряет, насколько позже он реально проснулся
+typedef struct {
+    rt_role_t role;
+    int seconds;
+    long samples;
+    long misses;
+    long overflow;
+    long min_us, max_us;
+    double sum_us;
+    unsigned int hist[RT_HIST_MAX_US];
+} rt_probe_t;
+
+static void *rt_probe_thread(void *arg) {
+    rt_probe_t *p = arg;
+    const rt_role_cfg_t *cfg = &rt_roles[p->role];
+    struct timespec next, now, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    end = next;
+    end.tv_sec += p->seconds;
+    p->min_us = -1;
+
+    while (global_tx == NULL || global_tx->running) {
+        next.tv_nsec += cfg->period_us * 1000L;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        if (next.tv_sec > end.tv_sec ||
+            (next.tv_sec == end.tv_sec && next.tv_nsec > end.tv_nsec)) break;
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        long lat = ((now.tv_sec - next.tv_sec) * 1000000000L + (now.tv_nsec - next.tv_nsec)) / 1000;
+        if (lat < 0) lat = 0;
+
+        if (lat < RT_HIST_MAX_US) p->hist[lat]++;
+        else p->overflow++;
+        if (p->min_us < 0 || lat < p->min_us) p->min_us = lat;
+        if (lat > p->max_us) p->max_us = lat;
+        if (lat > cfg->deadline_us) p->misses++;
+        p->sum_us += lat;
+        p->samples++;
+    }
+    return NULL;
+}
+
+// Процентиль по гистограмме
+static long rt_percentile(const rt_probe_t *p, double q) {
+    long target = (long)(p->samples * q);
+    long acc = 0;
+    for (int i = 0; i < RT_HIST_MAX_US; i++) {
+        acc += p->hist[i];
+        if (acc > target) return i;
+    }
+    return RT_HIST_MAX_US;
+}
+
+int rt_selftest(int seconds) {
+    static const int buckets[] = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000, RT_HIST_MAX_US};
+    const int nbuckets = sizeof(buckets) / sizeof(buckets[0]);
+    rt_probe_t *probes = calloc(RT_ROLE_COUNT, sizeof(rt_probe_t));
+    pthread_t threads[RT_ROLE_COUNT];
+    int all_ok = 1;
+
+    if (!probes) return 1;
+
+    printf("%sRT self-test: %d s, profile %s%s\n", BOLD, seconds,
+           rt_enabled ? "SCHED_FIFO + mlockall" : "SCHED_OTHER (use --rt to enable)", COLOR_RESET);
+
+    for (int r = 0; r < RT_ROLE_COUNT; r++) {
+        probes[r].role = r;
+        probes[r].seconds = seconds;
+        if (rt_thread_create(&threads[r], r, rt_probe_thread, &probes[r]) != 0) {
+            printf("%s[rt] cannot start %s thread%s\n", COLOR_RED, rt_roles[r].name, COLOR_RESET);
+            threads[r] = 0;
+        }
+    }
+    for (int r = 0; r < RT_ROLE_COUNT; r++) {
+        if (threads[r]) pthread_join(threads[r], NULL);
+    }
+
+    printf("\n%-8s %4s %3s %7s %8s %6s %6s %6s %6s %6s %7s\n",
+           "thread", "prio", "cpu", "period", "samples", "min", "avg", "p99", "p9999", "max", "misses");
+    for (int r = 0; r < RT_ROLE_COUNT; r++) {
+        const rt_probe_t *p = &probes[r];
+        const rt_role_cfg_t *cfg = &rt_roles[r];
+        if (p->samples == 0) continue;
+        int ok = p->misses == 0;
+        if (!ok) all_ok = 0;
+        printf("%-8s %4d %3d %7d %8ld %6ld %6.0f %6ld %6ld %6ld %s%7ld%s\n",
+               cfg->name, rt_enabled ? cfg->priority : 0, rt_enabled && rt_cpu_valid(cfg->cpu) ? cfg->cpu : -1,
+               cfg->period_us, p->samples, p->min_us, p->sum_us / p->samples,
+               rt_percentile(p, 0.99), rt_percentile(p, 0.9999), p->max_us,
+               ok ? COLOR_GREEN : COLOR_RED, p->misses, COLOR_RESET);
+    }
+
+    // Гистограмма по укрупненным корзинам (мкс)
+    printf("\n%-8s", "<= us");
+    for (int b = 0; b < nbuckets; b++) printf(" %7d", buckets[b]);
+    printf(" %7s\n", "more");
+    for (int r = 0; r < RT_ROLE_COUNT; r++) {
+        const rt_probe_t *p = &probes[r];
+        if (p->samples == 0) continue;
+        printf("%-8s", rt_roles[r].name);
+        int lo = 0;
+        for (int b = 0; b < nbuckets; b++) {
+            long n = 0;
+            for (int i = lo; i < buckets[b] && i < RT_HIST_MAX_US; i++) n += p->hist[i];
+            printf(" %7ld", n);
+            lo = buckets[b];
+        }
+        printf(" %7ld\n", p->overflow);
+    }
+
+    printf("\n%s%s%s\n", all_ok ? COLOR_GREEN : COLOR_RED,
+           all_ok ? "All deadlines held" : "Deadlines missed", COLOR_RESET);
+    free(probes);
+    return all_ok ? 0 : 2;
+}
@@ -0,0 +1,36 @@
+#ifndef FM_RT_H
+#define FM_RT_H
+
+#include <pthread.h>
+
+// Роли потоков реального времени
+typedef enum {
+    RT_ROLE_AUDIO = 0,   // Вывод звука в i2s_transmitter
+    RT_ROLE_RDS,         // Кодер RDS
+    RT_ROLE_SAMPLER,     // Опрос регистров и метеринг
+    RT_ROLE_CONTROL,     // Управление, расписание, TUI
+    RT_ROLE_COUNT
+} rt_role_t;
+
+typedef struct {
+    const char *name;
+    int priority;        // SCHED_FIFO 1..99, 0 = SCHED_OTHER
+    int cpu;             // -1 = любое ядро
+    int period_us;       // Период пробуждения для самотеста
+    int deadline_us;     // Допустимая задержка пробуждения
+} rt_role_cfg_t;
+
+#define RT_STACK_SIZE (256 * 1024)  // Стек потока, прогревается до входа в функцию потока
+#define RT_STACK_SPARE (16 * 1024)  // Не прогревается: кадры прогрева и guard-страница
+#define RT_HIST_MAX_US 10000        // Гистограмма задержек с шагом 1 мкс
+
+extern rt_role_cfg_t rt_roles[RT_ROLE_COUNT];
+extern int rt_enabled;
+
+void rt_load_profile(const char *path);
+int rt_process_setup(void);
+int rt_set_current(rt_role_t role);
+int rt_thread_create(pthread_t *thread, rt_role_t role, void *(*fn)(void *), void *arg);
+int rt_selftest(int seconds);
+
+#endif // FM_RT_H
@@ -0,0 +1,335 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <spawn.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include <sys/prctl.h>
+
+#include "fm.h"
+#include "fm_sched.h"
+
+extern char **environ;
+
+// Сравнение моментов времени
+static int ts_before(const struct timespec *a, const struct timespec *b) {
+    if (a->tv_sec != b->tv_sec) return a->tv_sec < b->tv_sec;
+    return a->tv_nsec < b->tv_nsec;
+}
+
+// Разница a - b в микросекундах
+static double ts_diff_us(const struct timespec *a, const struct timespec *b) {
+    return (a->tv_sec - b->tv_sec) * 1e6 + (a->tv_nsec - b->tv_nsec) / 1e3;
+}
+
+// Локальное время суток -> ближайший будущий момент
+static void sched_next_daily(sched_action_t *a, time_t not_before) {
+    time_t t = not_before;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    for (int day = 0; day < 3; day++) {
+        struct tm cand = tm;
+        cand.tm_mday += day;
+        cand.tm_hour = a->hour;
+        cand.tm_min = a->min;
+        cand.tm_sec = (int)a->sec;
+        cand.tm_isdst = -1;
+        time_t when = mktime(&cand);
+        if (when > not_before) {
+            a->when.tv_sec = when;
+            a->when.tv_nsec = (long)((a->sec - (int)a->sec) * 1e9);
+            return;
+        }
+    }
+}
+
+// Операции с кучей
+static void heap_push(sched_t *s, const sched_action_t *a) {
+    if (s->count == s->capacity) {
+        int cap = s->capacity ? s->capacity * 2 : 32;
+        sched_action_t *heap = realloc(s->heap, cap * sizeof(*heap));
+        if (!heap) return;
+        s->heap = heap;
+        s->capacity = cap;
+    }
+    int i = s->count++;
+    s->heap[i] = *a;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!ts_before(&s->heap[i].when, &s->heap[parent].when)) break;
+        sched_action_t tmp = s->heap[i];
+        s->heap[i] = s->heap[parent];
+        s->heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+static void heap_pop(sched_t *s, sched_action_t *out) {
+    *out = s->heap[0];
+    s->heap[0] = s->heap[--s->count];
+    int i = 0;
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < s->count && ts_before(&s->heap[l].when, &s->heap[m].when)) m = l;
+        if (r < s->count && ts_before(&s->heap[r].when, &s->heap[m].when)) m = r;
+        if (m == i) break;
+        sched_action_t tmp = s->heap[i];
+        s->heap[i] = s->heap[m];
+        s->heap[m] = tmp;
+        i = m;
+    }
+}
+
+// Разбор времени в начале строки, возвращает указатель на остаток
+static char *parse_when(char *line, sched_action_t *a, time_t now) {
+    int y, mo, d, h, mi, n = 0;
+    double sec;
+
+    if (line[0] == '@') {
+        // @1760000000.250 - unix-время
+        double t = strtod(line + 1, &line);
+        a->when.tv_sec = (time_t)t;
+        a->when.tv_nsec = (long)((t - (double)a->when.tv_sec) * 1e9);
+        return line;
+    }
+    if (sscanf(line, "daily %d:%d:%lf%n", &h, &mi, &sec, &n) == 3) {
+        a->daily = 1;
+        a->hour = h;
+        a->min = mi;
+        a->sec = sec;
+        sched_next_daily(a, now);
+        return line + n;
+    }
+    if (sscanf(line, "%d-%d-%d %d:%d:%lf%n", &y, &mo, &d, &h, &mi, &sec, &n) == 6) {
+        struct tm tm = {0};
+        tm.tm_year = y - 1900;
+        tm.tm_mon = mo - 1;
+        tm.tm_mday = d;
+        tm.tm_hour = h;
+        tm.tm_min = mi;
+        tm.tm_sec = (int)sec;
+        tm.tm_isdst = -1;
+        a->when.tv_sec = mktime(&tm);
+        a->when.tv_nsec = (long)((sec - (int)sec) * 1e9);
+        return line + n;
+    }
+    return NULL;
+}
+
+// Загрузка файла расписания
+//   2026-10-18 07:00:00.000  MUTE=0 FREQUENCY=96.5
+//   daily 23:00:00           MUTE=1
+//   @1760000000.250          TX=0
+int sched_load(sched_t *s, const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        printf("%sОшибка: Не могу открыть %s%s\n", COLOR_RED, path, COLOR_RESET);
+        return -1;
+    }
+
+    time_t now = time(NULL);
+    char line[1024];
+    int lineno = 0, skipped = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = 0;
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == 0) continue;
+
+        sched_action_t a;
+        memset(&a, 0, sizeof(a));
+        a.line = lineno;
+
+        char *rest = parse_when(p, &a, now);
+        if (!rest) {
+            printf("%s%s:%d: bad time%s\n", COLOR_YELLOW, path, lineno, COLOR_RESET);
+            continue;
+        }
+
+        // Параметры KEY=VALUE через пробел
+        char *save = NULL;
+        for (char *tok = strtok_r(rest, " \t", &save); tok; tok = strtok_r(NULL, " \t", &save)) {
+            char *eq = strchr(tok, '=');
+            if (!eq || a.count >= SCHED_MAX_SETTINGS) continue;
+            *eq = 0;
+            snprintf(a.key[a.count], sizeof(a.key[0]), "%s", tok);
+            snprintf(a.value[a.count], sizeof(a.value[0]), "%s", eq + 1);
+            // PROGRAM= может содержать пробелы - забираем остаток строки
+            if (strcmp(tok, "PROGRAM") == 0 && save && *save) {
+                size_t len = strlen(a.value[a.count]);
+                snprintf(a.value[a.count] + len, sizeof(a.value[0]) - len, " %s", save);
+                save += strlen(save);
+            }
+            a.count++;
+        }
+
+        if (a.count == 0) continue;
+        if (!a.daily && a.when.tv_sec < now) {
+            skipped++;
+            continue;
+        }
+        heap_push(s, &a);
+    }
+
+    fclose(f);
+    printf("%sSchedule: %d actions loaded, %d in the past skipped%s\n",
+           COLOR_GREEN, s->count, skipped, COLOR_RESET);
+    return 0;
+}
+
+void sched_free(sched_t *s) {
+    free(s->heap);
+    s->heap = NULL;
+    s->count = s->capacity = 0;
+}
+
+// Смена программы - внешний плеер, запускаем без ожидания
+static void sched_spawn_program(const char *cmd) {
+    pid_t pid;
+    char *argv[] = {"/bin/sh", "-c", (char *)cmd, NULL};
+    if (posix_spawn(&pid, "/bin/sh", NULL, NULL, argv, environ) != 0) {
+        printf("%s[sched] PROGRAM failed: %s%s\n", COLOR_RED, cmd, COLOR_RESET);
+    }
+}
+
+// Применение одного действия к состоянию; PROGRAM запускается сразу
+static void sched_apply(fm_transmitter_t *tx, const sched_action_t *a) {
+    for (int i = 0; i < a->count; i++) {
+        if (strcmp(a->key[i], "PROGRAM") == 0) {
+            sched_spawn_program(a->value[i]);
+        } else if (!apply_setting(tx, a->key[i], a->value[i])) {
+            printf("%s[sched] line %d: unknown key %s%s\n",
+                   COLOR_YELLOW, a->line, a->key[i], COLOR_RESET);
+        }
+    }
+}
+
+// Постановка таймера на ближайшее действие
+static int sched_arm(int tfd, const sched_t *s) {
+    struct itimerspec its = {0};
+    if (s->count > 0) {
+        its.it_value = s->heap[0].when;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1;
+    }
+    return timerfd_settime(tfd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &its, NULL);
+}
+
+static void sched_report(sched_t *s, const sched_action_t *a,
+                         const struct timespec *woke, const struct timespec *done) {
+    double jitter = ts_diff_us(woke, &a->when);
+    double apply = ts_diff_us(done, woke);
+
+    if (s->fired == 0 || jitter < s->jitter_min_us) s->jitter_min_us = jitter;
+    if (s->fired == 0 || jitter > s->jitter_max_us) s->jitter_max_us = jitter;
+    s->jitter_sum_us += jitter;
+    if (jitter > SCHED_LATE_US) s->late++;
+    s->fired++;
+
+    struct tm tm;
+    char stamp[32];
+    localtime_r(&a->when.tv_sec, &tm);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+
+    FILE *out = s->log ? s->log : stdout;
+    fprintf(out, "[sched] line %d scheduled %s.%06ld actual %+.1f us apply %.1f us\n",
+            a->line, stamp, a->when.tv_nsec / 1000, jitter, apply);
+    fflush(out);
+}
+
+// Основной цикл: timerfd на абсолютный CLOCK_REALTIME
+int sched_run(fm_transmitter_t *tx, sched_t *s) {
+    int tfd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+    if (tfd < 0) {
+        perror("timerfd_create");
+        return -1;
+    }
+
+    // Минимальный timer slack - иначе ядро объединяет пробуждения до 50 мкс
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+
+    sched_arm(tfd, s);
+
+    while (tx->running && s->count > 0) {
+        struct pollfd pfd = {tfd, POLLIN, 0};
+        int r = poll(&pfd, 1, 500);
+        if (r < 0 && errno != EINTR) break;
+        if (r <= 0) continue;
+
+        struct timespec woke;
+        clock_gettime(CLOCK_REALTIME, &woke);
+
+        uint64_t expirations;
+        if (read(tfd, &expirations, sizeof(expirations)) < 0 && errno == ECANCELED) {
+            // Системное время переставили - пересчитываем ежедневные действия
+            printf("%s[sched] clock changed, re-arming%s\n", COLOR_YELLOW, COLOR_RESET);
+            for (int i = 0; i < s->count; i++) {
+                if (s->heap[i].daily) sched_next_daily(&s->heap[i], woke.tv_sec - 1);
+            }
+            sched_t rebuilt = {0};
+            rebuilt.log = s->log;
+            for (int i = 0; i < s->count; i++) heap_push(&rebuilt, &s->heap[i]);
+            free(s->heap);
+            s->heap = rebuilt.heap;
+            s->capacity = rebuilt.capacity;
+            sched_arm(tfd, s);
+            continue;
+        }
+
+        // Все наступившие действия сливаются в одну транзакцию
+        sched_action_t due[16];
+        int ndue = 0;
+        fm_update_state(tx);
+        while (s->count > 0 && ndue < 16 && !ts_before(&woke, &s->heap[0].when)) {
+            heap_pop(s, &due[ndue]);
+            sched_apply(tx, &due[ndue]);
+            ndue++;
+        }
+
+        fm_txn_t txn;
+        fm_txn_begin(&txn);
+        fm_txn_add_state(&txn, tx);
+        fm_txn_commit(tx, &txn);
+
+        struct timespec done;
+        clock_gettime(CLOCK_REALTIME, &done);
+
+        for (int i = 0; i < ndue; i++) {
+            sched_report(s, &due[i], &woke, &done);
+            if (due[i].daily) {
+                sched_next_daily(&due[i], due[i].when.tv_sec);
+                heap_push(s, &due[i]);
+            }
+        }
+        sched_arm(tfd, s);
+    }
+
+    close(tfd);
+    return 0;
+}
+
+// Режим --schedule: загрузка, работа до сигнала, итоговая статистика
+int sched_main(fm_transmitter_t *tx, const char *path) {
+    sched_t s = {0};
+
+    if (sched_load(&s, path) != 0) return 1;
+
+    // Дочерние процессы PROGRAM= не ждем
+    signal(SIGCHLD, SIG_IGN);
+
+    sched_run(tx, &s);
+
+    if (s.fired > 0) {
+        printf("%sSchedule: %ld fired, jitter min %.1f / mean %.1f / max %.1f us, %ld over %.0f us%s\n",
+               COLOR_GREEN, s.fired, s.jitter_min_us, s.jitter_sum_us / s.fired,
+               s.jitter_max_us, s.late, SCHED_LATE_US, COLOR_RESET);
+    }
+    sched_free(&s);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#ifndef FM_SCHED_H
+#define FM_SCHED_H
+
+#include <stdio.h>
+#include <time.h>
+
+#include "fm.h"
+
+// Расписание: действия в абсолютное время CLOCK_REALTIME
+#define SCHED_MAX_SETTINGS 8     // Параметров KEY=VALUE в одной строке
+#define SCHED_LATE_US 1000.0     // Порог "опоздания" для статистики
+
+typedef struct {
+    struct timespec when;        // Момент срабатывания (CLOCK_REALTIME)
+    int daily;                   // Повторять каждый день
+    int hour, min;               // Время суток для daily
+    double sec;
+    int line;                    // Строка в файле расписания
+    int count;                   // Число параметров
+    char key[SCHED_MAX_SETTINGS][16];
+    char value[SCHED_MAX_SETTINGS][128];
+} sched_action_t;
+
+typedef struct {
+    sched_action_t *heap;        // Min-куча по when
+    int count;
+    int capacity;
+    // Статистика точности: фактическое время минус запланированное
+    long fired;
+    long late;
+    double jitter_min_us;
+    double jitter_max_us;
+    double jitter_sum_us;
+    FILE *log;
+} sched_t;
+
+int sched_load(sched_t *s, const char *path);
+void sched_free(sched_t *s);
+int sched_run(fm_transmitter_t *tx, sched_t *s);
+int sched_main(fm_transmitter_t *tx, const char *path);
+
+#endif // FM_SCHED_H
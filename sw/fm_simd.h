@@ -0,0 +1,17 @@
+#ifndef FM_SIMD_H
+#define FM_SIMD_H
+
+// Выбор набора SIMD инструкций: NEON на плате (-mfpu=neon), SSE2 на ПК
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FM_NEON 1
+#define FM_SIMD_NAME "NEON"
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FM_SSE2 1
+#define FM_SIMD_NAME "SSE2"
+#else
+#define FM_SIMD_NAME "scalar only"
+#endif
+
+#endif // FM_SIMD_H
@@ -0,0 +1,835 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#ifdef HAVE_MPG123
+#include <mpg123.h>
+#endif
+#ifdef HAVE_FAAD
+#include <neaacdec.h>
+#endif
+
+#include "fm.h"
+#include "fm_rt.h"
+#include "fm_stream.h"
+
+// Векторный тип GCC (NEON/SSE); окно входа ресемплера не выровнено
+typedef float v4f __attribute__((vector_size(16)));
+typedef float v4fu __attribute__((vector_size(16), aligned(4)));
+
+#define STREAM_P AUDIO_PERIOD
+
+static const char *stream_codec_names[] = { "unknown", "WAV", "L16", "MP3", "AAC" };
+
+static double stream_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void stream_log(const char *color, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void stream_log(const char *color, const char *fmt, ...) {
+    time_t now = time(NULL);
+    struct tm tm;
+    char stamp[16];
+    va_list ap;
+
+    localtime_r(&now, &tm);
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+    printf("%s[stream] %s ", color, stamp);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("%s\n", COLOR_RESET);
+    fflush(stdout);
+}
+
+// Кольцо: ждем места, пока поток вывода не освободит (противодавление на TCP)
+void stream_ring_push(stream_ring_t *r, const int16_t *x, int frames, const volatile int *stop) {
+    while (frames > 0 && !*stop) {
+        uint32_t head = r->head;
+        uint32_t space = STREAM_RING_FRAMES - (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+        if (space == 0) {
+            usleep(5000);
+            continue;
+        }
+        int n = frames < (int)space ? frames : (int)space;
+        uint32_t at = head & (STREAM_RING_FRAMES - 1);
+        int first = STREAM_RING_FRAMES - at < (uint32_t)n ? (int)(STREAM_RING_FRAMES - at) : n;
+        memcpy(&r->buf[at * 2], x, first * 2 * sizeof(int16_t));
+        memcpy(r->buf, x + first * 2, (n - first) * 2 * sizeof(int16_t));
+        __atomic_store_n(&r->head, head + n, __ATOMIC_RELEASE);
+        x += n * 2;
+        frames -= n;
+    }
+}
+
+// Не больше frames кадров из кольца; возвращает, сколько взято
+int stream_ring_pull(stream_ring_t *r, int16_t *x, int frames) {
+    uint32_t tail = r->tail;
+    uint32_t avail = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - tail;
+    int n = avail < (uint32_t)frames ? (int)avail : frames;
+    uint32_t at = tail & (STREAM_RING_FRAMES - 1);
+    int first = STREAM_RING_FRAMES - at < (uint32_t)n ? (int)(STREAM_RING_FRAMES - at) : n;
+    memcpy(x, &r->buf[at * 2], first * 2 * sizeof(int16_t));
+    memcpy(x + first * 2, r->buf, (n - first) * 2 * sizeof(int16_t));
+    __atomic_store_n(&r->tail, tail + n, __ATOMIC_RELEASE);
+    return n;
+}
+
+// Полифазный фильтр: sinc с окном Блэкмана, PHASES + 1 строк для дробной части 0..1
+void stream_rs_init(stream_rs_t *r, int in_rate) {
+    double fc = STREAM_RS_CUTOFF * (in_rate < AUDIO_RATE ? in_rate : AUDIO_RATE) / in_rate;
+    double half = STREAM_RS_TAPS / 2;
+
+    r->in_rate = in_rate;
+    r->step = (double)in_rate / AUDIO_RATE;
+    r->pos = 0;
+    r->fill = 0;
+    for (int p = 0; p <= STREAM_RS_PHASES; p++) {
+        float *h = &r->taps[p * STREAM_RS_TAPS];
+        double sum = 0;
+        for (int k = 0; k < STREAM_RS_TAPS; k++) {
+            double t = k - (half - 1) - (double)p / STREAM_RS_PHASES;
+            double x = 2.0 * fc * t;
+            double sinc = fabs(x) < 1e-9 ? 1.0 : sin(M_PI * x) / (M_PI * x);
+            double w = 0.42 + 0.5 * cos(M_PI * t / half) + 0.08 * cos(2.0 * M_PI * t / half);
+            h[k] = (float)(2.0 * fc * sinc * w);
+            sum += h[k];
+        }
+        for (int k = 0; k < STREAM_RS_TAPS; k++) h[k] = (float)(h[k] / sum);
+    }
+}
+
+// Вход в r->x (до STREAM_RS_SPACE(r) кадров за раз) -> не больше max стерео кадров в out
+int stream_rs_run(stream_rs_t *r, float *out, int max) {
+    int n = 0;
+
+    while (n < max) {
+        int i = (int)r->pos;
+        if (i + STREAM_RS_TAPS > r->fill) break;
+        int p = (int)((r->pos - i) * STREAM_RS_PHASES + 0.5);
+        const v4f *h = (const v4f *)&r->taps[p * STREAM_RS_TAPS];
+        const v4fu *xl = (const v4fu *)&r->x[0][i];
+        const v4fu *xr = (const v4fu *)&r->x[1][i];
+        v4f al = {0, 0, 0, 0}, ar = {0, 0, 0, 0};
+        for (int k = 0; k < STREAM_RS_TAPS / 4; k++) {
+            al += h[k] * xl[k];
+            ar += h[k] * xr[k];
+        }
+        out[2 * n] = al[0] + al[1] + al[2] + al[3];
+        out[2 * n + 1] = ar[0] + ar[1] + ar[2] + ar[3];
+        r->pos += r->step;
+        n++;
+    }
+
+    int drop = (int)r->pos < r->fill ? (int)r->pos : r->fill;
+    memmove(r->x[0], r->x[0] + drop, (r->fill - drop) * sizeof(float));
+    memmove(r->x[1], r->x[1] + drop, (r->fill - drop) * sizeof(float));
+    r->fill -= drop;
+    r->pos -= drop;
+    return n;
+}
+
+// Отсчеты декодера (S16, channels с шагом, берутся первые два) -> 48 кГц стерео в кольцо.
+// Вход любой длины (mpg123 отдает до 16384 кадров моно) идет кусками по размеру sout и окна ресемплера
+static void stream_emit(stream_t *s, const int16_t *x, int frames, int channels, int rate) {
+    if (frames <= 0 || channels < 1 || rate <= 0) return;
+    if (rate != s->rate || channels != s->channels) {
+        stream_log("", "%s %d Hz, %d ch%s", stream_codec_names[s->codec], rate, channels,
+                   ptp_clock ? ", resampling to 48000 Hz by PTP" : rate == AUDIO_RATE ? "" : ", resampling to 48000 Hz");
+        s->rate = rate;
+        s->channels = channels;
+        stream_rs_init(&s->rs, rate);
+    }
+    if (s->t_decoded == 0) s->t_decoded = stream_now();
+
+    int r1 = channels > 1 ? 1 : 0;
+    stream_rs_t *r = &s->rs;
+    while (frames > 0 && !s->stop) {
+        int k = frames < STREAM_PCM_MAX ? frames : STREAM_PCM_MAX;
+        if (rate == AUDIO_RATE && !ptp_clock) {
+            for (int f = 0; f < k; f++) {
+                s->sout[2 * f] = x[f * channels];
+                s->sout[2 * f + 1] = x[f * channels + r1];
+            }
+            stream_ring_push(&s->ring, s->sout, k, &s->stop);
+        } else {
+            if (k > STREAM_RS_SPACE(r)) k = STREAM_RS_SPACE(r);
+            for (int f = 0; f < k; f++) {
+                r->x[0][r->fill + f] = x[f * channels] * (1.0f / 32768.0f);
+                r->x[1][r->fill + f] = x[f * channels + r1] * (1.0f / 32768.0f);
+            }
+            r->fill += k;
+            // Источник идет по медиачасам PTP, вывод - по своему кварцу: шаг поправляется на их расхождение
+            if (ptp_clock) r->step = (double)r->in_rate / AUDIO_RATE / (1.0 + s->dac.ppb * 1e-9);
+            int n;
+            do {
+                n = stream_rs_run(r, s->fout, STREAM_PCM_MAX);
+                pcm_f32_to_s16(&s->conv, s->fout, s->sout, n * 2, 2);
+                stream_ring_push(&s->ring, s->sout, n, &s->stop);
+            } while (n == STREAM_PCM_MAX);
+        }
+        x += k * channels;
+        frames -= k;
+    }
+}
+
+// Сырые PCM 16 бит (WAV little-endian, L16 big-endian); кадр может разорваться между чтениями
+static void stream_pcm(stream_t *s, const uint8_t *p, int n, int big_endian) {
+    int ch = s->dec_channels, fb = 2 * ch;
+    int hi = big_endian ? 0 : 1, lo = 1 - hi;
+
+    while (n > 0 && !s->stop) {
+        if (s->part_fill > 0 || n < fb) {
+            int k = fb - s->part_fill < n ? fb - s->part_fill : n;
+            memcpy(s->part + s->part_fill, p, k);
+            s->part_fill += k;
+            p += k;
+            n -= k;
+            if (s->part_fill == fb) {
+                for (int c = 0; c < ch; c++) s->pcm[c] = (int16_t)(s->part[2 * c + hi] << 8 | s->part[2 * c + lo]);
+                stream_emit(s, s->pcm, 1, ch, s->dec_rate);
+                s->part_fill = 0;
+            }
+            continue;
+        }
+        int frames = n / fb < STREAM_PCM_MAX ? n / fb : STREAM_PCM_MAX;
+        for (int i = 0; i < frames * ch; i++) s->pcm[i] = (int16_t)(p[2 * i + hi] << 8 | p[2 * i + lo]);
+        stream_emit(s, s->pcm, frames, ch, s->dec_rate);
+        p += frames * fb;
+        n -= frames * fb;
+    }
+}
+
+static uint32_t stream_le(const uint8_t *p, int bytes) {
+    uint32_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+// Заголовок WAV: > 0 - смещение данных, 0 - нужно еще, < 0 - не PCM 16 бит
+static int stream_wav_header(stream_t *s) {
+    const uint8_t *h = s->hdr;
+    int fmt_ok = 0;
+
+    if (s->hdr_fill < 12) return 0;
+    if (memcmp(h, "RIFF", 4) != 0 || memcmp(h + 8, "WAVE", 4) != 0) return -1;
+    for (int off = 12; off + 8 <= s->hdr_fill; ) {
+        uint32_t size = stream_le(h + off + 4, 4);
+        if (memcmp(h + off, "fmt ", 4) == 0) {
+            if (off + 24 > s->hdr_fill) return 0;
+            int fmt = stream_le(h + off + 8, 2), bits = stream_le(h + off + 22, 2);
+            s->dec_channels = stream_le(h + off + 10, 2);
+            s->dec_rate = stream_le(h + off + 12, 4);
+            if ((fmt != 1 && fmt != 0xFFFE) || bits != 16 || s->dec_channels < 1 || s->dec_channels > 2 ||
+                s->dec_rate < 8000 || s->dec_rate > 192000) return -1;
+            fmt_ok = 1;
+        } else if (memcmp(h + off, "data", 4) == 0) {
+            return fmt_ok ? off + 8 : -1;
+        }
+        off += 8 + size + (size & 1);
+    }
+    return s->hdr_fill == STREAM_HDR_MAX ? -1 : 0;
+}
+
+#ifdef HAVE_MPG123
+static int stream_mp3(stream_t *s, const uint8_t *p, int n) {
+    mpg123_handle *mh = s->mp3;
+    size_t done;
+
+    if (mpg123_feed(mh, p, n) != MPG123_OK) {
+        printf("%sОшибка: mpg123: %s%s\n", COLOR_RED, mpg123_strerror(mh), COLOR_RESET);
+        return -1;
+    }
+    for (;;) {
+        int ret = mpg123_read(mh, (unsigned char *)s->pcm, sizeof(s->pcm), &done);
+        if (ret == MPG123_NEW_FORMAT) {
+            long rate;
+            int ch, enc;
+            mpg123_getformat(mh, &rate, &ch, &enc);
+            s->dec_rate = (int)rate;
+            s->dec_channels = ch;
+        }
+        if (done > 0) stream_emit(s, s->pcm, (int)(done / (2 * s->dec_channels)), s->dec_channels, s->dec_rate);
+        if (ret == MPG123_NEED_MORE || ret == MPG123_DONE) return 0;
+        if (ret == MPG123_ERR) {
+            printf("%sОшибка: mpg123: %s%s\n", COLOR_RED, mpg123_strerror(mh), COLOR_RESET);
+            return -1;
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_FAAD
+static void stream_aac_drop(stream_t *s, int k) {
+    memmove(s->aac_buf, s->aac_buf + k, s->aac_fill - k);
+    s->aac_fill -= k;
+}
+
+// ADTS: декодируем только целые кадры, после мусора ищем синхрослово
+static int stream_aac(stream_t *s, const uint8_t *p, int n) {
+    while (n > 0) {
+        int k = STREAM_AAC_BUF - s->aac_fill < n ? STREAM_AAC_BUF - s->aac_fill : n;
+        memcpy(s->aac_buf + s->aac_fill, p, k);
+        s->aac_fill += k;
+        p += k;
+        n -= k;
+        for (;;) {
+            const uint8_t *b = s->aac_buf;
+            int off = 0;
+            while (off + 7 <= s->aac_fill && !(b[off] == 0xFF && (b[off + 1] & 0xF6) == 0xF0)) off++;
+            if (off > 0) stream_aac_drop(s, off);
+            if (s->aac_fill < 7) break;
+            int len = (b[3] & 3) << 11 | b[4] << 3 | b[5] >> 5;
+            if (len < 7) {
+                stream_aac_drop(s, 1);
+                continue;
+            }
+            if (len > s->aac_fill) break;
+            if (!s->aac_ready) {
+                unsigned long rate;
+                unsigned char ch;
+                if (NeAACDecInit(s->aac, s->aac_buf, s->aac_fill, &rate, &ch) < 0) {
+                    stream_aac_drop(s, 1);
+                    continue;
+                }
+                s->aac_ready = 1;
+            }
+            NeAACDecFrameInfo fi;
+            int16_t *out = NeAACDecDecode(s->aac, &fi, s->aac_buf, len);
+            if (fi.error) {
+                if (s->aac_errors++ == 0) {
+                    printf("%sОшибка: faad: %s%s\n", COLOR_RED, NeAACDecGetErrorMessage(fi.error), COLOR_RESET);
+                }
+            } else if (out && fi.samples > 0 && fi.channels > 0) {
+                stream_emit(s, out, (int)(fi.samples / fi.channels), fi.channels, (int)fi.samplerate);
+            }
+            stream_aac_drop(s, len);
+        }
+    }
+    return 0;
+}
+#endif
+
+static int stream_codec_open(stream_t *s) {
+    s->hdr_fill = 0;
+    s->wav_ready = 0;
+    s->part_fill = 0;
+    s->aac_fill = 0;
+    s->aac_ready = 0;
+    s->aac_errors = 0;
+    switch (s->codec) {
+    case STREAM_CODEC_L16:
+        s->dec_rate = s->l16_rate;
+        s->dec_channels = s->l16_channels;
+        if (s->dec_channels < 1 || s->dec_channels > 2 || s->dec_rate < 8000) {
+            printf("%sОшибка: L16 %d Hz, %d ch не поддерживается%s\n", COLOR_RED, s->dec_rate, s->dec_channels, COLOR_RESET);
+            s->fatal = 1;
+            return -1;
+        }
+        return 0;
+    case STREAM_CODEC_MP3:
+#ifdef HAVE_MPG123
+    {
+        const long *rates;
+        size_t nrates;
+        int err;
+        mpg123_handle *mh = mpg123_new(NULL, &err);
+        if (!mh) {
+            printf("%sОшибка: mpg123: %s%s\n", COLOR_RED, mpg123_plain_strerror(err), COLOR_RESET);
+            return -1;
+        }
+        mpg123_param(mh, MPG123_ADD_FLAGS, MPG123_QUIET, 0);
+        // Только S16: дальше тот же путь, что у WAV
+        mpg123_format_none(mh);
+        mpg123_rates(&rates, &nrates);
+        for (size_t i = 0; i < nrates; i++) {
+            mpg123_format(mh, rates[i], MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
+        }
+        mpg123_open_feed(mh);
+        s->mp3 = mh;
+        s->dec_channels = 2;
+        return 0;
+    }
+#else
+        printf("%sОшибка: MP3 требует сборки с -DHAVE_MPG123 -lmpg123%s\n", COLOR_RED, COLOR_RESET);
+        s->fatal = 1;
+        return -1;
+#endif
+    case STREAM_CODEC_AAC:
+#ifdef HAVE_FAAD
+    {
+        NeAACDecHandle h = NeAACDecOpen();
+        NeAACDecConfigurationPtr cfg = NeAACDecGetCurrentConfiguration(h);
+        cfg->outputFormat = FAAD_FMT_16BIT;
+        cfg->downMatrix = 1;
+        NeAACDecSetConfiguration(h, cfg);
+        s->aac = h;
+        return 0;
+    }
+#else
+        printf("%sОшибка: AAC требует сборки с -DHAVE_FAAD -lfaad%s\n", COLOR_RED, COLOR_RESET);
+        s->fatal = 1;
+        return -1;
+#endif
+    default:
+        return 0;
+    }
+}
+
+static void stream_codec_close(stream_t *s) {
+#ifdef HAVE_MPG123
+    if (s->mp3) mpg123_delete(s->mp3);
+#endif
+#ifdef HAVE_FAAD
+    if (s->aac) NeAACDecClose(s->aac);
+#endif
+    s->mp3 = NULL;
+    s->aac = NULL;
+}
+
+// Тип потока без понятного Content-Type - по первым байтам
+static stream_codec_t stream_sniff(const uint8_t *p, int n) {
+    if (n >= 4 && memcmp(p, "RIFF", 4) == 0) return STREAM_CODEC_WAV;
+    if (n >= 3 && memcmp(p, "ID3", 3) == 0) return STREAM_CODEC_MP3;
+    if (n >= 2 && p[0] == 0xFF && (p[1] & 0xF6) == 0xF0) return STREAM_CODEC_AAC;
+    if (n >= 2 && p[0] == 0xFF && (p[1] & 0xE0) == 0xE0) return STREAM_CODEC_MP3;
+    return STREAM_CODEC_NONE;
+}
+
+static int stream_decode(stream_t *s, const uint8_t *p, int n) {
+    if (n <= 0) return 0;
+    if (s->codec == STREAM_CODEC_NONE) {
+        s->codec = stream_sniff(p, n);
+        if (s->codec == STREAM_CODEC_NONE) {
+            printf("%sОшибка: неизвестный формат потока%s\n", COLOR_RED, COLOR_RESET);
+            s->fatal = 1;
+            return -1;
+        }
+        if (stream_codec_open(s) != 0) return -1;
+    }
+    switch (s->codec) {
+    case STREAM_CODEC_WAV:
+        if (!s->wav_ready) {
+            int k = STREAM_HDR_MAX - s->hdr_fill < n ? STREAM_HDR_MAX - s->hdr_fill : n;
+            memcpy(s->hdr + s->hdr_fill, p, k);
+            s->hdr_fill += k;
+            int off = stream_wav_header(s);
+            if (off < 0) {
+                printf("%sОшибка: WAV: нужен PCM 16 бит, 1-2 канала%s\n", COLOR_RED, COLOR_RESET);
+                s->fatal = 1;
+                return -1;
+            }
+            if (off == 0) return 0;
+            s->wav_ready = 1;
+            stream_pcm(s, s->hdr + off, s->hdr_fill - off, 0);
+            p += k;
+            n -= k;
+        }
+        stream_pcm(s, p, n, 0);
+        return 0;
+    case STREAM_CODEC_L16:
+        stream_pcm(s, p, n, 1);
+        return 0;
+#ifdef HAVE_MPG123
+    case STREAM_CODEC_MP3:
+        return stream_mp3(s, p, n);
+#endif
+#ifdef HAVE_FAAD
+    case STREAM_CODEC_AAC:
+        return stream_aac(s, p, n);
+#endif
+    default:
+        return -1;
+    }
+}
+
+// StreamTitle='...'; из блока метаданных ICY
+static void stream_meta(stream_t *s) {
+    const char *t = strstr(s->meta, "StreamTitle='");
+    if (!t) return;
+    t += 13;
+    const char *e = strstr(t, "';");
+    int len = e ? (int)(e - t) : (int)strlen(t);
+    if (len >= (int)sizeof(s->title)) len = sizeof(s->title) - 1;
+    if ((int)strlen(s->title) == len && strncmp(s->title, t, len) == 0) return;
+    memcpy(s->title, t, len);
+    s->title[len] = '\0';
+    stream_log(COLOR_CYAN, "Now playing: %s", s->title);
+}
+
+// Звук и блоки метаданных каждые metaint байт
+static int stream_feed(stream_t *s, const uint8_t *p, int n) {
+    if (!s->metaint) return stream_decode(s, p, n);
+    while (n > 0) {
+        if (s->icy_left > 0) {
+            int k = n < s->icy_left ? n : s->icy_left;
+            if (stream_decode(s, p, k) != 0) return -1;
+            s->icy_left -= k;
+            p += k;
+            n -= k;
+        } else if (s->meta_len < 0) {
+            s->meta_len = p[0] * 16;
+            s->meta_got = 0;
+            p++;
+            n--;
+            if (s->meta_len == 0) {
+                s->meta_len = -1;
+                s->icy_left = s->metaint;
+            }
+        } else {
+            int k = n < s->meta_len - s->meta_got ? n : s->meta_len - s->meta_got;
+            memcpy(s->meta + s->meta_got, p, k);
+            s->meta_got += k;
+            p += k;
+            n -= k;
+            if (s->meta_got == s->meta_len) {
+                s->meta[s->meta_got] = '\0';
+                stream_meta(s);
+                s->meta_len = -1;
+                s->icy_left = s->metaint;
+            }
+        }
+    }
+    return 0;
+}
+
+static int stream_header(const char *hdrs, const char *name, char *val, int len) {
+    int nl = strlen(name);
+    for (const char *l = hdrs; l && *l; l = strchr(l, '\n') ? strchr(l, '\n') + 1 : NULL) {
+        if (strncasecmp(l, name, nl) != 0 || l[nl] != ':') continue;
+        l += nl + 1;
+        while (*l == ' ' || *l == '\t') l++;
+        int k = strcspn(l, "\r\n");
+        if (k >= len) k = len - 1;
+        memcpy(val, l, k);
+        val[k] = '\0';
+        return 1;
+    }
+    return 0;
+}
+
+static int stream_parse_url(const char *url, char *host, int hlen, char *port, int plen, const char **path) {
+    if (strncasecmp(url, "http://", 7) != 0) {
+        printf("%sОшибка: поддерживается только http:// (%s)%s\n", COLOR_RED, url, COLOR_RESET);
+        return -1;
+    }
+    const char *h = url + 7;
+    int alen = strcspn(h, "/?#");
+    const char *colon = memchr(h, ':', alen);
+    int hl = colon ? (int)(colon - h) : alen;
+    if (hl == 0 || hl >= hlen) return -1;
+    memcpy(host, h, hl);
+    host[hl] = '\0';
+    snprintf(port, plen, "%.*s", colon ? alen - hl - 1 : 2, colon ? colon + 1 : "80");
+    *path = h[alen] ? h + alen : "/";
+    return 0;
+}
+
+static int stream_dial(const char *host, const char *port) {
+    struct addrinfo hints = {0}, *res, *ai;
+    struct timeval tv = { STREAM_TIMEOUT_MS / 1000, (STREAM_TIMEOUT_MS % 1000) * 1000 };
+    int fd = -1;
+
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(host, port, &hints, &res);
+    if (err != 0) {
+        printf("%sОшибка: %s: %s%s\n", COLOR_RED, host, gai_strerror(err), COLOR_RESET);
+        return -1;
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        // На Linux SO_SNDTIMEO ограничивает и connect()
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    if (fd < 0) printf("%sОшибка: подключение к %s:%s: %s%s\n", COLOR_RED, host, port, strerror(errno), COLOR_RESET);
+    freeaddrinfo(res);
+    return fd;
+}
+
+// Подключение с переходами по Location; начало тела ответа остается в body
+static int stream_open(stream_t *s, uint8_t *body, int body_max) {
+    char url[STREAM_URL_MAX], host[128], port[16], req[STREAM_URL_MAX + 512];
+    char hdrs[STREAM_HDR_MAX + 1], val[256];
+    const char *path;
+
+    snprintf(url, sizeof(url), "%s", s->url);
+    for (int hop = 0; hop <= STREAM_MAX_REDIRECTS && !s->stop; hop++) {
+        if (stream_parse_url(url, host, sizeof(host), port, sizeof(port), &path) != 0) {
+            s->fatal = 1;
+            return -1;
+        }
+        int fd = stream_dial(host, port);
+        if (fd < 0) return -1;
+        if (s->t_connect == 0) s->t_connect = stream_now();
+
+        int len = snprintf(req, sizeof(req),
+                           "GET %s HTTP/1.0\r\nHost: %s\r\nUser-Agent: fm_ctrl\r\nAccept: */*\r\n"
+                           "Icy-MetaData: 1\r\nConnection: close\r\n\r\n", path, host);
+        if (send(fd, req, len, MSG_NOSIGNAL) != len) {
+            printf("%sОшибка: запрос к %s: %s%s\n", COLOR_RED, host, strerror(errno), COLOR_RESET);
+            close(fd);
+            return -1;
+        }
+
+        // Заголовки до пустой строки
+        int fill = 0;
+        char *end = NULL;
+        while (!end && fill < STREAM_HDR_MAX) {
+            int n = recv(fd, hdrs + fill, STREAM_HDR_MAX - fill, 0);
+            if (n <= 0) break;
+            fill += n;
+            hdrs[fill] = '\0';
+            end = strstr(hdrs, "\r\n\r\n");
+        }
+        if (!end) {
+            printf("%sОшибка: %s: нет заголовков ответа%s\n", COLOR_RED, host, COLOR_RESET);
+            close(fd);
+            return -1;
+        }
+        *end = '\0';
+        int code = 0;
+        sscanf(hdrs, "%*s %d", &code);
+        if (code >= 301 && code <= 308 && stream_header(hdrs, "Location", val, sizeof(val))) {
+            close(fd);
+            if (val[0] == '/') snprintf(url, sizeof(url), "http://%s:%s%s", host, port, val);
+            else snprintf(url, sizeof(url), "%s", val);
+            stream_log("", "redirect to %s", url);
+            continue;
+        }
+        if (code != 200) {
+            printf("%sОшибка: %s: %.*s%s\n", COLOR_RED, host, (int)strcspn(hdrs, "\r\n"), hdrs, COLOR_RESET);
+            close(fd);
+            return -1;
+        }
+        if (s->t_headers == 0) s->t_headers = stream_now();
+
+        s->metaint = stream_header(hdrs, "icy-metaint", val, sizeof(val)) ? atoi(val) : 0;
+        s->icy_left = s->metaint;
+        s->meta_len = -1;
+        if (!stream_header(hdrs, "icy-name", s->name, sizeof(s->name))) s->name[0] = '\0';
+        s->codec = STREAM_CODEC_NONE;
+        if (stream_header(hdrs, "Content-Type", val, sizeof(val))) {
+            if (strncasecmp(val, "audio/mpeg", 10) == 0 || strncasecmp(val, "audio/mp3", 9) == 0) {
+                s->codec = STREAM_CODEC_MP3;
+            } else if (strncasecmp(val, "audio/aac", 9) == 0 || strncasecmp(val, "audio/x-aac", 11) == 0) {
+                s->codec = STREAM_CODEC_AAC;    // И audio/aacp (HE-AAC)
+            } else if (strcasestr(val, "wav")) {
+                s->codec = STREAM_CODEC_WAV;
+            } else if (strncasecmp(val, "audio/L16", 9) == 0) {
+                const char *r = strcasestr(val, "rate="), *c = strcasestr(val, "channels=");
+                s->codec = STREAM_CODEC_L16;
+                s->l16_rate = r ? atoi(r + 5) : 44100;
+                s->l16_channels = c ? atoi(c + 9) : 1;
+            }
+        }
+        stream_log("", "connected to %s:%s%s%s (%s%s)", host, port, s->name[0] ? ": " : "", s->name,
+                   stream_codec_names[s->codec], s->metaint ? ", ICY metadata" : "");
+
+        int rest = fill - (int)(end + 4 - hdrs);
+        if (rest > body_max) rest = body_max;
+        memcpy(body, end + 4, rest);
+        s->fd = fd;
+        return rest;
+    }
+    if (!s->stop) printf("%sОшибка: больше %d переадресаций%s\n", COLOR_RED, STREAM_MAX_REDIRECTS, COLOR_RESET);
+    return -1;
+}
+
+// Сетевой поток: подключение, прием, декодирование; повтор с растущей паузой и разбросом
+static void *stream_net(void *arg) {
+    stream_t *s = arg;
+    static uint8_t buf[STREAM_NET_BUF];
+    int backoff = STREAM_BACKOFF_MIN_MS;
+
+    srand((unsigned)time(NULL) ^ (unsigned)getpid());
+    while (!s->stop && !s->fatal) {
+        int n = stream_open(s, buf, sizeof(buf));
+        if (n >= 0) {
+            s->t_session = stream_now();
+            if (s->codec == STREAM_CODEC_NONE || stream_codec_open(s) == 0) {
+                while (!s->stop) {
+                    s->bytes += n;
+                    if (stream_feed(s, buf, n) != 0) break;
+                    n = recv(s->fd, buf, sizeof(buf), 0);
+                    if (n == 0) {
+                        if (!s->stop) stream_log(COLOR_YELLOW, "server closed the stream");
+                        break;
+                    }
+                    if (n < 0) {
+                        if (!s->stop) stream_log(COLOR_YELLOW, "receive: %s", errno == EAGAIN ? "timeout" : strerror(errno));
+                        break;
+                    }
+                }
+            }
+            int fd = s->fd;
+            s->fd = -1;
+            close(fd);
+            stream_codec_close(s);
+            if (stream_now() - s->t_session >= STREAM_STABLE_S) backoff = STREAM_BACKOFF_MIN_MS;
+        }
+        if (s->stop || s->fatal) break;
+
+        // Половина паузы фиксирована, половина случайна: платы не переподключаются хором
+        int delay = backoff / 2 + rand() % (backoff / 2 + 1);
+        s->reconnects++;
+        stream_log(COLOR_YELLOW, "reconnecting in %.1f s", delay / 1000.0);
+        for (int t = 0; t < delay && !s->stop; t += 50) usleep(50000);
+        backoff = backoff * 2 < STREAM_BACKOFF_MAX_MS ? backoff * 2 : STREAM_BACKOFF_MAX_MS;
+    }
+    s->done = 1;
+    return NULL;
+}
+
+// VmRSS / VmHWM из /proc/self/status, МБ
+double stream_mem_mb(const char *key) {
+    char line[128];
+    long kb = 0;
+    int len = strlen(key);
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) return 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key, len) == 0 && line[len] == ':') {
+            kb = atol(line + len + 1);
+            break;
+        }
+    }
+    fclose(f);
+    return kb / 1024.0;
+}
+
+static double stream_cpu(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+// Строка состояния: память, процессор и сеть за интервал с прошлого вызова
+static void stream_report(stream_t *s, double *wall0, double *cpu0, long long *bytes0) {
+    double wall = stream_now(), cpu = stream_cpu(), dt = wall - *wall0;
+    uint32_t fill = s->ring.head - s->ring.tail;
+
+    stream_log("", "RSS %.1f MB (peak %.1f MB), CPU %.1f%%, buffer %u ms, %.0f kbit/s, %ld underruns, %ld reconnects",
+               stream_mem_mb("VmRSS"), stream_mem_mb("VmHWM"), dt > 0 ? (cpu - *cpu0) / dt * 100.0 : 0.0,
+               fill * 1000 / AUDIO_RATE, dt > 0 ? (s->bytes - *bytes0) * 8.0 / 1000.0 / dt : 0.0,
+               s->underruns, s->reconnects);
+    if (ptp_clock) {
+        char state[256];
+        ptp_format(ptp_clock, state, sizeof(state));
+        stream_log("", "output %+.3f ppm against PTP, %s", s->dac.ppb / 1000.0, state);
+    }
+    *wall0 = wall;
+    *cpu0 = cpu;
+    *bytes0 = s->bytes;
+}
+
+// Режим --stream: поток вывода ждет предзаполнения, затем берет из кольца по периоду
+int stream_main(const char *url, const char *play_dev, int prebuffer_ms, pcm_dither_t dither) {
+    static stream_t s;
+    audio_dev_t out;
+    int16_t period[STREAM_P * 2];
+    int playing = 0;
+    double rebuffer_at = 0;
+
+    // Все буферы - в одной статической структуре; memset заодно делает страницы резидентными
+    memset(&s, 0, sizeof(s));
+    snprintf(s.url, sizeof(s.url), "%s", url);
+    s.fd = -1;
+    s.prebuffer = (int)((long)prebuffer_ms * AUDIO_RATE / 1000);
+    if (s.prebuffer < STREAM_P) s.prebuffer = STREAM_P;
+    if (s.prebuffer > STREAM_RING_FRAMES - 4 * STREAM_P) s.prebuffer = STREAM_RING_FRAMES - 4 * STREAM_P;
+    pcm_conv_init(&s.conv, dither);
+#ifdef HAVE_MPG123
+    mpg123_init();
+#endif
+    if (audio_open(&out, play_dev, AUDIO_PACED, AUDIO_RATE, AUDIO_CHANNELS) != 0) return 1;
+
+    printf("Streaming %s to %s, prebuffer %d ms\n", url, play_dev, s.prebuffer * 1000 / AUDIO_RATE);
+    fflush(stdout);
+    s.t_start = stream_now();
+    if (rt_thread_create(&s.thread, RT_ROLE_CONTROL, stream_net, &s) != 0) {
+        printf("%sОшибка: сетевой поток не создан%s\n", COLOR_RED, COLOR_RESET);
+        audio_close(&out);
+        return 1;
+    }
+    if (rt_enabled) rt_set_current(RT_ROLE_AUDIO);
+
+    double wall0 = s.t_start, cpu0 = stream_cpu(), next_report = s.t_start + STREAM_STATS_S;
+    long long bytes0 = 0;
+    while (global_tx->running && !(s.done && s.ring.head == s.ring.tail)) {
+        uint32_t avail = __atomic_load_n(&s.ring.head, __ATOMIC_ACQUIRE) - s.ring.tail;
+
+        if (!playing && avail < (uint32_t)s.prebuffer && !s.done) {
+            // До первого звука устройство не трогаем; после - держим его тишиной
+            if (s.t_audio == 0) {
+                usleep(2000);
+                continue;
+            }
+            memset(period, 0, sizeof(period));
+        } else {
+            if (!playing) {
+                playing = 1;
+                if (rebuffer_at > 0) s.rebuffer_s += stream_now() - rebuffer_at;
+            }
+            int n = stream_ring_pull(&s.ring, period, STREAM_P);
+            if (n < STREAM_P) {
+                memset(period + 2 * n, 0, (STREAM_P - n) * 2 * sizeof(int16_t));
+                if (!s.done) {
+                    s.underruns++;
+                    playing = 0;
+                    rebuffer_at = stream_now();
+                    stream_log(COLOR_YELLOW, "buffer empty, refilling %d ms", s.prebuffer * 1000 / AUDIO_RATE);
+                }
+            }
+        }
+        if (audio_write(&out, period, STREAM_P) < 0) break;
+        if (ptp_clock) ptp_dac_update(ptp_clock, &s.dac, out.frames - audio_delay(&out), AUDIO_RATE);
+
+        double now = stream_now();
+        if (s.t_audio == 0 && playing) {
+            s.t_audio = now;
+            stream_log(COLOR_GREEN, "first audio after %.0f ms (connect %.0f, headers %.0f, decoded %.0f)",
+                       (now - s.t_start) * 1000.0, (s.t_connect - s.t_start) * 1000.0,
+                       (s.t_headers - s.t_start) * 1000.0, (s.t_decoded - s.t_start) * 1000.0);
+        }
+        if (now >= next_report) {
+            stream_report(&s, &wall0, &cpu0, &bytes0);
+            next_report = now + STREAM_STATS_S;
+        }
+    }
+
+    // Прием может стоять в recv() - будим его закрытием сокета
+    s.stop = 1;
+    if (s.fd >= 0) shutdown(s.fd, SHUT_RDWR);
+    for (int t = 0; t < 100 && !s.done; t++) usleep(10000);
+    if (s.done) pthread_join(s.thread, NULL);
+    else pthread_detach(s.thread);
+
+    double total = stream_now() - s.t_start;
+    printf("\n%sStream summary:%s\n", BOLD, COLOR_RESET);
+    if (s.t_audio > 0) printf("  Time to first audio: %.0f ms\n", (s.t_audio - s.t_start) * 1000.0);
+    else printf("  Time to first audio: -\n");
+    printf("  Played %.1f s, received %.1f MB, %ld reconnects, %ld underruns (%.1f s refilling)\n",
+           total, s.bytes / (1024.0 * 1024.0), s.reconnects, s.underruns, s.rebuffer_s);
+    printf("  RSS %.1f MB, peak %.1f MB, CPU %.2f%% of one core\n",
+           stream_mem_mb("VmRSS"), stream_mem_mb("VmHWM"), total > 0 ? stream_cpu() / total * 100.0 : 0.0);
+    audio_close(&out);
+    return s.fatal ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#ifndef FM_STREAM_H
+#define FM_STREAM_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "fm.h"
+#include "fm_audio.h"
+#include "fm_pcm.h"
+#include "fm_ptp.h"
+
+// Клиент интернет-радио HTTP/ICY вместо VLC: сеть -> декодер -> кольцо -> I2S
+#define STREAM_RING_FRAMES    131072   // Кольцо 48 кГц стерео, кадров (степень двойки, ~2.7 с)
+#define STREAM_PREBUFFER_MS   500      // Наполнение кольца перед стартом и после опустошения
+#define STREAM_NET_BUF        16384    // Чтение из сокета за раз
+#define STREAM_HDR_MAX        8192     // Заголовки ответа
+#define STREAM_MAX_REDIRECTS  5
+#define STREAM_TIMEOUT_MS     10000    // Нет данных - переподключение
+#define STREAM_BACKOFF_MIN_MS 500      // Пауза перед повтором, удваивается до максимума
+#define STREAM_BACKOFF_MAX_MS 30000
+#define STREAM_STABLE_S       30       // Столько проиграли без сбоя - пауза снова минимальная
+#define STREAM_STATS_S        60       // Период строки RSS/CPU
+#define STREAM_PCM_MAX        8192     // Кадров от декодера за раз (MP3 1152, AAC 2048 с SBR)
+#define STREAM_AAC_BUF        16384    // Накопление кадров ADTS
+#define STREAM_RS_TAPS        32       // Отводов на фазу ресемплера (кратно 4)
+#define STREAM_RS_PHASES      128      // Фаз полифазного фильтра
+#define STREAM_RS_CUTOFF      0.45     // Срез относительно меньшей из частот
+#define STREAM_URL_MAX        512
+
+typedef enum {
+    STREAM_CODEC_NONE = 0,
+    STREAM_CODEC_WAV,                  // RIFF/WAVE, PCM 16 бит
+    STREAM_CODEC_L16,                  // audio/L16, big-endian
+    STREAM_CODEC_MP3,                  // libmpg123 (-DHAVE_MPG123)
+    STREAM_CODEC_AAC                   // libfaad2, ADTS (-DHAVE_FAAD)
+} stream_codec_t;
+
+// Кольцо одного производителя и одного потребителя, без блокировок
+typedef struct {
+    int16_t buf[STREAM_RING_FRAMES * 2];
+    volatile uint32_t head;            // Пишет сетевой поток
+    volatile uint32_t tail;            // Пишет поток вывода
+} stream_ring_t;
+
+// Полифазный ресемплер к AUDIO_RATE
+typedef struct {
+    int in_rate;
+    double step;                       // Входных отсчетов на выходной
+    double pos;                        // Позиция следующего выходного отсчета в x
+    int fill;                          // Входных кадров в x
+    float taps[(STREAM_RS_PHASES + 1) * STREAM_RS_TAPS] __attribute__((aligned(16)));
+    float x[2][STREAM_RS_TAPS + STREAM_PCM_MAX] __attribute__((aligned(16)));
+} stream_rs_t;
+
+#define STREAM_RS_SPACE(r) (STREAM_RS_TAPS + STREAM_PCM_MAX - (r)->fill)
+
+typedef struct {
+    char url[STREAM_URL_MAX];
+    int prebuffer;                     // Кадров
+    // Текущее соединение
+    int fd;
+    stream_codec_t codec;
+    int metaint;                       // icy-metaint, 0 - без метаданных
+    int icy_left;                      // Байт звука до следующего блока метаданных
+    int meta_len, meta_got;
+    char meta[16 * 255 + 1];
+    char name[128];
+    char title[256];
+    int l16_rate, l16_channels;
+    // Декодер
+    uint8_t hdr[STREAM_HDR_MAX];       // Заголовок WAV
+    int hdr_fill;
+    int wav_ready;
+    uint8_t part[4];                   // Неполный кадр PCM между чтениями
+    int part_fill;
+    void *mp3;                         // mpg123_handle *
+    void *aac;                         // NeAACDecHandle
+    int aac_ready;
+    long aac_errors;
+    uint8_t aac_buf[STREAM_AAC_BUF];
+    int aac_fill;
+    int16_t pcm[STREAM_PCM_MAX * 2];
+    float fout[STREAM_PCM_MAX * 2];
+    int16_t sout[STREAM_PCM_MAX * 2];
+    int dec_rate, dec_channels;        // Формат, который отдает декодер
+    int rate, channels;                // Формат, под который настроен ресемплер
+    stream_rs_t rs;
+    ptp_dac_t dac;                     // С --ptp: ход вывода против медиачасов, шаг ресемплера
+    pcm_conv_t conv;
+    stream_ring_t ring;
+    // Состояние и статистика
+    pthread_t thread;
+    volatile int stop;
+    volatile int fatal;                // Формат не поддерживается этой сборкой
+    volatile int done;                 // Сетевой поток завершился
+    double t_start, t_connect, t_headers, t_decoded, t_audio;
+    double t_session;                  // Начало текущего соединения
+    long long bytes;
+    long reconnects, underruns;
+    double rebuffer_s;
+} stream_t;
+
+void stream_ring_push(stream_ring_t *r, const int16_t *x, int frames, const volatile int *stop);
+int stream_ring_pull(stream_ring_t *r, int16_t *x, int frames);
+void stream_rs_init(stream_rs_t *r, int in_rate);
+int stream_rs_run(stream_rs_t *r, float *out, int max);
+double stream_mem_mb(const char *key);
+int stream_main(const char *url, const char *play_dev, int prebuffer_ms, pcm_dither_t dither);
+
+#endif // FM_STREAM_H
@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "fm.h"
+#include "fm_tui.h"
+
+// Запрос состояния устройства и ответ "все в порядке"
+#define TUI_DSR      "\033[5n"
+#define TUI_DSR_OK   "\033[0n"
+
+tui_out_t tui_out = { .fd = -1 };
+
+static double tui_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Отдельное открытие stdout с O_NONBLOCK: флаг не задевает stdin того же терминала.
+// Обычный файл открывать заново нельзя (другое смещение), он и так не блокирует
+void tui_init(void) {
+    struct stat st;
+    tui_out.interval = 1.0 / REFRESH_RATE;
+    if (fstat(STDOUT_FILENO, &st) == 0 && !S_ISREG(st.st_mode)) {
+        tui_out.fd = open("/proc/self/fd/1", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    }
+    if (tui_out.fd < 0) tui_out.fd = dup(STDOUT_FILENO);
+    tui_out.ack = isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+    tui_out.win_at = tui_now();
+}
+
+// Без ответов DSR: байт, еще не прочитанных из pty или канала
+static int tui_queued(void) {
+    int n = 0;
+    if (ioctl(tui_out.fd, TIOCOUTQ, &n) == 0) return n;
+    if (ioctl(tui_out.fd, FIONREAD, &n) == 0) return n;
+    return 0;
+}
+
+// Дописать хвост кадра, сколько примет терминал
+static void tui_flush_pending(void) {
+    tui_out_t *t = &tui_out;
+    while (t->pend_off < t->pend_len) {
+        ssize_t n = write(t->fd, t->pending + t->pend_off, t->pend_len - t->pend_off);
+        if (n > 0) {
+            t->pend_off += n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            if (n < 0 && errno != EAGAIN) t->pend_off = t->pend_len;  // Терминал пропал
+            return;
+        }
+    }
+}
+
+static void tui_slower(void) {
+    tui_out_t *t = &tui_out;
+    t->interval *= 1.25;
+    if (t->interval > 1.0 / TUI_MIN_FPS) t->interval = 1.0 / TUI_MIN_FPS;
+}
+
+static void tui_faster(void) {
+    tui_out_t *t = &tui_out;
+    t->interval *= 0.95;
+    if (t->interval < 1.0 / REFRESH_RATE) t->interval = 1.0 / REFRESH_RATE;
+}
+
+// Кадр дошел до экрана. Задержка сверх минимальной - это очередь в пути:
+// если она больше периода, терминал не успевает и кадры идут реже
+static void tui_acked(double now) {
+    tui_out_t *t = &tui_out;
+    int slot = t->acked % TUI_INFLIGHT;
+    double d = now - t->sent_at[slot];
+
+    t->acked++;
+    t->delay = d;
+    t->win_bytes += t->sent_len[slot];
+    if (t->base_delay == 0 || d < t->base_delay) t->base_delay = d;
+    else t->base_delay += (d - t->base_delay) / 64;  // Медленно следует за ростом RTT
+    if (d - t->base_delay > t->interval) tui_slower();
+    else tui_faster();
+}
+
+// Чтение ввода: ответы терминала отделяются от нажатий клавиш
+static void tui_read_input(void) {
+    tui_out_t *t = &tui_out;
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+
+    while (t->in_len < (int)sizeof(t->in) && poll(&pfd, 1, 0) > 0) {
+        ssize_t n = read(STDIN_FILENO, t->in + t->in_len, sizeof(t->in) - t->in_len);
+        if (n <= 0) break;
+        t->in_len += n;
+    }
+
+    int len = strlen(TUI_DSR_OK);
+    for (int i = 0; i + len <= t->in_len; ) {
+        if (memcmp(t->in + i, TUI_DSR_OK, len) != 0) {
+            i++;
+            continue;
+        }
+        memmove(t->in + i, t->in + i + len, t->in_len - i - len);
+        t->in_len -= len;
+        if (t->acked < t->sent) tui_acked(tui_now());
+    }
+}
+
+// Есть нажатие; начало ответа терминала ждет продолжения
+static int tui_key_ready(void) {
+    tui_out_t *t = &tui_out;
+    if (t->in_len == 0) return 0;
+    return !(t->in_len < (int)strlen(TUI_DSR_OK) && memcmp(t->in, TUI_DSR_OK, t->in_len) == 0);
+}
+
+// Нажатая клавиша или -1
+int tui_getch(void) {
+    tui_out_t *t = &tui_out;
+    tui_read_input();
+    if (!tui_key_ready()) return -1;
+    int ch = (unsigned char)t->in[0];
+    memmove(t->in, t->in + 1, --t->in_len);
+    return ch;
+}
+
+// Пора ли собирать кадр. Кадр, время которого пришло, пока прошлые не дошли
+// до экрана, пропускается: на экран всегда идет самый свежий
+int tui_frame_due(int force) {
+    tui_out_t *t = &tui_out;
+    double now = tui_now();
+
+    tui_flush_pending();
+    if (t->acked < t->sent) tui_read_input();  // В ручном режиме ввод читает getchar()
+    int queued = t->ack ? 0 : tui_queued();
+
+    // Ответа нет: с самого начала - терминал не умеет DSR, иначе ответ потерян
+    if (t->ack && t->acked < t->sent && now - t->sent_at[t->acked % TUI_INFLIGHT] > TUI_ACK_TIMEOUT) {
+        if (t->acked == 0) t->ack = 0;
+        t->acked = t->sent;
+    }
+
+    if (force) {
+        tui_drain();
+        return 1;
+    }
+    if (now - t->last_at < t->interval) return 0;
+    if (t->pend_off < t->pend_len || queued > TUI_BACKLOG || (t->ack && t->sent - t->acked >= TUI_INFLIGHT)) {
+        t->dropped++;
+        t->last_at = now;
+        if (!t->ack) tui_slower();
+        return 0;
+    }
+    if (!t->ack) tui_faster();
+    return 1;
+}
+
+void tui_printf(const char *fmt, ...) {
+    tui_out_t *t = &tui_out;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(t->frame + t->len, TUI_FRAME_MAX - t->len, fmt, ap);
+    va_end(ap);
+    if (n > 0) t->len += n < TUI_FRAME_MAX - t->len ? n : TUI_FRAME_MAX - 1 - t->len;
+}
+
+// Отправка собранного кадра; wait - дождаться, пока терминал примет его целиком.
+// В ручном режиме ответы DSR не запрашиваются: ввод там читает getchar()
+void tui_frame_end(int wait) {
+    tui_out_t *t = &tui_out;
+    double now = tui_now();
+
+    if (t->ack && !wait && t->sent - t->acked < TUI_INFLIGHT) {
+        int slot = t->sent % TUI_INFLIGHT;
+        tui_printf("%s", TUI_DSR);
+        t->sent_at[slot] = now;
+        t->sent_len[slot] = t->len;
+        t->sent++;
+    } else if (!t->ack) {
+        t->win_bytes += t->len;
+    }
+
+    // Текст, напечатанный через stdio, должен уйти раньше кадра
+    fflush(stdout);
+    memcpy(t->pending, t->frame, t->len);
+    t->pend_off = 0;
+    t->pend_len = t->len;
+    t->len = 0;
+    tui_flush_pending();
+    if (wait) tui_drain();
+
+    t->frames++;
+    t->win_frames++;
+    t->last_at = now;
+    if (now - t->win_at >= TUI_STATS_S) {
+        t->fps = t->win_frames / (now - t->win_at);
+        t->rate = t->win_bytes / (now - t->win_at);
+        t->win_frames = 0;
+        t->win_bytes = 0;
+        t->win_at = now;
+    }
+}
+
+// Дописать хвост кадра с ожиданием, перед выводом через stdio и при выходе
+void tui_drain(void) {
+    tui_out_t *t = &tui_out;
+    struct pollfd pfd = { t->fd, POLLOUT, 0 };
+    while (t->pend_off < t->pend_len) {
+        tui_flush_pending();
+        if (t->pend_off < t->pend_len && poll(&pfd, 1, 100) < 0 && errno != EINTR) break;
+    }
+}
+
+// Дождаться ответов на все запросы, чтобы они не попали в getchar() ручного режима
+void tui_sync(void) {
+    tui_out_t *t = &tui_out;
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    double until = tui_now() + TUI_ACK_TIMEOUT;
+
+    tui_drain();
+    while (t->acked < t->sent && tui_now() < until) {
+        poll(&pfd, 1, 50);
+        tui_read_input();
+    }
+    if (t->acked == 0 && t->sent > 0) t->ack = 0;
+    t->acked = t->sent;
+}
+
+// Ожидание следующего кадра; нажатие клавиши прерывает ожидание сразу,
+// а хвост кадра дописывается по мере освобождения терминала
+void tui_wait(void) {
+    tui_out_t *t = &tui_out;
+    struct pollfd pfd[2] = { { STDIN_FILENO, POLLIN, 0 }, { t->fd, POLLOUT, 0 } };
+
+    for (;;) {
+        if (tui_key_ready()) return;
+        double left = t->last_at + t->interval - tui_now();
+        if (left <= 0) return;
+        int pending = t->pend_off < t->pend_len;
+        int r = poll(pfd, pending ? 2 : 1, (int)(left * 1000) + 1);
+        if (r < 0 && errno != EINTR) return;
+        if (r > 0 && (pfd[0].revents & POLLIN)) {
+            // Ответ терминала - не повод рисовать раньше времени
+            tui_read_input();
+            if (tui_key_ready()) return;
+        }
+        if (pending && (pfd[1].revents & POLLOUT)) tui_flush_pending();
+        if (!global_tx || !global_tx->running) return;
+    }
+}
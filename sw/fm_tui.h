@@ -0,0 +1,52 @@
+#ifndef FM_TUI_H
+#define FM_TUI_H
+
+#include "fm.h"
+
+// Вывод интерфейса с учетом очереди до экрана: кадр собирается в памяти и пишется
+// без блокировки. В конце кадра - запрос состояния терминала (DSR), ответ на него
+// приходит, когда терминал нарисовал все до него, даже через буферы ssh и TCP.
+// Пока кадры не дошли, новые пропускаются, так что на экран идет самый свежий
+#define TUI_FRAME_MAX      16384
+#define TUI_MIN_FPS        2         // Нижний предел частоты кадров
+#define TUI_INFLIGHT       2         // Кадров в пути до экрана, дальше - пропуск
+#define TUI_BACKLOG        512       // Без ответов DSR: байт в очереди pty для пропуска
+#define TUI_ACK_TIMEOUT    2.0       // Ответа нет - терминал не умеет DSR или ответ потерян
+#define TUI_STATS_S        1.0       // Окно подсчета FPS и скорости
+
+typedef struct {
+    int fd;                          // Свой неблокирующий дескриптор stdout
+    char frame[TUI_FRAME_MAX];
+    int len;                         // Собираемый кадр
+    char pending[TUI_FRAME_MAX];
+    int pend_off, pend_len;          // Недописанный хвост прошлого кадра
+    double interval;                 // Текущий период кадров, с
+    double last_at;                  // Время последнего кадра или пропуска
+    // Подтверждения DSR
+    int ack;                         // 1 - терминал отвечает на DSR
+    long sent, acked;                // Кадров с запросом / ответов
+    double sent_at[TUI_INFLIGHT];
+    int sent_len[TUI_INFLIGHT];
+    double base_delay;               // Минимальная задержка до экрана (без очереди)
+    double delay;                    // Задержка последнего подтвержденного кадра
+    char in[32];                     // Ввод: клавиши вперемешку с ответами терминала
+    int in_len;
+    // Статистика
+    long frames, dropped;
+    long win_frames, win_bytes;
+    double win_at;
+    double fps, rate;                // Кадров/с и байт/с до экрана за окно
+} tui_out_t;
+
+extern tui_out_t tui_out;
+
+void tui_init(void);
+int tui_frame_due(int force);
+void tui_printf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+void tui_frame_end(int wait);
+int tui_getch(void);
+void tui_drain(void);
+void tui_sync(void);
+void tui_wait(void);
+
+#endif // FM_TUI_H
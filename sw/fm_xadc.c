@@ -0,0 +1,706 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "fm.h"
+#include "fm_rt.h"
+#include "fm_xadc.h"
+
+// Телеметрия этого процесса для интерфейса и --serve
+xadc_t *xadc_active = NULL;
+
+static const char *xadc_action_names[] = {"none", "warn", "mute", "off"};
+
+static double xadc_now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void xadc_log(const char *color, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void xadc_log(const char *color, const char *fmt, ...) {
+    struct timespec ts;
+    struct tm tm;
+    char stamp[16];
+    va_list ap;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    localtime_r(&ts.tv_sec, &tm);
+    strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+    printf("%s[xadc] %s ", color, stamp);
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("%s\n", COLOR_RESET);
+    fflush(stdout);
+}
+
+// Атрибуты sysfs: одна строка на файл
+static int xadc_read_attr(const char *dir, const char *name, char *out, size_t size) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    int ok = fgets(out, size, f) != NULL;
+    fclose(f);
+    if (!ok) return -1;
+    out[strcspn(out, "\n")] = 0;
+    return 0;
+}
+
+static int xadc_read_double(const char *dir, const char *name, double *value) {
+    char buf[64];
+    if (xadc_read_attr(dir, name, buf, sizeof(buf)) != 0) return -1;
+    *value = atof(buf);
+    return 0;
+}
+
+static int xadc_write_attr(const char *dir, const char *name, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static int xadc_write_attr(const char *dir, const char *name, const char *fmt, ...) {
+    char path[512];
+    va_list ap;
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    va_start(ap, fmt);
+    vfprintf(f, fmt, ap);
+    va_end(ap);
+    // Ошибка драйвера приходит при сбросе буфера
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+// Устройство IIO с именем xadc в каталоге шины
+static int xadc_find(const char *bus, char *out, size_t size) {
+    DIR *d = opendir(bus);
+    struct dirent *e;
+    int found = -1;
+
+    if (!d) return -1;
+    while (found < 0 && (e = readdir(d))) {
+        char dir[300], name[64];
+        if (strncmp(e->d_name, "iio:device", 10) != 0) continue;
+        snprintf(dir, sizeof(dir), "%s/%s", bus, e->d_name);
+        if (xadc_read_attr(dir, "name", name, sizeof(name)) == 0 && strcmp(name, XADC_NAME) == 0) {
+            snprintf(out, size, "%s", dir);
+            found = 0;
+        }
+    }
+    closedir(d);
+    return found;
+}
+
+// Триггер по окончанию последовательности АЦП. Драйвер называет его "%s%d-%s":
+// для iio:device0 это "xadc0-samplerate". Триггеры лежат рядом с устройством
+static int xadc_find_trigger(const char *devdir, const char *devname, char *out, size_t size) {
+    char bus[300], want[80];
+    const char *base = strrchr(devdir, '/');
+    struct dirent *e;
+    int id = -1, found = -1;
+
+    if (base) snprintf(bus, sizeof(bus), "%.*s", base == devdir ? 1 : (int)(base - devdir), devdir);
+    else snprintf(bus, sizeof(bus), ".");
+    if (sscanf(base ? base + 1 : devdir, "iio:device%d", &id) == 1) {
+        snprintf(want, sizeof(want), "%s%d-samplerate", devname, id);
+    } else {
+        want[0] = '\0';
+    }
+
+    DIR *d = opendir(bus);
+    if (!d) return -1;
+    while (found < 0 && (e = readdir(d))) {
+        char dir[600], name[80];
+        if (strncmp(e->d_name, "trigger", 7) != 0) continue;
+        snprintf(dir, sizeof(dir), "%s/%s", bus, e->d_name);
+        if (xadc_read_attr(dir, "name", name, sizeof(name)) != 0) continue;
+        size_t len = strlen(name), plen = strlen(devname), slen = strlen("-samplerate");
+        // Номер устройства неизвестен (каталог не iio:deviceN) - первый "<имя>N-samplerate"
+        if (want[0] ? strcmp(name, want) == 0
+                    : len > plen + slen && strncmp(name, devname, plen) == 0 &&
+                      strcmp(name + len - slen, "-samplerate") == 0) {
+            snprintf(out, size, "%s", name);
+            found = 0;
+        }
+    }
+    closedir(d);
+    return found;
+}
+
+// Метка канала: in_temp0 -> temp, in_voltage0_vccint -> vccint, in_voltage8 -> voltage8
+static void xadc_label(const char *base, char *out, size_t size) {
+    const char *s = base + 3;
+    if (strncmp(s, "temp", 4) == 0) {
+        snprintf(out, size, "temp");
+        return;
+    }
+    const char *u = strchr(s, '_');
+    snprintf(out, size, "%s", u ? u + 1 : s);
+}
+
+static int xadc_cmp_index(const void *a, const void *b) {
+    return ((const xadc_chan_t *)a)->index - ((const xadc_chan_t *)b)->index;
+}
+
+// Каналы буфера из scan_elements: включение, порядок, формат, масштаб
+static int xadc_scan(xadc_t *x) {
+    char scan[320];
+    DIR *d;
+    struct dirent *e;
+
+    snprintf(scan, sizeof(scan), "%s/scan_elements", x->dir);
+    if (!(d = opendir(scan))) return -1;
+    x->nch = 0;
+    while ((e = readdir(d)) && x->nch < XADC_MAX_CHANNELS) {
+        size_t len = strlen(e->d_name);
+        if (len < 4 || strcmp(e->d_name + len - 3, "_en") != 0) continue;
+
+        xadc_chan_t *c = &x->ch[x->nch];
+        char attr[96], type[32], common[64];
+        memset(c, 0, sizeof(*c));
+        snprintf(c->base, sizeof(c->base), "%.*s", (int)(len - 3), e->d_name);
+
+        // Метку времени не берем: записи остаются из одних отсчетов
+        if (strcmp(c->base, "in_timestamp") == 0) {
+            xadc_write_attr(scan, e->d_name, "0");
+            continue;
+        }
+        if (strncmp(c->base, "in_temp", 7) != 0 && strncmp(c->base, "in_voltage", 10) != 0) continue;
+
+        snprintf(attr, sizeof(attr), "%s_index", c->base);
+        double index;
+        if (xadc_read_double(scan, attr, &index) != 0) continue;
+        snprintf(attr, sizeof(attr), "%s_type", c->base);
+        if (xadc_read_attr(scan, attr, type, sizeof(type)) != 0) continue;
+        // "le:u12/16>>4"
+        char endian, sign;
+        if (sscanf(type, "%ce:%c%d/%d>>%d", &endian, &sign, &c->bits, &c->storage, &c->shift) != 5 ||
+            c->storage % 8 || c->storage > 64 || c->bits > c->storage) {
+            printf("%sОшибка: формат канала %s не поддерживается: %s%s\n", COLOR_RED, c->base, type, COLOR_RESET);
+            continue;
+        }
+        if (xadc_write_attr(scan, e->d_name, "1") != 0) continue;
+
+        c->index = (int)index;
+        c->big_endian = endian == 'b';
+        c->is_signed = sign == 's';
+        c->is_temp = strncmp(c->base, "in_temp", 7) == 0;
+        xadc_label(c->base, c->label, sizeof(c->label));
+
+        // Масштаб и смещение: свои у канала или общие для типа
+        snprintf(common, sizeof(common), "%s", c->is_temp ? "in_temp" : "in_voltage");
+        snprintf(attr, sizeof(attr), "%s_scale", c->base);
+        if (xadc_read_double(x->dir, attr, &c->scale) != 0) {
+            snprintf(attr, sizeof(attr), "%s_scale", common);
+            if (xadc_read_double(x->dir, attr, &c->scale) != 0) c->scale = 1.0;
+        }
+        snprintf(attr, sizeof(attr), "%s_offset", c->base);
+        if (xadc_read_double(x->dir, attr, &c->offset) != 0) {
+            snprintf(attr, sizeof(attr), "%s_offset", common);
+            if (xadc_read_double(x->dir, attr, &c->offset) != 0) c->offset = 0;
+        }
+        c->all_min = INFINITY;
+        c->all_max = -INFINITY;
+        x->nch++;
+    }
+    closedir(d);
+    if (x->nch == 0) return -1;
+
+    // Запись буфера: каналы по scan_index, каждый выровнен по своему размеру
+    qsort(x->ch, x->nch, sizeof(x->ch[0]), xadc_cmp_index);
+    int off = 0, align = 1;
+    for (int i = 0; i < x->nch; i++) {
+        int bytes = x->ch[i].storage / 8;
+        off = (off + bytes - 1) / bytes * bytes;
+        x->ch[i].offset_bytes = off;
+        off += bytes;
+        if (bytes > align) align = bytes;
+    }
+    x->record = (off + align - 1) / align * align;
+    return 0;
+}
+
+// XADC_LIMIT=КАНАЛ,MIN,MAX,warn|mute|off в общем конфиге; без них - запасы по даташиту Zynq-7000
+static void xadc_load_limits(xadc_t *x, const char *path) {
+    static const char *defaults[] = {
+        "temp,,80,warn", "temp,,85,off",             // Коммерческий диапазон: Tj до 85 °C
+        "vccint,0.95,1.05,warn", "vccbram,0.95,1.05,warn", "vccaux,1.71,1.89,warn"
+    };
+    char lines[XADC_MAX_LIMITS][256];
+    int n = 0;
+
+    FILE *f = fopen(path, "r");
+    if (f) {
+        char line[256];
+        while (fgets(line, sizeof(line), f) && n < XADC_MAX_LIMITS) {
+            if (strncmp(line, "XADC_LIMIT=", 11) != 0) continue;
+            line[strcspn(line, "\n")] = 0;
+            snprintf(lines[n++], sizeof(lines[0]), "%s", line + 11);
+        }
+        fclose(f);
+    }
+    if (n == 0) {
+        for (n = 0; n < (int)(sizeof(defaults) / sizeof(defaults[0])); n++) {
+            snprintf(lines[n], sizeof(lines[0]), "%s", defaults[n]);
+        }
+    }
+
+    x->nlimits = 0;
+    for (int i = 0; i < n; i++) {
+        xadc_limit_t *l = &x->limits[x->nlimits];
+        char *field[4] = {0}, *s = lines[i];
+        int nf = 0;
+        while (nf < 4 && (field[nf++] = strsep(&s, ",")));
+        if (!field[3]) {
+            printf("%sОшибка: XADC_LIMIT=%s: нужно КАНАЛ,MIN,MAX,ДЕЙСТВИЕ%s\n", COLOR_RED, lines[i], COLOR_RESET);
+            continue;
+        }
+        memset(l, 0, sizeof(*l));
+        snprintf(l->label, sizeof(l->label), "%s", field[0]);
+        l->lo = field[1][0] ? atof(field[1]) : NAN;
+        l->hi = field[2][0] ? atof(field[2]) : NAN;
+        l->action = XADC_ACT_NONE;
+        for (int a = XADC_ACT_WARN; a <= XADC_ACT_OFF; a++) {
+            if (strcmp(field[3], xadc_action_names[a]) == 0) l->action = a;
+        }
+        if (l->action == XADC_ACT_NONE) {
+            printf("%sОшибка: XADC_LIMIT=%s: действие warn, mute или off%s\n", COLOR_RED, lines[i], COLOR_RESET);
+            continue;
+        }
+        l->chan = -1;
+        for (int c = 0; c < x->nch; c++) {
+            if (strcmp(x->ch[c].label, l->label) == 0) l->chan = c;
+        }
+        if (l->chan < 0) {
+            printf("%sXADC: no channel %s, limit ignored%s\n", COLOR_YELLOW, l->label, COLOR_RESET);
+            continue;
+        }
+        x->nlimits++;
+    }
+}
+
+// Отсчет канала из записи буфера в °C или В
+static double xadc_decode(const xadc_chan_t *c, const uint8_t *rec) {
+    const uint8_t *p = rec + c->offset_bytes;
+    int bytes = c->storage / 8;
+    uint64_t v = 0;
+
+    for (int i = 0; i < bytes; i++) {
+        v |= (uint64_t)p[c->big_endian ? bytes - 1 - i : i] << (8 * i);
+    }
+    v >>= c->shift;
+    if (c->bits < 64) v &= (1ULL << c->bits) - 1;
+    int64_t raw = (int64_t)v;
+    if (c->is_signed && c->bits < 64 && (v >> (c->bits - 1)) & 1) raw -= (int64_t)1 << c->bits;
+    return (raw + c->offset) * c->scale / 1000.0;
+}
+
+// Биты CTRL по действию; восстанавливается только то, что поменяла телеметрия
+static void xadc_apply(xadc_t *x, xadc_action_t want) {
+    uint32_t ctrl = fm_read(x->tx, REG_CTRL), next = ctrl;
+
+    if (want >= XADC_ACT_MUTE) {
+        if (!(ctrl & CTRL_MUTE_BIT)) {
+            next |= CTRL_MUTE_BIT;
+            x->muted_by_us = 1;
+        }
+    } else if (x->muted_by_us) {
+        next &= ~CTRL_MUTE_BIT;
+        x->muted_by_us = 0;
+    }
+    if (want >= XADC_ACT_OFF) {
+        if (ctrl & 0x1) {
+            next &= ~0x1u;
+            x->off_by_us = 1;
+        }
+    } else if (x->off_by_us) {
+        next |= 0x1;
+        x->off_by_us = 0;
+    }
+    // Через fm_write: --health принимает запись как ожидаемое состояние
+    if (next != ctrl) {
+        fm_write(x->tx, REG_CTRL, next);
+        x->changes++;
+    }
+}
+
+// Конец окна: публикация и пороги по худшему значению в окне
+static void xadc_window(xadc_t *x, double t) {
+    xadc_action_t want = XADC_ACT_NONE;
+    const char *why = "";
+
+    pthread_mutex_lock(&x->lock);
+    for (int i = 0; i < x->nch; i++) {
+        xadc_chan_t *c = &x->ch[i];
+        if (c->wn == 0) continue;
+        c->min = c->wmin;
+        c->max = c->wmax;
+        c->mean = c->wsum / c->wn;
+        if (c->min < c->all_min) c->all_min = c->min;
+        if (c->max > c->all_max) c->all_max = c->max;
+        c->wn = 0;
+    }
+    x->windows++;
+    x->last_window = xadc_now();
+    pthread_mutex_unlock(&x->lock);
+
+    for (int i = 0; i < x->nlimits; i++) {
+        xadc_limit_t *l = &x->limits[i];
+        xadc_chan_t *c = &x->ch[l->chan];
+        const char *unit = c->is_temp ? "°C" : "V";
+        int over_hi = !isnan(l->hi) && c->max > l->hi;
+        int over_lo = !isnan(l->lo) && c->min < l->lo;
+
+        if (over_hi || over_lo) {
+            l->inside_since = 0;
+            if (++l->over >= XADC_TRIP_WINDOWS && !l->tripped) {
+                l->tripped = 1;
+                x->trips++;
+                xadc_log(l->action >= XADC_ACT_MUTE ? COLOR_RED : COLOR_YELLOW, "%s %.3f %s %s %.3f: %s",
+                         c->label, over_hi ? c->max : c->min, unit, over_hi ? "above" : "below",
+                         over_hi ? l->hi : l->lo, xadc_action_names[l->action]);
+            }
+        } else {
+            l->over = 0;
+            // Отпускание - только с запасом и не раньше XADC_RELEASE_SEC
+            double h_hi = c->is_temp ? XADC_HYST_TEMP : XADC_HYST_VOLT * fabs(l->hi);
+            double h_lo = c->is_temp ? XADC_HYST_TEMP : XADC_HYST_VOLT * fabs(l->lo);
+            int clear = (isnan(l->hi) || c->max <= l->hi - h_hi) && (isnan(l->lo) || c->min >= l->lo + h_lo);
+            if (l->tripped && clear) {
+                if (l->inside_since == 0) l->inside_since = t;
+                if (t - l->inside_since >= XADC_RELEASE_SEC) {
+                    l->tripped = 0;
+                    l->inside_since = 0;
+                    xadc_log(COLOR_GREEN, "%s back in limits (%.3f..%.3f %s), %s released",
+                             c->label, c->min, c->max, unit, xadc_action_names[l->action]);
+                }
+            } else {
+                l->inside_since = 0;
+            }
+        }
+        if (l->tripped && l->action > want) {
+            want = l->action;
+            why = l->label;
+        }
+    }
+
+    pthread_mutex_lock(&x->lock);
+    x->action = want;
+    snprintf(x->reason, sizeof(x->reason), "%s", why);
+    pthread_mutex_unlock(&x->lock);
+    // Повтор на каждом окне: пока порог превышен, ручное включение не держится
+    xadc_apply(x, want);
+}
+
+static void *xadc_thread(void *arg) {
+    xadc_t *x = arg;
+    size_t chunk = x->standin ? (size_t)(x->rate / 10) + 1 : XADC_READ_RECORDS;
+    if (chunk > XADC_READ_RECORDS) chunk = XADC_READ_RECORDS;
+    uint8_t *buf = malloc((size_t)XADC_READ_RECORDS * x->record);
+    size_t have = 0;
+    double window_start = x->standin ? 0 : xadc_now();
+    struct timespec next;
+
+    if (!buf) return NULL;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!x->stop && x->tx->running) {
+        if (!x->standin) {
+            struct pollfd p = {x->fd, POLLIN, 0};
+            if (poll(&p, 1, 200) <= 0) continue;
+        }
+        ssize_t n = read(x->fd, buf + have, chunk * x->record - have);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EINTR) continue;
+            xadc_log(COLOR_RED, "read failed: %s", strerror(errno));
+            break;
+        }
+        if (n == 0) {
+            // Подмена кончилась; у устройства read() без данных не возвращает 0
+            if (x->standin) xadc_log(COLOR_YELLOW, "stand-in data ended");
+            x->ended = 1;
+            break;
+        }
+        have += n;
+        size_t records = have / x->record;
+
+        for (size_t r = 0; r < records; r++) {
+            const uint8_t *rec = buf + r * x->record;
+            for (int i = 0; i < x->nch; i++) {
+                xadc_chan_t *c = &x->ch[i];
+                double v = xadc_decode(c, rec);
+                if (c->wn == 0 || v < c->wmin) c->wmin = v;
+                if (c->wn == 0 || v > c->wmax) c->wmax = v;
+                c->wsum = c->wn ? c->wsum + v : v;
+                c->wn++;
+            }
+            x->records++;
+            // Подмена: время по числу записей, устройство: по часам
+            double t = x->standin ? x->records / x->rate : xadc_now();
+            if (t - window_start >= XADC_WINDOW_SEC) {
+                window_start = t;
+                xadc_window(x, t);
+            }
+        }
+        have -= records * x->record;
+        memmove(buf, buf + records * x->record, have);
+
+        // Подмена читается в темпе sampling_frequency
+        if (x->standin) {
+            long ns = (long)(records / x->rate * 1e9);
+            next.tv_sec += ns / 1000000000L;
+            next.tv_nsec += ns % 1000000000L;
+            if (next.tv_nsec >= 1000000000L) {
+                next.tv_nsec -= 1000000000L;
+                next.tv_sec++;
+            }
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !x->stop);
+        }
+    }
+    free(buf);
+    return NULL;
+}
+
+int xadc_start(xadc_t *x, fm_transmitter_t *tx, const char *dev) {
+    char name[64], trigger[80];
+
+    x->tx = tx;
+    x->fd = -1;
+    // DIR - само устройство или каталог шины с iio:deviceN и triggerN, как в sysfs
+    if (dev && xadc_read_attr(dev, "name", name, sizeof(name)) == 0) snprintf(x->dir, sizeof(x->dir), "%s", dev);
+    else if (xadc_find(dev ? dev : XADC_IIO_DIR, x->dir, sizeof(x->dir)) != 0) {
+        printf("%sОшибка: устройство IIO %s не найдено в %s%s\n", COLOR_RED, XADC_NAME, dev ? dev : XADC_IIO_DIR, COLOR_RESET);
+        return -1;
+    }
+    // Подмена - любой каталог вне sysfs; записи буфера в файле data
+    x->standin = strncmp(x->dir, "/sys/", 5) != 0;
+    if (xadc_read_attr(x->dir, "name", name, sizeof(name)) != 0) {
+        printf("%sОшибка: %s - не устройство IIO%s\n", COLOR_RED, x->dir, COLOR_RESET);
+        return -1;
+    }
+    if (x->standin) {
+        snprintf(x->dev, sizeof(x->dev), "%s/data", x->dir);
+    } else {
+        const char *base = strrchr(x->dir, '/');
+        snprintf(x->dev, sizeof(x->dev), "/dev/%s", base ? base + 1 : x->dir);
+    }
+
+    // Каналы и триггер меняются только при выключенном буфере
+    xadc_write_attr(x->dir, "buffer/enable", "0");
+    if (xadc_scan(x) != 0) {
+        printf("%sОшибка: нет каналов в %s/scan_elements%s\n", COLOR_RED, x->dir, COLOR_RESET);
+        return -1;
+    }
+    // Подмена проходит тот же поиск: без триггера буфер не пойдет и на плате
+    if (xadc_find_trigger(x->dir, name, trigger, sizeof(trigger)) != 0) {
+        printf("%sОшибка: нет триггера %s<N>-samplerate рядом с %s%s\n", COLOR_RED, name, x->dir, COLOR_RESET);
+        return -1;
+    }
+    if (xadc_write_attr(x->dir, "trigger/current_trigger", "%s", trigger) != 0) {
+        printf("%sОшибка: не могу выбрать триггер %s%s\n", COLOR_RED, trigger, COLOR_RESET);
+        return -1;
+    }
+    // Частоту выбирает драйвер из допустимых - берем ту, что он выставил
+    if (!x->standin) xadc_write_attr(x->dir, "sampling_frequency", "%d", XADC_SAMPLE_HZ);
+    if (xadc_read_double(x->dir, "sampling_frequency", &x->rate) != 0 || x->rate <= 0) x->rate = XADC_SAMPLE_HZ;
+    xadc_write_attr(x->dir, "buffer/length", "%d", XADC_BUFFER_LEN);
+    if (xadc_write_attr(x->dir, "buffer/enable", "1") != 0 && !x->standin) {
+        printf("%sОшибка: не могу включить буфер %s: %s%s\n", COLOR_RED, x->dir, strerror(errno), COLOR_RESET);
+        return -1;
+    }
+    x->fd = open(x->dev, O_RDONLY | (x->standin ? 0 : O_NONBLOCK));
+    if (x->fd < 0) {
+        printf("%sОшибка: не могу открыть %s: %s%s\n", COLOR_RED, x->dev, strerror(errno), COLOR_RESET);
+        xadc_write_attr(x->dir, "buffer/enable", "0");
+        return -1;
+    }
+
+    xadc_load_limits(x, CONFIG_FILE);
+    pthread_mutex_init(&x->lock, NULL);
+    printf("XADC %s%s: %d channels, %d-byte records at %.0f Hz, trigger %s, %d limits\n",
+           x->dir, x->standin ? " (stand-in)" : "", x->nch, x->record, x->rate, trigger, x->nlimits);
+    fflush(stdout);
+    xadc_active = x;
+    if (rt_thread_create(&x->thread, RT_ROLE_SAMPLER, xadc_thread, x) != 0) {
+        xadc_active = NULL;
+        close(x->fd);
+        xadc_write_attr(x->dir, "buffer/enable", "0");
+        return -1;
+    }
+    return 0;
+}
+
+void xadc_stop(xadc_t *x) {
+    x->stop = 1;
+    pthread_join(x->thread, NULL);
+    xadc_active = NULL;
+    close(x->fd);
+    xadc_write_attr(x->dir, "buffer/enable", "0");
+
+    // Действие по порогу при выходе остается: передатчик не включается сам
+    printf("%sXADC: %ld windows, %ld records, %ld trip%s%s%s%s\n", BOLD, x->windows, x->records,
+           x->trips, x->trips == 1 ? "" : "s", x->action ? ", still " : "",
+           x->action ? xadc_action_names[x->action] : "", COLOR_RESET);
+    for (int i = 0; i < x->nch; i++) {
+        xadc_chan_t *c = &x->ch[i];
+        if (c->all_min > c->all_max) continue;
+        printf("  %-10s %9.3f .. %-9.3f %s\n", c->label, c->all_min, c->all_max, c->is_temp ? "°C" : "V");
+    }
+}
+
+int xadc_format(xadc_t *x, char *out, size_t size) {
+    size_t n = 0;
+
+    pthread_mutex_lock(&x->lock);
+    if (x->windows == 0 || xadc_now() - x->last_window > XADC_STATUS_STALE * XADC_WINDOW_SEC) {
+        pthread_mutex_unlock(&x->lock);
+        return -1;
+    }
+    for (int i = 0; i < x->nch && n < size; i++) {
+        xadc_chan_t *c = &x->ch[i];
+        char label[24];
+        for (int k = 0; k < (int)sizeof(label); k++) {
+            label[k] = c->label[k] >= 'a' && c->label[k] <= 'z' ? c->label[k] - 32 : c->label[k];
+        }
+        n += snprintf(out + n, size - n, c->is_temp ? "%s=%.1f/%.1f/%.1f " : "%s=%.3f/%.3f/%.3f ",
+                      label, c->mean, c->min, c->max);
+    }
+    if (n < size) {
+        snprintf(out + n, size - n, "ACTION=%s%s%s", xadc_action_names[x->action],
+                 x->action ? ":" : "", x->reason);
+    }
+    pthread_mutex_unlock(&x->lock);
+    return 0;
+}
+
+int xadc_tui_line(xadc_t *x, char *out, size_t size) {
+    size_t n = 0;
+    int shown = 0, action;
+
+    pthread_mutex_lock(&x->lock);
+    if (x->windows == 0 || xadc_now() - x->last_window > XADC_STATUS_STALE * XADC_WINDOW_SEC) {
+        pthread_mutex_unlock(&x->lock);
+        snprintf(out, size, "XADC  no data");
+        return -1;
+    }
+    n += snprintf(out + n, size - n, "XADC ");
+    // Температура и первые три шины питания - в одну строку
+    for (int i = 0; i < x->nch && n < size; i++) {
+        xadc_chan_t *c = &x->ch[i];
+        if (c->is_temp) {
+            n += snprintf(out + n, size - n, " %.1f°C (%.1f-%.1f)", c->mean, c->min, c->max);
+        } else if (shown < 3) {
+            n += snprintf(out + n, size - n, "  %s %.3f", c->label, c->mean);
+            shown++;
+        }
+    }
+    action = x->action;
+    if (action && n < size) {
+        snprintf(out + n, size - n, "  %s: %s", action == XADC_ACT_OFF ? "CARRIER OFF" :
+                 action == XADC_ACT_MUTE ? "MUTED" : "WARN", x->reason);
+    }
+    pthread_mutex_unlock(&x->lock);
+    return action;
+}
+
+// Подмена: нагрев до 88 °C и остывание, провал VCCINT; формат, масштабы и имена триггеров
+// как у драйвера Zynq. DIR устроен как шина sysfs: iio:device0 и trigger0/1 рядом
+int xadc_gen(const char *bus, int seconds) {
+    static const struct { const char *base; int index; double volts; } rails[] = {
+        {"in_voltage0_vccint", 9, 1.0}, {"in_voltage1_vccaux", 10, 1.8}, {"in_voltage2_vccbram", 14, 1.0},
+        {"in_voltage3_vccpint", 15, 1.0}, {"in_voltage4_vccpaux", 16, 1.8}, {"in_voltage5_vccoddr", 17, 1.5}
+    };
+    const int nrails = sizeof(rails) / sizeof(rails[0]);
+    const int rate = 100;
+    const double temp_scale = 503975.0 / 4096, temp_offset = -2219, volt_scale = 3000.0 / 4096;
+    char dir[300], sub[320], path[320];
+
+    if (seconds <= 0) seconds = 120;
+    mkdir(bus, 0755);
+    snprintf(dir, sizeof(dir), "%s/iio:device0", bus);
+    const char *dirs[] = {"", "/scan_elements", "/buffer", "/trigger"};
+    for (int i = 0; i < 4; i++) {
+        snprintf(sub, sizeof(sub), "%s%s", dir, dirs[i]);
+        if (mkdir(sub, 0755) != 0 && errno != EEXIST) {
+            printf("%sОшибка: не могу создать %s: %s%s\n", COLOR_RED, sub, strerror(errno), COLOR_RESET);
+            return 1;
+        }
+    }
+    // Драйвер регистрирует два триггера; буферу нужен samplerate
+    const char *triggers[] = {"samplerate", "convst"};
+    for (int i = 0; i < 2; i++) {
+        snprintf(sub, sizeof(sub), "%s/trigger%d", bus, i);
+        if (mkdir(sub, 0755) != 0 && errno != EEXIST) {
+            printf("%sОшибка: не могу создать %s: %s%s\n", COLOR_RED, sub, strerror(errno), COLOR_RESET);
+            return 1;
+        }
+        xadc_write_attr(sub, "name", "%s0-%s\n", XADC_NAME, triggers[i]);
+    }
+    snprintf(sub, sizeof(sub), "%s/scan_elements", dir);
+    xadc_write_attr(dir, "name", "%s\n", XADC_NAME);
+    xadc_write_attr(dir, "sampling_frequency", "%d\n", rate);
+    xadc_write_attr(dir, "buffer/length", "%d\n", XADC_BUFFER_LEN);
+    xadc_write_attr(dir, "buffer/enable", "0\n");
+    xadc_write_attr(dir, "trigger/current_trigger", "\n");
+    xadc_write_attr(dir, "in_temp0_scale", "%.9f\n", temp_scale);
+    xadc_write_attr(dir, "in_temp0_offset", "%.0f\n", temp_offset);
+    xadc_write_attr(sub, "in_temp0_en", "0\n");
+    xadc_write_attr(sub, "in_temp0_index", "8\n");
+    xadc_write_attr(sub, "in_temp0_type", "le:u12/16>>4\n");
+    for (int i = 0; i < nrails; i++) {
+        char attr[80];
+        snprintf(attr, sizeof(attr), "%s_scale", rails[i].base);
+        xadc_write_attr(dir, attr, "%.9f\n", volt_scale);
+        snprintf(attr, sizeof(attr), "%s_en", rails[i].base);
+        xadc_write_attr(sub, attr, "0\n");
+        snprintf(attr, sizeof(attr), "%s_index", rails[i].base);
+        xadc_write_attr(sub, attr, "%d\n", rails[i].index);
+        snprintf(attr, sizeof(attr), "%s_type", rails[i].base);
+        xadc_write_attr(sub, attr, "le:u12/16>>4\n");
+    }
+
+    snprintf(path, sizeof(path), "%s/data", dir);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        printf("%sОшибка: не могу создать %s: %s%s\n", COLOR_RED, path, strerror(errno), COLOR_RESET);
+        return 1;
+    }
+    // Записи по scan_index: температура (8) первой
+    srand(1);
+    long total = (long)seconds * rate;
+    for (long n = 0; n < total; n++) {
+        double p = (double)n / total;
+        double temp = p < 0.4 ? 55 + 33 * p / 0.4 : p < 0.55 ? 88 : p < 0.75 ? 88 - 28 * (p - 0.55) / 0.2 : 60;
+        uint8_t rec[2 * 7];
+        double values[7];
+
+        values[0] = temp + 0.3 * (rand() / (double)RAND_MAX - 0.5);
+        for (int i = 0; i < nrails; i++) {
+            values[i + 1] = rails[i].volts + 0.0015 * (rand() / (double)RAND_MAX - 0.5);
+        }
+        // Провал VCCINT на 3 с на трети записи
+        if (n >= total * 0.3 && n < total * 0.3 + 3 * rate) values[1] = 0.93;
+
+        for (int i = 0; i < 7; i++) {
+            double code = i == 0 ? values[i] * 1000 / temp_scale - temp_offset : values[i] * 1000 / volt_scale;
+            int raw = (int)lround(code);
+            if (raw < 0) raw = 0;
+            if (raw > 4095) raw = 4095;
+            rec[2 * i] = (uint8_t)(raw << 4);
+            rec[2 * i + 1] = (uint8_t)(raw >> 4);
+        }
+        fwrite(rec, sizeof(rec), 1, f);
+    }
+    fclose(f);
+    printf("XADC stand-in in %s: %d s at %d Hz, temperature to 88 °C and a VCCINT dip at %d s\n",
+           bus, seconds, rate, (int)(seconds * 0.3));
+    printf("Run: fm_ctrl --sim FILE --xadc %s\n", bus);
+    return 0;
+}
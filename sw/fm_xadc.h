@@ -0,0 +1,95 @@
+#ifndef FM_XADC_H
+#define FM_XADC_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "fm.h"
+
+// Телеметрия XADC (температура кристалла, питание) через буфер IIO с триггером:
+// окна min/max/среднее рядом с состоянием передатчика, пороги глушат или снимают несущую
+#define XADC_IIO_DIR        "/sys/bus/iio/devices"
+#define XADC_NAME           "xadc"
+#define XADC_MAX_CHANNELS   16
+#define XADC_MAX_LIMITS     16
+#define XADC_SAMPLE_HZ      1000          // Запрашиваемая частота; драйвер может выставить свою
+#define XADC_BUFFER_LEN     4096          // Записей в буфере ядра
+#define XADC_READ_RECORDS   512           // Записей за один read()
+#define XADC_WINDOW_SEC     1             // Окно агрегации
+#define XADC_TRIP_WINDOWS   2             // Окон подряд за порогом до срабатывания
+#define XADC_RELEASE_SEC    30            // Столько внутри порога с запасом - действие снимается
+#define XADC_HYST_TEMP      5.0           // Запас отпускания, °C
+#define XADC_HYST_VOLT      0.01          // Запас отпускания, доля порога
+#define XADC_STATUS_STALE   5             // Окон без данных - телеметрия пропала
+
+typedef enum {
+    XADC_ACT_NONE = 0,
+    XADC_ACT_WARN,                        // Только сообщение и красный цвет
+    XADC_ACT_MUTE,                        // Бит MUTE: снимается модуляция
+    XADC_ACT_OFF                          // Несущая выключается (TX), как защита по перегреву
+} xadc_action_t;
+
+typedef struct {
+    char label[24];                       // "temp", "vccint", ...
+    char base[48];                        // Имя в sysfs: "in_temp0", "in_voltage0_vccint"
+    int index;                            // scan_index: порядок в записи буфера
+    int is_signed, big_endian, bits, storage, shift;
+    int offset_bytes;                     // Смещение в записи
+    double scale, offset;                 // (raw + offset) * scale: м°C или мВ
+    int is_temp;
+    // Текущее окно (поток телеметрии)
+    double wmin, wmax, wsum;
+    long wn;
+    // Опубликованное окно и крайние значения за работу
+    double min, max, mean;
+    double all_min, all_max;
+} xadc_chan_t;
+
+// XADC_LIMIT=КАНАЛ,MIN,MAX,warn|mute|off (пустая граница - не проверяется)
+typedef struct {
+    char label[24];
+    double lo, hi;                        // NAN - нет границы
+    xadc_action_t action;
+    int chan;                             // Индекс канала, -1 - нет в устройстве
+    int over;                             // Окон подряд за порогом
+    int tripped;
+    double inside_since;                  // Время возврата внутрь с запасом
+} xadc_limit_t;
+
+typedef struct {
+    fm_transmitter_t *tx;
+    char dir[300];                        // Каталог устройства в sysfs (или подмена)
+    char dev[320];                        // Символьное устройство буфера (или файл подмены)
+    int standin;                          // Подмена: чтение в темпе sampling_frequency
+    int fd;
+    double rate;
+    int record;                           // Байт в записи
+    xadc_chan_t ch[XADC_MAX_CHANNELS];
+    int nch;
+    xadc_limit_t limits[XADC_MAX_LIMITS];
+    int nlimits;
+    // Действие и что им изменено (восстанавливается только свое)
+    xadc_action_t action;
+    int muted_by_us, off_by_us;
+    char reason[64];
+    long windows, records, trips;
+    volatile long changes;                // Записей CTRL по порогам: интерфейс перечитывает состояние
+    double last_window;                   // CLOCK_MONOTONIC последнего окна
+    pthread_mutex_t lock;                 // Опубликованные окна и действие
+    pthread_t thread;
+    volatile int stop;
+    volatile int ended;                   // Конец файла подмены
+} xadc_t;
+
+extern xadc_t *xadc_active;
+
+int xadc_start(xadc_t *x, fm_transmitter_t *tx, const char *dev);
+void xadc_stop(xadc_t *x);
+// Строка "TEMP=mean/min/max VCCINT=..." для --serve; -1 - нет свежих окон
+int xadc_format(xadc_t *x, char *out, size_t size);
+// Строка интерфейса; возвращает xadc_action_t или -1, если свежих окон нет
+int xadc_tui_line(xadc_t *x, char *out, size_t size);
+// Подмена шины IIO в каталоге: iio:device0 с теми же атрибутами и файлом data, trigger0/1
+int xadc_gen(const char *bus, int seconds);
+
+#endif // FM_XADC_H